@@ -10,13 +10,19 @@
 #import "BookmarkCollectionViewCell.h"
 #import "BookmarkCollectionViewCellDelegate.h"
 #import "NSString+MD5.h"
+#import "CatMemoryManager.h"
+#import "CatBookmarkStore.h"
 
 @interface BookmarkCollectionViewController ()<BookmarkCollectionViewCellDelegate>
 {
     BookmarkCollectionViewCell* firstCell;
     UIImage* _snapShot;
-    NSMutableArray* favoritesEntries;
+    CatBookmarkList* bookmarks;
+    NSUInteger selfIndex;               // in bookmarks, or NSNotFound
+    NSDictionary* selfEntry;
+    NSMutableDictionary* toggledEntries;    // row -> entry
     NSMutableDictionary* imagesCache;
+    id memoryToken;
 }
 
 @end
@@ -26,27 +32,13 @@
 
 - (void) viewDidLoad
 {
-    NSString *bundlePath = [[NSBundle mainBundle] resourcePath];
-    NSError *error = nil;
-    NSString* directory =[bundlePath stringByAppendingPathComponent:@"bookmarks"];
-    if(![[NSFileManager defaultManager] fileExistsAtPath:directory]) {
-        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
-    }
     imagesCache = [NSMutableDictionary dictionary];
-    NSData* data = [NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:@"bookmark.txt"]];
-    NSDictionary* dico = data ? [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:&error] : @{@"favorites":@[]};
-
-    favoritesEntries = [(NSArray*)[dico objectForKey:@"favorites"] mutableCopy];
-    NSDictionary* selfEntry = nil;
-    for (int i=0;i<[favoritesEntries count];i++) {
-        NSDictionary* entry = [favoritesEntries objectAtIndex:i];
-        if([[entry objectForKey:@"location"] isEqualToString:[self location]]) {
-            selfEntry = entry;
-            [favoritesEntries removeObjectAtIndex:i];
-            [favoritesEntries insertObject:selfEntry atIndex:0];
-            break;
-        }
-    }
+    [self registerThumbnails];
+    // The current page goes first; the others follow in the list's order.
+    bookmarks = [[CatBookmarkStore sharedStore] list];
+    toggledEntries = [NSMutableDictionary dictionary];
+    selfIndex = [bookmarks indexOfLocation:[self location]];
+    selfEntry = selfIndex != NSNotFound ? [bookmarks bookmarkAtIndex:selfIndex] : nil;
     
     if(!selfEntry) {
         selfEntry =@{
@@ -54,12 +46,27 @@
                      @"location":[self location],
                      @"not-favorite":@YES
                      };
-        [favoritesEntries insertObject:selfEntry atIndex:0];
     }
 }
 
+- (NSDictionary*) entryAtRow:(NSInteger)row
+{
+    NSDictionary* entry = [toggledEntries objectForKey:@(row)];
+    if(entry) {
+        return entry;
+    }
+    if(row == 0) {
+        return selfEntry;
+    }
+    NSUInteger index = row - 1;
+    if(selfIndex != NSNotFound && index >= selfIndex) {
+        index++;
+    }
+    return [bookmarks bookmarkAtIndex:index];
+}
+
 - (NSInteger)collectionView:(UICollectionView *)collectionView numberOfItemsInSection:(NSInteger)section {
-    return [favoritesEntries count];
+    return [bookmarks count] + (selfIndex == NSNotFound ? 1 : 0);
 }
 
 - (UICollectionViewCell *)collectionView:(UICollectionView *)collectionView cellForItemAtIndexPath:(NSIndexPath *)indexPath{
@@ -68,7 +75,7 @@
     BookmarkCollectionViewCell *cell = [collectionView dequeueReusableCellWithReuseIdentifier:identifier forIndexPath:indexPath];
 
     [cell setDelegate:self];
-    NSDictionary* entry = [favoritesEntries objectAtIndex:indexPath.row];
+    NSDictionary* entry = [self entryAtRow:indexPath.row];
     
     if(entry) {
         cell.index = indexPath.row;
@@ -80,7 +87,7 @@
 
 - (void) refreshCell:(BookmarkCollectionViewCell*)cell
 {
-    NSDictionary* entry = [favoritesEntries objectAtIndex:cell.index];
+    NSDictionary* entry = [self entryAtRow:cell.index];
     BOOL bookMarked = ![entry objectForKey:@"not-favorite"];
     cell.backgroundColor = bookMarked?[UIColor colorWithWhite:.8 alpha:1]:[UIColor grayColor];
     
@@ -128,7 +135,7 @@
 {
     // If you need to use the touched cell, you can retrieve it like so
     BookmarkCollectionViewCell *cell = (BookmarkCollectionViewCell*)[collectionView cellForItemAtIndexPath:indexPath];
-    NSMutableDictionary* entry = [(NSDictionary*)[favoritesEntries objectAtIndex:cell.index] mutableCopy];
+    NSMutableDictionary* entry = [(NSDictionary*)[self entryAtRow:cell.index] mutableCopy];
     
     static NSString* notFavoriteKey = @"not-favorite";
     BOOL bookMarked = ![entry objectForKey:notFavoriteKey];
@@ -138,57 +145,59 @@
     else {
         [entry removeObjectForKey:notFavoriteKey];
     }
-    [favoritesEntries setObject:entry atIndexedSubscript:cell.index];
-    [self saveFavorites];
+    [self saveEntry:entry];
+    [toggledEntries setObject:entry forKey:@(cell.index)];
     [self refreshCell:cell];
 }
 
-- (void) saveFavorites
+// Only the toggled entry is journaled; the store writes in the background.
+- (void) saveEntry:(NSMutableDictionary*)entry
 {
-    NSString *bundlePath = [[NSBundle mainBundle] resourcePath];
-    NSString* directory =[bundlePath stringByAppendingPathComponent:@"bookmarks"];
-    
-    NSMutableArray* favorites =[NSMutableArray array];
-    NSDictionary* dico = @{@"favorites":favorites};
-    for(int i=0; i<[favoritesEntries count];i++) {
-        NSDictionary* entry = [favoritesEntries objectAtIndex:i];
-        if([entry objectForKey:@"not-favorite"]) {
-            if([entry objectForKey:@"thumbnail"]) {
-                NSMutableDictionary* newEntry = [entry mutableCopy];
-                NSString* thumbnail = [[[entry objectForKey:@"location"] md5] stringByAppendingPathExtension:@"jpg"];
-                NSString* thumbnailPath = [directory stringByAppendingPathComponent:thumbnail];
-                if([[NSFileManager defaultManager] fileExistsAtPath:thumbnailPath]) {
-                    [[NSFileManager defaultManager] removeItemAtPath:thumbnailPath error:nil];
-                }
-                [newEntry removeObjectForKey:@"thumbnail"];
-                [favoritesEntries setObject:newEntry atIndexedSubscript:i];
-            }
-        }
-        else {
-            if(![entry objectForKey:@"thumbnail"]) {
-                NSMutableDictionary* newEntry = [entry mutableCopy];
-                NSString* thumbnail = [[[newEntry objectForKey:@"location"] md5] stringByAppendingPathExtension:@"jpg"];
-                
-                UIImage* image = [[entry objectForKey:@"location"] isEqualToString:[self location]]? _snapShot : [imagesCache objectForKey:thumbnail];
-                if(image!=nil)
-                {
-                    NSData* imageData = [NSData dataWithData:UIImageJPEGRepresentation(image, 80)];
-                    NSError *writeError = nil;
-                    [imageData writeToFile:[directory stringByAppendingPathComponent:thumbnail] options:NSDataWritingAtomic error:&writeError];
-                    [newEntry setObject:thumbnail forKey:@"thumbnail"];
-                }
-                [favoritesEntries setObject:newEntry atIndexedSubscript:i];
-                [favorites addObject:newEntry];
-            }
-            else {
-                [favorites addObject:entry];
-            }
+    CatBookmarkStore* store = [CatBookmarkStore sharedStore];
+    if([entry objectForKey:@"not-favorite"]) {
+        [entry removeObjectForKey:@"thumbnail"];
+        [store removeBookmarkAtLocation:[entry objectForKey:@"location"]];
+        return;
+    }
+    NSData* imageData = nil;
+    if(![entry objectForKey:@"thumbnail"]) {
+        NSString* thumbnail = [[[entry objectForKey:@"location"] md5] stringByAppendingPathExtension:@"jpg"];
+        UIImage* image = [[entry objectForKey:@"location"] isEqualToString:[self location]]? _snapShot : [imagesCache objectForKey:thumbnail];
+        if(image!=nil)
+        {
+            imageData = UIImageJPEGRepresentation(image, 80);
+            [entry setObject:thumbnail forKey:@"thumbnail"];
         }
     }
-    NSError* error = nil;
-    NSData* data = [NSJSONSerialization dataWithJSONObject:dico options:NSJSONWritingPrettyPrinted error:&error];
-    NSString * path =[directory stringByAppendingPathComponent:@"bookmark.txt"];
-    [data writeToFile:path atomically:YES];
+    [store setBookmark:entry thumbnail:imageData];
+}
+
+- (void) dealloc
+{
+    [[CatMemoryManager sharedManager] unregisterCache:memoryToken];
+}
+
+// Thumbnails are reloaded from disk as cells are refreshed; the current
+// page's snapshot stays.
+- (void) registerThumbnails
+{
+    __weak BookmarkCollectionViewController* weakSelf = self;
+    memoryToken = [[CatMemoryManager sharedManager] registerCacheNamed:@"thumbnails" tier:CatMemoryTierDisposable cost:^unsigned long long{
+        BookmarkCollectionViewController* strongSelf = weakSelf;
+        if(!strongSelf) {
+            return 0;
+        }
+        unsigned long long bytes = 0;
+        for(UIImage* image in [strongSelf->imagesCache allValues]) {
+            bytes += CGImageGetBytesPerRow(image.CGImage) * CGImageGetHeight(image.CGImage);
+        }
+        return bytes;
+    } purge:^{
+        BookmarkCollectionViewController* strongSelf = weakSelf;
+        if(strongSelf) {
+            [strongSelf->imagesCache removeAllObjects];
+        }
+    }];
 }
 
 - (void) setSnapShot:(UIImage *)snapShot
@@ -199,7 +208,7 @@
         imageView.image = _snapShot;
         UIActivityIndicatorView* indicator = (UIActivityIndicatorView*)[firstCell viewWithTag:101];
         [indicator setHidden:_snapShot!=nil];
-        NSDictionary* entry = [favoritesEntries objectAtIndex:[firstCell index]];
+        NSDictionary* entry = [self entryAtRow:[firstCell index]];
         NSString* thumbnail = [entry objectForKey:@"thumbnail"];
         if(thumbnail==nil) {
             thumbnail = [[[entry objectForKey:@"location"] md5] stringByAppendingPathExtension:@"jpg"];
@@ -216,7 +225,7 @@
 
 - (void) clickedCell:(long)index
 {
-    NSDictionary* entry = [favoritesEntries objectAtIndex:index];
+    NSDictionary* entry = [self entryAtRow:index];
     [self.navigationController popViewControllerAnimated:YES];
     [_delegate openLink:[entry objectForKey:@"location"]];
 }
@@ -0,0 +1,278 @@
+//
+//  CatBookmarkIndex.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/4/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatBookmarkIndex.h"
+#include "CatDecisionCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define kBookmarkMagic 0x42746143u  // "CatB"
+#define kVersion 1
+#define kMinCapacity 16
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t stringsLength;
+    uint64_t reserved[3];
+} CatBookmarkHeader;
+
+// Offsets are into the strings.
+typedef struct {
+    uint64_t hash;
+    uint64_t location;
+    uint64_t title;
+    uint64_t thumbnail;
+    uint32_t locationLength;
+    uint32_t titleLength;
+    uint32_t thumbnailLength;
+    uint32_t reserved;
+} CatBookmarkRecord;
+
+struct CatBookmarkIndex {
+    void* map;
+    size_t mappedLength;
+    const CatBookmarkHeader* header;
+    const CatBookmarkRecord* records;
+    const uint32_t* slots;          // position + 1, 0: empty
+    const char* strings;
+};
+
+static size_t CatBookmarkFileSize(uint64_t count, uint64_t capacity, uint64_t stringsLength)
+{
+    return sizeof(CatBookmarkHeader) + count * sizeof(CatBookmarkRecord) + capacity * sizeof(uint32_t) + stringsLength;
+}
+
+static uint64_t CatBookmarkHash(const char* location, size_t length)
+{
+    return CatDecisionHash(kCatDecisionHashSeed, location, length);
+}
+
+CatBookmarkIndex* CatBookmarkIndexOpen(const char* path)
+{
+    int file = open(path, O_RDONLY);
+    if(file < 0) {
+        return NULL;
+    }
+    struct stat status;
+    void* map = MAP_FAILED;
+    if(fstat(file, &status) == 0 && (size_t)status.st_size >= sizeof(CatBookmarkHeader)) {
+        map = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+    else {
+        errno = EILSEQ;
+    }
+    close(file);
+    if(map == MAP_FAILED) {
+        return NULL;
+    }
+    const CatBookmarkHeader* header = map;
+    if(header->magic != kBookmarkMagic || header->version != kVersion || header->count > UINT32_MAX ||
+       header->capacity < kMinCapacity || (header->capacity & (header->capacity - 1)) || header->capacity <= header->count ||
+       header->capacity > (uint64_t)status.st_size || header->stringsLength > (uint64_t)status.st_size ||
+       CatBookmarkFileSize(header->count, header->capacity, header->stringsLength) != (size_t)status.st_size) {
+        munmap(map, (size_t)status.st_size);
+        errno = EILSEQ;
+        return NULL;
+    }
+    CatBookmarkIndex* index = calloc(1, sizeof(CatBookmarkIndex));
+    if(!index) {
+        munmap(map, (size_t)status.st_size);
+        return NULL;
+    }
+    index->map = map;
+    index->mappedLength = (size_t)status.st_size;
+    index->header = header;
+    index->records = (const CatBookmarkRecord*)(header + 1);
+    index->slots = (const uint32_t*)(index->records + header->count);
+    index->strings = (const char*)(index->slots + header->capacity);
+    return index;
+}
+
+void CatBookmarkIndexClose(CatBookmarkIndex* index)
+{
+    if(index) {
+        munmap(index->map, index->mappedLength);
+        free(index);
+    }
+}
+
+size_t CatBookmarkIndexCount(const CatBookmarkIndex* index)
+{
+    return (size_t)index->header->count;
+}
+
+uint64_t CatBookmarkIndexGeneration(const CatBookmarkIndex* index)
+{
+    return index->header->generation;
+}
+
+static int CatStringInBounds(const CatBookmarkIndex* index, uint64_t offset, uint32_t length)
+{
+    return offset <= index->header->stringsLength && length <= index->header->stringsLength - offset;
+}
+
+int CatBookmarkIndexGet(const CatBookmarkIndex* index, size_t position, CatBookmark* bookmark)
+{
+    if(position >= index->header->count) {
+        return 0;
+    }
+    const CatBookmarkRecord* record = &index->records[position];
+    if(!CatStringInBounds(index, record->location, record->locationLength) ||
+       !CatStringInBounds(index, record->title, record->titleLength) ||
+       !CatStringInBounds(index, record->thumbnail, record->thumbnailLength)) {
+        return 0;
+    }
+    bookmark->location = index->strings + record->location;
+    bookmark->locationLength = record->locationLength;
+    bookmark->title = index->strings + record->title;
+    bookmark->titleLength = record->titleLength;
+    bookmark->thumbnail = index->strings + record->thumbnail;
+    bookmark->thumbnailLength = record->thumbnailLength;
+    return 1;
+}
+
+long CatBookmarkIndexFind(const CatBookmarkIndex* index, const char* location, size_t length)
+{
+    uint64_t hash = CatBookmarkHash(location, length);
+    uint64_t mask = index->header->capacity - 1;
+    // A damaged table could be full: give up after one lap.
+    for(uint64_t i=hash & mask, probes=0; probes<=mask && index->slots[i]; i=(i + 1) & mask, probes++) {
+        uint64_t position = index->slots[i] - 1;
+        if(position >= index->header->count) {
+            continue;
+        }
+        const CatBookmarkRecord* record = &index->records[position];
+        if(record->hash == hash && record->locationLength == length &&
+           CatStringInBounds(index, record->location, record->locationLength) &&
+           memcmp(index->strings + record->location, location, length) == 0) {
+            return (long)position;
+        }
+    }
+    return -1;
+}
+
+static int CatWriteAll(int file, const void* bytes, size_t length)
+{
+    const char* cursor = bytes;
+    while(length) {
+        ssize_t written = write(file, cursor, length);
+        if(written < 0 && errno == EINTR) {
+            continue;
+        }
+        if(written <= 0) {
+            return -1;
+        }
+        cursor += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Returns where the string went.
+static uint64_t CatAppendString(char* strings, uint64_t* offset, const char* string, size_t length)
+{
+    uint64_t start = *offset;
+    if(length) {
+        memcpy(strings + start, string, length);
+    }
+    *offset += length;
+    return start;
+}
+
+int CatBookmarkIndexWrite(const char* path, uint64_t generation, const CatBookmark* bookmarks, size_t count)
+{
+    uint64_t capacity = kMinCapacity;
+    while(capacity < (uint64_t)count * 2) {
+        capacity *= 2;
+    }
+    uint64_t stringsLength = 0;
+    for(size_t i=0; i<count; i++) {
+        if(bookmarks[i].locationLength > UINT32_MAX || bookmarks[i].titleLength > UINT32_MAX || bookmarks[i].thumbnailLength > UINT32_MAX) {
+            errno = EINVAL;
+            return -1;
+        }
+        stringsLength += bookmarks[i].locationLength + bookmarks[i].titleLength + bookmarks[i].thumbnailLength;
+    }
+    if(count > UINT32_MAX - 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t size = CatBookmarkFileSize(count, capacity, stringsLength);
+    char* buffer = calloc(1, size);
+    size_t pathLength = strlen(path);
+    char* temporary = malloc(pathLength + 5);
+    if(!buffer || !temporary) {
+        free(buffer);
+        free(temporary);
+        errno = ENOMEM;
+        return -1;
+    }
+    CatBookmarkHeader* header = (CatBookmarkHeader*)buffer;
+    header->magic = kBookmarkMagic;
+    header->version = kVersion;
+    header->generation = generation;
+    header->count = count;
+    header->capacity = capacity;
+    header->stringsLength = stringsLength;
+    CatBookmarkRecord* records = (CatBookmarkRecord*)(header + 1);
+    uint32_t* slots = (uint32_t*)(records + count);
+    char* strings = (char*)(slots + capacity);
+
+    uint64_t offset = 0;
+    for(size_t i=0; i<count; i++) {
+        const CatBookmark* bookmark = &bookmarks[i];
+        CatBookmarkRecord* record = &records[i];
+        record->hash = CatBookmarkHash(bookmark->location, bookmark->locationLength);
+        record->location = CatAppendString(strings, &offset, bookmark->location, bookmark->locationLength);
+        record->locationLength = (uint32_t)bookmark->locationLength;
+        record->title = CatAppendString(strings, &offset, bookmark->title, bookmark->titleLength);
+        record->titleLength = (uint32_t)bookmark->titleLength;
+        record->thumbnail = CatAppendString(strings, &offset, bookmark->thumbnail, bookmark->thumbnailLength);
+        record->thumbnailLength = (uint32_t)bookmark->thumbnailLength;
+
+        uint64_t mask = capacity - 1;
+        uint64_t slot = record->hash & mask;
+        while(slots[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = (uint32_t)i + 1;
+    }
+
+    memcpy(temporary, path, pathLength);
+    memcpy(temporary + pathLength, ".tmp", 5);
+    int result = -1;
+    int file = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(file >= 0) {
+        int failed = CatWriteAll(file, buffer, size) != 0 || fsync(file) != 0;
+        int error = errno;
+        close(file);
+        if(!failed && rename(temporary, path) == 0) {
+            result = 0;
+        }
+        else {
+            error = failed ? error : errno;
+            unlink(temporary);
+            errno = error;
+        }
+    }
+    free(buffer);
+    free(temporary);
+    return result;
+}
@@ -0,0 +1,64 @@
+//
+//  CatBookmarkIndex.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/4/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Bookmarks in one read-only file, memory mapped:
+//    header        magic, version, generation, counts
+//    records       one per bookmark in list order: the hash of the
+//                  location and where its strings are
+//    slots         open addressing table by location hash, holding
+//                  record positions
+//    strings       location, title and thumbnail name of each bookmark
+//  Opening checks the header and the file size and maps the file, so it
+//  takes the same time for ten bookmarks or a hundred thousand; records
+//  are checked as they are read. The file is written whole, beside the
+//  old one and renamed over it. Plain C, no Apple dependency.
+//
+
+#ifndef CatBrowser_CatBookmarkIndex_h
+#define CatBrowser_CatBookmarkIndex_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CatBookmarkIndex CatBookmarkIndex;
+
+typedef struct {
+    const char* location;       // owned by the index, valid until it is closed
+    size_t locationLength;
+    const char* title;
+    size_t titleLength;
+    const char* thumbnail;      // empty when there is none
+    size_t thumbnailLength;
+} CatBookmark;
+
+// NULL on failure, with errno set: EILSEQ when the file is not a whole
+// index.
+CatBookmarkIndex* CatBookmarkIndexOpen(const char* path);
+void CatBookmarkIndexClose(CatBookmarkIndex* index);
+
+size_t CatBookmarkIndexCount(const CatBookmarkIndex* index);
+uint64_t CatBookmarkIndexGeneration(const CatBookmarkIndex* index);
+
+// 1, or 0 when position is out of range or the record is damaged.
+int CatBookmarkIndexGet(const CatBookmarkIndex* index, size_t position, CatBookmark* bookmark);
+// The position of the bookmark, or -1.
+long CatBookmarkIndexFind(const CatBookmarkIndex* index, const char* location, size_t length);
+
+// Writes count bookmarks, in order, to path through a temporary file,
+// synced before the rename. Locations should be unique: a repeated one
+// is found at its first position. 0, or -1 with errno set.
+int CatBookmarkIndexWrite(const char* path, uint64_t generation, const CatBookmark* bookmarks, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
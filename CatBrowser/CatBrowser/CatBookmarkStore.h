@@ -0,0 +1,79 @@
+//
+//  CatBookmarkStore.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/3/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  The favorites, kept in files of a directory:
+//    bookmark.idx      a snapshot, a CatBookmarkIndex, mapped at launch
+//    bookmark.journal  a header line with the snapshot's generation, then
+//                      one JSON line per change made since
+//    bookmark.txt      the {"favorites": [...]} JSON the app used to keep,
+//                      imported when there is no index and written again
+//                      with each snapshot
+//  Changes apply to the list in memory at once and are appended to the
+//  journal on a serial background queue; changes arriving while a write
+//  is being synced go out together in the next one. Once the journal
+//  holds more records than there are bookmarks, the snapshot is rewritten
+//  and the journal started over. Opening maps the snapshot and replays
+//  the journal, dropping a torn last line, or all of it when the snapshot
+//  already has its changes.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CatSuggestionEngine;
+
+// The bookmarks at one point: the mapped snapshot and the changes made
+// since. Reading an entry or finding a location does not depend on how
+// many bookmarks there are, only on the changes.
+@interface CatBookmarkList : NSObject <NSCopying>
+@property (readonly) NSUInteger count;
+- (NSDictionary*) bookmarkAtIndex:(NSUInteger)index;
+- (NSUInteger) indexOfLocation:(NSString*)location;     // NSNotFound
+- (NSDictionary*) bookmarkForLocation:(NSString*)location;
+- (NSArray*) allBookmarks;
+@end
+
+@interface CatBookmarkStore : NSObject
+
++ (CatBookmarkStore*) sharedStore;
+
+// Opens, or creates, the store in directory. A bookmark.txt without an
+// index is imported.
+- (id) initWithDirectory:(NSString*)directory;
+
+// Entries are dictionaries with a location, a title and, once it is
+// written, the name of a thumbnail in the directory. Setting replaces the
+// entry with the same location in place; a new one goes first. The
+// thumbnail, if any, is written under entry[@"thumbnail"] before the change
+// is journaled.
+- (void) setBookmark:(NSDictionary*)entry thumbnail:(NSData*)thumbnail;
+// Also deletes the entry's thumbnail.
+- (void) removeBookmarkAtLocation:(NSString*)location;
+
+// Returns at once, never waiting on the queue: the list as of the last
+// change made, written or not. Later changes do not show in it. Empty
+// until the store has opened, which waitUntilWritten waits for.
+- (CatBookmarkList*) list;
+// Snapshot order, newest first: the whole list.
+- (NSArray*) favorites;
+- (BOOL) exportToFile:(NSString*)path;
+
+// Gives the engine every bookmark in the background, then each change as
+// it is journaled.
+- (void) feedSuggestionEngine:(CatSuggestionEngine*)engine;
+
+// Blocks until pending changes are written. For tests.
+- (void) waitUntilWritten;
+// Rewrites the snapshot now.
+- (BOOL) compact;
+
+@property (readonly) NSString* directory;
+@property (readonly) unsigned long long generation;
+@property (readonly) NSUInteger journalRecords;    // since the last snapshot
+@property (readonly) NSUInteger commits;
+@property (readonly) NSUInteger compactions;
+
+@end
@@ -0,0 +1,705 @@
+//
+//  CatBookmarkStore.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/3/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatBookmarkStore.h"
+#import "CatBookmarkIndex.h"
+#import "CatMetrics.h"
+#import "CatSuggestionEngine.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+static const NSUInteger kMinCompactionRecords = 64;
+
+// Owns a mapped index; lists made before a compaction keep the old one.
+@interface CatBookmarkFile : NSObject
+{
+@package
+    CatBookmarkIndex* index;
+}
++ (CatBookmarkFile*) fileAtPath:(NSString*)path;
+@end
+
+@implementation CatBookmarkFile
+
++ (CatBookmarkFile*) fileAtPath:(NSString*)path
+{
+    CatBookmarkIndex* index = CatBookmarkIndexOpen(path.fileSystemRepresentation);
+    if(!index) {
+        return nil;
+    }
+    CatBookmarkFile* file = [[CatBookmarkFile alloc] init];
+    file->index = index;
+    return file;
+}
+
+- (void) dealloc
+{
+    CatBookmarkIndexClose(index);
+}
+
+@end
+
+static NSString* stringOfBytes(const char* bytes, size_t length)
+{
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding] ?: @"";
+}
+
+@interface CatBookmarkList ()
+- (id) initWithFile:(CatBookmarkFile*)file;
+- (BOOL) applyRecord:(NSDictionary*)record;
+@end
+
+@implementation CatBookmarkList
+{
+    CatBookmarkFile* file;                  // nil: empty
+    NSMutableArray* added;                  // locations not in the file, newest first
+    NSMutableDictionary* changed;           // location -> entry, or NSNull when removed from the file
+    NSMutableIndexSet* removed;             // file positions removed, or moved to the front
+}
+
+- (id) initWithFile:(CatBookmarkFile*)bookmarkFile
+{
+    if(self = [super init]) {
+        file = bookmarkFile;
+        added = [NSMutableArray array];
+        changed = [NSMutableDictionary dictionary];
+        removed = [NSMutableIndexSet indexSet];
+    }
+    return self;
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    CatBookmarkList* list = [[CatBookmarkList alloc] initWithFile:file];
+    list->added = [added mutableCopy];
+    list->changed = [changed mutableCopy];
+    list->removed = [removed mutableCopy];
+    return list;
+}
+
+- (NSUInteger) fileCount
+{
+    return file ? CatBookmarkIndexCount(file->index) : 0;
+}
+
+- (NSUInteger) count
+{
+    return added.count + [self fileCount] - removed.count;
+}
+
+- (long) filePositionOfLocation:(NSString*)location
+{
+    NSData* bytes = [location dataUsingEncoding:NSUTF8StringEncoding];
+    return file && bytes ? CatBookmarkIndexFind(file->index, bytes.bytes, bytes.length) : -1;
+}
+
+// The file position shown at index among the file's bookmarks: the
+// smallest one with index others before it that are not removed.
+- (NSUInteger) filePositionAtIndex:(NSUInteger)index
+{
+    if(index >= [self fileCount] - removed.count) {
+        return NSNotFound;
+    }
+    NSUInteger position = index;
+    while(YES) {
+        NSUInteger next = index + [removed countOfIndexesInRange:NSMakeRange(0, position + 1)];
+        if(next == position) {
+            return position;
+        }
+        position = next;
+    }
+}
+
+- (NSDictionary*) fileBookmarkAtPosition:(NSUInteger)position
+{
+    CatBookmark bookmark;
+    if(!CatBookmarkIndexGet(file->index, position, &bookmark)) {
+        return @{@"title": @"", @"location": @""};
+    }
+    NSString* location = stringOfBytes(bookmark.location, bookmark.locationLength);
+    id replaced = changed[location];
+    if([replaced isKindOfClass:[NSDictionary class]]) {
+        return replaced;
+    }
+    if(!bookmark.thumbnailLength) {
+        return @{@"title": stringOfBytes(bookmark.title, bookmark.titleLength), @"location": location};
+    }
+    return @{@"title": stringOfBytes(bookmark.title, bookmark.titleLength), @"location": location,
+             @"thumbnail": stringOfBytes(bookmark.thumbnail, bookmark.thumbnailLength)};
+}
+
+- (NSDictionary*) bookmarkAtIndex:(NSUInteger)index
+{
+    if(index < added.count) {
+        return changed[added[index]];
+    }
+    NSUInteger position = [self filePositionAtIndex:index - added.count];
+    return position == NSNotFound ? nil : [self fileBookmarkAtPosition:position];
+}
+
+- (NSUInteger) indexOfLocation:(NSString*)location
+{
+    if(!location) {
+        return NSNotFound;
+    }
+    id entry = changed[location];
+    if(entry == [NSNull null]) {
+        return NSNotFound;
+    }
+    if(entry) {
+        NSUInteger index = [added indexOfObject:location];
+        if(index != NSNotFound) {
+            return index;
+        }
+    }
+    long position = [self filePositionOfLocation:location];
+    if(position < 0 || [removed containsIndex:position]) {
+        return NSNotFound;
+    }
+    return added.count + position - [removed countOfIndexesInRange:NSMakeRange(0, position)];
+}
+
+- (NSDictionary*) bookmarkForLocation:(NSString*)location
+{
+    NSUInteger index = [self indexOfLocation:location];
+    return index == NSNotFound ? nil : [self bookmarkAtIndex:index];
+}
+
+- (NSArray*) allBookmarks
+{
+    NSMutableArray* bookmarks = [NSMutableArray arrayWithCapacity:[self count]];
+    for(NSString* location in added) {
+        [bookmarks addObject:changed[location]];
+    }
+    NSUInteger fileCount = [self fileCount];
+    for(NSUInteger position=0; position<fileCount; position++) {
+        if(![removed containsIndex:position]) {
+            @autoreleasepool {
+                [bookmarks addObject:[self fileBookmarkAtPosition:position]];
+            }
+        }
+    }
+    return bookmarks;
+}
+
+// {"set": entry} or {"remove": location}. A set keeps a bookmark where it
+// is; a new one goes first.
+- (BOOL) applyRecord:(NSDictionary*)record
+{
+    NSDictionary* entry = record[@"set"];
+    if([entry isKindOfClass:[NSDictionary class]]) {
+        NSString* location = entry[@"location"];
+        if(![location isKindOfClass:[NSString class]]) {
+            return NO;
+        }
+        if(![added containsObject:location]) {
+            long position = [self filePositionOfLocation:location];
+            if(position < 0 || [removed containsIndex:position]) {
+                [added insertObject:location atIndex:0];
+            }
+        }
+        changed[location] = entry;
+        return YES;
+    }
+    NSString* location = record[@"remove"];
+    if([location isKindOfClass:[NSString class]]) {
+        [added removeObject:location];
+        long position = [self filePositionOfLocation:location];
+        if(position >= 0) {
+            [removed addIndex:position];
+            changed[location] = [NSNull null];
+        }
+        else {
+            [changed removeObjectForKey:location];
+        }
+        return YES;
+    }
+    return NO;
+}
+
+@end
+
+@implementation CatBookmarkStore
+{
+    // only touched on queue
+    CatBookmarkList* list;
+    NSMutableData* pending;
+    BOOL flushScheduled;
+    int journal;
+    CatSuggestionEngine* engine;
+    dispatch_queue_t queue;
+    // @synchronized(self)
+    CatBookmarkList* published;     // never changed once published
+    NSMutableArray* unapplied;      // records published, still queued for list
+}
+
++ (CatBookmarkStore*) sharedStore
+{
+    static CatBookmarkStore* sharedStore = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSString* directory = [[[NSBundle mainBundle] resourcePath] stringByAppendingPathComponent:@"bookmarks"];
+        sharedStore = [[CatBookmarkStore alloc] initWithDirectory:directory];
+    });
+    return sharedStore;
+}
+
+- (id) initWithDirectory:(NSString*)directory
+{
+    if(self = [super init]) {
+        _directory = directory;
+        pending = [NSMutableData data];
+        journal = -1;
+        published = [[CatBookmarkList alloc] initWithFile:nil];
+        unapplied = [NSMutableArray array];
+        queue = dispatch_queue_create("com.dobuki.CatBrowser.bookmarks", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        dispatch_async(queue, ^{
+            [self open];
+        });
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    int openJournal = journal;
+    NSData* unwritten = pending;
+    dispatch_async(queue, ^{
+        if(openJournal >= 0) {
+            writeAll(openJournal, unwritten);
+            close(openJournal);
+        }
+    });
+}
+
+- (NSString*) snapshotPath
+{
+    return [_directory stringByAppendingPathComponent:@"bookmark.txt"];
+}
+
+- (NSString*) indexPath
+{
+    return [_directory stringByAppendingPathComponent:@"bookmark.idx"];
+}
+
+- (NSString*) journalPath
+{
+    return [_directory stringByAppendingPathComponent:@"bookmark.journal"];
+}
+
+static BOOL writeAll(int file, NSData* data)
+{
+    const char* bytes = data.bytes;
+    size_t written = 0;
+    while(written < data.length) {
+        ssize_t count = write(file, bytes + written, data.length - written);
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count <= 0) {
+            return NO;
+        }
+        written += count;
+    }
+    return YES;
+}
+
+// Written beside the file, synced, then renamed over it: either the old
+// file or the whole new one survives a crash.
+static BOOL replaceFile(NSString* path, NSData* data)
+{
+    NSString* temporary = [path stringByAppendingPathExtension:@"tmp"];
+    int file = open(temporary.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(file < 0) {
+        return NO;
+    }
+    BOOL written = writeAll(file, data) && fsync(file) == 0;
+    close(file);
+    if(!written || rename(temporary.fileSystemRepresentation, path.fileSystemRepresentation) != 0) {
+        unlink(temporary.fileSystemRepresentation);
+        return NO;
+    }
+    return YES;
+}
+
+static NSData* lineOfRecord(NSDictionary* record)
+{
+    // JSON escapes newlines in strings, so a record is always one line.
+    NSMutableData* line = [[NSJSONSerialization dataWithJSONObject:record options:0 error:NULL] mutableCopy];
+    [line appendBytes:"\n" length:1];
+    return line;
+}
+
+#pragma mark - Opening
+
+- (void) open
+{
+    [[NSFileManager defaultManager] createDirectoryAtPath:_directory withIntermediateDirectories:YES attributes:nil error:NULL];
+    CatBookmarkFile* file = [CatBookmarkFile fileAtPath:[self indexPath]];
+    if(file) {
+        _generation = CatBookmarkIndexGeneration(file->index);
+        list = [[CatBookmarkList alloc] initWithFile:file];
+    }
+    else {
+        [self importSnapshot];
+    }
+    if(![self replayJournal] && ![self startJournal]) {
+        NSLog(@"Bookmark journal could not be opened: %s", strerror(errno));
+    }
+    [self republish];
+}
+
+// No index yet: the JSON the app used to keep, read once and indexed.
+- (void) importSnapshot
+{
+    NSData* data = [NSData dataWithContentsOfFile:[self snapshotPath]];
+    NSDictionary* dico = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+    if(data && ![dico isKindOfClass:[NSDictionary class]]) {
+        NSLog(@"Bookmarks unreadable, starting over");
+        dico = nil;
+    }
+    NSNumber* generation = dico[@"generation"];
+    _generation = [generation isKindOfClass:[NSNumber class]] ? [generation unsignedLongLongValue] : 0;
+    NSMutableArray* favorites = [NSMutableArray array];
+    NSMutableSet* locations = [NSMutableSet set];
+    NSArray* entries = dico[@"favorites"];
+    for(NSDictionary* entry in [entries isKindOfClass:[NSArray class]] ? entries : nil) {
+        NSString* location = [entry isKindOfClass:[NSDictionary class]] ? entry[@"location"] : nil;
+        if([location isKindOfClass:[NSString class]] && ![locations containsObject:location]) {
+            [locations addObject:location];
+            [favorites addObject:entry];
+        }
+    }
+    CatBookmarkFile* file = [self writeIndex:favorites generation:_generation];
+    list = [[CatBookmarkList alloc] initWithFile:file];
+    if(!file) {
+        // Kept in memory until an index can be written.
+        NSLog(@"Bookmark index not written: %s", strerror(errno));
+        for(NSDictionary* entry in [favorites reverseObjectEnumerator]) {
+            [list applyRecord:@{@"set": entry}];
+        }
+    }
+}
+
+static NSData* bytesOfValue(id value)
+{
+    return [value isKindOfClass:[NSString class]] ? [value dataUsingEncoding:NSUTF8StringEncoding] : [NSData data];
+}
+
+- (CatBookmarkFile*) writeIndex:(NSArray*)favorites generation:(unsigned long long)generation
+{
+    NSMutableData* buffer = [NSMutableData dataWithLength:favorites.count * sizeof(CatBookmark)];
+    CatBookmark* bookmarks = buffer.mutableBytes;
+    NSMutableArray* strings = [NSMutableArray arrayWithCapacity:favorites.count * 3];
+    for(NSUInteger i=0; i<favorites.count; i++) {
+        NSDictionary* entry = favorites[i];
+        NSData* location = bytesOfValue(entry[@"location"]);
+        NSData* title = bytesOfValue(entry[@"title"]);
+        NSData* thumbnail = bytesOfValue(entry[@"thumbnail"]);
+        [strings addObject:location];
+        [strings addObject:title];
+        [strings addObject:thumbnail];
+        bookmarks[i] = (CatBookmark){ location.bytes, location.length, title.bytes, title.length, thumbnail.bytes, thumbnail.length };
+    }
+    if(CatBookmarkIndexWrite([self indexPath].fileSystemRepresentation, generation, bookmarks, favorites.count) != 0) {
+        return nil;
+    }
+    return [CatBookmarkFile fileAtPath:[self indexPath]];
+}
+
+// Applies the journal if it follows the snapshot, and opens it for
+// appending. NO when it has to be started over.
+- (BOOL) replayJournal
+{
+    NSData* data = [NSData dataWithContentsOfFile:[self journalPath] options:NSDataReadingMappedIfSafe error:NULL];
+    const char* bytes = data.bytes;
+    const char* end = bytes + data.length;
+    const char* line = bytes;
+    NSUInteger records = 0;
+    BOOL header = YES;
+    while(line < end) {
+        const char* newline = memchr(line, '\n', end - line);
+        if(!newline) {
+            break;
+        }
+        NSDictionary* record = [NSJSONSerialization JSONObjectWithData:[NSData dataWithBytesNoCopy:(void*)line length:newline - line freeWhenDone:NO]
+                                                               options:0 error:NULL];
+        if(![record isKindOfClass:[NSDictionary class]]) {
+            break;
+        }
+        if(header) {
+            // Older: a compaction got as far as the snapshot.
+            NSNumber* generation = record[@"generation"];
+            if(![generation isKindOfClass:[NSNumber class]] || [generation unsignedLongLongValue] != _generation) {
+                return NO;
+            }
+            header = NO;
+        }
+        else if(![list applyRecord:record]) {
+            break;
+        }
+        else {
+            records++;
+        }
+        line = newline + 1;
+    }
+    if(header) {
+        return NO;
+    }
+    NSUInteger length = line - bytes;
+    if(length < data.length) {
+        NSLog(@"Bookmark journal cut after %lu records, %lu bytes dropped", (unsigned long)records, (unsigned long)(data.length - length));
+    }
+    journal = open([self journalPath].fileSystemRepresentation, O_WRONLY | O_APPEND);
+    if(journal < 0 || ftruncate(journal, length) != 0) {
+        return NO;
+    }
+    _journalRecords = records;
+    return YES;
+}
+
+- (BOOL) startJournal
+{
+    if(journal >= 0) {
+        close(journal);
+        journal = -1;
+    }
+    _journalRecords = 0;
+    if(!replaceFile([self journalPath], lineOfRecord(@{@"generation": @(_generation)}))) {
+        return NO;
+    }
+    journal = open([self journalPath].fileSystemRepresentation, O_WRONLY | O_APPEND);
+    return journal >= 0;
+}
+
+#pragma mark - Changes
+
+- (void) setBookmark:(NSDictionary*)entry thumbnail:(NSData*)thumbnail
+{
+    if(![entry[@"location"] isKindOfClass:[NSString class]]) {
+        return;
+    }
+    NSDictionary* record = @{@"set": [entry copy]};
+    @synchronized(self) {
+        [self publishRecord:record];
+        dispatch_async(queue, ^{
+            NSString* name = entry[@"thumbnail"];
+            if(thumbnail && [name isKindOfClass:[NSString class]] &&
+               ![thumbnail writeToFile:[_directory stringByAppendingPathComponent:name] options:NSDataWritingAtomic error:NULL]) {
+                NSLog(@"Bookmark thumbnail not written: %@", name);
+            }
+            [self journalRecord:record];
+        });
+    }
+}
+
+- (void) removeBookmarkAtLocation:(NSString*)location
+{
+    if(!location) {
+        return;
+    }
+    NSDictionary* record = @{@"remove": location};
+    @synchronized(self) {
+        [self publishRecord:record];
+        dispatch_async(queue, ^{
+            NSString* name = [list bookmarkForLocation:location][@"thumbnail"];
+            [self journalRecord:record];
+            if([name isKindOfClass:[NSString class]]) {
+                [[NSFileManager defaultManager] removeItemAtPath:[_directory stringByAppendingPathComponent:name] error:NULL];
+            }
+        });
+    }
+}
+
+// Called with the lock held, so records are published in the order they
+// are queued.
+- (void) publishRecord:(NSDictionary*)record
+{
+    CatBookmarkList* next = [published copy];
+    [next applyRecord:record];
+    published = next;
+    [unapplied addObject:record];
+}
+
+// On queue, once list was opened or replaced: the published list starts
+// from it again, with the records still queued.
+- (void) republish
+{
+    @synchronized(self) {
+        CatBookmarkList* next = [list copy];
+        for(NSDictionary* record in unapplied) {
+            [next applyRecord:record];
+        }
+        published = next;
+    }
+}
+
+// Records wait in pending until the flush, which writes and syncs all of
+// those that came in meanwhile at once.
+- (void) journalRecord:(NSDictionary*)record
+{
+    [list applyRecord:record];
+    @synchronized(self) {
+        [unapplied removeObjectAtIndex:0];
+    }
+    if(record[@"set"]) {
+        [engine setBookmark:record[@"set"]];
+    }
+    else {
+        [engine removeBookmarkAtLocation:record[@"remove"]];
+    }
+    [pending appendData:lineOfRecord(record)];
+    _journalRecords++;
+    CatMetricsCount(CatCounterBookmarkRecords);
+    if(!flushScheduled) {
+        flushScheduled = YES;
+        dispatch_async(queue, ^{
+            [self flush];
+        });
+    }
+}
+
+- (void) flush
+{
+    flushScheduled = NO;
+    if(!pending.length) {
+        return;
+    }
+    if(journal < 0 || !writeAll(journal, pending) || fsync(journal) != 0) {
+        // The list in memory has the changes; the snapshot takes them all.
+        NSLog(@"Bookmark journal not written: %s", strerror(errno));
+        [self compactNow];
+        return;
+    }
+    [pending setLength:0];
+    _commits++;
+    CatMetricsCount(CatCounterBookmarkCommits);
+    if(_journalRecords > MAX(kMinCompactionRecords, list.count)) {
+        [self compactNow];
+    }
+}
+
+#pragma mark - Compaction
+
+// The index goes first: until the journal is started over, its header
+// names the generation before, and opening skips it. bookmark.txt is
+// kept for older versions.
+- (BOOL) compactNow
+{
+    NSArray* favorites = [list allBookmarks];
+    CatBookmarkFile* file = [self writeIndex:favorites generation:_generation + 1];
+    if(!file) {
+        NSLog(@"Bookmarks not saved: %s", strerror(errno));
+        return NO;
+    }
+    _generation++;
+    _compactions++;
+    list = [[CatBookmarkList alloc] initWithFile:file];
+    [self republish];
+    [pending setLength:0];
+    if(![self startJournal]) {
+        NSLog(@"Bookmark journal could not be started: %s", strerror(errno));
+    }
+    if(![self exportFavorites:favorites toFile:[self snapshotPath]]) {
+        NSLog(@"bookmark.txt not written: %s", strerror(errno));
+    }
+    return YES;
+}
+
+- (BOOL) exportFavorites:(NSArray*)favorites toFile:(NSString*)path
+{
+    NSDictionary* dico = @{@"favorites": favorites, @"generation": @(_generation)};
+    NSData* data = [NSJSONSerialization dataWithJSONObject:dico options:NSJSONWritingPrettyPrinted error:NULL];
+    return data && replaceFile(path, data);
+}
+
+- (BOOL) exportToFile:(NSString*)path
+{
+    __block BOOL exported = NO;
+    dispatch_sync(queue, ^{
+        exported = [self exportFavorites:[list allBookmarks] toFile:path];
+    });
+    return exported;
+}
+
+- (BOOL) compact
+{
+    __block BOOL compacted = NO;
+    dispatch_sync(queue, ^{
+        compacted = [self compactNow];
+    });
+    return compacted;
+}
+
+#pragma mark - Reading
+
+- (CatBookmarkList*) list
+{
+    @synchronized(self) {
+        return published;
+    }
+}
+
+- (NSArray*) favorites
+{
+    return [[self list] allBookmarks];
+}
+
+- (void) feedSuggestionEngine:(CatSuggestionEngine*)suggestionEngine
+{
+    dispatch_async(queue, ^{
+        engine = suggestionEngine;
+        [engine setBookmarks:[list allBookmarks]];
+    });
+}
+
+- (void) waitUntilWritten
+{
+    dispatch_sync(queue, ^{
+        [self flush];
+    });
+}
+
+- (unsigned long long) generation
+{
+    __block unsigned long long generation = 0;
+    dispatch_sync(queue, ^{
+        generation = _generation;
+    });
+    return generation;
+}
+
+- (NSUInteger) journalRecords
+{
+    __block NSUInteger records = 0;
+    dispatch_sync(queue, ^{
+        records = _journalRecords;
+    });
+    return records;
+}
+
+- (NSUInteger) commits
+{
+    __block NSUInteger commits = 0;
+    dispatch_sync(queue, ^{
+        commits = _commits;
+    });
+    return commits;
+}
+
+- (NSUInteger) compactions
+{
+    __block NSUInteger compactions = 0;
+    dispatch_sync(queue, ^{
+        compactions = _compactions;
+    });
+    return compactions;
+}
+
+@end
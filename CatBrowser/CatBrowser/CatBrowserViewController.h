@@ -26,8 +26,12 @@ static const CGFloat kAddressHeight = 24.0f;
 
 @property (strong, nonatomic) UILabel *pageTitle;
 @property (strong, nonatomic) UITextField *addressField;
+// Interception metrics over the page, refreshed every second.
+// Shown at launch when the CatDebugOverlay user default is set (-CatDebugOverlay YES).
+@property (strong, nonatomic) UILabel *debugOverlay;
 
 - (void)loadRequestFromString:(NSString*)urlString;
+- (void)setDebugOverlayVisible:(BOOL)visible;
 
 - (IBAction)bookMark:(UIBarButtonItem *)sender;
 - (IBAction)goHome:(id)sender;
@@ -8,13 +8,32 @@
 
 #import "CatBrowserViewController.h"
 #import "CatURLProtocol.h"
+#import "CatMetrics.h"
+#import "CatRedirectCache.h"
+#import "CatSearchDebouncer.h"
+#import "CatSuggestionEngine.h"
+#import "CatHistoryStore.h"
+#import "CatSnapshotter.h"
+#import "CatPageBridge.h"
+#import "CatMemoryManager.h"
+#import "CatBookmarkStore.h"
+#import "CatImagePool.h"
+#import "CatGIFDowngrader.h"
+#import "CatDecisionCache.h"
 #import "BookmarkCollectionViewController.h"
 #import "BookmarkCollectionViewControllerDelegate.h"
 
-@interface CatBrowserViewController () <UIWebViewDelegate, UIScrollViewDelegate, UITextFieldDelegate, BookmarkCollectionViewControllerDelegate>
+@interface CatBrowserViewController () <UIWebViewDelegate, UIScrollViewDelegate, UITextFieldDelegate, UITableViewDataSource, UITableViewDelegate, BookmarkCollectionViewControllerDelegate>
 {
     NSTimer* bookmarkRefresh;
+    CatSnapshotter* snapshotter;
+    CatPageBridge* page;
     NSURL* lastURL;
+    NSTimer* debugRefresh;
+    CatSearchDebouncer* search;
+    BOOL searchLoading;         // the page loading is a search typed in the address bar
+    UITableView* suggestionsView;
+    NSArray* suggestions;
 }
 - (void)updateButtons;
 
@@ -25,13 +44,20 @@
 @implementation CatBrowserViewController
 
 static NSString* HOME = @"https://www.google.com";
+static const NSTimeInterval kSearchQuietPeriod = .4;
+static const NSUInteger kMaxSuggestions = 6;
+static const CGFloat kSuggestionHeight = 44.0f;
 
 - (void)viewDidLoad
 {
     [super viewDidLoad];
     [CatURLProtocol register];
+    [self registerCaches];
     [[self webView] setDelegate:self];
+    page = [[CatPageBridge alloc] initWithWebView:[self webView]];
     [[[self webView] scrollView] setDelegate:self];
+    [[CatHistoryStore sharedStore] feedSuggestionEngine:[CatSuggestionEngine sharedEngine]];
+    [[CatBookmarkStore sharedStore] feedSuggestionEngine:[CatSuggestionEngine sharedEngine]];
     // Do any additional setup after loading the view, typically from a nib.
     [self loadRequestFromString:HOME];
     
@@ -63,18 +89,121 @@ static NSString* HOME = @"https://www.google.com";
       forControlEvents:UIControlEventEditingDidEndOnExit];
     [navBar addSubview:address];
     self.addressField = address;
+    
+    /* Search as you type, once the user pauses. Quiet period overridable with -CatSearchQuietPeriod */
+    NSTimeInterval quietPeriod = [[NSUserDefaults standardUserDefaults] objectForKey:@"CatSearchQuietPeriod"]
+        ? [[NSUserDefaults standardUserDefaults] doubleForKey:@"CatSearchQuietPeriod"] : kSearchQuietPeriod;
+    __weak CatBrowserViewController* weakSelf = self;
+    search = [[CatSearchDebouncer alloc] initWithQuietPeriod:quietPeriod handler:^(NSString* query) {
+        [weakSelf loadSearch:query];
+    }];
+    
+    /* Suggestions from bookmarks and history, under the address bar */
+    suggestionsView = [[UITableView alloc] initWithFrame:CGRectZero style:UITableViewStylePlain];
+    suggestionsView.autoresizingMask = UIViewAutoresizingFlexibleWidth;
+    suggestionsView.rowHeight = kSuggestionHeight;
+    suggestionsView.dataSource = self;
+    suggestionsView.delegate = self;
+    suggestionsView.hidden = YES;
+    [self.view addSubview:suggestionsView];
+    
+    if([[NSUserDefaults standardUserDefaults] boolForKey:@"CatDebugOverlay"]) {
+        [self setDebugOverlayVisible:YES];
+    }
+}
+
+- (void)setDebugOverlayVisible:(BOOL)visible
+{
+    [debugRefresh invalidate];
+    debugRefresh = nil;
+    [self.debugOverlay removeFromSuperview];
+    self.debugOverlay = nil;
+    if(!visible) {
+        return;
+    }
+    
+    UILabel *overlay = [[UILabel alloc] initWithFrame:CGRectInset(self.webView.frame, kMargin, kMargin)];
+    overlay.autoresizingMask = UIViewAutoresizingFlexibleWidth;
+    overlay.userInteractionEnabled = NO;
+    overlay.numberOfLines = 0;
+    overlay.font = [UIFont fontWithName:@"Menlo" size:10];
+    overlay.textColor = [UIColor whiteColor];
+    overlay.backgroundColor = [UIColor colorWithWhite:0 alpha:.6];
+    [self.view addSubview:overlay];
+    self.debugOverlay = overlay;
+    debugRefresh = [NSTimer scheduledTimerWithTimeInterval:1 target:self selector:@selector(updateDebugOverlay:) userInfo:nil repeats:YES];
+    [self updateDebugOverlay:nil];
+}
+
+- (void)updateDebugOverlay:(NSTimer*)timer
+{
+    UILabel *overlay = self.debugOverlay;
+    overlay.text = [CatMetrics summary];
+    CGRect frame = overlay.frame;
+    frame.size.height = [overlay sizeThatFits:CGSizeMake(frame.size.width, CGFLOAT_MAX)].height;
+    overlay.frame = frame;
 }
 
 - (void)loadRequestFromAddressField:(id)addressField
 {
     NSString *urlString = [addressField text];
+    if([search.pendingQuery isEqualToString:urlString]) {
+        // Return during the quiet period: load the search now, once.
+        [search flush];
+        return;
+    }
     [self loadRequestFromString:urlString];
 }
 
+- (void)loadSearch:(NSString*)query
+{
+    // Whatever is still loading, intercepted images included, is for an older query.
+    if(_webView.loading) {
+        [_webView stopLoading];
+    }
+    [self loadRequestFromString:query];
+    searchLoading = YES;
+}
+
 - (void)didReceiveMemoryWarning
 {
     [super didReceiveMemoryWarning];
-    // Dispose of any resources that can be recreated.
+    [[CatMemoryManager sharedManager] handleMemoryPressure];
+}
+
+- (void)registerCaches
+{
+    CatMemoryManager* manager = [CatMemoryManager sharedManager];
+    // Static: clearing it would free nothing and only forget decisions, so it is reported only.
+    [manager registerCacheNamed:@"decisions" tier:CatMemoryTierDisposable cost:^unsigned long long{
+        return sizeof(CatDecisionCache);
+    } purge:nil];
+    CatGIFDowngrader* gifs = [CatGIFDowngrader sharedDowngrader];
+    [manager registerCacheNamed:@"gifs" tier:CatMemoryTierDisposable cost:^unsigned long long{
+        return gifs.cachedBytes;
+    } purge:^{
+        [gifs purge];
+    }];
+    CatImagePool* pool = [CatImagePool sharedPool];
+    [manager registerCacheNamed:@"pool" tier:CatMemoryTierCache cost:^unsigned long long{
+        return pool.residentBytes;
+    } purge:^{
+        [pool drain];
+    }];
+    __weak CatBrowserViewController* weakSelf = self;
+    [manager registerCacheNamed:@"snapshot" tier:CatMemoryTierCache cost:^unsigned long long{
+        CatBrowserViewController* strongSelf = weakSelf;
+        return strongSelf ? strongSelf->snapshotter.residentBytes : 0;
+    } purge:^{
+        CatBrowserViewController* strongSelf = weakSelf;
+        if(strongSelf) {
+            [strongSelf->snapshotter purge];
+        }
+    }];
+    CatSuggestionEngine* suggestions = [CatSuggestionEngine sharedEngine];
+    [manager registerCacheNamed:@"suggestions" tier:CatMemoryTierWorkingSet cost:^unsigned long long{
+        return suggestions.indexBytes;
+    } purge:nil];
 }
 
 - (NSString*)encodeURIComponent:(NSString*)string
@@ -94,6 +223,8 @@ static NSString* HOME = @"https://www.google.com";
         url = [NSURL URLWithString:[@"https://www.google.com/#q=" stringByAppendingString:[self encodeURIComponent:urlString]]];
     }
     NSURLRequest *urlRequest = [NSURLRequest requestWithURL:url];
+    [search cancel];
+    searchLoading = NO;
     [self.webView loadRequest:urlRequest];
     if([self samePath:url otherURL:lastURL] && !_webView.loading) {
         [self.webView reload];
@@ -126,37 +257,65 @@ static NSString* HOME = @"https://www.google.com";
 
 - (void)updateTitle:(UIWebView*)aWebView
 {
-    NSString* pageTitle = [aWebView stringByEvaluatingJavaScriptFromString:@"document.title"];
-    self.pageTitle.text = pageTitle;
+    self.pageTitle.text = [page state].title;
 }
 
 - (void)updateAddress:(UIWebView*)aWebView
 {
-    NSString* location = [aWebView stringByEvaluatingJavaScriptFromString:@"location.href"];
-    self.addressField.text = location;
+    self.addressField.text = [page state].location;
+}
+
+- (BOOL)webView:(UIWebView *)webView shouldStartLoadWithRequest:(NSURLRequest *)request navigationType:(UIWebViewNavigationType)navigationType
+{
+    if([request.URL isEqual:request.mainDocumentURL]) {
+        [[CatRedirectCache sharedCache] beginPage];
+        [page beginPage];
+        id<CatFormatPolicy> policy = [CatURLProtocol formatPolicy];
+        if([policy respondsToSelector:@selector(resetPage)]) {
+            [policy resetPage];
+        }
+    }
+    return YES;
 }
 
 - (void)webViewDidStartLoad:(UIWebView *)webView
 {
     [UIApplication sharedApplication].networkActivityIndicatorVisible = YES;
+    [snapshotter setNeedsCapture];
+    [page invalidate];
     [self updateButtons];
 }
 - (void)webViewDidFinishLoad:(UIWebView *)webView
 {
     [UIApplication sharedApplication].networkActivityIndicatorVisible = NO;
+    [snapshotter setNeedsCapture];
+    [page invalidate];
+    if(!webView.loading) {
+        searchLoading = NO;
+    }
     [self updateButtons];
     [self updateTitle:webView];
+    if(!webView.loading) {
+        CatPageState* state = [page state];
+        [[CatSuggestionEngine sharedEngine] noteVisitToLocation:state.location title:state.title];
+        [[CatHistoryStore sharedStore] addVisitToLocation:state.location title:state.title];
+    }
 //    if(![self.addressField isFirstResponder])
 //         [self updateAddress:webView];
 }
 - (void)webView:(UIWebView *)webView didFailLoadWithError:(NSError *)error
 {
     [UIApplication sharedApplication].networkActivityIndicatorVisible = NO;
+    [page invalidate];
+    if(!webView.loading) {
+        searchLoading = NO;
+    }
     [self updateButtons];
 }
 
 -(void)scrollViewDidScroll:(UIScrollView *)scrollView
 {
+    [snapshotter setNeedsCapture];
 //    if([scrollView contentOffset].y<20)
 //        [self.navigationController.navigationBar setHidden:NO];
 }
@@ -164,13 +323,16 @@ static NSString* HOME = @"https://www.google.com";
 - (BOOL)textField:(UITextField *)textField shouldChangeCharactersInRange:(NSRange)range replacementString:(NSString *)string
 {
     NSString* urlString = [[textField text] stringByReplacingCharactersInRange:range withString:string];
+    [self updateSuggestionsForText:urlString];
     NSURL *url = [NSURL URLWithString:urlString];
     NSString* scheme = url.scheme;
     if(!scheme) {
-        if(_webView.loading) {
-//            [_webView stopLoading];
+        // The search loading is already out of date; stop it and its images now
+        // rather than when the next one starts.
+        if(searchLoading && _webView.loading) {
+            [_webView stopLoading];
         }
-        [self loadRequestFromString:urlString];
+        [search submitQuery:urlString];
     }
     return YES;
 }
@@ -194,10 +356,13 @@ static NSString* HOME = @"https://www.google.com";
 - (void) updateBookmark:(BookmarkCollectionViewController*)bookmarkViewController
 {
     if([CatURLProtocol cat]) {
-        bookmarkViewController.snapShot = [self takeSnapshot:_webView];
+        [snapshotter captureView:_webView offset:[_webView scrollView].contentOffset.y publish:^(UIImage* image) {
+            bookmarkViewController.snapShot = image;
+        }];
     }
     else {
         bookmarkViewController.snapShot = nil;
+        [snapshotter setNeedsCapture];
         [CatURLProtocol setCat:YES];
         [self updateCatButton];
         [_webView reload];
@@ -209,9 +374,11 @@ static NSString* HOME = @"https://www.google.com";
         [[self pageTitle] setHidden:YES];
         [[self addressField] setHidden:YES];
         BookmarkCollectionViewController* bookmarkViewController = segue.destinationViewController;
-        [bookmarkViewController setLocation:[_webView stringByEvaluatingJavaScriptFromString:@"location.href"]];
-        [bookmarkViewController setPageTitle:[_webView stringByEvaluatingJavaScriptFromString:@"document.title"]];
+        CatPageState* state = [page state];
+        [bookmarkViewController setLocation:state.location];
+        [bookmarkViewController setPageTitle:state.title];
         [bookmarkViewController setDelegate:self];
+        snapshotter = [self makeSnapshotter];
         bookmarkRefresh = [NSTimer scheduledTimerWithTimeInterval:.5 target:self selector:@selector(updateBookmarkTimer:) userInfo:bookmarkViewController repeats:YES];
         [self updateBookmark:bookmarkViewController];
     }
@@ -227,21 +394,10 @@ static NSString* HOME = @"https://www.google.com";
     }
 }
 
-- (UIImage *) takeSnapshot:(UIView *)view
+- (CatSnapshotter*) makeSnapshotter
 {
-    int mul = [CatBrowserViewController isRetina] ? 2 : 1;
     CGSize thumbnailSize = [[UIDevice currentDevice] userInterfaceIdiom] == UIUserInterfaceIdiomPad ? CGSizeMake(190, 172) : CGSizeMake(120, 92);
-    CGSize size = CGSizeMake(view.frame.size.width,view.frame.size.width/thumbnailSize.width*thumbnailSize.height);
-    UIGraphicsBeginImageContextWithOptions(size, view.opaque, thumbnailSize.width*mul/view.frame.size.width);
-    CGContextRef context = UIGraphicsGetCurrentContext();
-    CGContextTranslateCTM(context,0,fmin(0,[_webView scrollView].contentOffset.y));
-    [view.layer renderInContext:context];
-    
-    UIImage * img = UIGraphicsGetImageFromCurrentImageContext();
-    
-    UIGraphicsEndImageContext();
-    
-    return img;
+    return [[CatSnapshotter alloc] initWithThumbnailSize:thumbnailSize scale:[CatBrowserViewController isRetina] ? 2 : 1];
 }
 
 - (void) viewWillAppear:(BOOL)animated
@@ -250,6 +406,7 @@ static NSString* HOME = @"https://www.google.com";
         [bookmarkRefresh invalidate];
         bookmarkRefresh = nil;
     }
+    snapshotter = nil;
 }
 
 - (void) viewDidAppear:(BOOL)animated
@@ -263,6 +420,52 @@ static NSString* HOME = @"https://www.google.com";
     [textField selectAll:self];
 }
 
+- (void)textFieldDidEndEditing:(UITextField *)textField
+{
+    [self updateSuggestionsForText:nil];
+}
+
+- (void)updateSuggestionsForText:(NSString*)text
+{
+    suggestions = text ? [[CatSuggestionEngine sharedEngine] suggestionsForText:text limit:kMaxSuggestions] : nil;
+    suggestionsView.hidden = !suggestions.count;
+    if(!suggestions.count) {
+        return;
+    }
+    UINavigationBar *navBar = self.navigationController.navigationBar;
+    CGFloat top = CGRectGetMaxY([self.view convertRect:navBar.bounds fromView:navBar]);
+    suggestionsView.frame = CGRectMake(0, top, self.view.bounds.size.width, suggestions.count * kSuggestionHeight);
+    [self.view bringSubviewToFront:suggestionsView];
+    [suggestionsView reloadData];
+}
+
+- (NSInteger)tableView:(UITableView *)tableView numberOfRowsInSection:(NSInteger)section
+{
+    return suggestions.count;
+}
+
+- (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    static NSString *identifier = @"Suggestion";
+    UITableViewCell *cell = [tableView dequeueReusableCellWithIdentifier:identifier];
+    if(!cell) {
+        cell = [[UITableViewCell alloc] initWithStyle:UITableViewCellStyleSubtitle reuseIdentifier:identifier];
+        cell.detailTextLabel.textColor = [UIColor grayColor];
+    }
+    CatSuggestion* suggestion = suggestions[indexPath.row];
+    cell.textLabel.text = suggestion.title.length ? suggestion.title : suggestion.location;
+    cell.detailTextLabel.text = suggestion.location;
+    cell.imageView.image = suggestion.bookmarked ? [UIImage imageNamed:@"blankstar.png"] : nil;
+    return cell;
+}
+
+- (void)tableView:(UITableView *)tableView didSelectRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    CatSuggestion* suggestion = suggestions[indexPath.row];
+    [self.addressField resignFirstResponder];
+    [self openLink:suggestion.location];
+}
+
 - (void) openLink:(NSString*) location
 {
     [[self addressField] setText:location];
@@ -0,0 +1,137 @@
+//
+//  CatDecisionCache.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/24/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatDecisionCache.h"
+
+#include <pthread.h>
+
+// Value layout, high to low: 32 bits of config version, 19 unused, a
+// valid bit, the decision, and rule + 1 in 11 bits.
+#define kVersionShift 32
+#define kValidBit (1ULL << 12)
+#define kInterceptBit (1ULL << 11)
+#define kRuleMask 0x7FFULL
+
+static inline uint64_t CatEntryKey(uint32_t version)
+{
+    return ((uint64_t)version << kVersionShift) | kValidBit;
+}
+
+static inline int CatEntryMatches(uint64_t value, uint64_t check, uint64_t hash, uint64_t key)
+{
+    return (value & ~(kInterceptBit | kRuleMask)) == key && (value ^ check) == hash;
+}
+
+// The low hash bits pick the shard and a pair of neighbouring slots.
+static inline CatDecisionSlot* CatSlotPair(CatDecisionCache* cache, uint64_t hash)
+{
+    CatDecisionShard* shard = &cache->shards[hash % kCatDecisionShards];
+    size_t index = (size_t)((hash / kCatDecisionShards) % kCatDecisionSlotsPerShard) & ~(size_t)1;
+    return &shard->slots[index];
+}
+
+// Threads hash to a stripe of their own, mostly: the adds are atomic but
+// seldom shared, and order nothing.
+static inline CatDecisionCounters* CatThreadCounters(CatDecisionCache* cache)
+{
+    uint64_t thread = (uint64_t)(uintptr_t)pthread_self() * 0x9E3779B97F4A7C15ULL;
+    return &cache->counters[thread >> 60 & (kCatDecisionStripes - 1)];
+}
+
+static inline void CatCount(volatile uint64_t* counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+uint64_t CatDecisionHash(uint64_t hash, const void* bytes, size_t length)
+{
+    const unsigned char* p = bytes;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+int CatDecisionCacheLookup(CatDecisionCache* cache, uint64_t hash, uint32_t version, int* intercept, int* rule)
+{
+    CatDecisionSlot* pair = CatSlotPair(cache, hash);
+    uint64_t key = CatEntryKey(version);
+    for(int i = 0; i < 2; i++) {
+        uint64_t value = pair[i].value;
+        uint64_t check = pair[i].check;
+        if(CatEntryMatches(value, check, hash, key)) {
+            *intercept = (value & kInterceptBit) != 0;
+            *rule = (int)(value & kRuleMask) - 1;
+            CatCount(&CatThreadCounters(cache)->hits);
+            return 1;
+        }
+    }
+    CatCount(&CatThreadCounters(cache)->misses);
+    return 0;
+}
+
+void CatDecisionCacheStore(CatDecisionCache* cache, uint64_t hash, uint32_t version, int intercept, int rule)
+{
+    if(rule > kCatDecisionMaxRule) {
+        return;
+    }
+    CatDecisionSlot* pair = CatSlotPair(cache, hash);
+    uint64_t key = CatEntryKey(version);
+    uint64_t value = key | (intercept ? kInterceptBit : 0) | (uint64_t)(rule + 1);
+    // Prefer a slot that is empty or stale; otherwise the second slot
+    // takes the newcomer and the first keeps the older, proven entry.
+    int target = 1;
+    for(int i = 0; i < 2; i++) {
+        uint64_t current = pair[i].value;
+        if(!(current & kValidBit) || current >> kVersionShift != version || CatEntryMatches(current, pair[i].check, hash, key)) {
+            target = i;
+            break;
+        }
+    }
+    __atomic_store_n(&pair[target].value, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&pair[target].check, hash ^ value, __ATOMIC_RELAXED);
+    CatCount(&CatThreadCounters(cache)->stores);
+}
+
+void CatDecisionCacheClear(CatDecisionCache* cache)
+{
+    for(int s = 0; s < kCatDecisionShards; s++) {
+        for(int i = 0; i < kCatDecisionSlotsPerShard; i++) {
+            __atomic_store_n(&cache->shards[s].slots[i].value, 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void CatDecisionCacheStats(const CatDecisionCache* cache, uint64_t* hits, uint64_t* misses, uint64_t* stores)
+{
+    uint64_t h = 0, m = 0, s = 0;
+    for(int i = 0; i < kCatDecisionStripes; i++) {
+        h += cache->counters[i].hits;
+        m += cache->counters[i].misses;
+        s += cache->counters[i].stores;
+    }
+    if(hits) {
+        *hits = h;
+    }
+    if(misses) {
+        *misses = m;
+    }
+    if(stores) {
+        *stores = s;
+    }
+}
+
+void CatDecisionCacheResetStats(CatDecisionCache* cache)
+{
+    for(int i = 0; i < kCatDecisionStripes; i++) {
+        __atomic_store_n(&cache->counters[i].hits, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cache->counters[i].misses, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&cache->counters[i].stores, 0, __ATOMIC_RELAXED);
+    }
+}
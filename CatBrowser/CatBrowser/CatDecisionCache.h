@@ -0,0 +1,73 @@
+//
+//  CatDecisionCache.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/24/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Remembers canInitWithRequest: decisions, since WebKit asks about the
+//  same URL several times per load. An entry is two 64-bit words: the
+//  config version with the decision, and the whole URL hash XORed with
+//  that first word. Readers and writers need no lock: a reader that sees
+//  one word of an old entry and one of a new one gets another hash back
+//  and takes it as a miss. A stale version reads as a miss too, which is
+//  how a config swap or the cat toggle invalidates everything at once.
+//  Counters are kept per thread stripe, so loader threads asking about the
+//  same URL do not fight over one cache line. Plain C, no Apple
+//  dependency.
+//
+
+#ifndef CatBrowser_CatDecisionCache_h
+#define CatBrowser_CatDecisionCache_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define kCatDecisionShards 16
+#define kCatDecisionSlotsPerShard 512
+#define kCatDecisionStripes 16
+// Rules past this index are matched every time.
+#define kCatDecisionMaxRule 2045
+
+typedef struct {
+    volatile uint64_t value;
+    volatile uint64_t check;        // hash ^ value
+} CatDecisionSlot;
+
+typedef struct {
+    CatDecisionSlot slots[kCatDecisionSlotsPerShard];
+} CatDecisionShard;
+
+typedef struct {
+    volatile uint64_t hits;
+    volatile uint64_t misses;
+    volatile uint64_t stores;
+    char padding[64 - 3 * sizeof(uint64_t)];
+} CatDecisionCounters;
+
+typedef struct {
+    CatDecisionShard shards[kCatDecisionShards];
+    CatDecisionCounters counters[kCatDecisionStripes];
+} CatDecisionCache;
+
+// 64-bit FNV-1a, chainable: pass the previous result to hash more bytes.
+#define kCatDecisionHashSeed 0xcbf29ce484222325ULL
+uint64_t CatDecisionHash(uint64_t hash, const void* bytes, size_t length);
+
+// Returns 1 and fills intercept and rule on a hit, 0 on a miss.
+int CatDecisionCacheLookup(CatDecisionCache* cache, uint64_t hash, uint32_t version, int* intercept, int* rule);
+void CatDecisionCacheStore(CatDecisionCache* cache, uint64_t hash, uint32_t version, int intercept, int rule);
+void CatDecisionCacheClear(CatDecisionCache* cache);
+
+void CatDecisionCacheStats(const CatDecisionCache* cache, uint64_t* hits, uint64_t* misses, uint64_t* stores);
+void CatDecisionCacheResetStats(CatDecisionCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+//
+//  CatDecodeCostPolicy.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/25/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Format policy that weighs the config's type weights by what each format
+//  costs to decode at each size class, as measured on delivered images.
+//  The config's formatBudget sets the limits:
+//    decodedBytes       a format expected to decode larger than this is
+//                       picked less, in proportion (0: no limit)
+//    animationsPerPage  no more gifs on a page once it has this many
+//    preferOriginal     weight multiplier for the format of the image replaced
+//  Gifs are also left out for a while after a memory warning.
+//
+
+#import <Foundation/Foundation.h>
+#import "CatFormatPolicy.h"
+
+@interface CatDecodeCostPolicy : NSObject <CatFormatPolicy>
+
+// didDeliverData: decodes the image off the main thread, every frame, and
+// records the cost. It samples at most one image per type and size class
+// every sampleInterval.
+- (void) recordDecodeOfType:(NSString*)type sizeClass:(NSUInteger)sizeClass nanoseconds:(uint64_t)nanoseconds bytes:(uint64_t)bytes;
+
+// Mean measured cost, 0 until something was recorded.
+- (uint64_t) expectedBytesForType:(NSString*)type sizeClass:(NSUInteger)sizeClass;
+- (uint64_t) expectedNanosecondsForType:(NSString*)type sizeClass:(NSUInteger)sizeClass;
+
+- (void) noteMemoryWarning;
+@property (readonly, getter=isUnderMemoryPressure) BOOL underMemoryPressure;
+@property NSTimeInterval pressureInterval;      // default 60s
+@property NSTimeInterval sampleInterval;        // default 2s
+
+@property (readonly) NSUInteger pageAnimations;
+@property (readonly) NSUInteger avoidedAnimations;  // gifs left out by the budget
+// type/sizeClass -> @{count, bytes, nanoseconds} (means)
+- (NSDictionary*) costs;
+
+@end
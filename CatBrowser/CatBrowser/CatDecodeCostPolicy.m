@@ -0,0 +1,228 @@
+//
+//  CatDecodeCostPolicy.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/25/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatDecodeCostPolicy.h"
+#import "CatInterceptConfig.h"
+#import "CatMetrics.h"
+#import <ImageIO/ImageIO.h>
+#import <UIKit/UIKit.h>
+
+// Past this many samples the mean becomes a moving average, so costs follow
+// what the origin serves now.
+static const double kCostWindow = 16;
+static const size_t kMaxSampledFrames = 256;
+
+@interface CatDecodeCost : NSObject
+{
+@public
+    NSUInteger count;
+    double bytes;
+    double nanoseconds;
+    CFAbsoluteTime lastSample;
+}
+@end
+
+@implementation CatDecodeCost
+@end
+
+@implementation CatDecodeCostPolicy
+{
+    NSMutableDictionary* costs;     // "type/sizeClass" -> CatDecodeCost
+    dispatch_queue_t sampler;
+    CFAbsoluteTime pressureUntil;
+}
+
+- (id) init
+{
+    if(self = [super init]) {
+        costs = [NSMutableDictionary dictionary];
+        sampler = dispatch_queue_create("com.dobuki.CatBrowser.decodecost", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(sampler, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        _pressureInterval = 60;
+        _sampleInterval = 2;
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(noteMemoryWarning)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+static NSString* costKey(NSString* type, NSUInteger sizeClass)
+{
+    return [NSString stringWithFormat:@"%@/%lu", type, (unsigned long)sizeClass];
+}
+
+- (NSString*) typeForURL:(NSURL*)url sizeClass:(NSUInteger)sizeClass config:(CatInterceptConfig*)config
+{
+    NSDictionary* budget = config.formatBudget;
+    double byteBudget = [budget[@"decodedBytes"] doubleValue];
+    NSUInteger animationsPerPage = [budget[@"animationsPerPage"] unsignedIntegerValue];
+    double preferOriginal = budget[@"preferOriginal"] ? [budget[@"preferOriginal"] doubleValue] : 1;
+    NSString* original = CatFormatTypeForExtension(url.pathExtension);
+    NSDictionary* typeWeights = config.typeWeights;
+    NSArray* types = [typeWeights.allKeys sortedArrayUsingSelector:@selector(compare:)];
+
+    @synchronized(self) {
+        BOOL animationsAllowed = !self.underMemoryPressure && (!budget[@"animationsPerPage"] || _pageAnimations < animationsPerPage);
+        double weights[types.count];
+        double total = 0;
+        BOOL skippedAnimation = NO;
+        for(NSUInteger i=0; i<types.count; i++) {
+            NSString* type = types[i];
+            double weight = MAX(0, [typeWeights[type] doubleValue]);
+            if(weight > 0 && [type isEqualToString:@"gif"] && !animationsAllowed) {
+                weight = 0;
+                skippedAnimation = YES;
+            }
+            if(weight > 0 && [type isEqualToString:original]) {
+                weight *= preferOriginal;
+            }
+            CatDecodeCost* cost = costs[costKey(type, sizeClass)];
+            if(weight > 0 && byteBudget > 0 && cost && cost->bytes > byteBudget) {
+                weight *= byteBudget / cost->bytes;
+            }
+            weights[i] = weight;
+            total += weight;
+        }
+        if(total <= 0) {
+            // Only gifs are configured and they are ruled out: a gif still beats no cat.
+            return [config randomType];
+        }
+        if(skippedAnimation) {
+            _avoidedAnimations++;
+        }
+        double pick = total * arc4random() / ((double)UINT32_MAX + 1);
+        NSString* chosen = types.lastObject;
+        for(NSUInteger i=0; i<types.count; i++) {
+            if(pick < weights[i]) {
+                chosen = types[i];
+                break;
+            }
+            pick -= weights[i];
+        }
+        if([chosen isEqualToString:@"gif"]) {
+            _pageAnimations++;
+        }
+        return chosen;
+    }
+}
+
+- (void) recordDecodeOfType:(NSString*)type sizeClass:(NSUInteger)sizeClass nanoseconds:(uint64_t)nanoseconds bytes:(uint64_t)bytes
+{
+    @synchronized(self) {
+        NSString* key = costKey(type, sizeClass);
+        CatDecodeCost* cost = costs[key];
+        if(!cost) {
+            cost = costs[key] = [[CatDecodeCost alloc] init];
+        }
+        cost->count++;
+        double weight = 1 / MIN((double)cost->count, kCostWindow);
+        cost->bytes += (bytes - cost->bytes) * weight;
+        cost->nanoseconds += (nanoseconds - cost->nanoseconds) * weight;
+    }
+}
+
+- (void) resetPage
+{
+    @synchronized(self) {
+        _pageAnimations = 0;
+    }
+}
+
+- (void) didDeliverData:(NSData*)data type:(NSString*)type sizeClass:(NSUInteger)sizeClass
+{
+    if(!data.length || !type) {
+        return;
+    }
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    @synchronized(self) {
+        NSString* key = costKey(type, sizeClass);
+        CatDecodeCost* cost = costs[key];
+        if(!cost) {
+            cost = costs[key] = [[CatDecodeCost alloc] init];
+        }
+        if(cost->lastSample && now - cost->lastSample < _sampleInterval) {
+            return;
+        }
+        cost->lastSample = now;
+    }
+    dispatch_async(sampler, ^{
+        CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)data, NULL);
+        if(!source) {
+            return;
+        }
+        size_t frames = MIN(CGImageSourceGetCount(source), kMaxSampledFrames);
+        uint64_t bytes = 0;
+        uint64_t start = CatMetricsNow();
+        for(size_t i=0; i<frames; i++) {
+            CGImageRef image = CGImageSourceCreateImageAtIndex(source, i, NULL);
+            if(!image) {
+                continue;
+            }
+            // Copying the pixels forces the decode WebKit would do.
+            CFDataRef pixels = CGDataProviderCopyData(CGImageGetDataProvider(image));
+            if(pixels) {
+                bytes += CFDataGetLength(pixels);
+                CFRelease(pixels);
+            }
+            CGImageRelease(image);
+        }
+        uint64_t elapsed = CatMetricsNow() - start;
+        CFRelease(source);
+        if(bytes) {
+            [self recordDecodeOfType:type sizeClass:sizeClass nanoseconds:elapsed bytes:bytes];
+        }
+    });
+}
+
+- (uint64_t) expectedBytesForType:(NSString*)type sizeClass:(NSUInteger)sizeClass
+{
+    @synchronized(self) {
+        CatDecodeCost* cost = costs[costKey(type, sizeClass)];
+        return cost ? (uint64_t)cost->bytes : 0;
+    }
+}
+
+- (uint64_t) expectedNanosecondsForType:(NSString*)type sizeClass:(NSUInteger)sizeClass
+{
+    @synchronized(self) {
+        CatDecodeCost* cost = costs[costKey(type, sizeClass)];
+        return cost ? (uint64_t)cost->nanoseconds : 0;
+    }
+}
+
+- (void) noteMemoryWarning
+{
+    @synchronized(self) {
+        pressureUntil = CFAbsoluteTimeGetCurrent() + _pressureInterval;
+    }
+}
+
+- (BOOL) isUnderMemoryPressure
+{
+    return CFAbsoluteTimeGetCurrent() < pressureUntil;
+}
+
+- (NSDictionary*) costs
+{
+    NSMutableDictionary* result = [NSMutableDictionary dictionary];
+    @synchronized(self) {
+        [costs enumerateKeysAndObjectsUsingBlock:^(NSString* key, CatDecodeCost* cost, BOOL* stop) {
+            if(cost->count) {
+                result[key] = @{ @"count": @(cost->count), @"bytes": @((uint64_t)cost->bytes), @"nanoseconds": @((uint64_t)cost->nanoseconds) };
+            }
+        }];
+    }
+    return result;
+}
+
+@end
@@ -0,0 +1,34 @@
+//
+//  CatFormatPolicy.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/25/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Chooses the format (gif, jpg, png) of each replacement image.
+//  CatURLProtocol asks its policy once per intercepted request and shows
+//  it every image delivered, so a policy can measure what each format costs
+//  the device and steer away from the expensive ones.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CatInterceptConfig;
+
+@protocol CatFormatPolicy <NSObject>
+@required
+// Type of the replacement for the image at url, shown at sizeClass.
+- (NSString*) typeForURL:(NSURL*)url sizeClass:(NSUInteger)sizeClass config:(CatInterceptConfig*)config;
+@optional
+// The body handed to WebKit for a replacement. Called on a loader thread.
+- (void) didDeliverData:(NSData*)data type:(NSString*)type sizeClass:(NSUInteger)sizeClass;
+// A new page started loading.
+- (void) resetPage;
+@end
+
+// Draws from the config's type weights and nothing else.
+@interface CatWeightedFormatPolicy : NSObject <CatFormatPolicy>
+@end
+
+// Image type of a file extension (jpeg -> jpg), or nil when it is not one we serve.
+NSString* CatFormatTypeForExtension(NSString* extension);
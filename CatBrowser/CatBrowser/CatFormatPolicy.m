@@ -0,0 +1,31 @@
+//
+//  CatFormatPolicy.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/25/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatFormatPolicy.h"
+#import "CatInterceptConfig.h"
+
+NSString* CatFormatTypeForExtension(NSString* extension)
+{
+    NSString* lowercase = extension.lowercaseString;
+    if([lowercase isEqualToString:@"jpeg"]) {
+        return @"jpg";
+    }
+    if([lowercase isEqualToString:@"jpg"] || [lowercase isEqualToString:@"png"] || [lowercase isEqualToString:@"gif"]) {
+        return lowercase;
+    }
+    return nil;
+}
+
+@implementation CatWeightedFormatPolicy
+
+- (NSString*) typeForURL:(NSURL*)url sizeClass:(NSUInteger)sizeClass config:(CatInterceptConfig*)config
+{
+    return [config randomType];
+}
+
+@end
@@ -0,0 +1,512 @@
+//
+//  CatGIF.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/26/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatGIF.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kMaxCodes 4096
+
+typedef struct {
+    uint8_t* bytes;
+    size_t length;
+    size_t capacity;
+    int failed;
+} CatBuffer;
+
+static void CatBufferAppend(CatBuffer* buffer, const void* bytes, size_t length)
+{
+    if(buffer->failed) {
+        return;
+    }
+    if(buffer->length + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while(capacity < buffer->length + length) {
+            capacity *= 2;
+        }
+        uint8_t* grown = realloc(buffer->bytes, capacity);
+        if(!grown) {
+            buffer->failed = 1;
+            return;
+        }
+        buffer->bytes = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void CatBufferByte(CatBuffer* buffer, uint8_t byte)
+{
+    CatBufferAppend(buffer, &byte, 1);
+}
+
+static inline uint16_t CatRead16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void CatWrite16(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t)(value & 0xFF);
+    p[1] = (uint8_t)((value >> 8) & 0xFF);
+}
+
+// MARK: Block structure
+
+// A frame is everything from the end of the previous one (its extensions,
+// graphic control included) to the end of its image data.
+typedef struct {
+    size_t start;
+    size_t descriptor;
+    size_t end;
+} CatGIFFrame;
+
+// Position past a run of data sub-blocks, or 0 when it runs off the end.
+static size_t CatSkipSubBlocks(const uint8_t* data, size_t length, size_t position)
+{
+    while(position < length) {
+        uint8_t size = data[position++];
+        if(!size) {
+            return position;
+        }
+        position += size;
+    }
+    return 0;
+}
+
+static size_t CatColorTableSize(uint8_t flags)
+{
+    return flags & 0x80 ? 3u << ((flags & 7) + 1) : 0;
+}
+
+// Fills the header end and up to capacity frames. Returns the frame count or -1.
+static long CatGIFScan(const uint8_t* data, size_t length, size_t* headerEnd, CatGIFFrame* frames, size_t capacity)
+{
+    if(length < 13 || memcmp(data, "GIF", 3) != 0 || (memcmp(data + 3, "87a", 3) != 0 && memcmp(data + 3, "89a", 3) != 0)) {
+        return -1;
+    }
+    size_t position = 13 + CatColorTableSize(data[10]);
+    if(position > length) {
+        return -1;
+    }
+    *headerEnd = position;
+    long count = 0;
+    size_t start = position;
+    while(position < length) {
+        uint8_t block = data[position];
+        if(block == 0x3B) {
+            return count;
+        }
+        if(block == 0x21) {
+            if(position + 2 > length) {
+                return -1;
+            }
+            position = CatSkipSubBlocks(data, length, position + 2);
+        }
+        else if(block == 0x2C) {
+            if(position + 11 > length) {
+                return -1;
+            }
+            size_t descriptor = position;
+            position += 10 + CatColorTableSize(data[position + 9]);
+            if(position + 1 > length) {
+                return -1;
+            }
+            position = CatSkipSubBlocks(data, length, position + 1);
+            if(position) {
+                if((size_t)count < capacity) {
+                    frames[count].start = start;
+                    frames[count].descriptor = descriptor;
+                    frames[count].end = position;
+                }
+                count++;
+                start = position;
+            }
+        }
+        else {
+            return -1;
+        }
+        if(!position) {
+            return -1;
+        }
+    }
+    // Missing trailer: browsers show what is there, so do we.
+    return count;
+}
+
+int CatGIFInspect(const uint8_t* data, size_t length, CatGIFInfo* info)
+{
+    size_t headerEnd;
+    long frames = CatGIFScan(data, length, &headerEnd, NULL, 0);
+    if(frames < 0) {
+        return -1;
+    }
+    info->width = CatRead16(data + 6);
+    info->height = CatRead16(data + 8);
+    info->frames = (uint32_t)frames;
+    info->decodedBytes = (uint64_t)info->width * info->height * 4 * (uint64_t)frames;
+    return 0;
+}
+
+// MARK: LZW
+
+size_t CatGIFDecodeLZW(const uint8_t* codes, size_t length, int minCodeSize, uint8_t* pixels, size_t pixelCount)
+{
+    if(minCodeSize < 2 || minCodeSize > 8) {
+        return 0;
+    }
+    uint16_t prefix[kMaxCodes];
+    uint8_t suffix[kMaxCodes];
+    uint8_t stack[kMaxCodes + 1];
+    int clear = 1 << minCodeSize;
+    int end = clear + 1;
+    for(int i = 0; i < clear; i++) {
+        prefix[i] = 0;
+        suffix[i] = (uint8_t)i;
+    }
+    int codeSize = minCodeSize + 1;
+    int next = end + 1;
+    int old = -1;
+    uint8_t first = 0;
+    uint32_t accumulator = 0;
+    int bits = 0;
+    size_t position = 0;
+    size_t written = 0;
+
+    while(written < pixelCount) {
+        while(bits < codeSize && position < length) {
+            accumulator |= (uint32_t)codes[position++] << bits;
+            bits += 8;
+        }
+        if(bits < codeSize) {
+            break;
+        }
+        int code = accumulator & ((1u << codeSize) - 1);
+        accumulator >>= codeSize;
+        bits -= codeSize;
+
+        if(code == clear) {
+            codeSize = minCodeSize + 1;
+            next = end + 1;
+            old = -1;
+            continue;
+        }
+        if(code == end) {
+            break;
+        }
+        if(old < 0) {
+            if(code > clear) {
+                break;
+            }
+            pixels[written++] = (uint8_t)code;
+            old = code;
+            first = (uint8_t)code;
+            continue;
+        }
+        int in = code;
+        int depth = 0;
+        if(code >= next) {
+            if(code > next) {
+                break;
+            }
+            stack[depth++] = first;
+            code = old;
+        }
+        while(code >= clear) {
+            if(depth >= kMaxCodes) {
+                return written;
+            }
+            stack[depth++] = suffix[code];
+            code = prefix[code];
+        }
+        first = suffix[code];
+        stack[depth++] = first;
+        while(depth && written < pixelCount) {
+            pixels[written++] = stack[--depth];
+        }
+        if(next < kMaxCodes) {
+            prefix[next] = (uint16_t)old;
+            suffix[next] = first;
+            next++;
+            if(next == (1 << codeSize) && codeSize < 12) {
+                codeSize++;
+            }
+        }
+        old = in;
+    }
+    return written;
+}
+
+typedef struct {
+    CatBuffer* buffer;
+    uint32_t accumulator;
+    int bits;
+} CatBitWriter;
+
+static void CatWriteCode(CatBitWriter* writer, int code, int size)
+{
+    writer->accumulator |= (uint32_t)code << writer->bits;
+    writer->bits += size;
+    while(writer->bits >= 8) {
+        CatBufferByte(writer->buffer, (uint8_t)(writer->accumulator & 0xFF));
+        writer->accumulator >>= 8;
+        writer->bits -= 8;
+    }
+}
+
+// Open addressing on (prefix << 8 | byte); twice the code space keeps probes short.
+#define kHashSize 8191
+
+uint8_t* CatGIFEncodeLZW(const uint8_t* pixels, size_t pixelCount, int minCodeSize, size_t* length)
+{
+    if(minCodeSize < 2 || minCodeSize > 8) {
+        return NULL;
+    }
+    int32_t keys[kHashSize];
+    int16_t values[kHashSize];
+    CatBuffer buffer = { NULL, 0, 0, 0 };
+    CatBitWriter writer = { &buffer, 0, 0 };
+    int clear = 1 << minCodeSize;
+    int codeSize = minCodeSize + 1;
+    int maxCode = clear + 1;
+    memset(keys, 0xFF, sizeof(keys));
+    CatWriteCode(&writer, clear, codeSize);
+
+    int current = -1;
+    for(size_t i = 0; i < pixelCount; i++) {
+        uint8_t pixel = pixels[i] & (clear - 1);
+        if(current < 0) {
+            current = pixel;
+            continue;
+        }
+        int32_t key = (current << 8) | pixel;
+        size_t slot = (size_t)key % kHashSize;
+        while(keys[slot] >= 0 && keys[slot] != key) {
+            slot = (slot + 1) % kHashSize;
+        }
+        if(keys[slot] == key) {
+            current = values[slot];
+            continue;
+        }
+        CatWriteCode(&writer, current, codeSize);
+        keys[slot] = key;
+        values[slot] = (int16_t)++maxCode;
+        if(maxCode >= (1 << codeSize)) {
+            codeSize++;
+        }
+        if(maxCode == kMaxCodes - 1) {
+            CatWriteCode(&writer, clear, codeSize);
+            memset(keys, 0xFF, sizeof(keys));
+            codeSize = minCodeSize + 1;
+            maxCode = clear + 1;
+        }
+        current = pixel;
+    }
+    if(current >= 0) {
+        CatWriteCode(&writer, current, codeSize);
+    }
+    CatWriteCode(&writer, clear + 1, codeSize);
+    if(writer.bits) {
+        CatBufferByte(&buffer, (uint8_t)writer.accumulator);
+    }
+    if(buffer.failed) {
+        free(buffer.bytes);
+        return NULL;
+    }
+    *length = buffer.length;
+    return buffer.bytes;
+}
+
+// MARK: Transcoding
+
+// Rows of an interlaced image come in four passes; put them back in order.
+static void CatDeinterlace(const uint8_t* source, uint8_t* target, uint32_t width, uint32_t height)
+{
+    static const uint32_t starts[] = { 0, 4, 2, 1 };
+    static const uint32_t steps[] = { 8, 8, 4, 2 };
+    uint32_t row = 0;
+    for(int pass = 0; pass < 4; pass++) {
+        for(uint32_t y = starts[pass]; y < height; y += steps[pass]) {
+            memcpy(target + (size_t)y * width, source + (size_t)row * width, width);
+            row++;
+        }
+    }
+}
+
+// Appends one frame scaled by canvasWidth/width, canvasHeight/height. 0 on success.
+static int CatAppendScaledFrame(CatBuffer* output, const uint8_t* data, const CatGIFFrame* frame,
+                                uint32_t width, uint32_t height, uint32_t scaledWidth, uint32_t scaledHeight)
+{
+    // Extensions before the image go through untouched.
+    CatBufferAppend(output, data + frame->start, frame->descriptor - frame->start);
+
+    const uint8_t* descriptor = data + frame->descriptor;
+    uint32_t left = CatRead16(descriptor + 1);
+    uint32_t top = CatRead16(descriptor + 3);
+    uint32_t frameWidth = CatRead16(descriptor + 5);
+    uint32_t frameHeight = CatRead16(descriptor + 7);
+    uint8_t flags = descriptor[9];
+    size_t tableSize = CatColorTableSize(flags);
+    const uint8_t* table = descriptor + 10;
+    int minCodeSize = table[tableSize];
+    if(!frameWidth || !frameHeight) {
+        return -1;
+    }
+
+    // Gather the sub-blocks into one code stream.
+    size_t position = frame->descriptor + 10 + tableSize + 1;
+    CatBuffer codes = { NULL, 0, 0, 0 };
+    while(position < frame->end && data[position]) {
+        CatBufferAppend(&codes, data + position + 1, data[position]);
+        position += 1 + data[position];
+    }
+    size_t pixelCount = (size_t)frameWidth * frameHeight;
+    uint8_t* pixels = calloc(pixelCount, 1);
+    uint8_t* ordered = flags & 0x40 ? malloc(pixelCount) : NULL;
+    if(codes.failed || !pixels || (flags & 0x40 && !ordered)) {
+        free(codes.bytes);
+        free(pixels);
+        free(ordered);
+        return -1;
+    }
+    CatGIFDecodeLZW(codes.bytes, codes.length, minCodeSize, pixels, pixelCount);
+    free(codes.bytes);
+    if(ordered) {
+        CatDeinterlace(pixels, ordered, frameWidth, frameHeight);
+        free(pixels);
+        pixels = ordered;
+    }
+
+    uint32_t scaledLeft = (uint32_t)((uint64_t)left * scaledWidth / width);
+    uint32_t scaledTop = (uint32_t)((uint64_t)top * scaledHeight / height);
+    uint32_t newWidth = (uint32_t)((uint64_t)frameWidth * scaledWidth / width);
+    uint32_t newHeight = (uint32_t)((uint64_t)frameHeight * scaledHeight / height);
+    newWidth = newWidth ? newWidth : 1;
+    newHeight = newHeight ? newHeight : 1;
+    if(scaledLeft >= scaledWidth) {
+        scaledLeft = scaledWidth - 1;
+    }
+    if(scaledTop >= scaledHeight) {
+        scaledTop = scaledHeight - 1;
+    }
+    if(scaledLeft + newWidth > scaledWidth) {
+        newWidth = scaledWidth - scaledLeft;
+    }
+    if(scaledTop + newHeight > scaledHeight) {
+        newHeight = scaledHeight - scaledTop;
+    }
+
+    uint8_t* scaled = malloc((size_t)newWidth * newHeight);
+    if(!scaled) {
+        free(pixels);
+        return -1;
+    }
+    for(uint32_t y = 0; y < newHeight; y++) {
+        const uint8_t* row = pixels + (size_t)((uint64_t)y * frameHeight / newHeight) * frameWidth;
+        for(uint32_t x = 0; x < newWidth; x++) {
+            scaled[(size_t)y * newWidth + x] = row[(uint64_t)x * frameWidth / newWidth];
+        }
+    }
+    free(pixels);
+
+    size_t encodedLength = 0;
+    uint8_t* encoded = CatGIFEncodeLZW(scaled, (size_t)newWidth * newHeight, minCodeSize, &encodedLength);
+    free(scaled);
+    if(!encoded) {
+        return -1;
+    }
+
+    uint8_t header[10];
+    header[0] = 0x2C;
+    CatWrite16(header + 1, scaledLeft);
+    CatWrite16(header + 3, scaledTop);
+    CatWrite16(header + 5, newWidth);
+    CatWrite16(header + 7, newHeight);
+    header[9] = flags & ~0x40;
+    CatBufferAppend(output, header, sizeof(header));
+    CatBufferAppend(output, table, tableSize);
+    CatBufferByte(output, (uint8_t)minCodeSize);
+    for(size_t offset = 0; offset < encodedLength; offset += 255) {
+        size_t chunk = encodedLength - offset < 255 ? encodedLength - offset : 255;
+        CatBufferByte(output, (uint8_t)chunk);
+        CatBufferAppend(output, encoded + offset, chunk);
+    }
+    CatBufferByte(output, 0);
+    free(encoded);
+    return 0;
+}
+
+int CatGIFTranscode(const uint8_t* data, size_t length, CatGIFLimits limits,
+                    uint8_t** output, size_t* outputLength, CatGIFInfo* before, CatGIFInfo* after)
+{
+    CatGIFInfo info;
+    if(CatGIFInspect(data, length, &info) != 0) {
+        return -1;
+    }
+    if(before) {
+        *before = info;
+    }
+    uint32_t kept = limits.maxFrames && limits.maxFrames < info.frames ? limits.maxFrames : info.frames;
+    uint32_t largest = info.width > info.height ? info.width : info.height;
+    int scale = limits.maxDimension && largest > limits.maxDimension && info.width && info.height;
+    if(kept == info.frames && !scale) {
+        if(after) {
+            *after = info;
+        }
+        return 0;
+    }
+
+    CatGIFFrame* frames = malloc(sizeof(CatGIFFrame) * (kept ? kept : 1));
+    size_t headerEnd;
+    if(!frames || CatGIFScan(data, length, &headerEnd, frames, kept) < 0) {
+        free(frames);
+        return -1;
+    }
+
+    uint32_t width = info.width, height = info.height;
+    if(scale) {
+        width = (uint32_t)((uint64_t)info.width * limits.maxDimension / largest);
+        height = (uint32_t)((uint64_t)info.height * limits.maxDimension / largest);
+        width = width ? width : 1;
+        height = height ? height : 1;
+    }
+
+    CatBuffer buffer = { NULL, 0, 0, 0 };
+    CatBufferAppend(&buffer, data, headerEnd);
+    if(buffer.bytes) {
+        CatWrite16(buffer.bytes + 6, width);
+        CatWrite16(buffer.bytes + 8, height);
+    }
+    int failed = 0;
+    for(uint32_t i = 0; i < kept && !failed; i++) {
+        if(scale) {
+            failed = CatAppendScaledFrame(&buffer, data, &frames[i], info.width, info.height, width, height);
+        }
+        else {
+            CatBufferAppend(&buffer, data + frames[i].start, frames[i].end - frames[i].start);
+        }
+    }
+    CatBufferByte(&buffer, 0x3B);
+    free(frames);
+    if(failed || buffer.failed) {
+        free(buffer.bytes);
+        return -1;
+    }
+
+    *output = buffer.bytes;
+    *outputLength = buffer.length;
+    if(after) {
+        after->width = width;
+        after->height = height;
+        after->frames = kept;
+        after->decodedBytes = (uint64_t)width * height * 4 * kept;
+    }
+    return 1;
+}
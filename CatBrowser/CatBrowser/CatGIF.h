@@ -0,0 +1,59 @@
+//
+//  CatGIF.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/26/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Shrinks animated GIFs for when memory is tight. WebKit keeps every
+//  decoded frame of an animation resident, so a gif costs frames x width x
+//  height x 4 bytes. The transcoder drops frames past a cap and scales
+//  frames down to a maximum dimension. Dropping frames copies the kept ones
+//  as they are. Scaling decodes the LZW data, resamples palette indices
+//  (nearest neighbour, so the palette and transparency stay valid) and
+//  encodes again. Plain C, no Apple dependency.
+//
+
+#ifndef CatBrowser_CatGIF_h
+#define CatBrowser_CatGIF_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t maxFrames;         // 0: all, 1: first frame only
+    uint32_t maxDimension;      // largest side of the canvas, 0: unlimited
+} CatGIFLimits;
+
+typedef struct {
+    uint32_t width;             // canvas
+    uint32_t height;
+    uint32_t frames;
+    uint64_t decodedBytes;      // width x height x 4 x frames
+} CatGIFInfo;
+
+// Parses the block structure without decoding. Returns 0 on success, -1
+// when the data is not a well formed GIF.
+int CatGIFInspect(const uint8_t* data, size_t length, CatGIFInfo* info);
+
+// Returns 1 and a malloc'd GIF within limits in output, 0 when the input
+// already is within limits (output untouched), -1 when it is not a GIF.
+// before and after may be NULL.
+int CatGIFTranscode(const uint8_t* data, size_t length, CatGIFLimits limits,
+                    uint8_t** output, size_t* outputLength, CatGIFInfo* before, CatGIFInfo* after);
+
+// Image data (LZW) helpers, exposed for tests. Decode returns the number
+// of indices written, encode returns a malloc'd code stream without the
+// sub-block framing, or NULL.
+size_t CatGIFDecodeLZW(const uint8_t* codes, size_t length, int minCodeSize, uint8_t* pixels, size_t pixelCount);
+uint8_t* CatGIFEncodeLZW(const uint8_t* pixels, size_t pixelCount, int minCodeSize, size_t* length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
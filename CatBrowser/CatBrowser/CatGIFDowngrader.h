@@ -0,0 +1,46 @@
+//
+//  CatGIFDowngrader.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/26/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Transcodes gif replacements with CatGIF before WebKit sees them. A mode
+//  can be set for good; on top of it, a memory warning switches to
+//  pressureMode for pressureInterval. Memory saved is the decoded size
+//  (frames x width x height x 4) before minus after.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef enum {
+    CatGIFDowngradeNone,
+    CatGIFDowngradeFirstFrame,
+    CatGIFDowngradeFrameCap,        // at most maxFrames frames
+    CatGIFDowngradeResolutionCap,   // at most maxDimension, or the size class when smaller
+} CatGIFDowngradeMode;
+
+@interface CatGIFDowngrader : NSObject
+
++ (CatGIFDowngrader*) sharedDowngrader;
+
+// The gif within the active mode's limits, or data itself when it already
+// is, or is not a gif we can parse. Key is the one the image store gave
+// the gif; the transcoded variant is kept under it for reuse, unless nil.
+- (NSData*) dataForGIF:(NSData*)data key:(NSString*)key sizeClass:(NSUInteger)sizeClass;
+
+- (void) noteMemoryWarning;
+// Drops the transcoded variants kept for reuse.
+- (void) purge;
+@property (readonly) unsigned long long cachedBytes;
+@property (readonly) CatGIFDowngradeMode activeMode;
+@property CatGIFDowngradeMode mode;             // default none
+@property CatGIFDowngradeMode pressureMode;     // default first frame
+@property NSTimeInterval pressureInterval;      // default 60s
+@property uint32_t maxFrames;                   // default 8
+@property uint32_t maxDimension;                // default 128
+
+@property (readonly) NSUInteger transcodedImages;
+@property (readonly) uint64_t bytesSaved;
+
+@end
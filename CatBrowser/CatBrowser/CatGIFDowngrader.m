@@ -0,0 +1,153 @@
+//
+//  CatGIFDowngrader.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/26/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatGIFDowngrader.h"
+#import "CatGIF.h"
+#import <UIKit/UIKit.h>
+
+// The pool serves the same few gifs over and over; keep their transcoded variants.
+static const NSUInteger kVariantCount = 32;
+
+@interface CatGIFDowngrader () <NSCacheDelegate>
+@end
+
+@implementation CatGIFDowngrader
+{
+    NSCache* variants;      // "storekey-frames-dimension" -> NSData
+    CFAbsoluteTime pressureUntil;
+}
+
++ (CatGIFDowngrader*) sharedDowngrader
+{
+    static CatGIFDowngrader* sharedDowngrader = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedDowngrader = [[CatGIFDowngrader alloc] init];
+    });
+    return sharedDowngrader;
+}
+
+- (id) init
+{
+    if(self = [super init]) {
+        variants = [[NSCache alloc] init];
+        variants.countLimit = kVariantCount;
+        variants.delegate = self;
+        _pressureMode = CatGIFDowngradeFirstFrame;
+        _pressureInterval = 60;
+        _maxFrames = 8;
+        _maxDimension = 128;
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(noteMemoryWarning)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void) noteMemoryWarning
+{
+    @synchronized(self) {
+        pressureUntil = CFAbsoluteTimeGetCurrent() + _pressureInterval;
+    }
+}
+
+- (void) purge
+{
+    [variants removeAllObjects];
+}
+
+- (void) cache:(NSCache*)cache willEvictObject:(id)object
+{
+    @synchronized(self) {
+        _cachedBytes -= MIN(_cachedBytes, [object length]);
+    }
+}
+
+- (unsigned long long) cachedBytes
+{
+    @synchronized(self) {
+        return _cachedBytes;
+    }
+}
+
+- (CatGIFDowngradeMode) activeMode
+{
+    @synchronized(self) {
+        return CFAbsoluteTimeGetCurrent() < pressureUntil ? _pressureMode : _mode;
+    }
+}
+
+- (CatGIFLimits) limitsForMode:(CatGIFDowngradeMode)mode sizeClass:(NSUInteger)sizeClass
+{
+    CatGIFLimits limits = { 0, 0 };
+    switch(mode) {
+        case CatGIFDowngradeFirstFrame:
+            limits.maxFrames = 1;
+            break;
+        case CatGIFDowngradeFrameCap:
+            limits.maxFrames = _maxFrames;
+            break;
+        case CatGIFDowngradeResolutionCap:
+            limits.maxDimension = sizeClass && sizeClass < _maxDimension ? (uint32_t)sizeClass : _maxDimension;
+            break;
+        default:
+            break;
+    }
+    return limits;
+}
+
+- (NSData*) dataForGIF:(NSData*)data key:(NSString*)storeKey sizeClass:(NSUInteger)sizeClass
+{
+    CatGIFDowngradeMode mode = self.activeMode;
+    if(mode == CatGIFDowngradeNone || !data.length) {
+        return data;
+    }
+    CatGIFLimits limits = [self limitsForMode:mode sizeClass:sizeClass];
+    NSString* key = [storeKey stringByAppendingFormat:@"-%u-%u", limits.maxFrames, limits.maxDimension];
+    NSData* variant = key ? [variants objectForKey:key] : nil;
+    if(variant) {
+        // Transcoded before, but it is one more image decoded smaller.
+        CatGIFInfo before, after;
+        if(CatGIFInspect(data.bytes, data.length, &before) == 0 && CatGIFInspect(variant.bytes, variant.length, &after) == 0) {
+            [self countTranscodeFrom:before to:after];
+        }
+        return variant;
+    }
+
+    uint8_t* output = NULL;
+    size_t length = 0;
+    CatGIFInfo before, after;
+    if(CatGIFTranscode(data.bytes, data.length, limits, &output, &length, &before, &after) != 1) {
+        return data;
+    }
+    variant = [NSData dataWithBytesNoCopy:output length:length freeWhenDone:YES];
+    if(key) {
+        @synchronized(self) {
+            _cachedBytes += variant.length;
+        }
+        [variants setObject:variant forKey:key];
+    }
+    [self countTranscodeFrom:before to:after];
+    return variant;
+}
+
+- (void) countTranscodeFrom:(CatGIFInfo)before to:(CatGIFInfo)after
+{
+    @synchronized(self) {
+        _transcodedImages++;
+        if(before.decodedBytes > after.decodedBytes) {
+            _bytesSaved += before.decodedBytes - after.decodedBytes;
+        }
+    }
+}
+
+@end
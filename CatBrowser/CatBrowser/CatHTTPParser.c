@@ -0,0 +1,329 @@
+//
+//  CatHTTPParser.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/22/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatHTTPParser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    CatHTTPHead,
+    CatHTTPLength,
+    CatHTTPChunkSize,
+    CatHTTPChunkData,
+    CatHTTPChunkEnd,
+    CatHTTPTrailer,
+    CatHTTPUntilClose,
+    CatHTTPDone,
+    CatHTTPError,
+};
+
+void CatHTTPParserInit(CatHTTPParser* parser, CatHTTPCallbacks callbacks, void* context)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->callbacks = callbacks;
+    parser->context = context;
+    CatHTTPParserReset(parser);
+}
+
+void CatHTTPParserReset(CatHTTPParser* parser)
+{
+    parser->state = CatHTTPHead;
+    parser->status = 0;
+    parser->keepAlive = 0;
+    parser->chunked = 0;
+    parser->untilClose = 0;
+    parser->noBody = 0;
+    parser->remaining = 0;
+    parser->sawDigit = 0;
+    parser->inExtension = 0;
+    parser->lineLength = 0;
+    parser->headLength = 0;
+}
+
+int CatHTTPParserIsIdle(const CatHTTPParser* parser)
+{
+    return parser->state == CatHTTPDone || (parser->state == CatHTTPHead && parser->headLength == 0);
+}
+
+static int CatHeaderIs(const char* name, size_t length, const char* expected)
+{
+    size_t expectedLength = strlen(expected);
+    if(length != expectedLength) {
+        return 0;
+    }
+    for(size_t i = 0; i < length; i++) {
+        char c = name[i];
+        if(c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        if(c != expected[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int CatValueContains(const char* value, size_t length, const char* token)
+{
+    size_t tokenLength = strlen(token);
+    for(size_t i = 0; i + tokenLength <= length; i++) {
+        if(CatHeaderIs(value + i, tokenLength, token)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reads the status line and the framing headers. Returns 0 on a malformed head.
+static int CatParseHead(CatHTTPParser* parser)
+{
+    const char* head = parser->head;
+    size_t length = parser->headLength;
+    if(length < 12 || memcmp(head, "HTTP/1.", 7) != 0 || head[8] != ' ') {
+        return 0;
+    }
+    int minor = head[7] - '0';
+    int status = 0;
+    for(int i = 9; i < 12; i++) {
+        if(head[i] < '0' || head[i] > '9') {
+            return 0;
+        }
+        status = status * 10 + head[i] - '0';
+    }
+    parser->status = status;
+    parser->keepAlive = minor >= 1;
+
+    int hasLength = 0;
+    const char* line = memchr(head, '\n', length);
+    while(line && (size_t)(line - head) < length) {
+        line++;
+        const char* end = memchr(line, '\n', length - (line - head));
+        if(!end) {
+            end = head + length;
+        }
+        const char* colon = memchr(line, ':', end - line);
+        if(colon) {
+            const char* value = colon + 1;
+            while(value < end && (*value == ' ' || *value == '\t')) {
+                value++;
+            }
+            size_t valueLength = end - value;
+            size_t nameLength = colon - line;
+            if(CatHeaderIs(line, nameLength, "content-length")) {
+                int64_t contentLength = 0;
+                int digits = 0;
+                for(const char* c = value; c < end && *c >= '0' && *c <= '9'; c++, digits++) {
+                    // Like the chunk size: a length that would overflow is malformed.
+                    if(contentLength > (INT64_MAX - 9) / 10) {
+                        return 0;
+                    }
+                    contentLength = contentLength * 10 + (*c - '0');
+                }
+                // Only whitespace may follow the digits, so "12abc" and "12, 13"
+                // are malformed rather than read as 12, and a repeated header
+                // must agree with the first (RFC 9112 section 6.3).
+                for(const char* c = value + digits; c < end; c++) {
+                    if(*c != ' ' && *c != '\t' && *c != '\r') {
+                        return 0;
+                    }
+                }
+                if(!digits || contentLength < 0 || (hasLength && contentLength != parser->remaining)) {
+                    return 0;
+                }
+                parser->remaining = contentLength;
+                hasLength = 1;
+            }
+            else if(CatHeaderIs(line, nameLength, "transfer-encoding")) {
+                parser->chunked = CatValueContains(value, valueLength, "chunked");
+            }
+            else if(CatHeaderIs(line, nameLength, "connection")) {
+                if(CatValueContains(value, valueLength, "close")) {
+                    parser->keepAlive = 0;
+                }
+                else if(CatValueContains(value, valueLength, "keep-alive")) {
+                    parser->keepAlive = 1;
+                }
+            }
+        }
+        line = end < head + length ? end : NULL;
+    }
+
+    if(parser->noBody || status == 204 || status == 304) {
+        parser->remaining = 0;
+        parser->state = CatHTTPLength;
+    }
+    else if(parser->chunked) {
+        parser->remaining = 0;
+        parser->state = CatHTTPChunkSize;
+    }
+    else if(hasLength) {
+        parser->state = CatHTTPLength;
+    }
+    else {
+        parser->untilClose = 1;
+        parser->keepAlive = 0;
+        parser->state = CatHTTPUntilClose;
+    }
+    return 1;
+}
+
+static void CatComplete(CatHTTPParser* parser)
+{
+    parser->state = CatHTTPDone;
+    if(parser->callbacks.onComplete) {
+        parser->callbacks.onComplete(parser->context);
+    }
+}
+
+long CatHTTPParserFeed(CatHTTPParser* parser, const char* bytes, size_t length)
+{
+    size_t used = 0;
+    while(used < length || parser->state == CatHTTPLength) {
+        switch(parser->state) {
+            case CatHTTPHead: {
+                char c = bytes[used++];
+                if(parser->headLength == kCatHTTPMaxHead) {
+                    parser->state = CatHTTPError;
+                    return -1;
+                }
+                parser->head[parser->headLength++] = c;
+                if(c != '\n') {
+                    break;
+                }
+                size_t headLength = parser->headLength;
+                const char* head = parser->head;
+                size_t blank = 0;
+                if(headLength >= 4 && memcmp(head + headLength - 4, "\r\n\r\n", 4) == 0) {
+                    blank = 4;
+                }
+                else if(headLength >= 2 && head[headLength - 2] == '\n') {
+                    blank = 2;
+                }
+                if(!blank) {
+                    break;
+                }
+                parser->headLength -= blank;
+                if(!CatParseHead(parser)) {
+                    parser->state = CatHTTPError;
+                    return -1;
+                }
+                if(parser->status >= 100 && parser->status < 200) {
+                    // Interim response, the real one follows.
+                    int noBody = parser->noBody;
+                    CatHTTPParserReset(parser);
+                    parser->noBody = noBody;
+                    break;
+                }
+                if(parser->callbacks.onHead) {
+                    parser->callbacks.onHead(parser->context, parser->status, parser->head, parser->headLength);
+                }
+                break;
+            }
+            case CatHTTPLength: {
+                if(parser->remaining == 0) {
+                    CatComplete(parser);
+                    return (long)used;
+                }
+                size_t count = length - used;
+                if((int64_t)count > parser->remaining) {
+                    count = (size_t)parser->remaining;
+                }
+                if(count && parser->callbacks.onBody) {
+                    parser->callbacks.onBody(parser->context, bytes + used, count);
+                }
+                used += count;
+                parser->remaining -= count;
+                if(parser->remaining > 0) {
+                    return (long)used;
+                }
+                break;
+            }
+            case CatHTTPChunkSize: {
+                char c = bytes[used++];
+                if(c == '\n') {
+                    if(!parser->sawDigit) {
+                        parser->state = CatHTTPError;
+                        return -1;
+                    }
+                    parser->sawDigit = 0;
+                    parser->inExtension = 0;
+                    parser->lineLength = 0;
+                    parser->state = parser->remaining ? CatHTTPChunkData : CatHTTPTrailer;
+                }
+                else if(c == ';') {
+                    parser->inExtension = 1;
+                }
+                else if(!parser->inExtension && c != '\r' && c != ' ') {
+                    int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                    if(digit < 0 || parser->remaining > (INT64_MAX >> 4)) {
+                        parser->state = CatHTTPError;
+                        return -1;
+                    }
+                    parser->remaining = parser->remaining * 16 + digit;
+                    parser->sawDigit = 1;
+                }
+                break;
+            }
+            case CatHTTPChunkData: {
+                size_t count = length - used;
+                if((int64_t)count > parser->remaining) {
+                    count = (size_t)parser->remaining;
+                }
+                if(parser->callbacks.onBody) {
+                    parser->callbacks.onBody(parser->context, bytes + used, count);
+                }
+                used += count;
+                parser->remaining -= count;
+                if(parser->remaining == 0) {
+                    parser->state = CatHTTPChunkEnd;
+                }
+                break;
+            }
+            case CatHTTPChunkEnd:
+                if(bytes[used++] == '\n') {
+                    parser->state = CatHTTPChunkSize;
+                }
+                break;
+            case CatHTTPTrailer: {
+                char c = bytes[used++];
+                if(c == '\n') {
+                    if(parser->lineLength == 0) {
+                        CatComplete(parser);
+                        return (long)used;
+                    }
+                    parser->lineLength = 0;
+                }
+                else if(c != '\r') {
+                    parser->lineLength++;
+                }
+                break;
+            }
+            case CatHTTPUntilClose:
+                if(parser->callbacks.onBody) {
+                    parser->callbacks.onBody(parser->context, bytes + used, length - used);
+                }
+                used = length;
+                break;
+            case CatHTTPDone:
+                return (long)used;
+            default:
+                return -1;
+        }
+    }
+    return (long)used;
+}
+
+int CatHTTPParserFinish(CatHTTPParser* parser)
+{
+    if(parser->state == CatHTTPUntilClose) {
+        CatComplete(parser);
+        return 0;
+    }
+    return CatHTTPParserIsIdle(parser) ? 0 : -1;
+}
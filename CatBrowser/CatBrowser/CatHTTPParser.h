@@ -0,0 +1,70 @@
+//
+//  CatHTTPParser.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/22/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Incremental HTTP/1.x response parser for the origin connection pool.
+//  Bytes are fed as they come off the socket; the parser frames the body
+//  (Content-Length, chunked, or until close) and reports whether the
+//  connection can carry another response. It stops at the end of each
+//  message so pipelined responses are routed one at a time.
+//  Plain C, no Apple dependency.
+//
+
+#ifndef CatBrowser_CatHTTPParser_h
+#define CatBrowser_CatHTTPParser_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define kCatHTTPMaxHead 16384
+
+typedef struct {
+    // Status line and headers, without the final blank line.
+    void (*onHead)(void* context, int status, const char* head, size_t length);
+    void (*onBody)(void* context, const char* bytes, size_t length);
+    void (*onComplete)(void* context);
+} CatHTTPCallbacks;
+
+typedef struct {
+    CatHTTPCallbacks callbacks;
+    void* context;
+    int state;
+    int status;
+    int keepAlive;          // valid once the head is parsed
+    int chunked;
+    int untilClose;
+    int noBody;             // set before feeding for responses to HEAD requests
+    int64_t remaining;
+    int sawDigit;
+    int inExtension;
+    size_t lineLength;
+    char head[kCatHTTPMaxHead];
+    size_t headLength;
+} CatHTTPParser;
+
+void CatHTTPParserInit(CatHTTPParser* parser, CatHTTPCallbacks callbacks, void* context);
+// Gets ready for the next response on the same connection.
+void CatHTTPParserReset(CatHTTPParser* parser);
+
+// Consumes bytes up to the end of the current message. Returns the number
+// of bytes used, which is less than length when a message completed and
+// more responses follow, or -1 when the response is malformed.
+long CatHTTPParserFeed(CatHTTPParser* parser, const char* bytes, size_t length);
+// The peer closed the connection. Returns 0 if that completed the message
+// (or none was started), -1 if the response was cut short.
+int CatHTTPParserFinish(CatHTTPParser* parser);
+
+int CatHTTPParserIsIdle(const CatHTTPParser* parser);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+//
+//  CatHistogram.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/19/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatHistogram.h"
+
+static inline int CatBucketForValue(uint64_t value)
+{
+    if(!value) {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll(value);
+    return bucket < kCatHistogramBuckets ? bucket : kCatHistogramBuckets - 1;
+}
+
+void CatHistogramRecord(CatHistogram* histogram, uint64_t value)
+{
+    __sync_fetch_and_add(&histogram->buckets[CatBucketForValue(value)], 1);
+    __sync_fetch_and_add(&histogram->count, 1);
+    __sync_fetch_and_add(&histogram->sum, value);
+    uint64_t max = histogram->max;
+    while(value > max && !__sync_bool_compare_and_swap(&histogram->max, max, value)) {
+        max = histogram->max;
+    }
+}
+
+void CatHistogramReset(CatHistogram* histogram)
+{
+    for(int b = 0; b < kCatHistogramBuckets; b++) {
+        __sync_lock_test_and_set(&histogram->buckets[b], 0);
+    }
+    __sync_lock_test_and_set(&histogram->count, 0);
+    __sync_lock_test_and_set(&histogram->sum, 0);
+    __sync_lock_test_and_set(&histogram->max, 0);
+}
+
+uint64_t CatHistogramPercentile(const CatHistogram* histogram, double p)
+{
+    // Count from the buckets rather than the count field, so a record
+    // racing with this read cannot push the rank past the last bucket.
+    uint64_t total = 0;
+    for(int b = 0; b < kCatHistogramBuckets; b++) {
+        total += histogram->buckets[b];
+    }
+    if(!total) {
+        return 0;
+    }
+    p = p < 0 ? 0 : p > 1 ? 1 : p;
+    uint64_t rank = (uint64_t)(p * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for(int b = 0; b < kCatHistogramBuckets; b++) {
+        seen += histogram->buckets[b];
+        if(seen >= rank) {
+            uint64_t upper = b == kCatHistogramBuckets - 1 ? UINT64_MAX : ((uint64_t)1 << b) - 1;
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+uint64_t CatHistogramMean(const CatHistogram* histogram)
+{
+    uint64_t count = histogram->count;
+    return count ? histogram->sum / count : 0;
+}
@@ -0,0 +1,45 @@
+//
+//  CatHistogram.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/19/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Lock free histogram with power of two buckets. Recording is a handful
+//  of atomic adds, cheap enough for every request on every loader thread.
+//  Percentiles are exact to within a factor of two, which is what we need
+//  to spot regressions. Plain C, no Apple dependency.
+//
+
+#ifndef CatBrowser_CatHistogram_h
+#define CatBrowser_CatHistogram_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bucket 0 holds 0, bucket b holds [2^(b-1), 2^b).
+#define kCatHistogramBuckets 64
+
+typedef struct {
+    volatile uint64_t buckets[kCatHistogramBuckets];
+    volatile uint64_t count;
+    volatile uint64_t sum;
+    volatile uint64_t max;
+} CatHistogram;
+
+void CatHistogramRecord(CatHistogram* histogram, uint64_t value);
+void CatHistogramReset(CatHistogram* histogram);
+
+// Upper bound of the bucket holding the p-th fraction (0..1) of the values,
+// capped at the largest value seen. 0 when empty.
+uint64_t CatHistogramPercentile(const CatHistogram* histogram, double p);
+uint64_t CatHistogramMean(const CatHistogram* histogram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,683 @@
+//
+//  CatHistoryLog.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/29/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+// pread, pwrite, ftruncate, strdup and mmap under -std=c99.
+#define _POSIX_C_SOURCE 200809L
+
+#include "CatHistoryLog.h"
+#include "CatDecisionCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define kLogMagic 0x4c746143u       // "CatL"
+#define kRecordMagic 0x52746143u    // "CatR"
+#define kIndexMagic 0x49746143u     // "CatI"
+#define kVersion 1
+#define kInitialCapacity 1024
+
+// The log and the table both carry the generation; compaction bumps it,
+// so a table left over from before a crash in the middle of a compaction
+// is recognised and rebuilt.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+} CatHistoryFileHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t visits;
+    double time;
+    uint32_t urlLength;
+    uint32_t titleLength;
+} CatHistoryRecord;             // then the url and the title
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t records;
+    uint64_t logLength;         // log bytes the table and the time file account for
+    uint64_t reserved[2];
+} CatHistoryIndexHeader;
+
+// Urls are told apart by their 64-bit hash alone; a collision would merge
+// two urls' counts, and lookups check the url.
+typedef struct {
+    uint64_t hash;              // 0: empty
+    uint64_t offset;            // latest record
+    double time;
+    uint32_t visits;
+    uint32_t reserved;
+} CatHistorySlot;
+
+typedef struct {
+    double time;
+    uint64_t offset;
+} CatHistoryTimeEntry;
+
+struct CatHistoryLog {
+    char* directory;
+    int logFile;
+    int timeFile;
+    int indexFile;
+    uint64_t generation;
+    uint64_t logLength;
+    CatHistoryIndexHeader* header;
+    CatHistorySlot* slots;
+    size_t mappedLength;
+    char* buffer;
+    size_t bufferCapacity;
+};
+
+static char* CatPath(const CatHistoryLog* log, const char* name)
+{
+    size_t length = strlen(log->directory) + strlen(name) + 2;
+    char* path = malloc(length);
+    if(path) {
+        snprintf(path, length, "%s/%s", log->directory, name);
+    }
+    return path;
+}
+
+static int CatReadFully(int file, void* bytes, size_t length, uint64_t offset)
+{
+    while(length) {
+        ssize_t done = pread(file, bytes, length, (off_t)offset);
+        if(done <= 0) {
+            if(done < 0 && errno == EINTR) {
+                continue;
+            }
+            if(!done) {
+                errno = EIO;
+            }
+            return -1;
+        }
+        bytes = (char*)bytes + done;
+        length -= done;
+        offset += done;
+    }
+    return 0;
+}
+
+static int CatWriteFully(int file, const void* bytes, size_t length, uint64_t offset)
+{
+    while(length) {
+        ssize_t done = pwrite(file, bytes, length, (off_t)offset);
+        if(done < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        bytes = (const char*)bytes + done;
+        length -= done;
+        offset += done;
+    }
+    return 0;
+}
+
+static uint64_t CatURLHash(const char* url, size_t length)
+{
+    uint64_t hash = CatDecisionHash(kCatDecisionHashSeed, url, length);
+    return hash ? hash : 1;
+}
+
+static size_t CatRecordSize(const CatHistoryRecord* record)
+{
+    return sizeof(CatHistoryRecord) + record->urlLength + record->titleLength;
+}
+
+static int CatReserve(CatHistoryLog* log, size_t length)
+{
+    if(length <= log->bufferCapacity) {
+        return 0;
+    }
+    char* grown = realloc(log->buffer, length);
+    if(!grown) {
+        return -1;
+    }
+    log->buffer = grown;
+    log->bufferCapacity = length;
+    return 0;
+}
+
+// MARK: Table
+
+static size_t CatIndexSize(uint64_t capacity)
+{
+    return sizeof(CatHistoryIndexHeader) + capacity * sizeof(CatHistorySlot);
+}
+
+// A new, empty table file at path, mapped.
+static CatHistoryIndexHeader* CatCreateIndex(const char* path, uint64_t capacity, uint64_t generation, int* file)
+{
+    int descriptor = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(descriptor < 0) {
+        return NULL;
+    }
+    size_t size = CatIndexSize(capacity);
+    void* map = MAP_FAILED;
+    if(ftruncate(descriptor, (off_t)size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    }
+    if(map == MAP_FAILED) {
+        close(descriptor);
+        unlink(path);
+        return NULL;
+    }
+    CatHistoryIndexHeader* header = map;
+    header->magic = kIndexMagic;
+    header->version = kVersion;
+    header->generation = generation;
+    header->capacity = capacity;
+    *file = descriptor;
+    return header;
+}
+
+static void CatUseIndex(CatHistoryLog* log, CatHistoryIndexHeader* header, int file)
+{
+    if(log->header) {
+        munmap(log->header, log->mappedLength);
+    }
+    if(log->indexFile >= 0 && log->indexFile != file) {
+        close(log->indexFile);
+    }
+    log->header = header;
+    log->slots = (CatHistorySlot*)(header + 1);
+    log->mappedLength = CatIndexSize(header->capacity);
+    log->indexFile = file;
+}
+
+// Maps an existing table when it is whole and of the log's generation.
+static int CatMapIndex(CatHistoryLog* log, int file)
+{
+    struct stat status;
+    if(fstat(file, &status) != 0 || (size_t)status.st_size < sizeof(CatHistoryIndexHeader)) {
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if(map == MAP_FAILED) {
+        return -1;
+    }
+    CatHistoryIndexHeader* header = map;
+    if(header->magic != kIndexMagic || header->version != kVersion || header->generation != log->generation ||
+       !header->capacity || (header->capacity & (header->capacity - 1)) ||
+       CatIndexSize(header->capacity) != (size_t)status.st_size || header->logLength > log->logLength ||
+       header->logLength < sizeof(CatHistoryFileHeader)) {
+        munmap(map, (size_t)status.st_size);
+        return -1;
+    }
+    CatUseIndex(log, header, file);
+    return 0;
+}
+
+static CatHistorySlot* CatFindSlot(CatHistorySlot* slots, uint64_t capacity, uint64_t hash)
+{
+    uint64_t mask = capacity - 1;
+    uint64_t i = hash & mask;
+    while(slots[i].hash && slots[i].hash != hash) {
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
+
+// Rehashes into a table twice as large, written beside and renamed over.
+static int CatGrowIndex(CatHistoryLog* log)
+{
+    char* path = CatPath(log, "history.idx");
+    char* temporary = CatPath(log, "history.idx.tmp");
+    int file = -1;
+    CatHistoryIndexHeader* header = path && temporary ? CatCreateIndex(temporary, log->header->capacity * 2, log->generation, &file) : NULL;
+    int result = -1;
+    if(header) {
+        CatHistorySlot* slots = (CatHistorySlot*)(header + 1);
+        for(uint64_t i=0; i<log->header->capacity; i++) {
+            if(log->slots[i].hash) {
+                *CatFindSlot(slots, header->capacity, log->slots[i].hash) = log->slots[i];
+            }
+        }
+        header->count = log->header->count;
+        header->records = log->header->records;
+        header->logLength = log->header->logLength;
+        if(rename(temporary, path) == 0) {
+            CatUseIndex(log, header, file);
+            result = 0;
+        }
+        else {
+            munmap(header, CatIndexSize(header->capacity));
+            close(file);
+            unlink(temporary);
+        }
+    }
+    free(path);
+    free(temporary);
+    return result;
+}
+
+// MARK: Records
+
+// Reads the record at offset into record and the buffer (url then title).
+static int CatReadRecord(CatHistoryLog* log, uint64_t offset, CatHistoryRecord* record)
+{
+    if(offset + sizeof(CatHistoryRecord) > log->logLength ||
+       CatReadFully(log->logFile, record, sizeof(CatHistoryRecord), offset) != 0) {
+        return -1;
+    }
+    if(record->magic != kRecordMagic || !record->urlLength || record->urlLength > kCatHistoryMaxURLLength ||
+       record->titleLength > kCatHistoryMaxTitleLength || offset + CatRecordSize(record) > log->logLength) {
+        return -1;
+    }
+    size_t length = record->urlLength + record->titleLength;
+    if(CatReserve(log, length) != 0 ||
+       CatReadFully(log->logFile, log->buffer, length, offset + sizeof(CatHistoryRecord)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Accounts for a record in the time file and the table.
+static int CatApplyRecord(CatHistoryLog* log, uint64_t offset, const CatHistoryRecord* record, uint64_t hash)
+{
+    if((log->header->count + 1) * 2 > log->header->capacity && CatGrowIndex(log) != 0) {
+        return -1;
+    }
+    CatHistoryTimeEntry entry = { record->time, offset };
+    if(CatWriteFully(log->timeFile, &entry, sizeof(entry), log->header->records * sizeof(entry)) != 0) {
+        return -1;
+    }
+    CatHistorySlot* slot = CatFindSlot(log->slots, log->header->capacity, hash);
+    if(!slot->hash) {
+        slot->hash = hash;
+        log->header->count++;
+    }
+    slot->offset = offset;
+    slot->time = record->time;
+    slot->visits += record->visits;
+    log->header->records++;
+    log->header->logLength = offset + CatRecordSize(record);
+    return 0;
+}
+
+// Accounts for the records past what the table knows. A torn record at
+// the end, from a crash in the middle of an append, is cut off.
+static int CatReplay(CatHistoryLog* log)
+{
+    uint64_t offset = log->header->logLength;
+    CatHistoryRecord record;
+    while(offset < log->logLength) {
+        if(CatReadRecord(log, offset, &record) != 0) {
+            if(ftruncate(log->logFile, (off_t)offset) != 0) {
+                return -1;
+            }
+            log->logLength = offset;
+            break;
+        }
+        if(CatApplyRecord(log, offset, &record, CatURLHash(log->buffer, record.urlLength)) != 0) {
+            return -1;
+        }
+        offset += CatRecordSize(&record);
+    }
+    return 0;
+}
+
+// The full parse, when the table is missing or does not match the log.
+static int CatRebuild(CatHistoryLog* log)
+{
+    char* path = CatPath(log, "history.idx");
+    int file = -1;
+    CatHistoryIndexHeader* header = path ? CatCreateIndex(path, kInitialCapacity, log->generation, &file) : NULL;
+    free(path);
+    if(!header) {
+        return -1;
+    }
+    header->logLength = sizeof(CatHistoryFileHeader);
+    CatUseIndex(log, header, file);
+    if(ftruncate(log->timeFile, 0) != 0) {
+        return -1;
+    }
+    return CatReplay(log);
+}
+
+// MARK: Log
+
+CatHistoryLog* CatHistoryLogOpen(const char* directory)
+{
+    CatHistoryLog* log = calloc(1, sizeof(CatHistoryLog));
+    if(!log) {
+        return NULL;
+    }
+    log->logFile = log->timeFile = log->indexFile = -1;
+    log->directory = strdup(directory);
+    char* logPath = log->directory ? CatPath(log, "history.log") : NULL;
+    char* timePath = log->directory ? CatPath(log, "history.time") : NULL;
+    char* indexPath = log->directory ? CatPath(log, "history.idx") : NULL;
+    int failed = !logPath || !timePath || !indexPath;
+
+    struct stat status;
+    if(!failed) {
+        log->logFile = open(logPath, O_RDWR | O_CREAT, 0644);
+        failed = log->logFile < 0 || fstat(log->logFile, &status) != 0;
+    }
+    if(!failed) {
+        CatHistoryFileHeader fileHeader;
+        if((size_t)status.st_size < sizeof(fileHeader)) {
+            fileHeader.magic = kLogMagic;
+            fileHeader.version = kVersion;
+            fileHeader.generation = 1;
+            failed = ftruncate(log->logFile, 0) != 0 || CatWriteFully(log->logFile, &fileHeader, sizeof(fileHeader), 0) != 0;
+            status.st_size = sizeof(fileHeader);
+        }
+        else if(CatReadFully(log->logFile, &fileHeader, sizeof(fileHeader), 0) != 0 ||
+                fileHeader.magic != kLogMagic || fileHeader.version != kVersion) {
+            errno = EILSEQ;
+            failed = 1;
+        }
+        log->generation = fileHeader.generation;
+        log->logLength = (uint64_t)status.st_size;
+    }
+    if(!failed) {
+        log->timeFile = open(timePath, O_RDWR | O_CREAT, 0644);
+        failed = log->timeFile < 0 || fstat(log->timeFile, &status) != 0;
+    }
+    if(!failed) {
+        int file = open(indexPath, O_RDWR);
+        if(file >= 0 && CatMapIndex(log, file) == 0 &&
+           (uint64_t)status.st_size >= log->header->records * sizeof(CatHistoryTimeEntry)) {
+            // Entries written after the table's last update are written again by the replay.
+            failed = ftruncate(log->timeFile, (off_t)(log->header->records * sizeof(CatHistoryTimeEntry))) != 0 ||
+                     CatReplay(log) != 0;
+        }
+        else {
+            if(file >= 0 && file != log->indexFile) {
+                close(file);
+            }
+            failed = CatRebuild(log) != 0;
+        }
+    }
+    free(logPath);
+    free(timePath);
+    free(indexPath);
+    if(failed) {
+        int error = errno;
+        CatHistoryLogClose(log);
+        errno = error;
+        return NULL;
+    }
+    return log;
+}
+
+void CatHistoryLogClose(CatHistoryLog* log)
+{
+    if(!log) {
+        return;
+    }
+    if(log->header) {
+        munmap(log->header, log->mappedLength);
+    }
+    if(log->indexFile >= 0) {
+        close(log->indexFile);
+    }
+    if(log->timeFile >= 0) {
+        close(log->timeFile);
+    }
+    if(log->logFile >= 0) {
+        close(log->logFile);
+    }
+    free(log->buffer);
+    free(log->directory);
+    free(log);
+}
+
+int CatHistoryLogAppend(CatHistoryLog* log, const char* url, size_t urlLength, const char* title, size_t titleLength, double time)
+{
+    if(!urlLength || urlLength > kCatHistoryMaxURLLength) {
+        errno = EINVAL;
+        return -1;
+    }
+    if(titleLength > kCatHistoryMaxTitleLength) {
+        titleLength = kCatHistoryMaxTitleLength;
+    }
+    CatHistoryRecord record = { kRecordMagic, 1, time, (uint32_t)urlLength, (uint32_t)titleLength };
+    size_t size = CatRecordSize(&record);
+    if(CatReserve(log, size) != 0) {
+        return -1;
+    }
+    // One write, so a crash leaves a whole record or a torn tail the next open cuts off.
+    memcpy(log->buffer, &record, sizeof(record));
+    memcpy(log->buffer + sizeof(record), url, urlLength);
+    memcpy(log->buffer + sizeof(record) + urlLength, title, titleLength);
+    uint64_t offset = log->logLength;
+    if(CatWriteFully(log->logFile, log->buffer, size, offset) != 0) {
+        int error = errno;
+        ftruncate(log->logFile, (off_t)offset);
+        errno = error;
+        return -1;
+    }
+    log->logLength += size;
+    return CatApplyRecord(log, offset, &record, CatURLHash(url, urlLength));
+}
+
+int CatHistoryLogLookup(CatHistoryLog* log, const char* url, size_t urlLength, CatHistoryVisit* visit)
+{
+    if(!urlLength || urlLength > kCatHistoryMaxURLLength) {
+        return 0;
+    }
+    const CatHistorySlot* slot = CatFindSlot(log->slots, log->header->capacity, CatURLHash(url, urlLength));
+    if(!slot->hash) {
+        return 0;
+    }
+    uint32_t visits = slot->visits;
+    double time = slot->time;
+    CatHistoryRecord record;
+    if(CatReadRecord(log, slot->offset, &record) != 0) {
+        return -1;
+    }
+    if(record.urlLength != urlLength || memcmp(log->buffer, url, urlLength) != 0) {
+        return 0;
+    }
+    visit->time = time;
+    visit->visits = visits;
+    visit->url = log->buffer;
+    visit->urlLength = record.urlLength;
+    visit->title = log->buffer + record.urlLength;
+    visit->titleLength = record.titleLength;
+    return 1;
+}
+
+static int CatReadTimeEntry(const CatHistoryLog* log, uint64_t position, CatHistoryTimeEntry* entry)
+{
+    return CatReadFully(log->timeFile, entry, sizeof(*entry), position * sizeof(*entry));
+}
+
+size_t CatHistoryLogEnumerateSince(CatHistoryLog* log, double since, CatHistoryVisitor visitor, void* context)
+{
+    uint64_t low = 0, high = log->header->records;
+    CatHistoryTimeEntry entry;
+    while(low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if(CatReadTimeEntry(log, middle, &entry) != 0) {
+            return 0;
+        }
+        if(entry.time < since) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    size_t count = 0;
+    CatHistoryRecord record;
+    for(uint64_t position = log->header->records; position-- > low; ) {
+        if(CatReadTimeEntry(log, position, &entry) != 0 || CatReadRecord(log, entry.offset, &record) != 0) {
+            break;
+        }
+        CatHistoryVisit visit = { record.time, record.visits, log->buffer, record.urlLength, log->buffer + record.urlLength, record.titleLength };
+        count++;
+        if(!visitor(&visit, context)) {
+            break;
+        }
+    }
+    return count;
+}
+
+size_t CatHistoryLogEnumerateURLs(CatHistoryLog* log, CatHistoryVisitor visitor, void* context)
+{
+    size_t count = 0;
+    CatHistoryRecord record;
+    for(uint64_t i=0; i<log->header->capacity; i++) {
+        CatHistorySlot slot = log->slots[i];
+        if(!slot.hash || CatReadRecord(log, slot.offset, &record) != 0) {
+            continue;
+        }
+        CatHistoryVisit visit = { slot.time, slot.visits, log->buffer, record.urlLength, log->buffer + record.urlLength, record.titleLength };
+        count++;
+        if(!visitor(&visit, context)) {
+            break;
+        }
+    }
+    return count;
+}
+
+int CatHistoryLogNeedsCompaction(const CatHistoryLog* log)
+{
+    return log->header->records > 2 * log->header->count + kInitialCapacity;
+}
+
+static int CatCompareSlotTimes(const void* a, const void* b)
+{
+    double timeA = ((const CatHistorySlot*)a)->time;
+    double timeB = ((const CatHistorySlot*)b)->time;
+    return timeA < timeB ? -1 : timeA > timeB;
+}
+
+int CatHistoryLogCompact(CatHistoryLog* log, double dropBefore)
+{
+    // Latest record of every url kept, oldest first, so the time file stays sorted.
+    CatHistorySlot* kept = malloc((log->header->count + 1) * sizeof(CatHistorySlot));
+    if(!kept) {
+        return -1;
+    }
+    uint64_t count = 0;
+    for(uint64_t i=0; i<log->header->capacity; i++) {
+        if(log->slots[i].hash && log->slots[i].time >= dropBefore) {
+            kept[count++] = log->slots[i];
+        }
+    }
+    qsort(kept, count, sizeof(CatHistorySlot), CatCompareSlotTimes);
+
+    uint64_t capacity = kInitialCapacity;
+    while((count + 1) * 2 > capacity) {
+        capacity *= 2;
+    }
+    uint64_t generation = log->generation + 1;
+    char* paths[3] = { CatPath(log, "history.log"), CatPath(log, "history.time"), CatPath(log, "history.idx") };
+    char* temporaries[3] = { CatPath(log, "history.log.tmp"), CatPath(log, "history.time.tmp"), CatPath(log, "history.idx.tmp") };
+    int logFile = -1, timeFile = -1, indexFile = -1;
+    CatHistoryIndexHeader* header = NULL;
+    int failed = 0;
+    for(int i=0; i<3; i++) {
+        failed |= !paths[i] || !temporaries[i];
+    }
+    if(!failed) {
+        logFile = open(temporaries[0], O_RDWR | O_CREAT | O_TRUNC, 0644);
+        timeFile = open(temporaries[1], O_RDWR | O_CREAT | O_TRUNC, 0644);
+        header = CatCreateIndex(temporaries[2], capacity, generation, &indexFile);
+        failed = logFile < 0 || timeFile < 0 || !header;
+    }
+    uint64_t offset = sizeof(CatHistoryFileHeader);
+    if(!failed) {
+        CatHistoryFileHeader fileHeader = { kLogMagic, kVersion, generation };
+        failed = CatWriteFully(logFile, &fileHeader, sizeof(fileHeader), 0) != 0;
+    }
+    CatHistorySlot* slots = header ? (CatHistorySlot*)(header + 1) : NULL;
+    for(uint64_t i=0; i<count && !failed; i++) {
+        CatHistoryRecord record;
+        if(CatReadRecord(log, kept[i].offset, &record) != 0) {
+            continue;
+        }
+        record.visits = kept[i].visits;
+        record.time = kept[i].time;
+        CatHistoryTimeEntry entry = { record.time, offset };
+        failed = CatWriteFully(logFile, &record, sizeof(record), offset) != 0 ||
+                 CatWriteFully(logFile, log->buffer, record.urlLength + record.titleLength, offset + sizeof(record)) != 0 ||
+                 CatWriteFully(timeFile, &entry, sizeof(entry), header->records * sizeof(entry)) != 0;
+        CatHistorySlot* slot = CatFindSlot(slots, capacity, kept[i].hash);
+        *slot = kept[i];
+        slot->offset = offset;
+        header->count++;
+        header->records++;
+        offset += CatRecordSize(&record);
+    }
+    free(kept);
+    if(!failed) {
+        header->logLength = offset;
+        // The log goes first: a table of the old generation beside it is rebuilt.
+        failed = fsync(logFile) != 0 || fsync(timeFile) != 0 || msync(header, CatIndexSize(capacity), MS_SYNC) != 0 ||
+                 rename(temporaries[0], paths[0]) != 0 || rename(temporaries[1], paths[1]) != 0 ||
+                 rename(temporaries[2], paths[2]) != 0;
+    }
+    if(failed) {
+        if(header) {
+            munmap(header, CatIndexSize(capacity));
+        }
+        for(int i=0; i<3; i++) {
+            if(temporaries[i]) {
+                unlink(temporaries[i]);
+            }
+        }
+        if(indexFile >= 0) {
+            close(indexFile);
+        }
+    }
+    else {
+        close(log->logFile);
+        close(log->timeFile);
+        log->logFile = logFile;
+        log->timeFile = timeFile;
+        log->logLength = offset;
+        log->generation = generation;
+        CatUseIndex(log, header, indexFile);
+        logFile = timeFile = -1;
+    }
+    if(logFile >= 0) {
+        close(logFile);
+    }
+    if(timeFile >= 0) {
+        close(timeFile);
+    }
+    for(int i=0; i<3; i++) {
+        free(paths[i]);
+        free(temporaries[i]);
+    }
+    return failed ? -1 : 0;
+}
+
+uint64_t CatHistoryLogRecordCount(const CatHistoryLog* log)
+{
+    return log->header->records;
+}
+
+uint64_t CatHistoryLogURLCount(const CatHistoryLog* log)
+{
+    return log->header->count;
+}
+
+uint64_t CatHistoryLogBytes(const CatHistoryLog* log)
+{
+    return log->logLength;
+}
@@ -0,0 +1,82 @@
+//
+//  CatHistoryLog.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/29/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Browsing history on disk, in three files of a directory:
+//    history.log   every visit appended as a record (time, url, title)
+//    history.idx   open addressing hash table by url, memory mapped: the
+//                  offset of the latest record, the visit count, the time
+//    history.time  (time, offset) per record in append order, binary
+//                  searched for recent history
+//  An append is one write to the log and one to the time file plus a
+//  slot update in the mapping, with a rehash into a table twice as large
+//  now and then. Opening maps the table and replays only the records
+//  appended after it was last updated, so startup does not parse the log.
+//  Compaction rewrites the log with one record per url, carrying its
+//  visit count. Plain C, no Apple dependency, not thread safe.
+//
+
+#ifndef CatBrowser_CatHistoryLog_h
+#define CatBrowser_CatHistoryLog_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longer urls (data: mostly) are not recorded.
+#define kCatHistoryMaxURLLength 8192
+#define kCatHistoryMaxTitleLength 1024
+
+typedef struct CatHistoryLog CatHistoryLog;
+
+typedef struct {
+    double time;                // seconds, the caller's clock
+    uint32_t visits;
+    const char* url;            // owned by the log, valid until its next call
+    size_t urlLength;
+    const char* title;
+    size_t titleLength;
+} CatHistoryVisit;
+
+// Returns nonzero to go on.
+typedef int (*CatHistoryVisitor)(const CatHistoryVisit* visit, void* context);
+
+// The directory must exist. NULL on failure, with errno set.
+CatHistoryLog* CatHistoryLogOpen(const char* directory);
+void CatHistoryLogClose(CatHistoryLog* log);
+
+// 0, or -1 on failure (errno set). Visits should come in time order: the
+// time file is searched as if they did.
+int CatHistoryLogAppend(CatHistoryLog* log, const char* url, size_t urlLength, const char* title, size_t titleLength, double time);
+
+// The url's latest title and visit time, and its visit count. Returns 1,
+// 0 when it was never visited, -1 on failure.
+int CatHistoryLogLookup(CatHistoryLog* log, const char* url, size_t urlLength, CatHistoryVisit* visit);
+
+// Records at or after since, newest first, one visit each. Returns how
+// many were visited.
+size_t CatHistoryLogEnumerateSince(CatHistoryLog* log, double since, CatHistoryVisitor visitor, void* context);
+// One visit per url with its count and latest time, in table order.
+size_t CatHistoryLogEnumerateURLs(CatHistoryLog* log, CatHistoryVisitor visitor, void* context);
+
+// True when the log holds more than twice as many records as urls and is
+// worth rewriting.
+int CatHistoryLogNeedsCompaction(const CatHistoryLog* log);
+// Drops urls last visited before the given time, then rewrites. 0 or -1.
+int CatHistoryLogCompact(CatHistoryLog* log, double dropBefore);
+
+uint64_t CatHistoryLogRecordCount(const CatHistoryLog* log);
+uint64_t CatHistoryLogURLCount(const CatHistoryLog* log);
+uint64_t CatHistoryLogBytes(const CatHistoryLog* log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+//
+//  CatHistoryStore.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/29/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Browsing history kept across launches in a CatHistoryLog. All file
+//  access happens on a serial background queue: visits are appended
+//  asynchronously and answers come back on the main queue. The log is
+//  compacted on that queue once it has grown well past one record per
+//  location, dropping locations not visited for maxAge.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CatSuggestionEngine;
+
+@interface CatHistoryEntry : NSObject
+@property (readonly) NSString* location;
+@property (readonly) NSString* title;
+@property (readonly) NSDate* date;          // latest visit
+@property (readonly) NSUInteger visits;
+@end
+
+@interface CatHistoryStore : NSObject
+
++ (CatHistoryStore*) sharedStore;
+
+// Opens, or creates, the log in directory. An unreadable log is started over.
+- (id) initWithDirectory:(NSString*)directory;
+
+- (void) addVisitToLocation:(NSString*)location title:(NSString*)title;
+- (void) addVisitToLocation:(NSString*)location title:(NSString*)title date:(NSDate*)date;
+
+// Nil when the location was never visited.
+- (void) entryForLocation:(NSString*)location completion:(void (^)(CatHistoryEntry* entry))completion;
+// Visits since the date, newest first, one entry per visit.
+- (void) entriesSince:(NSDate*)date limit:(NSUInteger)limit completion:(void (^)(NSArray* entries))completion;
+
+// Feeds every remembered location to the engine, in the background.
+- (void) feedSuggestionEngine:(CatSuggestionEngine*)engine;
+
+// Blocks until pending visits are written. For tests.
+- (void) waitUntilWritten;
+
+@property (readonly) NSString* directory;
+@property NSTimeInterval maxAge;            // default 90 days
+@property (readonly) unsigned long long recordCount;
+@property (readonly) unsigned long long locationCount;
+
+@end
@@ -0,0 +1,222 @@
+//
+//  CatHistoryStore.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/29/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatHistoryStore.h"
+#import "CatHistoryLog.h"
+#import "CatSuggestionEngine.h"
+
+static const NSTimeInterval kDefaultMaxAge = 90 * 24 * 3600;
+
+@interface CatHistoryEntry ()
+@property (readwrite) NSString* location;
+@property (readwrite) NSString* title;
+@property (readwrite) NSDate* date;
+@property (readwrite) NSUInteger visits;
+@end
+
+@implementation CatHistoryEntry
+
++ (CatHistoryEntry*) entryWithVisit:(const CatHistoryVisit*)visit
+{
+    CatHistoryEntry* entry = [[CatHistoryEntry alloc] init];
+    entry.location = [[NSString alloc] initWithBytes:visit->url length:visit->urlLength encoding:NSUTF8StringEncoding];
+    if(!entry.location) {
+        return nil;
+    }
+    entry.title = [[NSString alloc] initWithBytes:visit->title length:visit->titleLength encoding:NSUTF8StringEncoding];
+    entry.date = [NSDate dateWithTimeIntervalSinceReferenceDate:visit->time];
+    entry.visits = visit->visits;
+    return entry;
+}
+
+@end
+
+@implementation CatHistoryStore
+{
+    CatHistoryLog* log;                 // only touched on queue
+    dispatch_queue_t queue;
+}
+
++ (CatHistoryStore*) sharedStore
+{
+    static CatHistoryStore* sharedStore = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSString* documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES) firstObject];
+        sharedStore = [[CatHistoryStore alloc] initWithDirectory:[documents stringByAppendingPathComponent:@"history"]];
+    });
+    return sharedStore;
+}
+
+- (id) initWithDirectory:(NSString*)directory
+{
+    if(self = [super init]) {
+        _directory = directory;
+        _maxAge = kDefaultMaxAge;
+        queue = dispatch_queue_create("com.dobuki.CatBrowser.history", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        dispatch_async(queue, ^{
+            [self open];
+        });
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    CatHistoryLog* openLog = log;
+    dispatch_async(queue, ^{
+        CatHistoryLogClose(openLog);
+    });
+}
+
+- (void) open
+{
+    NSFileManager* fileManager = [NSFileManager defaultManager];
+    [fileManager createDirectoryAtPath:_directory withIntermediateDirectories:YES attributes:nil error:NULL];
+    log = CatHistoryLogOpen(_directory.fileSystemRepresentation);
+    if(!log && errno == EILSEQ) {
+        NSLog(@"History log unreadable, starting over");
+        [fileManager removeItemAtPath:_directory error:NULL];
+        [fileManager createDirectoryAtPath:_directory withIntermediateDirectories:YES attributes:nil error:NULL];
+        log = CatHistoryLogOpen(_directory.fileSystemRepresentation);
+    }
+    if(!log) {
+        NSLog(@"History log could not be opened: %s", strerror(errno));
+    }
+}
+
+- (void) addVisitToLocation:(NSString*)location title:(NSString*)title
+{
+    [self addVisitToLocation:location title:title date:[NSDate date]];
+}
+
+// The UTF-8 bytes of a string, cut at a character boundary when too long.
+static NSData* bytesOfString(NSString* string, size_t maxLength)
+{
+    NSData* data = [string dataUsingEncoding:NSUTF8StringEncoding] ?: [NSData data];
+    size_t length = MIN(data.length, maxLength);
+    const char* bytes = data.bytes;
+    while(length && length < data.length && (bytes[length] & 0xC0) == 0x80) {
+        length--;
+    }
+    return length == data.length ? data : [data subdataWithRange:NSMakeRange(0, length)];
+}
+
+- (void) addVisitToLocation:(NSString*)location title:(NSString*)title date:(NSDate*)date
+{
+    NSData* url = [location dataUsingEncoding:NSUTF8StringEncoding];
+    if(!url.length || url.length > kCatHistoryMaxURLLength) {
+        return;
+    }
+    NSData* titleBytes = bytesOfString(title, kCatHistoryMaxTitleLength);
+    NSTimeInterval time = [date timeIntervalSinceReferenceDate];
+    dispatch_async(queue, ^{
+        if(!log) {
+            return;
+        }
+        if(CatHistoryLogAppend(log, url.bytes, url.length, titleBytes.bytes, titleBytes.length, time) != 0) {
+            NSLog(@"History visit not recorded: %s", strerror(errno));
+        }
+        if(CatHistoryLogNeedsCompaction(log) &&
+           CatHistoryLogCompact(log, [NSDate timeIntervalSinceReferenceDate] - _maxAge) != 0) {
+            NSLog(@"History compaction failed: %s", strerror(errno));
+        }
+    });
+}
+
+- (void) entryForLocation:(NSString*)location completion:(void (^)(CatHistoryEntry* entry))completion
+{
+    NSData* url = [location dataUsingEncoding:NSUTF8StringEncoding];
+    dispatch_async(queue, ^{
+        CatHistoryEntry* entry = nil;
+        CatHistoryVisit visit;
+        if(log && url.length && CatHistoryLogLookup(log, url.bytes, url.length, &visit) == 1) {
+            entry = [CatHistoryEntry entryWithVisit:&visit];
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(entry);
+        });
+    });
+}
+
+typedef struct {
+    __unsafe_unretained NSMutableArray* entries;
+    NSUInteger limit;
+    __unsafe_unretained CatSuggestionEngine* engine;
+} CatHistoryCollector;
+
+static int collectEntry(const CatHistoryVisit* visit, void* context)
+{
+    CatHistoryCollector* collector = context;
+    CatHistoryEntry* entry = [CatHistoryEntry entryWithVisit:visit];
+    if(entry) {
+        [collector->entries addObject:entry];
+    }
+    return collector->entries.count < collector->limit;
+}
+
+- (void) entriesSince:(NSDate*)date limit:(NSUInteger)limit completion:(void (^)(NSArray* entries))completion
+{
+    NSTimeInterval since = [date timeIntervalSinceReferenceDate];
+    dispatch_async(queue, ^{
+        NSMutableArray* entries = [NSMutableArray array];
+        CatHistoryCollector collector = { entries, limit, nil };
+        if(log && limit) {
+            CatHistoryLogEnumerateSince(log, since, collectEntry, &collector);
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(entries);
+        });
+    });
+}
+
+static int feedEntry(const CatHistoryVisit* visit, void* context)
+{
+    CatHistoryCollector* collector = context;
+    @autoreleasepool {
+        CatHistoryEntry* entry = [CatHistoryEntry entryWithVisit:visit];
+        [collector->engine noteVisits:entry.visits toLocation:entry.location title:entry.title date:entry.date];
+    }
+    return 1;
+}
+
+- (void) feedSuggestionEngine:(CatSuggestionEngine*)engine
+{
+    dispatch_async(queue, ^{
+        CatHistoryCollector collector = { nil, 0, engine };
+        if(log) {
+            CatHistoryLogEnumerateURLs(log, feedEntry, &collector);
+        }
+    });
+}
+
+- (void) waitUntilWritten
+{
+    dispatch_sync(queue, ^{});
+}
+
+- (unsigned long long) recordCount
+{
+    __block unsigned long long count = 0;
+    dispatch_sync(queue, ^{
+        count = log ? CatHistoryLogRecordCount(log) : 0;
+    });
+    return count;
+}
+
+- (unsigned long long) locationCount
+{
+    __block unsigned long long count = 0;
+    dispatch_sync(queue, ^{
+        count = log ? CatHistoryLogURLCount(log) : 0;
+    });
+    return count;
+}
+
+@end
@@ -0,0 +1,50 @@
+//
+//  CatImagePool.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/16/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Bounded in-memory pool of replacement images, one ring buffer per type.
+//  startLoading takes from it in O(1); a low priority worker refills a ring
+//  in batches whenever it drops under its low watermark. Each image keeps
+//  the key the image store gave it, so derived variants can be found
+//  without hashing the body again.
+//
+
+#import <Foundation/Foundation.h>
+
+// Sets *key to the store key of the image, or leaves it nil.
+typedef NSData* (^CatImagePoolSource)(NSString* type, NSString** key);
+
+@interface CatImagePool : NSObject
+
++ (CatImagePool*) sharedPool;
+
+- (id) initWithTypes:(NSArray*)types capacity:(NSUInteger)capacity;
+
+// Next image of that type, or nil when the ring ran dry. Key may be NULL.
+- (NSData*) takeImageOfType:(NSString*)type key:(NSString**)key;
+- (BOOL) addImage:(NSData*)data key:(NSString*)key type:(NSString*)type;
+- (NSUInteger) depthForType:(NSString*)type;
+
+// Queues a refill of every ring under its low watermark.
+- (void) scheduleRefill;
+- (void) drain;
+
+// Called on the worker queue to produce one image. Returning nil ends the batch.
+@property (copy) CatImagePoolSource source;
+
+@property (readonly) NSUInteger capacity;
+@property NSUInteger lowWatermark;
+@property NSUInteger highWatermark;
+@property NSUInteger refillBatch;
+
+@property (readonly) NSUInteger takes;
+@property (readonly) NSUInteger dryTakes;
+@property (readonly) NSUInteger refills;
+@property (readonly) NSUInteger refilledImages;
+@property (readonly) unsigned long long residentBytes;
+- (NSDictionary*) metrics;
+
+@end
@@ -0,0 +1,206 @@
+//
+//  CatImagePool.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/16/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatImagePool.h"
+
+static const NSUInteger kDefaultCapacity = 8;
+
+@interface CatImageRing : NSObject
+{
+@public
+    NSMutableArray* slots;
+    NSMutableArray* keys;   // store key of each slot, or NSNull
+    NSUInteger head;
+    NSUInteger count;
+}
+@end
+
+@implementation CatImageRing
+@end
+
+@implementation CatImagePool
+{
+    NSDictionary* rings;    // type -> CatImageRing
+    dispatch_queue_t worker;
+    BOOL refillScheduled;
+}
+
++ (CatImagePool*) sharedPool
+{
+    static CatImagePool* sharedPool = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedPool = [[CatImagePool alloc] initWithTypes:@[@"gif", @"jpg", @"png"] capacity:kDefaultCapacity];
+    });
+    return sharedPool;
+}
+
+- (id) initWithTypes:(NSArray*)types capacity:(NSUInteger)capacity
+{
+    if(self = [super init]) {
+        _capacity = MAX(1, capacity);
+        _lowWatermark = MAX(1, _capacity * 3 / 8);
+        _highWatermark = _capacity;
+        _refillBatch = MAX(1, _capacity / 2);
+        NSMutableDictionary* allRings = [NSMutableDictionary dictionary];
+        for(NSString* type in types) {
+            CatImageRing* ring = [[CatImageRing alloc] init];
+            ring->slots = [NSMutableArray arrayWithCapacity:_capacity];
+            ring->keys = [NSMutableArray arrayWithCapacity:_capacity];
+            for(NSUInteger i=0; i<_capacity; i++) {
+                [ring->slots addObject:[NSNull null]];
+                [ring->keys addObject:[NSNull null]];
+            }
+            allRings[type] = ring;
+        }
+        rings = allRings;
+        worker = dispatch_queue_create("com.dobuki.CatBrowser.imagepool", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(worker, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+    }
+    return self;
+}
+
+- (NSData*) takeImageOfType:(NSString*)type key:(NSString**)key
+{
+    CatImageRing* ring = rings[type];
+    NSData* data = nil;
+    id dataKey = nil;
+    BOOL low = NO;
+    @synchronized(self) {
+        _takes++;
+        if(ring && ring->count) {
+            data = ring->slots[ring->head];
+            dataKey = ring->keys[ring->head];
+            ring->slots[ring->head] = [NSNull null];
+            ring->keys[ring->head] = [NSNull null];
+            ring->head = (ring->head + 1) % _capacity;
+            ring->count--;
+            _residentBytes -= data.length;
+        }
+        else {
+            _dryTakes++;
+        }
+        low = ring && ring->count < _lowWatermark;
+    }
+    if(low) {
+        [self scheduleRefill];
+    }
+    if(key) {
+        *key = dataKey == [NSNull null] ? nil : dataKey;
+    }
+    return data;
+}
+
+- (BOOL) addImage:(NSData*)data key:(NSString*)key type:(NSString*)type
+{
+    CatImageRing* ring = rings[type];
+    if(!ring || !data.length) {
+        return NO;
+    }
+    @synchronized(self) {
+        if(ring->count == _capacity) {
+            return NO;
+        }
+        NSUInteger slot = (ring->head + ring->count) % _capacity;
+        ring->slots[slot] = data;
+        ring->keys[slot] = key ?: [NSNull null];
+        ring->count++;
+        _residentBytes += data.length;
+    }
+    return YES;
+}
+
+- (NSUInteger) depthForType:(NSString*)type
+{
+    CatImageRing* ring = rings[type];
+    @synchronized(self) {
+        return ring ? ring->count : 0;
+    }
+}
+
+- (void) scheduleRefill
+{
+    @synchronized(self) {
+        if(refillScheduled || !_source) {
+            return;
+        }
+        refillScheduled = YES;
+    }
+    dispatch_async(worker, ^{
+        [self refill];
+    });
+}
+
+- (void) refill
+{
+    @synchronized(self) {
+        refillScheduled = NO;
+    }
+    CatImagePoolSource source = _source;
+    for(NSString* type in rings) {
+        if([self depthForType:type] >= _lowWatermark) {
+            continue;
+        }
+        @synchronized(self) {
+            _refills++;
+        }
+        // Fill up to the high watermark, one batch per pass, so a dry origin ends the refill early.
+        NSUInteger high = MIN(_highWatermark, _capacity);
+        while([self depthForType:type] < high) {
+            NSUInteger added = 0;
+            // Stops at the watermark, so no image is fetched only to be dropped.
+            for(NSUInteger i=0; i<_refillBatch && [self depthForType:type] < high; i++) {
+                NSString* key = nil;
+                NSData* data = source ? source(type, &key) : nil;
+                if(!data || ![self addImage:data key:key type:type]) {
+                    break;
+                }
+                added++;
+            }
+            @synchronized(self) {
+                _refilledImages += added;
+            }
+            if(added < _refillBatch) {
+                break;
+            }
+        }
+    }
+}
+
+- (void) drain
+{
+    @synchronized(self) {
+        for(CatImageRing* ring in [rings allValues]) {
+            for(NSUInteger i=0; i<_capacity; i++) {
+                ring->slots[i] = [NSNull null];
+                ring->keys[i] = [NSNull null];
+            }
+            ring->head = 0;
+            ring->count = 0;
+        }
+        _residentBytes = 0;
+    }
+}
+
+- (NSDictionary*) metrics
+{
+    NSMutableDictionary* depths = [NSMutableDictionary dictionary];
+    for(NSString* type in rings) {
+        depths[type] = @([self depthForType:type]);
+    }
+    @synchronized(self) {
+        return @{@"depth":depths,
+                 @"takes":@(_takes),
+                 @"dryTakes":@(_dryTakes),
+                 @"refills":@(_refills),
+                 @"refilledImages":@(_refilledImages),
+                 @"residentBytes":@(_residentBytes)};
+    }
+}
+
+@end
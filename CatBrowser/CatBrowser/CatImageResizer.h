@@ -0,0 +1,51 @@
+//
+//  CatImageResizer.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/17/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Shrinks replacement images to the size class of the slot they replace,
+//  so WebKit never decodes a multi-megapixel cat for a 32x32 avatar.
+//  Resized variants are kept in their own disk store, one per size class,
+//  under the key the content-addressed store gave the original. Variants
+//  are made ahead of time or in the background, never while a request
+//  waits: a request finding none gets the original this once.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CatImageStore;
+
+// Largest dimension, in pixels, of each size class. 0 means full size.
+extern const NSUInteger CatImageSizeClasses[];
+extern const NSUInteger CatImageSizeClassCount;
+
+@interface CatImageResizer : NSObject
+
++ (CatImageResizer*) sharedResizer;
+
+- (id) initWithStore:(CatImageStore*)store;
+
+// Size class for the slot an URL is displayed in, guessed from size hints
+// such as width=, sz=, googleusercontent =s72 or 120x90 in the path.
+// Falls back to defaultSizeClass.
+- (NSUInteger) sizeClassForURL:(NSURL*)url;
++ (NSUInteger) pixelHintForURL:(NSURL*)url;
+
+// The variant made earlier of the stored image under key, or nil. Never decodes.
+- (NSData*) variantForKey:(NSString*)key type:(NSString*)type sizeClass:(NSUInteger)sizeClass;
+// Makes that variant on a background queue, unless it exists or is on its way.
+- (void) prepareVariantOfData:(NSData*)data key:(NSString*)key type:(NSString*)type sizeClass:(NSUInteger)sizeClass;
+// Image data no larger than the size class, made now if needed, or the
+// original data when it already fits, cannot be decoded, or is animated.
+// Decodes on the calling thread: for callers already off the loading path.
+- (NSData*) dataForImage:(NSData*)data key:(NSString*)key type:(NSString*)type sizeClass:(NSUInteger)sizeClass;
+
+@property NSUInteger defaultSizeClass;
+@property CGFloat screenScale;
+
+@property (readonly) NSUInteger resizedImages;
+@property (readonly) NSUInteger reusedImages;
+
+@end
@@ -0,0 +1,219 @@
+//
+//  CatImageResizer.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/17/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatImageResizer.h"
+#import "CatImageStore.h"
+#import "CatResample.h"
+
+const NSUInteger CatImageSizeClasses[] = { 32, 64, 128, 256, 512, 1024 };
+const NSUInteger CatImageSizeClassCount = sizeof(CatImageSizeClasses)/sizeof(CatImageSizeClasses[0]);
+
+static const unsigned long long kVariantBudget = 8 * 1024 * 1024;
+
+@implementation CatImageResizer
+{
+    CatImageStore* variants;
+    dispatch_queue_t worker;
+    NSMutableSet* pending;      // variant keys being made on the worker
+}
+
++ (CatImageResizer*) sharedResizer
+{
+    static CatImageResizer* sharedResizer = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSString* caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+        CatImageStore* store = [[CatImageStore alloc] initWithDirectory:[caches stringByAppendingPathComponent:@"cats-sized"] budget:kVariantBudget];
+        sharedResizer = [[CatImageResizer alloc] initWithStore:store];
+    });
+    return sharedResizer;
+}
+
+- (id) initWithStore:(CatImageStore*)store
+{
+    if(self = [super init]) {
+        variants = store;
+        worker = dispatch_queue_create("com.dobuki.CatBrowser.resizer", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(worker, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+        pending = [NSMutableSet set];
+        _defaultSizeClass = 512;
+        _screenScale = [UIScreen mainScreen].scale;
+    }
+    return self;
+}
+
++ (NSUInteger) pixelHintForURL:(NSURL*)url
+{
+    static NSSet* sizeParameters = nil;
+    static NSRegularExpression* prefixed = nil;
+    static NSRegularExpression* dimensions = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sizeParameters = [NSSet setWithObjects:@"w", @"h", @"width", @"height", @"sz", @"size", @"s", @"maxwidth", nil];
+        // googleusercontent style: .../s72-c/photo.jpg, photo=s72, =w120-h90
+        prefixed = [NSRegularExpression regularExpressionWithPattern:@"(?:^|[/=_-])[swh](\\d{2,4})(?=$|[-/_.])" options:0 error:NULL];
+        // .../thumb_120x90.jpg
+        dimensions = [NSRegularExpression regularExpressionWithPattern:@"(\\d{2,4})x(\\d{2,4})" options:0 error:NULL];
+    });
+
+    NSUInteger hint = 0;
+    for(NSString* pair in [url.query componentsSeparatedByString:@"&"]) {
+        NSRange equal = [pair rangeOfString:@"="];
+        if(equal.location != NSNotFound && [sizeParameters containsObject:[[pair substringToIndex:equal.location] lowercaseString]]) {
+            hint = MAX(hint, (NSUInteger)MAX(0, [[pair substringFromIndex:equal.location+1] integerValue]));
+        }
+    }
+    if(hint) {
+        return hint;
+    }
+
+    NSString* path = url.path;
+    if(!path) {
+        return 0;
+    }
+    for(NSRegularExpression* expression in @[prefixed, dimensions]) {
+        for(NSTextCheckingResult* match in [expression matchesInString:path options:0 range:NSMakeRange(0, path.length)]) {
+            for(NSUInteger i=1; i<match.numberOfRanges; i++) {
+                hint = MAX(hint, (NSUInteger)[[path substringWithRange:[match rangeAtIndex:i]] integerValue]);
+            }
+        }
+        if(hint) {
+            break;
+        }
+    }
+    return hint;
+}
+
+- (NSUInteger) sizeClassForURL:(NSURL*)url
+{
+    NSUInteger hint = [CatImageResizer pixelHintForURL:url];
+    if(!hint) {
+        return _defaultSizeClass;
+    }
+    NSUInteger pixels = (NSUInteger)ceil(hint * MAX(1, _screenScale));
+    for(NSUInteger i=0; i<CatImageSizeClassCount; i++) {
+        if(pixels <= CatImageSizeClasses[i]) {
+            return CatImageSizeClasses[i];
+        }
+    }
+    return 0;
+}
+
+// The original is named after its body already, so its key names the variant too.
+static NSString* variantKey(NSString* key, NSString* type, NSUInteger sizeClass)
+{
+    return [[[key stringByDeletingPathExtension] stringByAppendingFormat:@"-%lu", (unsigned long)sizeClass] stringByAppendingPathExtension:type];
+}
+
+static BOOL needsVariant(NSData* data, NSString* key, NSString* type, NSUInteger sizeClass)
+{
+    return sizeClass && key && data.length && ![type isEqualToString:@"gif"];
+}
+
+- (NSData*) variantForKey:(NSString*)key type:(NSString*)type sizeClass:(NSUInteger)sizeClass
+{
+    if(!sizeClass || !key || [type isEqualToString:@"gif"]) {
+        return nil;
+    }
+    NSData* variant = [variants dataForKey:variantKey(key, type, sizeClass)];
+    if(variant) {
+        @synchronized(self) {
+            _reusedImages++;
+        }
+    }
+    return variant;
+}
+
+- (void) prepareVariantOfData:(NSData*)data key:(NSString*)key type:(NSString*)type sizeClass:(NSUInteger)sizeClass
+{
+    if(!needsVariant(data, key, type, sizeClass)) {
+        return;
+    }
+    NSString* variant = variantKey(key, type, sizeClass);
+    @synchronized(self) {
+        if([pending containsObject:variant] || [variants containsKey:variant]) {
+            return;
+        }
+        [pending addObject:variant];
+    }
+    dispatch_async(worker, ^{
+        [self dataForImage:data key:key type:type sizeClass:sizeClass];
+        @synchronized(self) {
+            [pending removeObject:variant];
+        }
+    });
+}
+
+- (NSData*) dataForImage:(NSData*)data key:(NSString*)key type:(NSString*)type sizeClass:(NSUInteger)sizeClass
+{
+    if(!needsVariant(data, key, type, sizeClass)) {
+        return data;
+    }
+    NSString* storeKey = variantKey(key, type, sizeClass);
+    NSData* variant = [variants dataForKey:storeKey];
+    if(variant) {
+        @synchronized(self) {
+            _reusedImages++;
+        }
+        return variant;
+    }
+    variant = [self resizeData:data type:type limit:sizeClass];
+    if(!variant) {
+        return data;
+    }
+    // Images that already fit are stored too, so they are not decoded again.
+    [variants storeData:variant key:storeKey];
+    @synchronized(self) {
+        _resizedImages++;
+    }
+    return variant;
+}
+
+- (NSData*) resizeData:(NSData*)data type:(NSString*)type limit:(NSUInteger)limit
+{
+    // The UIImage is released after its last use, which may be this line:
+    // the CGImage it owns is retained on its own for the draw.
+    CGImageRef source = CGImageRetain([UIImage imageWithData:data].CGImage);
+    if(!source) {
+        return nil;
+    }
+    size_t width = CGImageGetWidth(source);
+    size_t height = CGImageGetHeight(source);
+    if(MAX(width, height) <= limit) {
+        CGImageRelease(source);
+        return data;
+    }
+    double scale = (double)limit / MAX(width, height);
+    size_t scaledWidth = MAX(1, (size_t)lround(width * scale));
+    size_t scaledHeight = MAX(1, (size_t)lround(height * scale));
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGBitmapInfo bitmapInfo = kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big;
+    CGContextRef decoded = CGBitmapContextCreate(NULL, width, height, 8, width*4, colorSpace, bitmapInfo);
+    CGContextRef scaled = CGBitmapContextCreate(NULL, scaledWidth, scaledHeight, 8, scaledWidth*4, colorSpace, bitmapInfo);
+    CGColorSpaceRelease(colorSpace);
+
+    NSData* result = nil;
+    if(decoded && scaled) {
+        CGContextDrawImage(decoded, CGRectMake(0, 0, width, height), source);
+        if(CatResampleRGBA(CGBitmapContextGetData(decoded), (int)width, (int)height, CGBitmapContextGetBytesPerRow(decoded),
+                           CGBitmapContextGetData(scaled), (int)scaledWidth, (int)scaledHeight, CGBitmapContextGetBytesPerRow(scaled),
+                           CatResamplePathSIMD) == 0) {
+            CGImageRef image = CGBitmapContextCreateImage(scaled);
+            UIImage* resized = [UIImage imageWithCGImage:image];
+            result = [type isEqualToString:@"png"] ? UIImagePNGRepresentation(resized) : UIImageJPEGRepresentation(resized, .85);
+            CGImageRelease(image);
+        }
+    }
+    CGContextRelease(decoded);
+    CGContextRelease(scaled);
+    CGImageRelease(source);
+    return result;
+}
+
+@end
@@ -0,0 +1,55 @@
+//
+//  CatImageStore.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/13/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Content-addressed disk store of replacement images. Files are named
+//  after the md5 of their body, so the same cat fetched twice is stored
+//  once. The store keeps its total size under a budget by evicting the
+//  least recently served images.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface CatImageStore : NSObject
+
++ (CatImageStore*) sharedStore;
+
+- (id) initWithDirectory:(NSString*)directory budget:(unsigned long long)budget;
+
+// Stores the body under its hash and returns the key. Type is the file extension (gif, jpg, png).
+- (NSString*) storeData:(NSData*)data type:(NSString*)type;
+// Stores the body under a caller chosen key, for derived images such as resized variants.
+- (BOOL) storeData:(NSData*)data key:(NSString*)key;
+// Moves a fully written file into the store. Digest is the md5 of its body, computed by the writer.
+- (NSString*) storeFileAtPath:(NSString*)path digest:(NSString*)digest type:(NSString*)type;
+- (NSData*) dataForKey:(NSString*)key;
+- (BOOL) containsKey:(NSString*)key;
+
+// A random stored image of the given type, or nil. Counts as a hit or a miss.
+- (NSData*) randomDataOfType:(NSString*)type key:(NSString**)key;
+
+// YES while the store holds fewer than refillThreshold images of that type,
+// in which case interceptions should go to the network and store the result.
+- (BOOL) needsRefillForType:(NSString*)type;
+- (NSUInteger) countForType:(NSString*)type;
+
+// Seeds the store with every gif/jpg/jpeg/png file in a directory.
+- (NSUInteger) importDirectory:(NSString*)path;
+- (void) removeAllImages;
+
++ (NSString*) MIMETypeForType:(NSString*)type;
+
+@property (readonly) NSString* directory;
+@property (readonly) unsigned long long budget;
+@property (readonly) unsigned long long size;
+@property NSUInteger refillThreshold;
+
+@property (readonly) NSUInteger hits;
+@property (readonly) NSUInteger misses;
+@property (readonly) NSUInteger evictions;
+- (void) resetCounters;
+
+@end
@@ -0,0 +1,286 @@
+//
+//  CatImageStore.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/13/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatImageStore.h"
+#import "NSString+MD5.h"
+
+static const unsigned long long kDefaultBudget = 24 * 1024 * 1024;
+static const NSUInteger kDefaultRefillThreshold = 12;
+
+@implementation CatImageStore
+{
+    NSMutableDictionary* sizes;         // key -> NSNumber bytes
+    NSMutableOrderedSet* recentlyUsed;  // least recently served first
+    NSMutableDictionary* keysByType;    // type -> NSMutableArray of keys
+    dispatch_queue_t touchQueue;
+}
+
++ (CatImageStore*) sharedStore
+{
+    static CatImageStore* sharedStore = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSString* caches = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+        sharedStore = [[CatImageStore alloc] initWithDirectory:[caches stringByAppendingPathComponent:@"cats"] budget:kDefaultBudget];
+    });
+    return sharedStore;
+}
+
++ (NSString*) normalizedType:(NSString*)type
+{
+    type = type.lowercaseString;
+    return [type isEqualToString:@"jpeg"] ? @"jpg" : type;
+}
+
++ (NSString*) MIMETypeForType:(NSString*)type
+{
+    type = [self normalizedType:type];
+    if([type isEqualToString:@"jpg"]) {
+        return @"image/jpeg";
+    }
+    return [@"image/" stringByAppendingString:type];
+}
+
+- (id) initWithDirectory:(NSString*)directory budget:(unsigned long long)budget
+{
+    if(self = [super init]) {
+        _directory = directory;
+        _budget = budget;
+        _refillThreshold = kDefaultRefillThreshold;
+        sizes = [NSMutableDictionary dictionary];
+        recentlyUsed = [NSMutableOrderedSet orderedSet];
+        keysByType = [NSMutableDictionary dictionary];
+        touchQueue = dispatch_queue_create("com.dobuki.CatBrowser.imagestore", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(touchQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+
+        NSFileManager* fileManager = [NSFileManager defaultManager];
+        [fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
+        [self loadIndex];
+    }
+    return self;
+}
+
+// Rebuilds the LRU order from modification dates, which are bumped whenever an image is served.
+- (void) loadIndex
+{
+    NSURL* directoryURL = [NSURL fileURLWithPath:_directory isDirectory:YES];
+    NSArray* keys = @[NSURLFileSizeKey, NSURLContentModificationDateKey];
+    NSArray* files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:directoryURL includingPropertiesForKeys:keys options:NSDirectoryEnumerationSkipsHiddenFiles error:NULL];
+    NSMutableArray* entries = [NSMutableArray arrayWithCapacity:files.count];
+    for(NSURL* file in files) {
+        NSDictionary* values = [file resourceValuesForKeys:keys error:NULL];
+        if(values[NSURLFileSizeKey] && values[NSURLContentModificationDateKey]) {
+            [entries addObject:@[file.lastPathComponent, values[NSURLFileSizeKey], values[NSURLContentModificationDateKey]]];
+        }
+    }
+    [entries sortUsingComparator:^NSComparisonResult(NSArray* a, NSArray* b) {
+        return [a[2] compare:b[2]];
+    }];
+    for(NSArray* entry in entries) {
+        [self addKey:entry[0] size:[entry[1] unsignedLongLongValue]];
+    }
+    [self evictToBudget];
+}
+
+- (void) addKey:(NSString*)key size:(unsigned long long)size
+{
+    NSString* type = key.pathExtension;
+    sizes[key] = @(size);
+    [recentlyUsed addObject:key];
+    NSMutableArray* typed = keysByType[type];
+    if(!typed) {
+        typed = [NSMutableArray array];
+        keysByType[type] = typed;
+    }
+    [typed addObject:key];
+    _size += size;
+}
+
+- (void) removeKey:(NSString*)key
+{
+    _size -= [sizes[key] unsignedLongLongValue];
+    [sizes removeObjectForKey:key];
+    [recentlyUsed removeObject:key];
+    [keysByType[key.pathExtension] removeObject:key];
+    [[NSFileManager defaultManager] removeItemAtPath:[_directory stringByAppendingPathComponent:key] error:NULL];
+}
+
+- (void) evictToBudget
+{
+    while(_size > _budget && recentlyUsed.count > 1) {
+        [self removeKey:recentlyUsed.firstObject];
+        _evictions++;
+    }
+}
+
+- (NSString*) storeData:(NSData*)data type:(NSString*)type
+{
+    if(!data.length) {
+        return nil;
+    }
+    NSString* key = [[data md5] stringByAppendingPathExtension:[CatImageStore normalizedType:type]];
+    return [self storeData:data key:key] ? key : nil;
+}
+
+- (BOOL) storeData:(NSData*)data key:(NSString*)key
+{
+    if(!data.length) {
+        return NO;
+    }
+    @synchronized(self) {
+        if(sizes[key]) {
+            [self touchKey:key];
+            return YES;
+        }
+    }
+    NSString* path = [_directory stringByAppendingPathComponent:key];
+    if(![data writeToFile:path options:NSDataWritingAtomic error:NULL]) {
+        return NO;
+    }
+    @synchronized(self) {
+        if(!sizes[key]) {
+            [self addKey:key size:data.length];
+            [self evictToBudget];
+        }
+    }
+    return YES;
+}
+
+- (NSString*) storeFileAtPath:(NSString*)path digest:(NSString*)digest type:(NSString*)type
+{
+    NSString* key = [digest stringByAppendingPathExtension:[CatImageStore normalizedType:type]];
+    NSFileManager* fileManager = [NSFileManager defaultManager];
+    unsigned long long size = [[fileManager attributesOfItemAtPath:path error:NULL] fileSize];
+    @synchronized(self) {
+        if(sizes[key]) {
+            [self touchKey:key];
+            [fileManager removeItemAtPath:path error:NULL];
+            return key;
+        }
+    }
+    if(!size || ![fileManager moveItemAtPath:path toPath:[_directory stringByAppendingPathComponent:key] error:NULL]) {
+        [fileManager removeItemAtPath:path error:NULL];
+        return nil;
+    }
+    @synchronized(self) {
+        if(!sizes[key]) {
+            [self addKey:key size:size];
+            [self evictToBudget];
+        }
+    }
+    return key;
+}
+
+- (void) touchKey:(NSString*)key
+{
+    [recentlyUsed removeObject:key];
+    [recentlyUsed addObject:key];
+    NSString* path = [_directory stringByAppendingPathComponent:key];
+    dispatch_async(touchQueue, ^{
+        [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate:[NSDate date]} ofItemAtPath:path error:NULL];
+    });
+}
+
+- (BOOL) containsKey:(NSString*)key
+{
+    @synchronized(self) {
+        return sizes[key] != nil;
+    }
+}
+
+- (NSData*) dataForKey:(NSString*)key
+{
+    @synchronized(self) {
+        if(!sizes[key]) {
+            return nil;
+        }
+        [self touchKey:key];
+    }
+    NSData* data = [NSData dataWithContentsOfFile:[_directory stringByAppendingPathComponent:key] options:NSDataReadingMappedIfSafe error:NULL];
+    if(!data) {
+        @synchronized(self) {
+            if(sizes[key]) {
+                [self removeKey:key];
+            }
+        }
+    }
+    return data;
+}
+
+- (NSData*) randomDataOfType:(NSString*)type key:(NSString**)key
+{
+    NSString* chosen = nil;
+    @synchronized(self) {
+        NSArray* typed = keysByType[[CatImageStore normalizedType:type]];
+        if(typed.count) {
+            chosen = typed[arc4random_uniform((u_int32_t)typed.count)];
+        }
+    }
+    NSData* data = chosen ? [self dataForKey:chosen] : nil;
+    @synchronized(self) {
+        if(data) {
+            _hits++;
+        }
+        else {
+            _misses++;
+        }
+    }
+    if(key) {
+        *key = data ? chosen : nil;
+    }
+    return data;
+}
+
+- (NSUInteger) countForType:(NSString*)type
+{
+    @synchronized(self) {
+        return [keysByType[[CatImageStore normalizedType:type]] count];
+    }
+}
+
+- (BOOL) needsRefillForType:(NSString*)type
+{
+    return [self countForType:type] < _refillThreshold;
+}
+
+- (NSUInteger) importDirectory:(NSString*)path
+{
+    NSUInteger imported = 0;
+    NSArray* types = @[@"gif", @"jpg", @"png"];
+    for(NSString* file in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:path error:NULL]) {
+        NSString* type = [CatImageStore normalizedType:file.pathExtension];
+        if(![types containsObject:type]) {
+            continue;
+        }
+        NSData* data = [NSData dataWithContentsOfFile:[path stringByAppendingPathComponent:file]];
+        if([self storeData:data type:type]) {
+            imported++;
+        }
+    }
+    return imported;
+}
+
+- (void) removeAllImages
+{
+    @synchronized(self) {
+        for(NSString* key in [sizes allKeys]) {
+            [self removeKey:key];
+        }
+    }
+}
+
+- (void) resetCounters
+{
+    @synchronized(self) {
+        _hits = 0;
+        _misses = 0;
+        _evictions = 0;
+    }
+}
+
+@end
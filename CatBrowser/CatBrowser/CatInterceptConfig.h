@@ -0,0 +1,63 @@
+//
+//  CatInterceptConfig.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/18/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Every interception setting in one immutable object: the on/off switch,
+//  the compiled URL rules, host allow/deny lists and replacement type
+//  weights. A change builds a new config that CatURLProtocol publishes
+//  whole, so loader threads never see half an update.
+//
+
+#import <Foundation/Foundation.h>
+#import "CatURLMatcher.h"
+
+// Dictionary and JSON keys. Rule lists are arrays of strings.
+extern NSString* const CatInterceptEnabledKey;        // NSNumber BOOL
+extern NSString* const CatInterceptExtensionsKey;
+extern NSString* const CatInterceptSchemesKey;
+extern NSString* const CatInterceptSubstringsKey;
+extern NSString* const CatInterceptExclusionsKey;
+extern NSString* const CatInterceptDenyHostsKey;
+extern NSString* const CatInterceptAllowHostsKey;
+extern NSString* const CatInterceptTypeWeightsKey;    // type -> NSNumber weight
+extern NSString* const CatInterceptOriginKey;         // URL string replacement images come from
+extern NSString* const CatInterceptFormatBudgetKey;   // format policy budget, see CatDecodeCostPolicy
+
+@interface CatInterceptConfig : NSObject
+
++ (CatInterceptConfig*) defaultConfig;
+
+// Missing keys keep their default. Returns nil when the rules do not
+// compile or a value is not of the type listed above.
++ (CatInterceptConfig*) configWithDictionary:(NSDictionary*)dictionary;
++ (CatInterceptConfig*) configWithJSONData:(NSData*)data error:(NSError**)error;
+
+// Same rules, other switch position.
+- (CatInterceptConfig*) configWithEnabled:(BOOL)enabled;
+
+- (NSDictionary*) dictionaryRepresentation;
+
+// Replacement type drawn according to typeWeights.
+- (NSString*) randomType;
+// Origin URL with the type parameter appended.
+- (NSURL*) originURLForType:(NSString*)type;
+
+// Tallies a canInitWithRequest: decision against the rule that made it.
+// Configs derived with configWithEnabled: share their tallies.
+- (void) countDecision:(BOOL)intercepted rule:(int)rule;
+// "kind:pattern" (or "none") -> @{@"intercepted": n, @"passed": n}
+- (NSDictionary*) decisionCounts;
+
+@property (readonly) BOOL enabled;
+// Increases with every config built, so caches can tell snapshots apart.
+@property (readonly) uint32_t version;
+// Owned by the config, valid as long as it is.
+@property (readonly) const CatURLMatcher* matcher;
+@property (readonly) NSDictionary* typeWeights;
+@property (readonly) NSURL* originURL;
+@property (readonly) NSDictionary* formatBudget;
+
+@end
@@ -0,0 +1,242 @@
+//
+//  CatInterceptConfig.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/18/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatInterceptConfig.h"
+#import <libkern/OSAtomic.h>
+
+NSString* const CatInterceptEnabledKey = @"enabled";
+NSString* const CatInterceptExtensionsKey = @"extensions";
+NSString* const CatInterceptSchemesKey = @"schemes";
+NSString* const CatInterceptSubstringsKey = @"substrings";
+NSString* const CatInterceptExclusionsKey = @"exclusions";
+NSString* const CatInterceptDenyHostsKey = @"denyHosts";
+NSString* const CatInterceptAllowHostsKey = @"allowHosts";
+NSString* const CatInterceptTypeWeightsKey = @"typeWeights";
+NSString* const CatInterceptOriginKey = @"origin";
+NSString* const CatInterceptFormatBudgetKey = @"formatBudget";
+
+static volatile int32_t lastVersion = 0;
+
+// String keys, NSNumber values.
+static BOOL isNumberDictionary(id dictionary)
+{
+    if(![dictionary isKindOfClass:[NSDictionary class]]) {
+        return NO;
+    }
+    for(id key in dictionary) {
+        if(![key isKindOfClass:[NSString class]] || ![dictionary[key] isKindOfClass:[NSNumber class]]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@implementation CatInterceptConfig
+{
+    CatURLMatcher* matcher;
+    NSDictionary* rules;
+    NSArray* weightedTypes;
+    NSArray* cumulativeWeights;
+    double totalWeight;
+    // int64_t intercepted/passed pairs, slot 0 for no rule, then one per rule.
+    NSMutableData* decisions;
+}
+
++ (NSDictionary*) defaultDictionary
+{
+    return @{
+        CatInterceptEnabledKey: @YES,
+        CatInterceptExtensionsKey: @[ @"jpg", @"png", @"gif", @"jpeg", @"bmp" ],
+        CatInterceptSchemesKey: @[ @"data" ],
+        CatInterceptSubstringsKey: @[ @"://encrypted-tbn", @"googleusercontent.com", @"maps-api-ssl.google.com/maps/api/staticmap" ],
+        // Spacer gif used all over Google result pages.
+        CatInterceptExclusionsKey: @[ @"data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D" ],
+        CatInterceptDenyHostsKey: @[],
+        CatInterceptAllowHostsKey: @[],
+        CatInterceptTypeWeightsKey: @{ @"gif": @1, @"jpg": @1, @"png": @1 },
+        CatInterceptOriginKey: @"http://thecatapi.com/api/images/get?format=src",
+        CatInterceptFormatBudgetKey: @{ @"decodedBytes": @(4 * 1024 * 1024), @"animationsPerPage": @4, @"preferOriginal": @3 },
+    };
+}
+
++ (CatInterceptConfig*) defaultConfig
+{
+    return [[CatInterceptConfig alloc] initWithDictionary:[self defaultDictionary]];
+}
+
++ (CatInterceptConfig*) configWithDictionary:(NSDictionary*)dictionary
+{
+    NSMutableDictionary* merged = [[self defaultDictionary] mutableCopy];
+    [merged addEntriesFromDictionary:dictionary];
+    return [[CatInterceptConfig alloc] initWithDictionary:merged];
+}
+
++ (CatInterceptConfig*) configWithJSONData:(NSData*)data error:(NSError**)error
+{
+    id dictionary = [NSJSONSerialization JSONObjectWithData:data options:0 error:error];
+    if(!dictionary) {
+        return nil;
+    }
+    CatInterceptConfig* config = [dictionary isKindOfClass:[NSDictionary class]] ? [self configWithDictionary:dictionary] : nil;
+    if(!config && error) {
+        *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSPropertyListReadCorruptError
+                                 userInfo:@{NSLocalizedDescriptionKey: @"Invalid interception config"}];
+    }
+    return config;
+}
+
+- (id) initWithDictionary:(NSDictionary*)dictionary
+{
+    if(self = [super init]) {
+        // intercept.json is edited by hand: a value of the wrong type
+        // rejects the whole file rather than raising further down.
+        id enabled = dictionary[CatInterceptEnabledKey];
+        id origin = dictionary[CatInterceptOriginKey];
+        _enabled = [enabled isKindOfClass:[NSNumber class]] && [enabled boolValue];
+        _originURL = [origin isKindOfClass:[NSString class]] ? [NSURL URLWithString:origin] : nil;
+        _formatBudget = [dictionary[CatInterceptFormatBudgetKey] copy];
+        if(![enabled isKindOfClass:[NSNumber class]] || !_originURL.scheme || !isNumberDictionary(_formatBudget)
+           || ![self compileRules:dictionary] || ![self setWeights:dictionary[CatInterceptTypeWeightsKey]]) {
+            return nil;
+        }
+        decisions = [NSMutableData dataWithLength:sizeof(int64_t) * 2 * (CatURLMatcherRuleCount(matcher) + 1)];
+        _version = (uint32_t)OSAtomicIncrement32Barrier(&lastVersion);
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    CatURLMatcherRelease(matcher);
+}
+
+// Rule indices follow this order, which is what metrics report against.
+- (BOOL) compileRules:(NSDictionary*)dictionary
+{
+    NSArray* keys = @[CatInterceptExtensionsKey, CatInterceptSchemesKey, CatInterceptSubstringsKey,
+                      CatInterceptExclusionsKey, CatInterceptDenyHostsKey, CatInterceptAllowHostsKey];
+    const CatURLRuleKind kinds[] = { CatURLRuleExtension, CatURLRuleScheme, CatURLRuleSubstring,
+                                     CatURLRuleExclude, CatURLRuleDenyHost, CatURLRuleAllowHost };
+    NSMutableDictionary* compiled = [NSMutableDictionary dictionary];
+    NSMutableArray* patterns = [NSMutableArray array];
+    NSMutableData* table = [NSMutableData data];
+    for(NSUInteger k=0; k<keys.count; k++) {
+        NSArray* list = dictionary[keys[k]];
+        if(![list isKindOfClass:[NSArray class]]) {
+            return NO;
+        }
+        for(NSString* pattern in list) {
+            if(![pattern isKindOfClass:[NSString class]]) {
+                return NO;
+            }
+            [patterns addObject:pattern];
+            CatURLRule rule = { kinds[k], pattern.UTF8String };
+            [table appendBytes:&rule length:sizeof(rule)];
+        }
+        compiled[keys[k]] = [list copy];
+    }
+    // The patterns array keeps the UTF-8 buffers alive; the matcher copies them.
+    matcher = CatURLMatcherCreate(table.bytes, patterns.count);
+    rules = compiled;
+    return matcher != NULL;
+}
+
+- (BOOL) setWeights:(NSDictionary*)weights
+{
+    if(!isNumberDictionary(weights)) {
+        return NO;
+    }
+    NSMutableArray* types = [NSMutableArray array];
+    NSMutableArray* cumulative = [NSMutableArray array];
+    double total = 0;
+    for(NSString* type in [weights.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        double weight = [weights[type] doubleValue];
+        if(weight > 0) {
+            total += weight;
+            [types addObject:type];
+            [cumulative addObject:@(total)];
+        }
+    }
+    if(!types.count) {
+        return NO;
+    }
+    _typeWeights = [weights copy];
+    weightedTypes = types;
+    cumulativeWeights = cumulative;
+    totalWeight = total;
+    return YES;
+}
+
+- (CatInterceptConfig*) configWithEnabled:(BOOL)enabled
+{
+    NSMutableDictionary* dictionary = [[self dictionaryRepresentation] mutableCopy];
+    dictionary[CatInterceptEnabledKey] = @(enabled);
+    CatInterceptConfig* config = [[CatInterceptConfig alloc] initWithDictionary:dictionary];
+    config->decisions = decisions;
+    return config;
+}
+
+- (NSDictionary*) dictionaryRepresentation
+{
+    NSMutableDictionary* dictionary = [rules mutableCopy];
+    dictionary[CatInterceptEnabledKey] = @(_enabled);
+    dictionary[CatInterceptTypeWeightsKey] = _typeWeights;
+    dictionary[CatInterceptOriginKey] = _originURL.absoluteString;
+    dictionary[CatInterceptFormatBudgetKey] = _formatBudget;
+    return dictionary;
+}
+
+- (const CatURLMatcher*) matcher
+{
+    return matcher;
+}
+
+- (NSURL*) originURLForType:(NSString*)type
+{
+    NSString* origin = _originURL.absoluteString;
+    NSString* separator = _originURL.query ? @"&" : @"?";
+    return [NSURL URLWithString:[origin stringByAppendingFormat:@"%@type=%@", separator, type]];
+}
+
+- (void) countDecision:(BOOL)intercepted rule:(int)rule
+{
+    int64_t* counts = decisions.mutableBytes;
+    OSAtomicIncrement64(&counts[(rule + 1) * 2 + (intercepted ? 0 : 1)]);
+}
+
+- (NSDictionary*) decisionCounts
+{
+    static const char* kindNames[] = { "extension", "scheme", "substring", "exclude", "denyHost", "allowHost" };
+    const int64_t* counts = decisions.bytes;
+    NSMutableDictionary* result = [NSMutableDictionary dictionary];
+    for(size_t slot=0; slot<=CatURLMatcherRuleCount(matcher); slot++) {
+        if(!counts[slot*2] && !counts[slot*2+1]) {
+            continue;
+        }
+        NSString* label = @"none";
+        if(slot) {
+            const CatURLRule* rule = CatURLMatcherRuleAt(matcher, slot-1);
+            label = [NSString stringWithFormat:@"%s:%s", kindNames[rule->kind], rule->pattern];
+        }
+        result[label] = @{ @"intercepted": @(counts[slot*2]), @"passed": @(counts[slot*2+1]) };
+    }
+    return result;
+}
+
+- (NSString*) randomType
+{
+    double pick = totalWeight * arc4random() / ((double)UINT32_MAX + 1);
+    for(NSUInteger i=0; i<weightedTypes.count; i++) {
+        if(pick < [cumulativeWeights[i] doubleValue]) {
+            return weightedTypes[i];
+        }
+    }
+    return weightedTypes.lastObject;
+}
+
+@end
@@ -0,0 +1,49 @@
+//
+//  CatMemoryManager.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/2/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  One place for every in-memory cache to be measured and emptied. A cache
+//  registers a cost block, telling the bytes it holds, and a purge block,
+//  in a tier saying how dear it is to rebuild. On memory pressure tiers
+//  are purged cheapest first, until what the purgeable caches still hold
+//  is under targetBytes; the first tier always goes. A cache without a
+//  purge block is only reported, and doesn't count against the target. Blocks run on the thread that calls in, the main thread for
+//  memory warnings.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef enum {
+    CatMemoryTierDisposable,    // rebuilt for free or from disk
+    CatMemoryTierCache,         // rebuilt with work: decoding, fetching
+    CatMemoryTierWorkingSet,    // in use; purged last
+    CatMemoryTierCount
+} CatMemoryTier;
+
+typedef unsigned long long (^CatMemoryCost)(void);
+typedef void (^CatMemoryPurge)(void);
+
+@interface CatMemoryManager : NSObject
+
++ (CatMemoryManager*) sharedManager;
+
+// Returns a token for unregisterCache:. Names need not be unique.
+- (id) registerCacheNamed:(NSString*)name tier:(CatMemoryTier)tier cost:(CatMemoryCost)cost purge:(CatMemoryPurge)purge;
+- (void) unregisterCache:(id)token;
+
+// Returns the bytes freed.
+- (unsigned long long) handleMemoryPressure;
+- (unsigned long long) purgeThroughTier:(CatMemoryTier)tier;
+
+// name -> bytes, summed over caches of the same name.
+- (NSDictionary*) residentBytes;
+@property (readonly) unsigned long long totalResidentBytes;
+
+@property unsigned long long targetBytes;       // default 4MB
+@property (readonly) NSUInteger pressureEvents;
+@property (readonly) unsigned long long bytesFreed;
+
+@end
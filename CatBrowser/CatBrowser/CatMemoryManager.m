@@ -0,0 +1,156 @@
+//
+//  CatMemoryManager.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/2/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatMemoryManager.h"
+
+static const unsigned long long kDefaultTargetBytes = 4 * 1024 * 1024;
+
+@interface CatMemoryRegistration : NSObject
+{
+@package
+    NSString* name;
+    CatMemoryTier tier;
+    CatMemoryCost cost;
+    CatMemoryPurge purge;
+}
+@end
+
+@implementation CatMemoryRegistration
+@end
+
+@implementation CatMemoryManager
+{
+    NSMutableArray* registrations;
+}
+
++ (CatMemoryManager*) sharedManager
+{
+    static CatMemoryManager* sharedManager = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedManager = [[CatMemoryManager alloc] init];
+    });
+    return sharedManager;
+}
+
+- (id) init
+{
+    if(self = [super init]) {
+        registrations = [NSMutableArray array];
+        _targetBytes = kDefaultTargetBytes;
+    }
+    return self;
+}
+
+- (id) registerCacheNamed:(NSString*)name tier:(CatMemoryTier)tier cost:(CatMemoryCost)cost purge:(CatMemoryPurge)purge
+{
+    CatMemoryRegistration* registration = [[CatMemoryRegistration alloc] init];
+    registration->name = [name copy];
+    registration->tier = tier;
+    registration->cost = [cost copy];
+    registration->purge = [purge copy];
+    @synchronized(self) {
+        [registrations addObject:registration];
+    }
+    return registration;
+}
+
+- (void) unregisterCache:(id)token
+{
+    @synchronized(self) {
+        [registrations removeObjectIdenticalTo:token];
+    }
+}
+
+// Blocks are called outside the lock: a purge may unregister.
+- (NSArray*) registrations
+{
+    @synchronized(self) {
+        return [registrations copy];
+    }
+}
+
+static unsigned long long totalCost(NSArray* list, BOOL purgeableOnly)
+{
+    unsigned long long total = 0;
+    for(CatMemoryRegistration* registration in list) {
+        if(purgeableOnly && !registration->purge) {
+            continue;
+        }
+        total += registration->cost ? registration->cost() : 0;
+    }
+    return total;
+}
+
+- (unsigned long long) purgeTier:(CatMemoryTier)tier of:(NSArray*)list
+{
+    unsigned long long freed = 0;
+    for(CatMemoryRegistration* registration in list) {
+        if(registration->tier != tier || !registration->purge) {
+            continue;
+        }
+        unsigned long long before = registration->cost ? registration->cost() : 0;
+        registration->purge();
+        unsigned long long after = registration->cost ? registration->cost() : 0;
+        freed += before > after ? before - after : 0;
+    }
+    return freed;
+}
+
+- (unsigned long long) purgeThroughTier:(CatMemoryTier)lastTier
+{
+    NSArray* list = [self registrations];
+    unsigned long long freed = 0;
+    for(CatMemoryTier tier=0; tier<=lastTier && tier<CatMemoryTierCount; tier++) {
+        freed += [self purgeTier:tier of:list];
+    }
+    [self noteFreed:freed];
+    return freed;
+}
+
+- (unsigned long long) handleMemoryPressure
+{
+    NSArray* list = [self registrations];
+    unsigned long long freed = 0;
+    for(CatMemoryTier tier=0; tier<CatMemoryTierCount; tier++) {
+        // Report-only caches don't count: no purge would bring them under the target.
+        if(tier > 0 && totalCost(list, YES) <= self.targetBytes) {
+            break;
+        }
+        freed += [self purgeTier:tier of:list];
+    }
+    @synchronized(self) {
+        _pressureEvents++;
+    }
+    [self noteFreed:freed];
+    return freed;
+}
+
+- (void) noteFreed:(unsigned long long)freed
+{
+    @synchronized(self) {
+        _bytesFreed += freed;
+    }
+}
+
+- (NSDictionary*) residentBytes
+{
+    NSMutableDictionary* bytes = [NSMutableDictionary dictionary];
+    for(CatMemoryRegistration* registration in [self registrations]) {
+        unsigned long long cost = registration->cost ? registration->cost() : 0;
+        bytes[registration->name] = @([bytes[registration->name] unsignedLongLongValue] + cost);
+    }
+    return bytes;
+}
+
+- (unsigned long long) totalResidentBytes
+{
+    return totalCost([self registrations], NO);
+}
+
+@end
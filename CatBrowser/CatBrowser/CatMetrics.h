@@ -0,0 +1,64 @@
+//
+//  CatMetrics.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/19/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Process wide instrumentation of the interception path. Recording is a
+//  C call into a lock free histogram, so it can stay on in release builds;
+//  reading is a snapshot for logs, tests and the debug overlay.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef enum {
+    CatMetricClassification,    // canInitWithRequest:, ns
+    CatMetricSetup,             // initWithRequest:cachedResponse:client:, ns
+    CatMetricFirstByte,         // startLoading to the first byte handed to WebKit, ns
+    CatMetricFetch,             // startLoading to the end of the response, ns
+    CatMetricBytes,             // bytes delivered per replaced request
+    CatMetricSnapshot,          // bookmark thumbnail rendering on the main thread, ns
+    CatMetricSnapshotProcess,   // bookmark thumbnail filtering, hashing and imaging off it, ns
+    CatMetricBridgeAvoided,     // page state reads answered from the cache, per page
+    CatMetricCount
+} CatMetric;
+
+typedef enum {
+    CatCounterPool,             // served from the in-memory pool
+    CatCounterStore,            // served from the disk store
+    CatCounterNetwork,          // fetched from the origin
+    CatCounterFailed,           // origin fetch failed
+    CatCounterDisabled,         // requests seen while cats were switched off
+    CatCounterSearchLoads,      // address bar searches loaded
+    CatCounterSearchAvoided,    // address bar searches superseded before loading
+    CatCounterSnapshotPublished,    // bookmark thumbnails that changed
+    CatCounterSnapshotUnchanged,    // rendered, same tiles as before
+    CatCounterSnapshotSkipped,      // ticks skipped on an idle page
+    CatCounterBridgeCalls,      // JavaScript evaluations reading the page state
+    CatCounterBridgeAvoided,    // page state reads answered from the cache
+    CatCounterBookmarkRecords,  // bookmark changes journaled
+    CatCounterBookmarkCommits,  // journal writes, each synced once
+    CatCounterCount
+} CatCounter;
+
+// Monotonic clock in nanoseconds.
+uint64_t CatMetricsNow(void);
+void CatMetricsRecord(CatMetric metric, uint64_t value);
+void CatMetricsCount(CatCounter counter);
+
+@interface CatMetrics : NSObject
+
+// @{ metric name: @{count, mean, p50, p90, p99, max}, @"counters": @{...},
+//    @"rules": decisions of the current config by rule,
+//    @"decisionCache": CatURLProtocol decisionCacheStats,
+//    @"redirects": CatRedirectCache counts and round trips saved,
+//    @"gifs": CatGIFDowngrader mode, gifs transcoded and decoded bytes saved }
++ (NSDictionary*) snapshot;
+// A few lines for the debug overlay.
++ (NSString*) summary;
++ (void) reset;
+
++ (NSString*) nameForMetric:(CatMetric)metric;
+
+@end
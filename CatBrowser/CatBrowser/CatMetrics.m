@@ -0,0 +1,170 @@
+//
+//  CatMetrics.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/19/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatMetrics.h"
+#import "CatHistogram.h"
+#import "CatInterceptConfig.h"
+#import "CatURLProtocol.h"
+#import "CatReplacementLoader.h"
+#import "CatRedirectCache.h"
+#import "CatGIFDowngrader.h"
+#import "CatMemoryManager.h"
+#import <libkern/OSAtomic.h>
+#include <mach/mach_time.h>
+
+static CatHistogram histograms[CatMetricCount];
+static volatile int64_t counters[CatCounterCount];
+
+uint64_t CatMetricsNow(void)
+{
+    static mach_timebase_info_data_t timebase;
+    if(!timebase.denom) {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+void CatMetricsRecord(CatMetric metric, uint64_t value)
+{
+    CatHistogramRecord(&histograms[metric], value);
+}
+
+void CatMetricsCount(CatCounter counter)
+{
+    OSAtomicIncrement64(&counters[counter]);
+}
+
+@implementation CatMetrics
+
++ (NSString*) nameForMetric:(CatMetric)metric
+{
+    static NSString* names[] = { @"classification", @"setup", @"firstByte", @"fetch", @"bytes", @"snapshot", @"snapshotProcess", @"bridgeAvoided" };
+    return names[metric];
+}
+
++ (NSString*) nameForCounter:(CatCounter)counter
+{
+    static NSString* names[] = { @"pool", @"store", @"network", @"failed", @"disabled", @"searches", @"searchesAvoided",
+                              @"snapshots", @"snapshotsUnchanged", @"snapshotsSkipped", @"bridgeCalls", @"bridgeAvoided",
+                              @"bookmarkRecords", @"bookmarkCommits" };
+    return names[counter];
+}
+
++ (NSDictionary*) snapshot
+{
+    NSMutableDictionary* snapshot = [NSMutableDictionary dictionary];
+    for(int m=0; m<CatMetricCount; m++) {
+        const CatHistogram* histogram = &histograms[m];
+        snapshot[[self nameForMetric:m]] = @{
+            @"count": @(histogram->count),
+            @"mean": @(CatHistogramMean(histogram)),
+            @"p50": @(CatHistogramPercentile(histogram, .5)),
+            @"p90": @(CatHistogramPercentile(histogram, .9)),
+            @"p99": @(CatHistogramPercentile(histogram, .99)),
+            @"max": @(histogram->max),
+        };
+    }
+    NSMutableDictionary* counts = [NSMutableDictionary dictionary];
+    for(int c=0; c<CatCounterCount; c++) {
+        counts[[self nameForCounter:c]] = @(counters[c]);
+    }
+    counts[@"cancelled"] = @([CatReplacementLoader cancelledRequests]);
+    snapshot[@"counters"] = counts;
+    snapshot[@"rules"] = [[CatURLProtocol config] decisionCounts];
+    snapshot[@"decisionCache"] = [CatURLProtocol decisionCacheStats];
+    CatRedirectCache* redirects = [CatRedirectCache sharedCache];
+    snapshot[@"redirects"] = @{
+        @"known": @(redirects.count),
+        @"hits": @(redirects.hits),
+        @"misses": @(redirects.misses),
+        @"expired": @(redirects.expirations),
+        @"saved": @(redirects.roundTripsSaved),
+        @"pageSaved": @(redirects.pageRoundTripsSaved),
+    };
+    CatGIFDowngrader* gifs = [CatGIFDowngrader sharedDowngrader];
+    snapshot[@"gifs"] = @{
+        @"mode": @(gifs.activeMode),
+        @"transcoded": @(gifs.transcodedImages),
+        @"bytesSaved": @(gifs.bytesSaved),
+    };
+    CatMemoryManager* memory = [CatMemoryManager sharedManager];
+    snapshot[@"memory"] = @{
+        @"resident": [memory residentBytes],
+        @"pressureEvents": @(memory.pressureEvents),
+        @"bytesFreed": @(memory.bytesFreed),
+    };
+    return snapshot;
+}
+
+static NSString* formatDuration(uint64_t ns)
+{
+    if(ns < 1000) {
+        return [NSString stringWithFormat:@"%lluns", ns];
+    }
+    if(ns < 1000000) {
+        return [NSString stringWithFormat:@"%.1fus", ns / 1e3];
+    }
+    return [NSString stringWithFormat:@"%.1fms", ns / 1e6];
+}
+
++ (NSString*) summary
+{
+    NSMutableString* summary = [NSMutableString string];
+    for(int m=0; m<CatMetricBytes; m++) {
+        const CatHistogram* histogram = &histograms[m];
+        [summary appendFormat:@"%@ p50 %@ p99 %@ (%llu)\n", [self nameForMetric:m],
+         formatDuration(CatHistogramPercentile(histogram, .5)), formatDuration(CatHistogramPercentile(histogram, .99)), histogram->count];
+    }
+    [summary appendFormat:@"bytes p50 %lluKB total %lluKB\n", CatHistogramPercentile(&histograms[CatMetricBytes], .5) / 1024, histograms[CatMetricBytes].sum / 1024];
+
+    long long intercepted = 0, passed = 0;
+    for(NSDictionary* counts in [[[CatURLProtocol config] decisionCounts] allValues]) {
+        intercepted += [counts[@"intercepted"] longLongValue];
+        passed += [counts[@"passed"] longLongValue];
+    }
+    NSDictionary* decisions = [CatURLProtocol decisionCacheStats];
+    [summary appendFormat:@"decision cache %.0f%% of %llu\n", [decisions[@"hitRate"] doubleValue] * 100,
+     [decisions[@"hits"] unsignedLongLongValue] + [decisions[@"misses"] unsignedLongLongValue]];
+    [summary appendFormat:@"cats %lld pass %lld | pool %lld store %lld net %lld fail %lld\n",
+     intercepted, passed, counters[CatCounterPool], counters[CatCounterStore], counters[CatCounterNetwork], counters[CatCounterFailed]];
+    CatRedirectCache* redirects = [CatRedirectCache sharedCache];
+    [summary appendFormat:@"redirects %lu known, saved %lu this page (%lu cats), %lu total",
+     (unsigned long)redirects.count, (unsigned long)redirects.pageRoundTripsSaved, (unsigned long)redirects.pageInterceptions, (unsigned long)redirects.roundTripsSaved];
+    [summary appendFormat:@"\nsearches %lld loaded, %lld avoided", counters[CatCounterSearchLoads], counters[CatCounterSearchAvoided]];
+    CatGIFDowngrader* gifs = [CatGIFDowngrader sharedDowngrader];
+    [summary appendFormat:@"\ngifs mode %d, %lu downgraded, saved %lluKB decoded",
+     gifs.activeMode, (unsigned long)gifs.transcodedImages, gifs.bytesSaved / 1024];
+    [summary appendFormat:@"\nsnapshots %lld published, %lld unchanged, %lld skipped, p50 %@ main %@ queue",
+     counters[CatCounterSnapshotPublished], counters[CatCounterSnapshotUnchanged], counters[CatCounterSnapshotSkipped],
+     formatDuration(CatHistogramPercentile(&histograms[CatMetricSnapshot], .5)),
+     formatDuration(CatHistogramPercentile(&histograms[CatMetricSnapshotProcess], .5))];
+    [summary appendFormat:@"\nbridge %lld calls, %lld avoided, p50 %llu per page",
+     counters[CatCounterBridgeCalls], counters[CatCounterBridgeAvoided], CatHistogramPercentile(&histograms[CatMetricBridgeAvoided], .5)];
+    [summary appendFormat:@"\nbookmarks %lld changes in %lld writes",
+     counters[CatCounterBookmarkRecords], counters[CatCounterBookmarkCommits]];
+    CatMemoryManager* memory = [CatMemoryManager sharedManager];
+    [summary appendFormat:@"\nmemory %lluKB in caches, %lu warnings freed %lluKB",
+     memory.totalResidentBytes / 1024, (unsigned long)memory.pressureEvents, memory.bytesFreed / 1024];
+    return summary;
+}
+
++ (void) reset
+{
+    for(int m=0; m<CatMetricCount; m++) {
+        CatHistogramReset(&histograms[m]);
+    }
+    for(int c=0; c<CatCounterCount; c++) {
+        int64_t value;
+        do {
+            value = counters[c];
+        } while(!OSAtomicCompareAndSwap64Barrier(value, 0, &counters[c]));
+    }
+    [CatURLProtocol resetDecisionCacheStats];
+}
+
+@end
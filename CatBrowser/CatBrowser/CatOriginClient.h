@@ -0,0 +1,67 @@
+//
+//  CatOriginClient.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/22/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  HTTP/1.1 client for the replacement origin. It keeps a bounded pool of
+//  persistent connections per host, so a burst of replacement fetches pays
+//  for a few TCP handshakes instead of one per image. Requests can be
+//  pipelined. Connections idle for longer than idleTimeout are closed.
+//  Only plain http GET is supported; anything else goes to NSURLConnection.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef void (^CatOriginResponseBlock)(NSHTTPURLResponse* response);
+typedef void (^CatOriginDataBlock)(NSData* data);
+typedef void (^CatOriginCompletionBlock)(NSError* error);
+
+@interface CatOriginTask : NSObject
+
+// No callback starts after this returns.
+- (void) cancel;
+
+@property (readonly) NSURLRequest* request;
+// Current URL, after redirects.
+@property (readonly) NSURL* URL;
+@property (readonly) NSUInteger redirects;
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+@end
+
+@interface CatOriginClient : NSObject
+
++ (BOOL) canFetchRequest:(NSURLRequest*)request;
+
+// Redirects are followed. The response, then the body chunks, then the
+// completion are delivered in order on delegateQueue; the completion gets
+// nil on success. A redirect to a URL this client cannot fetch, https
+// for one, completes with NSURLErrorUnsupportedURL and the task's URL set
+// to the target, for the caller to go on some other way.
+- (CatOriginTask*) fetchRequest:(NSURLRequest*)request
+                       response:(CatOriginResponseBlock)response
+                           data:(CatOriginDataBlock)data
+                     completion:(CatOriginCompletionBlock)completion;
+
+- (void) closeIdleConnections;
+
+@property NSOperationQueue* delegateQueue;     // default: a serial queue of its own
+@property NSUInteger maxConnectionsPerHost;     // default 4
+@property NSUInteger pipelineDepth;             // requests in flight per connection, default 1
+@property NSTimeInterval idleTimeout;           // default 15s
+@property NSTimeInterval timeout;               // without any byte from the server, default 30s
+@property NSUInteger maxRedirects;              // default 5
+// NO sends Connection: close and opens a connection per request.
+@property BOOL reuseConnections;
+
+// One dictionary per open connection: host, requests, bytesIn, bytesOut,
+// inFlight, age and idle (seconds).
+- (NSArray*) connectionStats;
+@property (readonly) NSUInteger connectionsOpened;
+@property (readonly) NSUInteger requestsSent;
+@property (readonly) NSUInteger reusedRequests;     // sent on a connection that had served one before
+@property (readonly) NSUInteger retriedRequests;    // resent after a reused connection dropped
+
+@end
@@ -0,0 +1,693 @@
+//
+//  CatOriginClient.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/22/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatOriginClient.h"
+#import "CatHTTPParser.h"
+#include <sys/socket.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+@class CatOriginConnection;
+
+@interface CatOriginClient ()
+- (void) cancelTask:(CatOriginTask*)task;
+@end
+
+@interface CatOriginTask ()
+@property (readwrite) NSURLRequest* request;
+@property (readwrite) NSURL* URL;
+@property (readwrite) NSUInteger redirects;
+@property (readwrite, getter=isCancelled) BOOL cancelled;
+@end
+
+@implementation CatOriginTask
+{
+@package
+    __weak CatOriginClient* client;
+    CatOriginConnection* connection;
+    CatOriginResponseBlock responseBlock;
+    CatOriginDataBlock dataBlock;
+    CatOriginCompletionBlock completionBlock;
+    NSURL* redirectURL;
+    BOOL receivedHead;
+    BOOL retried;
+}
+
+- (void) cancel
+{
+    self.cancelled = YES;
+    [client cancelTask:self];
+}
+
+@end
+
+// Everything below runs on the client queue.
+@interface CatOriginConnection : NSObject
+{
+@package
+    __weak CatOriginClient* client;
+    NSString* key;
+    NSString* host;
+    int port;
+    int fd;
+    dispatch_source_t readSource;
+    dispatch_source_t writeSource;
+    BOOL writing;
+    BOOL connected;
+    BOOL closed;
+    BOOL reusable;
+    BOOL messageComplete;
+    NSMutableData* output;
+    CatHTTPParser* parser;
+    NSMutableArray* inFlight;
+    NSUInteger requests;
+    unsigned long long bytesIn;
+    unsigned long long bytesOut;
+    CFAbsoluteTime created;
+    CFAbsoluteTime lastActivity;
+}
+@end
+
+@implementation CatOriginConnection
+
+- (void) dealloc
+{
+    free(parser);
+}
+
+@end
+
+@interface CatOriginClient ()
+- (void) task:(CatOriginTask*)task didReceiveStatus:(int)status head:(const char*)head length:(size_t)length;
+- (void) task:(CatOriginTask*)task didReceiveBody:(const char*)bytes length:(size_t)length;
+@end
+
+static void CatOriginOnHead(void* context, int status, const char* head, size_t length)
+{
+    CatOriginConnection* connection = (__bridge CatOriginConnection*)context;
+    [connection->client task:connection->inFlight.firstObject didReceiveStatus:status head:head length:length];
+}
+
+static void CatOriginOnBody(void* context, const char* bytes, size_t length)
+{
+    CatOriginConnection* connection = (__bridge CatOriginConnection*)context;
+    [connection->client task:connection->inFlight.firstObject didReceiveBody:bytes length:length];
+}
+
+static void CatOriginOnComplete(void* context)
+{
+    // Acted on once the parser returns, so the connection is never torn down under it.
+    CatOriginConnection* connection = (__bridge CatOriginConnection*)context;
+    connection->messageComplete = YES;
+}
+
+// Non blocking connect with a timeout. Returns the socket or -1.
+static int CatOriginConnect(const char* host, int port, int timeoutMilliseconds)
+{
+    struct addrinfo hints, *addresses = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%d", port);
+    if(getaddrinfo(host, service, &hints, &addresses) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for(struct addrinfo* address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if(fd < 0) {
+            continue;
+        }
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        if(connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        int error = errno;
+        if(error == EINPROGRESS) {
+            struct pollfd pending = { fd, POLLOUT, 0 };
+            socklen_t length = sizeof(error);
+            if(poll(&pending, 1, timeoutMilliseconds) == 1
+               && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+                break;
+            }
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+static NSError* CatOriginError(NSInteger code, NSURL* url)
+{
+    return [NSError errorWithDomain:NSURLErrorDomain code:code userInfo:url ? @{NSURLErrorFailingURLErrorKey: url} : nil];
+}
+
+@implementation CatOriginClient
+{
+    dispatch_queue_t queue;
+    dispatch_source_t timer;
+    NSMutableDictionary* connections;   // host:port -> NSMutableArray of CatOriginConnection
+    NSMutableDictionary* pending;       // host:port -> NSMutableArray of CatOriginTask
+}
+
++ (BOOL) canFetchRequest:(NSURLRequest*)request
+{
+    return [request.URL.scheme caseInsensitiveCompare:@"http"] == NSOrderedSame
+        && request.URL.host.length
+        && (!request.HTTPMethod || [request.HTTPMethod isEqualToString:@"GET"]);
+}
+
+- (id) init
+{
+    if(self = [super init]) {
+        queue = dispatch_queue_create("com.dobuki.CatBrowser.origin", DISPATCH_QUEUE_SERIAL);
+        connections = [NSMutableDictionary dictionary];
+        pending = [NSMutableDictionary dictionary];
+        _delegateQueue = [[NSOperationQueue alloc] init];
+        _delegateQueue.name = @"com.dobuki.CatBrowser.origin.delegate";
+        _delegateQueue.maxConcurrentOperationCount = 1;
+        _maxConnectionsPerHost = 4;
+        _pipelineDepth = 1;
+        _idleTimeout = 15;
+        _timeout = 30;
+        _maxRedirects = 5;
+        _reuseConnections = YES;
+
+        timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC), NSEC_PER_SEC, NSEC_PER_SEC / 4);
+        __weak CatOriginClient* weakSelf = self;
+        dispatch_source_set_event_handler(timer, ^{
+            [weakSelf expireConnections];
+        });
+        dispatch_resume(timer);
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    dispatch_source_cancel(timer);
+    for(NSArray* list in connections.allValues) {
+        for(CatOriginConnection* connection in list) {
+            [self teardown:connection];
+        }
+    }
+}
+
+- (CatOriginTask*) fetchRequest:(NSURLRequest*)request
+                       response:(CatOriginResponseBlock)response
+                           data:(CatOriginDataBlock)data
+                     completion:(CatOriginCompletionBlock)completion
+{
+    CatOriginTask* task = [[CatOriginTask alloc] init];
+    task->client = self;
+    task->responseBlock = response;
+    task->dataBlock = data;
+    task->completionBlock = completion;
+    task.request = request;
+    task.URL = request.URL;
+    dispatch_async(queue, ^{
+        [self enqueue:task];
+    });
+    return task;
+}
+
+- (void) cancelTask:(CatOriginTask*)task
+{
+    dispatch_async(queue, ^{
+        NSString* key = [self keyForURL:task.URL];
+        [pending[key] removeObjectIdenticalTo:task];
+        CatOriginConnection* connection = task->connection;
+        if(connection && connection->inFlight.firstObject == task && task->receivedHead) {
+            // Its response is on the wire; the only way to stop it is to hang up.
+            [connection->inFlight removeObjectAtIndex:0];
+            [self close:connection error:nil];
+        }
+        // Otherwise the response is read and dropped when its turn comes.
+        [self releaseBlocks:task];
+    });
+}
+
+#pragma mark Scheduling
+
+- (NSString*) keyForURL:(NSURL*)url
+{
+    return [NSString stringWithFormat:@"%@:%d", url.host.lowercaseString, url.port ? url.port.intValue : 80];
+}
+
+- (void) enqueue:(CatOriginTask*)task
+{
+    if(task.cancelled) {
+        return;
+    }
+    if(![CatOriginClient canFetchRequest:[NSURLRequest requestWithURL:task.URL]]) {
+        [self complete:task error:CatOriginError(NSURLErrorUnsupportedURL, task.URL)];
+        return;
+    }
+    NSString* key = [self keyForURL:task.URL];
+    NSMutableArray* queued = pending[key];
+    if(!queued) {
+        queued = pending[key] = [NSMutableArray array];
+    }
+    [queued addObject:task];
+    [self dispatchPendingForKey:key];
+}
+
+- (void) dispatchPendingForKey:(NSString*)key
+{
+    NSMutableArray* queued = pending[key];
+    while(queued.count) {
+        CatOriginConnection* connection = [self connectionForKey:key URL:[queued.firstObject URL]];
+        if(!connection) {
+            return;
+        }
+        CatOriginTask* task = queued.firstObject;
+        [queued removeObjectAtIndex:0];
+        [self send:task on:connection];
+    }
+}
+
+- (CatOriginConnection*) connectionForKey:(NSString*)key URL:(NSURL*)url
+{
+    NSMutableArray* list = connections[key];
+    for(CatOriginConnection* connection in list) {
+        if(!connection->inFlight.count && connection->reusable) {
+            return connection;
+        }
+    }
+    if(list.count < MAX(1, _maxConnectionsPerHost)) {
+        return [self open:key URL:url];
+    }
+    if(_pipelineDepth > 1 && _reuseConnections) {
+        CatOriginConnection* best = nil;
+        for(CatOriginConnection* connection in list) {
+            // Pipeline only behind a connection known to stay open.
+            if(connection->reusable && connection->requests > connection->inFlight.count
+               && connection->inFlight.count < _pipelineDepth
+               && (!best || connection->inFlight.count < best->inFlight.count)) {
+                best = connection;
+            }
+        }
+        return best;
+    }
+    return nil;
+}
+
+- (void) send:(CatOriginTask*)task on:(CatOriginConnection*)connection
+{
+    task->connection = connection;
+    task->receivedHead = NO;
+    [connection->inFlight addObject:task];
+    connection->requests++;
+    _requestsSent++;
+    if(connection->requests > 1) {
+        _reusedRequests++;
+    }
+
+    NSURL* url = task.URL;
+    NSString* path = CFBridgingRelease(CFURLCopyPath((__bridge CFURLRef)url));
+    NSMutableString* head = [NSMutableString stringWithFormat:@"GET %@%@%@ HTTP/1.1\r\nHost: %@", path.length ? path : @"/",
+                             url.query ? @"?" : @"", url.query ?: @"", url.host];
+    if(connection->port != 80) {
+        [head appendFormat:@":%d", connection->port];
+    }
+    [head appendString:@"\r\n"];
+    [task.request.allHTTPHeaderFields enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSString* value, BOOL* stop) {
+        if([name caseInsensitiveCompare:@"Host"] != NSOrderedSame && [name caseInsensitiveCompare:@"Connection"] != NSOrderedSame) {
+            [head appendFormat:@"%@: %@\r\n", name, value];
+        }
+    }];
+    [head appendString:_reuseConnections ? @"Connection: keep-alive\r\n\r\n" : @"Connection: close\r\n\r\n"];
+    [connection->output appendData:[head dataUsingEncoding:NSUTF8StringEncoding]];
+    if(!_reuseConnections) {
+        connection->reusable = NO;
+    }
+    [self flush:connection];
+}
+
+#pragma mark Connections
+
+- (CatOriginConnection*) open:(NSString*)key URL:(NSURL*)url
+{
+    CatOriginConnection* connection = [[CatOriginConnection alloc] init];
+    connection->client = self;
+    connection->key = key;
+    connection->host = url.host;
+    connection->port = url.port ? url.port.intValue : 80;
+    connection->fd = -1;
+    connection->reusable = YES;
+    connection->output = [NSMutableData data];
+    connection->inFlight = [NSMutableArray array];
+    connection->created = connection->lastActivity = CFAbsoluteTimeGetCurrent();
+    connection->parser = malloc(sizeof(CatHTTPParser));
+    CatHTTPCallbacks callbacks = { CatOriginOnHead, CatOriginOnBody, CatOriginOnComplete };
+    CatHTTPParserInit(connection->parser, callbacks, (__bridge void*)connection);
+
+    NSMutableArray* list = connections[key];
+    if(!list) {
+        list = connections[key] = [NSMutableArray array];
+    }
+    [list addObject:connection];
+    _connectionsOpened++;
+
+    NSString* host = connection->host;
+    int port = connection->port;
+    int timeoutMilliseconds = (int)(_timeout * 1000);
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        int fd = CatOriginConnect(host.UTF8String, port, timeoutMilliseconds);
+        dispatch_async(queue, ^{
+            [self connection:connection didConnect:fd];
+        });
+    });
+    return connection;
+}
+
+- (void) connection:(CatOriginConnection*)connection didConnect:(int)fd
+{
+    if(connection->closed) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    if(fd < 0) {
+        for(CatOriginTask* task in connection->inFlight) {
+            task->retried = YES;    // the host is unreachable, a new connection would not help
+        }
+        [self close:connection error:CatOriginError(NSURLErrorCannotConnectToHost, [connection->inFlight.firstObject URL])];
+        return;
+    }
+    connection->fd = fd;
+    connection->connected = YES;
+    connection->lastActivity = CFAbsoluteTimeGetCurrent();
+
+    // The descriptor is closed once both sources are cancelled.
+    __block int sources = 2;
+    void (^release)(void) = ^{
+        if(--sources == 0) {
+            close(fd);
+        }
+    };
+    __weak CatOriginClient* weakSelf = self;
+    __weak CatOriginConnection* weakConnection = connection;
+    connection->readSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, queue);
+    dispatch_source_set_event_handler(connection->readSource, ^{
+        CatOriginConnection* strongConnection = weakConnection;
+        if(strongConnection) {
+            [weakSelf read:strongConnection];
+        }
+    });
+    dispatch_source_set_cancel_handler(connection->readSource, release);
+    connection->writeSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_WRITE, fd, 0, queue);
+    dispatch_source_set_event_handler(connection->writeSource, ^{
+        CatOriginConnection* strongConnection = weakConnection;
+        if(strongConnection) {
+            [weakSelf flush:strongConnection];
+        }
+    });
+    dispatch_source_set_cancel_handler(connection->writeSource, release);
+    dispatch_resume(connection->readSource);
+    [self flush:connection];
+}
+
+- (void) flush:(CatOriginConnection*)connection
+{
+    if(!connection->connected || connection->closed) {
+        return;
+    }
+    while(connection->output.length) {
+        ssize_t count = send(connection->fd, connection->output.bytes, connection->output.length, 0);
+        if(count > 0) {
+            connection->bytesOut += count;
+            [connection->output replaceBytesInRange:NSMakeRange(0, count) withBytes:NULL length:0];
+        }
+        else if(count < 0 && errno == EAGAIN) {
+            break;
+        }
+        else {
+            [self close:connection error:CatOriginError(NSURLErrorNetworkConnectionLost, [connection->inFlight.firstObject URL])];
+            return;
+        }
+    }
+    BOOL wantsWrite = connection->output.length > 0;
+    if(wantsWrite != connection->writing) {
+        connection->writing = wantsWrite;
+        wantsWrite ? dispatch_resume(connection->writeSource) : dispatch_suspend(connection->writeSource);
+    }
+}
+
+- (void) read:(CatOriginConnection*)connection
+{
+    char buffer[32 * 1024];
+    while(!connection->closed) {
+        ssize_t count = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if(count < 0 && errno == EAGAIN) {
+            return;
+        }
+        if(count <= 0) {
+            BOOL complete = CatHTTPParserFinish(connection->parser) == 0;
+            if(connection->messageComplete) {
+                connection->messageComplete = NO;
+                [self finishMessageOn:connection];
+            }
+            [self close:connection error:complete && !connection->inFlight.count ? nil
+                       : CatOriginError(NSURLErrorNetworkConnectionLost, [connection->inFlight.firstObject URL])];
+            return;
+        }
+        connection->bytesIn += count;
+        connection->lastActivity = CFAbsoluteTimeGetCurrent();
+        size_t offset = 0;
+        while(offset < (size_t)count && !connection->closed) {
+            if(!connection->inFlight.count) {
+                // Bytes nobody asked for.
+                [self close:connection error:nil];
+                return;
+            }
+            long used = CatHTTPParserFeed(connection->parser, buffer + offset, count - offset);
+            if(used < 0) {
+                CatOriginTask* task = connection->inFlight.firstObject;
+                task->retried = YES;
+                [self close:connection error:CatOriginError(NSURLErrorBadServerResponse, task.URL)];
+                return;
+            }
+            offset += used;
+            if(connection->messageComplete) {
+                connection->messageComplete = NO;
+                [self finishMessageOn:connection];
+            }
+        }
+    }
+}
+
+- (void) finishMessageOn:(CatOriginConnection*)connection
+{
+    CatOriginTask* task = connection->inFlight.firstObject;
+    [connection->inFlight removeObjectAtIndex:0];
+    task->connection = nil;
+    connection->reusable = connection->reusable && connection->parser->keepAlive;
+    CatHTTPParserReset(connection->parser);
+
+    if(task->redirectURL && !task.cancelled) {
+        task.URL = task->redirectURL;
+        task.redirects++;
+        task->redirectURL = nil;
+        task->retried = NO;
+        [self enqueue:task];
+    }
+    else {
+        [self complete:task error:nil];
+    }
+
+    if(!connection->reusable && !connection->inFlight.count) {
+        [self close:connection error:nil];
+    }
+    else {
+        [self dispatchPendingForKey:connection->key];
+    }
+}
+
+// Tasks still waiting for their response are sent again on another
+// connection when nothing of theirs was received yet, once.
+- (void) close:(CatOriginConnection*)connection error:(NSError*)error
+{
+    if(connection->closed) {
+        return;
+    }
+    [self teardown:connection];
+    [connections[connection->key] removeObjectIdenticalTo:connection];
+
+    NSArray* orphans = connection->inFlight;
+    connection->inFlight = [NSMutableArray array];
+    for(CatOriginTask* task in orphans) {
+        task->connection = nil;
+        task->redirectURL = nil;
+        if(task.cancelled) {
+            continue;
+        }
+        if(!task->receivedHead && !task->retried) {
+            task->retried = YES;
+            _retriedRequests++;
+            [self enqueue:task];
+        }
+        else {
+            [self complete:task error:error ?: CatOriginError(NSURLErrorNetworkConnectionLost, task.URL)];
+        }
+    }
+    [self dispatchPendingForKey:connection->key];
+}
+
+- (void) teardown:(CatOriginConnection*)connection
+{
+    connection->closed = YES;
+    if(connection->readSource) {
+        if(!connection->writing) {
+            dispatch_resume(connection->writeSource);   // suspended sources cannot be cancelled
+        }
+        dispatch_source_cancel(connection->writeSource);
+        dispatch_source_cancel(connection->readSource);
+        connection->readSource = nil;
+        connection->writeSource = nil;
+    }
+}
+
+- (void) expireConnections
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for(NSArray* list in [connections.allValues copy]) {
+        for(CatOriginConnection* connection in [list copy]) {
+            CFAbsoluteTime quiet = now - connection->lastActivity;
+            if(!connection->inFlight.count && quiet > _idleTimeout) {
+                [self close:connection error:nil];
+            }
+            else if(connection->inFlight.count && quiet > _timeout) {
+                for(CatOriginTask* task in connection->inFlight) {
+                    task->retried = YES;
+                }
+                [self close:connection error:CatOriginError(NSURLErrorTimedOut, [connection->inFlight.firstObject URL])];
+            }
+        }
+    }
+}
+
+- (void) closeIdleConnections
+{
+    dispatch_async(queue, ^{
+        for(NSArray* list in [connections.allValues copy]) {
+            for(CatOriginConnection* connection in [list copy]) {
+                if(!connection->inFlight.count) {
+                    [self close:connection error:nil];
+                }
+            }
+        }
+    });
+}
+
+- (NSArray*) connectionStats
+{
+    NSMutableArray* stats = [NSMutableArray array];
+    dispatch_sync(queue, ^{
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        for(NSArray* list in connections.allValues) {
+            for(CatOriginConnection* connection in list) {
+                [stats addObject:@{
+                    @"host": connection->key,
+                    @"requests": @(connection->requests),
+                    @"bytesIn": @(connection->bytesIn),
+                    @"bytesOut": @(connection->bytesOut),
+                    @"inFlight": @(connection->inFlight.count),
+                    @"age": @(now - connection->created),
+                    @"idle": @(connection->inFlight.count ? 0 : now - connection->lastActivity),
+                }];
+            }
+        }
+    });
+    return stats;
+}
+
+#pragma mark Responses
+
+static BOOL isRedirect(int status)
+{
+    return status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+}
+
+- (void) task:(CatOriginTask*)task didReceiveStatus:(int)status head:(const char*)head length:(size_t)length
+{
+    task->receivedHead = YES;
+    NSString* text = [[NSString alloc] initWithBytes:head length:length encoding:NSISOLatin1StringEncoding];
+    NSMutableDictionary* fields = [NSMutableDictionary dictionary];
+    // Like the parser, take a bare LF as a line end.
+    NSArray* lines = [text componentsSeparatedByString:@"\n"];
+    for(NSUInteger i=1; i<lines.count; i++) {
+        NSString* line = [lines[i] hasSuffix:@"\r"] ? [lines[i] substringToIndex:[lines[i] length] - 1] : lines[i];
+        NSRange colon = [line rangeOfString:@":"];
+        if(colon.location == NSNotFound) {
+            continue;
+        }
+        NSString* name = [line substringToIndex:colon.location];
+        NSString* value = [[line substringFromIndex:colon.location+1] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        fields[name] = fields[name] ? [NSString stringWithFormat:@"%@, %@", fields[name], value] : value;
+    }
+
+    NSString* location = fields[@"Location"] ?: fields[@"location"];
+    if(isRedirect(status) && location && task.redirects < _maxRedirects) {
+        task->redirectURL = [NSURL URLWithString:location relativeToURL:task.URL].absoluteURL;
+        return;
+    }
+    NSHTTPURLResponse* response = [[NSHTTPURLResponse alloc] initWithURL:task.URL statusCode:status HTTPVersion:@"HTTP/1.1" headerFields:fields];
+    CatOriginResponseBlock block = task->responseBlock;
+    if(block) {
+        [_delegateQueue addOperationWithBlock:^{
+            if(!task.cancelled) {
+                block(response);
+            }
+        }];
+    }
+}
+
+- (void) task:(CatOriginTask*)task didReceiveBody:(const char*)bytes length:(size_t)length
+{
+    CatOriginDataBlock block = task->dataBlock;
+    if(task->redirectURL || !block || task.cancelled) {
+        return;
+    }
+    NSData* data = [NSData dataWithBytes:bytes length:length];
+    [_delegateQueue addOperationWithBlock:^{
+        if(!task.cancelled) {
+            block(data);
+        }
+    }];
+}
+
+- (void) complete:(CatOriginTask*)task error:(NSError*)error
+{
+    CatOriginCompletionBlock block = task->completionBlock;
+    [self releaseBlocks:task];
+    if(block) {
+        [_delegateQueue addOperationWithBlock:^{
+            if(!task.cancelled) {
+                block(error);
+            }
+        }];
+    }
+}
+
+- (void) releaseBlocks:(CatOriginTask*)task
+{
+    task->responseBlock = nil;
+    task->dataBlock = nil;
+    task->completionBlock = nil;
+}
+
+@end
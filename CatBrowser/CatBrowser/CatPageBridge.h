@@ -0,0 +1,46 @@
+//
+//  CatPageBridge.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/1/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  What the browser reads from the page, in one JavaScript evaluation.
+//  Every stringByEvaluatingJavaScriptFromString: is a synchronous round
+//  trip into WebKit, so title, location, scroll metrics and image count
+//  come back together as one JSON record, cached until the next load
+//  event. Calls answered from the cache are counted as avoided.
+//
+
+#import <UIKit/UIKit.h>
+
+@interface CatPageState : NSObject
+
+// A record as returned by the bridge script. Missing fields are empty.
++ (CatPageState*) stateWithRecord:(NSString*)record;
+
+@property (readonly) NSString* title;
+@property (readonly) NSString* location;
+@property (readonly) CGFloat scrollY;           // at the time of the evaluation
+@property (readonly) CGFloat scrollHeight;
+@property (readonly) CGFloat viewportHeight;
+@property (readonly) NSUInteger imageCount;
+
+@end
+
+@interface CatPageBridge : NSObject
+
+- (id) initWithWebView:(UIWebView*)webView;
+
+// Evaluates the page once per invalidation.
+- (CatPageState*) state;
+// Load events: the next state is read again.
+- (void) invalidate;
+// A new main document: also closes the previous page's count.
+- (void) beginPage;
+
+@property (readonly) NSUInteger evaluations;
+@property (readonly) NSUInteger avoidedCalls;
+@property (readonly) NSUInteger pageAvoidedCalls;
+
+@end
@@ -0,0 +1,102 @@
+//
+//  CatPageBridge.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/1/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatPageBridge.h"
+#import "CatMetrics.h"
+
+// Short keys keep the record small: it is copied out of WebKit as a string.
+static NSString* const kBridgeScript =
+    @"(function(){var d=document,b=d.body;"
+    @"return JSON.stringify({t:d.title,h:location.href,y:window.pageYOffset,"
+    @"s:b?b.scrollHeight:0,v:window.innerHeight,i:d.images.length});})()";
+
+@interface CatPageState ()
+@property (readwrite) NSString* title;
+@property (readwrite) NSString* location;
+@property (readwrite) CGFloat scrollY;
+@property (readwrite) CGFloat scrollHeight;
+@property (readwrite) CGFloat viewportHeight;
+@property (readwrite) NSUInteger imageCount;
+@end
+
+@implementation CatPageState
+
+static NSString* stringField(NSDictionary* record, NSString* key)
+{
+    id value = record[key];
+    return [value isKindOfClass:[NSString class]] ? value : @"";
+}
+
+static double numberField(NSDictionary* record, NSString* key)
+{
+    id value = record[key];
+    return [value isKindOfClass:[NSNumber class]] ? [value doubleValue] : 0;
+}
+
++ (CatPageState*) stateWithRecord:(NSString*)record
+{
+    NSData* data = [record dataUsingEncoding:NSUTF8StringEncoding];
+    NSDictionary* fields = data.length ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+    if(![fields isKindOfClass:[NSDictionary class]]) {
+        fields = @{};
+    }
+    CatPageState* state = [[CatPageState alloc] init];
+    state.title = stringField(fields, @"t");
+    state.location = stringField(fields, @"h");
+    state.scrollY = numberField(fields, @"y");
+    state.scrollHeight = numberField(fields, @"s");
+    state.viewportHeight = numberField(fields, @"v");
+    state.imageCount = (NSUInteger)numberField(fields, @"i");
+    return state;
+}
+
+@end
+
+@implementation CatPageBridge
+{
+    __weak UIWebView* webView;
+    CatPageState* cached;
+}
+
+- (id) initWithWebView:(UIWebView*)aWebView
+{
+    if(self = [super init]) {
+        webView = aWebView;
+    }
+    return self;
+}
+
+- (CatPageState*) state
+{
+    if(cached) {
+        _avoidedCalls++;
+        _pageAvoidedCalls++;
+        CatMetricsCount(CatCounterBridgeAvoided);
+        return cached;
+    }
+    cached = [CatPageState stateWithRecord:[webView stringByEvaluatingJavaScriptFromString:kBridgeScript]];
+    _evaluations++;
+    CatMetricsCount(CatCounterBridgeCalls);
+    return cached;
+}
+
+- (void) invalidate
+{
+    cached = nil;
+}
+
+- (void) beginPage
+{
+    if(_evaluations) {
+        CatMetricsRecord(CatMetricBridgeAvoided, _pageAvoidedCalls);
+    }
+    _pageAvoidedCalls = 0;
+    cached = nil;
+}
+
+@end
@@ -0,0 +1,460 @@
+//
+//  CatPrefixIndex.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/28/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatPrefixIndex.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Node 0 is the root and link 0 is unused, so 0 can mean none in both.
+typedef struct {
+    uint32_t label;             // offset in labels
+    uint32_t labelLength;
+    uint32_t parent;
+    uint32_t child;
+    uint32_t sibling;
+    uint32_t terminals;         // entries with a key ending here
+    uint32_t top[kCatPrefixTopK];
+    uint32_t topCount;
+} CatPrefixNode;
+
+// Terminal lists are doubly linked and each terminal is paired with the
+// key link of its entry, so removing an entry does not walk the long lists
+// of popular words.
+typedef struct {
+    uint32_t value;
+    uint32_t next;
+    uint32_t previous;
+    uint32_t pair;
+} CatPrefixLink;
+
+typedef struct {
+    double score;
+    uint32_t keys;              // nodes where its keys end
+    uint32_t used;
+} CatPrefixEntry;
+
+struct CatPrefixIndex {
+    CatPrefixNode* nodes;
+    size_t nodeCount;
+    size_t nodeCapacity;
+    char* labels;
+    size_t labelLength;
+    size_t labelCapacity;
+    CatPrefixLink* links;
+    size_t linkCount;
+    size_t linkCapacity;
+    uint32_t freeLinks;
+    CatPrefixEntry* entries;
+    size_t entryCapacity;
+};
+
+static int CatGrow(void** array, size_t* capacity, size_t needed, size_t size)
+{
+    if(needed <= *capacity) {
+        return 0;
+    }
+    size_t grown = *capacity ? *capacity : 64;
+    // By half, not double: at 100k entries the slack is megabytes.
+    while(grown < needed) {
+        grown += grown / 2;
+    }
+    void* resized = realloc(*array, grown * size);
+    if(!resized) {
+        return -1;
+    }
+    memset((char*)resized + *capacity * size, 0, (grown - *capacity) * size);
+    *array = resized;
+    *capacity = grown;
+    return 0;
+}
+
+CatPrefixIndex* CatPrefixIndexCreate(void)
+{
+    CatPrefixIndex* index = calloc(1, sizeof(CatPrefixIndex));
+    if(!index) {
+        return NULL;
+    }
+    if(CatGrow((void**)&index->nodes, &index->nodeCapacity, 1, sizeof(CatPrefixNode)) ||
+       CatGrow((void**)&index->links, &index->linkCapacity, 1, sizeof(CatPrefixLink))) {
+        CatPrefixIndexDestroy(index);
+        return NULL;
+    }
+    index->nodeCount = 1;
+    index->linkCount = 1;
+    return index;
+}
+
+void CatPrefixIndexDestroy(CatPrefixIndex* index)
+{
+    if(!index) {
+        return;
+    }
+    free(index->nodes);
+    free(index->labels);
+    free(index->links);
+    free(index->entries);
+    free(index);
+}
+
+static uint32_t CatNewLink(CatPrefixIndex* index, uint32_t value, uint32_t next)
+{
+    uint32_t link = index->freeLinks;
+    if(link) {
+        index->freeLinks = index->links[link].next;
+    }
+    else {
+        link = (uint32_t)index->linkCount++;
+    }
+    index->links[link].value = value;
+    index->links[link].next = next;
+    index->links[link].previous = 0;
+    index->links[link].pair = 0;
+    return link;
+}
+
+static void CatFreeLinks(CatPrefixIndex* index, uint32_t link)
+{
+    while(link) {
+        uint32_t next = index->links[link].next;
+        index->links[link].next = index->freeLinks;
+        index->freeLinks = link;
+        link = next;
+    }
+}
+
+static inline int CatBetter(const CatPrefixIndex* index, uint32_t a, uint32_t b)
+{
+    double scoreA = index->entries[a].score;
+    double scoreB = index->entries[b].score;
+    return scoreA > scoreB || (scoreA == scoreB && a < b);
+}
+
+// Puts entry in the node's list if it ranks. Returns whether it is in it.
+static int CatOffer(CatPrefixIndex* index, CatPrefixNode* node, uint32_t entry)
+{
+    if(!index->entries[entry].used) {
+        return 0;
+    }
+    uint32_t position = node->topCount;
+    for(uint32_t i=0; i<node->topCount; i++) {
+        if(node->top[i] == entry) {
+            position = i;
+            break;
+        }
+    }
+    if(position == node->topCount) {
+        if(node->topCount < kCatPrefixTopK) {
+            node->topCount++;
+        }
+        else if(CatBetter(index, entry, node->top[kCatPrefixTopK - 1])) {
+            position = kCatPrefixTopK - 1;
+        }
+        else {
+            return 0;
+        }
+    }
+    while(position > 0 && CatBetter(index, entry, node->top[position - 1])) {
+        node->top[position] = node->top[position - 1];
+        position--;
+    }
+    node->top[position] = entry;
+    return 1;
+}
+
+static int CatContains(const CatPrefixNode* node, uint32_t entry)
+{
+    for(uint32_t i=0; i<node->topCount; i++) {
+        if(node->top[i] == entry) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The best entries below a node are among its own and its children's best.
+static void CatRebuild(CatPrefixIndex* index, uint32_t nodeIndex)
+{
+    CatPrefixNode* node = &index->nodes[nodeIndex];
+    node->topCount = 0;
+    for(uint32_t link = node->terminals; link; link = index->links[link].next) {
+        CatOffer(index, node, index->links[link].value);
+    }
+    for(uint32_t child = node->child; child; child = index->nodes[child].sibling) {
+        const CatPrefixNode* childNode = &index->nodes[child];
+        for(uint32_t i=0; i<childNode->topCount; i++) {
+            CatOffer(index, node, childNode->top[i]);
+        }
+    }
+}
+
+// From a key's end up to the root. A list the entry does not make can be
+// left alone, along with all the lists above it.
+static void CatRaise(CatPrefixIndex* index, uint32_t node, uint32_t entry)
+{
+    while(CatOffer(index, &index->nodes[node], entry) && node) {
+        node = index->nodes[node].parent;
+    }
+}
+
+static uint32_t CatDepth(const CatPrefixIndex* index, uint32_t node)
+{
+    uint32_t depth = 0;
+    for(; node; node = index->nodes[node].parent) {
+        depth++;
+    }
+    return depth;
+}
+
+// The entry's keys share ancestors, so its paths go up together, a level
+// at a time: a shared list rebuilt along one path would read the stale
+// list of a child on another. A list that did not hold the entry needs no
+// rebuild, and neither do the lists above it.
+static void CatLower(CatPrefixIndex* index, uint32_t entry)
+{
+    uint32_t deepest = 0;
+    for(uint32_t link = index->entries[entry].keys; link; link = index->links[link].next) {
+        uint32_t depth = CatDepth(index, index->links[link].value);
+        deepest = depth > deepest ? depth : deepest;
+    }
+    for(uint32_t level = deepest + 1; level-- > 0;) {
+        for(uint32_t link = index->entries[entry].keys; link; link = index->links[link].next) {
+            uint32_t node = index->links[link].value;
+            uint32_t depth = CatDepth(index, node);
+            if(depth < level) {
+                continue;
+            }
+            for(; depth > level; depth--) {
+                node = index->nodes[node].parent;
+            }
+            if(CatContains(&index->nodes[node], entry)) {
+                CatRebuild(index, node);
+            }
+        }
+    }
+}
+
+static int CatEnsureEntry(CatPrefixIndex* index, uint32_t entry)
+{
+    size_t capacity = index->entryCapacity;
+    if(CatGrow((void**)&index->entries, &index->entryCapacity, (size_t)entry + 1, sizeof(CatPrefixEntry))) {
+        return -1;
+    }
+    for(size_t i=capacity; i<index->entryCapacity; i++) {
+        index->entries[i].score = -INFINITY;
+    }
+    index->entries[entry].used = 1;
+    return 0;
+}
+
+static uint32_t CatNewNode(CatPrefixIndex* index, uint32_t parent, uint32_t label, uint32_t labelLength)
+{
+    uint32_t node = (uint32_t)index->nodeCount++;
+    memset(&index->nodes[node], 0, sizeof(CatPrefixNode));
+    index->nodes[node].parent = parent;
+    index->nodes[node].label = label;
+    index->nodes[node].labelLength = labelLength;
+    return node;
+}
+
+// Child of node whose label starts with byte, and the sibling before it.
+static uint32_t CatFindChild(const CatPrefixIndex* index, uint32_t node, char byte, uint32_t* previous)
+{
+    uint32_t before = 0;
+    uint32_t child = index->nodes[node].child;
+    while(child && index->labels[index->nodes[child].label] != byte) {
+        before = child;
+        child = index->nodes[child].sibling;
+    }
+    if(previous) {
+        *previous = before;
+    }
+    return child;
+}
+
+int CatPrefixIndexInsert(CatPrefixIndex* index, uint32_t entry, const char* key, size_t length)
+{
+    if(!length || length > UINT32_MAX) {
+        return 0;
+    }
+    // An insert adds at most a split and a leaf, so nothing moves once it starts.
+    if(CatEnsureEntry(index, entry) ||
+       CatGrow((void**)&index->nodes, &index->nodeCapacity, index->nodeCount + 2, sizeof(CatPrefixNode)) ||
+       CatGrow((void**)&index->labels, &index->labelCapacity, index->labelLength + length, 1) ||
+       CatGrow((void**)&index->links, &index->linkCapacity, index->linkCount + 2, sizeof(CatPrefixLink))) {
+        return -1;
+    }
+
+    uint32_t node = 0;
+    size_t matched = 0;
+    while(matched < length) {
+        uint32_t previous;
+        uint32_t child = CatFindChild(index, node, key[matched], &previous);
+        if(!child) {
+            memcpy(index->labels + index->labelLength, key + matched, length - matched);
+            uint32_t leaf = CatNewNode(index, node, (uint32_t)index->labelLength, (uint32_t)(length - matched));
+            index->labelLength += length - matched;
+            index->nodes[leaf].sibling = index->nodes[node].child;
+            index->nodes[node].child = leaf;
+            node = leaf;
+            break;
+        }
+        CatPrefixNode* childNode = &index->nodes[child];
+        uint32_t common = 1;
+        while(common < childNode->labelLength && matched + common < length &&
+              index->labels[childNode->label + common] == key[matched + common]) {
+            common++;
+        }
+        if(common < childNode->labelLength) {
+            // The common part becomes a node of its own, in the child's place;
+            // the child keeps its id, its terminals and the rest of its label.
+            uint32_t split = CatNewNode(index, node, childNode->label, common);
+            CatPrefixNode* splitNode = &index->nodes[split];
+            childNode = &index->nodes[child];
+            memcpy(splitNode->top, childNode->top, sizeof(childNode->top));
+            splitNode->topCount = childNode->topCount;
+            splitNode->child = child;
+            splitNode->sibling = childNode->sibling;
+            childNode->sibling = 0;
+            childNode->parent = split;
+            childNode->label += common;
+            childNode->labelLength -= common;
+            if(previous) {
+                index->nodes[previous].sibling = split;
+            }
+            else {
+                index->nodes[node].child = split;
+            }
+            child = split;
+        }
+        node = child;
+        matched += common;
+    }
+
+    // Popular words end thousands of keys; the entry's own few keys are quicker to check.
+    for(uint32_t link = index->entries[entry].keys; link; link = index->links[link].next) {
+        if(index->links[link].value == node) {
+            return 0;
+        }
+    }
+    uint32_t head = index->nodes[node].terminals;
+    uint32_t terminal = CatNewLink(index, entry, head);
+    if(head) {
+        index->links[head].previous = terminal;
+    }
+    index->nodes[node].terminals = terminal;
+    uint32_t keyLink = CatNewLink(index, node, index->entries[entry].keys);
+    index->entries[entry].keys = keyLink;
+    index->links[keyLink].pair = terminal;
+    CatRaise(index, node, entry);
+    return 0;
+}
+
+void CatPrefixIndexSetScore(CatPrefixIndex* index, uint32_t entry, double score)
+{
+    if(entry >= index->entryCapacity || !index->entries[entry].used) {
+        return;
+    }
+    CatPrefixEntry* record = &index->entries[entry];
+    double previous = record->score;
+    record->score = score;
+    if(score < previous) {
+        CatLower(index, entry);
+        return;
+    }
+    for(uint32_t link = record->keys; link; link = index->links[link].next) {
+        CatRaise(index, index->links[link].value, entry);
+    }
+}
+
+double CatPrefixIndexScore(const CatPrefixIndex* index, uint32_t entry)
+{
+    return entry < index->entryCapacity && index->entries[entry].used ? index->entries[entry].score : -INFINITY;
+}
+
+void CatPrefixIndexRemove(CatPrefixIndex* index, uint32_t entry)
+{
+    if(entry >= index->entryCapacity || !index->entries[entry].used) {
+        return;
+    }
+    CatPrefixEntry* record = &index->entries[entry];
+    for(uint32_t link = record->keys; link; link = index->links[link].next) {
+        uint32_t terminal = index->links[link].pair;
+        uint32_t previous = index->links[terminal].previous;
+        uint32_t next = index->links[terminal].next;
+        if(previous) {
+            index->links[previous].next = next;
+        }
+        else {
+            index->nodes[index->links[link].value].terminals = next;
+        }
+        if(next) {
+            index->links[next].previous = previous;
+        }
+        index->links[terminal].next = 0;
+        CatFreeLinks(index, terminal);
+    }
+    record->used = 0;
+    CatLower(index, entry);
+    CatFreeLinks(index, record->keys);
+    record->keys = 0;
+    record->score = -INFINITY;
+}
+
+size_t CatPrefixIndexQuery(const CatPrefixIndex* index, const char* prefix, size_t length, uint32_t* entries, size_t capacity)
+{
+    uint32_t node = 0;
+    size_t matched = 0;
+    while(matched < length) {
+        uint32_t child = CatFindChild(index, node, prefix[matched], NULL);
+        if(!child) {
+            return 0;
+        }
+        const CatPrefixNode* childNode = &index->nodes[child];
+        size_t compared = childNode->labelLength < length - matched ? childNode->labelLength : length - matched;
+        if(memcmp(index->labels + childNode->label, prefix + matched, compared) != 0) {
+            return 0;
+        }
+        matched += compared;
+        node = child;
+    }
+    const CatPrefixNode* found = &index->nodes[node];
+    size_t count = found->topCount < capacity ? found->topCount : capacity;
+    memcpy(entries, found->top, count * sizeof(uint32_t));
+    return count;
+}
+
+size_t CatPrefixIndexNodeCount(const CatPrefixIndex* index)
+{
+    return index->nodeCount;
+}
+
+size_t CatPrefixIndexMemoryUsage(const CatPrefixIndex* index)
+{
+    return sizeof(CatPrefixIndex) + index->nodeCapacity * sizeof(CatPrefixNode) + index->labelCapacity +
+        index->linkCapacity * sizeof(CatPrefixLink) + index->entryCapacity * sizeof(CatPrefixEntry);
+}
+
+double CatFrecencyCombine(double a, double b)
+{
+    if(a == -INFINITY) {
+        return b;
+    }
+    if(b == -INFINITY) {
+        return a;
+    }
+    double high = a > b ? a : b;
+    double low = a > b ? b : a;
+    return high + log2(1 + exp2(low - high));
+}
+
+double CatFrecencyAddVisit(double score, double time, double halfLife, double weight)
+{
+    return CatFrecencyCombine(score, time / halfLife + log2(weight));
+}
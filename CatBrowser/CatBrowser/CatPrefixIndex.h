@@ -0,0 +1,62 @@
+//
+//  CatPrefixIndex.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/28/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Prefix index for address bar suggestions. Keys live in a radix trie
+//  whose nodes each keep the best kCatPrefixTopK entries below them, so a
+//  query walks the prefix and copies one list: the cost depends on the
+//  length of what was typed, not on the number of entries. An entry can
+//  have several keys (its location, the words of its title). Raising a
+//  score updates the lists on its key paths; lowering it or removing the
+//  entry rebuilds the lists that held it from their children. Entry ids
+//  are the caller's, small and dense. Plain C, no Apple dependency, not
+//  thread safe.
+//
+
+#ifndef CatBrowser_CatPrefixIndex_h
+#define CatBrowser_CatPrefixIndex_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define kCatPrefixTopK 8
+
+typedef struct CatPrefixIndex CatPrefixIndex;
+
+CatPrefixIndex* CatPrefixIndexCreate(void);
+void CatPrefixIndexDestroy(CatPrefixIndex* index);
+
+// Adds a key for entry. Keys are bytes, matched as they are: lowercase
+// them first. Returns 0, or -1 when out of memory.
+int CatPrefixIndexInsert(CatPrefixIndex* index, uint32_t entry, const char* key, size_t length);
+void CatPrefixIndexSetScore(CatPrefixIndex* index, uint32_t entry, double score);
+double CatPrefixIndexScore(const CatPrefixIndex* index, uint32_t entry);
+// Drops the entry and all its keys.
+void CatPrefixIndexRemove(CatPrefixIndex* index, uint32_t entry);
+
+// Best entries with a key starting with prefix, highest score first.
+// Returns how many were written, at most kCatPrefixTopK.
+size_t CatPrefixIndexQuery(const CatPrefixIndex* index, const char* prefix, size_t length, uint32_t* entries, size_t capacity);
+
+size_t CatPrefixIndexNodeCount(const CatPrefixIndex* index);
+size_t CatPrefixIndexMemoryUsage(const CatPrefixIndex* index);
+
+// Frecency in log2 space: score is log2 of the sum of 2^(t/halfLife) over
+// visits, each weighted. Scores only grow with new visits, and an old
+// visit weighs half as much as a new one per halfLife, so scores computed
+// at different times compare without being refreshed. Start from -INFINITY.
+double CatFrecencyAddVisit(double score, double time, double halfLife, double weight);
+double CatFrecencyCombine(double a, double b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
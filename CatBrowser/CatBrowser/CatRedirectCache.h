@@ -0,0 +1,51 @@
+//
+//  CatRedirectCache.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/23/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Final image URLs learned from the origin's redirects. With format=src
+//  every origin fetch is a redirect plus the image, so an interception that
+//  reuses a learned URL goes straight to the image host, or skips the
+//  network when that image is still in the store. Entries expire after ttl
+//  and are retired after maxUses so pages keep getting different cats.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface CatRedirectCache : NSObject
+
++ (CatRedirectCache*) sharedCache;
+
+- (id) initWithCapacity:(NSUInteger)capacity ttl:(NSTimeInterval)ttl;
+
+// An origin fetch of that type was redirected hops times to url. storeKey
+// is the image store key of the body, or nil if it was not stored.
+- (void) learnURL:(NSURL*)url type:(NSString*)type hops:(NSUInteger)hops storeKey:(NSString*)storeKey;
+// A fetch of a learned URL failed or returned something else than an image.
+- (void) forgetURL:(NSURL*)url;
+
+// A learned URL for that type, or nil. Counts as one use.
+- (NSURL*) URLForType:(NSString*)type hops:(NSUInteger*)hops storeKey:(NSString**)storeKey;
+// Round trips skipped by serving a learned URL: its hops, plus one when
+// the body came from the store.
+- (void) countSavedRoundTrips:(NSUInteger)count;
+
+// Starts the per page tally, on each main frame navigation.
+- (void) beginPage;
+- (void) removeAllURLs;
+
+@property (readonly) NSUInteger capacity;
+@property (readonly) NSTimeInterval ttl;
+@property NSUInteger maxUses;               // default 2
+@property (readonly) NSUInteger count;
+
+@property (readonly) NSUInteger hits;
+@property (readonly) NSUInteger misses;
+@property (readonly) NSUInteger expirations;
+@property (readonly) NSUInteger roundTripsSaved;
+@property (readonly) NSUInteger pageRoundTripsSaved;
+@property (readonly) NSUInteger pageInterceptions;  // URLForType: calls since beginPage
+
+@end
@@ -0,0 +1,165 @@
+//
+//  CatRedirectCache.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/23/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatRedirectCache.h"
+
+static const NSUInteger kDefaultCapacity = 128;
+static const NSTimeInterval kDefaultTTL = 10 * 60;
+
+@interface CatRedirectEntry : NSObject
+{
+@public
+    NSURL* url;
+    NSString* type;
+    NSString* storeKey;
+    NSUInteger hops;
+    NSUInteger uses;
+    CFAbsoluteTime expiry;
+}
+@end
+
+@implementation CatRedirectEntry
+@end
+
+@implementation CatRedirectCache
+{
+    NSMutableDictionary* entries;   // absolute URL string -> CatRedirectEntry
+    NSMutableArray* order;          // oldest first
+}
+
++ (CatRedirectCache*) sharedCache
+{
+    static CatRedirectCache* sharedCache = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedCache = [[CatRedirectCache alloc] initWithCapacity:kDefaultCapacity ttl:kDefaultTTL];
+    });
+    return sharedCache;
+}
+
+- (id) initWithCapacity:(NSUInteger)capacity ttl:(NSTimeInterval)ttl
+{
+    if(self = [super init]) {
+        _capacity = MAX(1, capacity);
+        _ttl = ttl;
+        _maxUses = 2;
+        entries = [NSMutableDictionary dictionaryWithCapacity:_capacity];
+        order = [NSMutableArray arrayWithCapacity:_capacity];
+    }
+    return self;
+}
+
+- (void) removeEntry:(CatRedirectEntry*)entry
+{
+    [entries removeObjectForKey:entry->url.absoluteString];
+    [order removeObjectIdenticalTo:entry];
+}
+
+- (void) learnURL:(NSURL*)url type:(NSString*)type hops:(NSUInteger)hops storeKey:(NSString*)storeKey
+{
+    if(!url || !type || !hops) {
+        return;
+    }
+    @synchronized(self) {
+        CatRedirectEntry* entry = entries[url.absoluteString];
+        if(entry) {
+            // Same image again from the origin: refresh, keep the use count.
+            [order removeObjectIdenticalTo:entry];
+        }
+        else {
+            while(order.count >= _capacity) {
+                [self removeEntry:order.firstObject];
+            }
+            entry = [[CatRedirectEntry alloc] init];
+            entry->url = url;
+            entries[url.absoluteString] = entry;
+        }
+        entry->type = type;
+        entry->hops = hops;
+        entry->storeKey = storeKey ?: entry->storeKey;
+        entry->expiry = CFAbsoluteTimeGetCurrent() + _ttl;
+        [order addObject:entry];
+    }
+}
+
+- (void) forgetURL:(NSURL*)url
+{
+    @synchronized(self) {
+        CatRedirectEntry* entry = entries[url.absoluteString];
+        if(entry) {
+            [self removeEntry:entry];
+        }
+    }
+}
+
+- (NSURL*) URLForType:(NSString*)type hops:(NSUInteger*)hops storeKey:(NSString**)storeKey
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    @synchronized(self) {
+        _pageInterceptions++;
+        // Entries are in expiry order, so expired ones are all at the front.
+        while(order.count && ((CatRedirectEntry*)order.firstObject)->expiry <= now) {
+            [self removeEntry:order.firstObject];
+            _expirations++;
+        }
+        CatRedirectEntry* best = nil;
+        for(CatRedirectEntry* entry in order) {
+            if([entry->type isEqualToString:type] && (!best || entry->uses < best->uses)) {
+                best = entry;
+            }
+        }
+        if(!best) {
+            _misses++;
+            return nil;
+        }
+        _hits++;
+        if(++best->uses >= _maxUses) {
+            [self removeEntry:best];
+        }
+        if(hops) {
+            *hops = best->hops;
+        }
+        if(storeKey) {
+            *storeKey = best->storeKey;
+        }
+        return best->url;
+    }
+}
+
+- (void) countSavedRoundTrips:(NSUInteger)count
+{
+    @synchronized(self) {
+        _roundTripsSaved += count;
+        _pageRoundTripsSaved += count;
+    }
+}
+
+- (void) beginPage
+{
+    @synchronized(self) {
+        _pageRoundTripsSaved = 0;
+        _pageInterceptions = 0;
+    }
+}
+
+- (void) removeAllURLs
+{
+    @synchronized(self) {
+        [entries removeAllObjects];
+        [order removeAllObjects];
+    }
+}
+
+- (NSUInteger) count
+{
+    @synchronized(self) {
+        return order.count;
+    }
+}
+
+@end
@@ -0,0 +1,58 @@
+//
+//  CatReplacementLoader.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/14/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Fetches one replacement image on a dedicated networking queue and
+//  streams it to its delegate chunk by chunk. The body is spooled to a
+//  temporary file and hashed as it arrives, then handed to the image
+//  store, so memory per request stays bounded by the chunk size.
+//  Plain http fetches go through a shared CatOriginClient, which keeps
+//  connections to the origin alive between images.
+//
+
+#import <Foundation/Foundation.h>
+
+@class CatReplacementLoader;
+@class CatImageStore;
+@class CatOriginClient;
+
+@protocol CatReplacementLoaderDelegate <NSObject>
+@required
+- (void) loader:(CatReplacementLoader*)loader didReceiveResponse:(NSURLResponse*)response;
+- (void) loader:(CatReplacementLoader*)loader didLoadData:(NSData*)data;
+- (void) loaderDidFinishLoading:(CatReplacementLoader*)loader;
+- (void) loader:(CatReplacementLoader*)loader didFailWithError:(NSError*)error;
+@end
+
+@interface CatReplacementLoader : NSObject
+
++ (NSOperationQueue*) networkQueue;
+// Delivers on networkQueue.
++ (CatOriginClient*) originClient;
+
+// Totals over every loader cancelled before it finished.
++ (int64_t) cancelledRequests;
++ (int64_t) cancelledBytes;
+
+- (id) initWithRequest:(NSURLRequest*)request type:(NSString*)type store:(CatImageStore*)store;
+- (void) start;
+// Aborts the fetch and drops its spool file. No delegate message starts
+// after this returns, but one already under way on networkQueue can still
+// arrive: a delegate that needs a hard stop checks on its own thread.
+- (void) cancel;
+
+@property (weak) id<CatReplacementLoaderDelegate> delegate;
+@property (readonly) NSURLRequest* request;
+@property (readonly) NSString* type;
+@property (readonly) long long receivedBytes;
+// Where the body came from once the response arrived, after redirects.
+@property (readonly) NSURL* finalURL;
+@property (readonly) NSUInteger redirects;
+// Image store key of the body, set when it finished loading and was stored.
+@property (readonly) NSString* storedKey;
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+@end
@@ -0,0 +1,257 @@
+//
+//  CatReplacementLoader.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/14/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatReplacementLoader.h"
+#import "CatImageStore.h"
+#import "CatOriginClient.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <libkern/OSAtomic.h>
+
+static volatile int64_t cancelledRequests = 0;
+static volatile int64_t cancelledBytes = 0;
+
+@interface CatReplacementLoader () <NSURLConnectionDataDelegate>
+// Set by the caller's thread, read on networkQueue.
+@property (readwrite, getter=isCancelled) BOOL cancelled;
+@end
+
+@implementation CatReplacementLoader
+{
+    CatImageStore* store;
+    NSURLConnection* connection;
+    CatOriginTask* task;
+    NSString* spoolPath;
+    NSFileHandle* spool;
+    CC_MD5_CTX digest;
+    BOOL storable;
+}
+
++ (NSOperationQueue*) networkQueue
+{
+    static NSOperationQueue* networkQueue = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        networkQueue = [[NSOperationQueue alloc] init];
+        networkQueue.name = @"com.dobuki.CatBrowser.network";
+        networkQueue.maxConcurrentOperationCount = 1;
+    });
+    return networkQueue;
+}
+
++ (CatOriginClient*) originClient
+{
+    static CatOriginClient* originClient = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        originClient = [[CatOriginClient alloc] init];
+        originClient.delegateQueue = [CatReplacementLoader networkQueue];
+    });
+    return originClient;
+}
+
++ (int64_t) cancelledRequests
+{
+    return cancelledRequests;
+}
+
++ (int64_t) cancelledBytes
+{
+    return cancelledBytes;
+}
+
+- (id) initWithRequest:(NSURLRequest*)request type:(NSString*)type store:(CatImageStore*)aStore
+{
+    if(self = [super init]) {
+        _request = request;
+        _type = type;
+        store = aStore;
+    }
+    return self;
+}
+
+- (void) start
+{
+    if([CatOriginClient canFetchRequest:_request]) {
+        // Like NSURLConnection with its delegate, the task keeps the loader alive until it ends.
+        task = [[CatReplacementLoader originClient] fetchRequest:_request response:^(NSHTTPURLResponse* response) {
+            _redirects = task.redirects;
+            [self receivedResponse:response];
+        } data:^(NSData* data) {
+            [self receivedData:data];
+        } completion:^(NSError* error) {
+            if([error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorUnsupportedURL && task.redirects) {
+                [self followRedirect];
+            }
+            else {
+                error ? [self failedWithError:error] : [self finishedLoading];
+            }
+        }];
+        return;
+    }
+    [self connectWithRequest:_request];
+}
+
+- (void) connectWithRequest:(NSURLRequest*)request
+{
+    connection = [[NSURLConnection alloc] initWithRequest:request delegate:self startImmediately:NO];
+    [connection setDelegateQueue:[CatReplacementLoader networkQueue]];
+    [connection start];
+}
+
+// The origin redirected somewhere the origin client does not go, most
+// likely https: NSURLConnection takes over from there.
+- (void) followRedirect
+{
+    if(self.cancelled) {
+        return;
+    }
+    _redirects = task.redirects;
+    NSMutableURLRequest* request = [_request mutableCopy];
+    request.URL = task.URL;
+    task = nil;
+    [self connectWithRequest:request];
+}
+
+- (void) cancel
+{
+    self.cancelled = YES;
+    self.delegate = nil;
+    // Runs behind any callback already queued, so the spool is never closed under a write.
+    [[CatReplacementLoader networkQueue] addOperationWithBlock:^{
+        if(!connection && !task) {
+            return;
+        }
+        [connection cancel];
+        connection = nil;
+        [task cancel];
+        task = nil;
+        [self closeSpool];
+        OSAtomicIncrement64(&cancelledRequests);
+        OSAtomicAdd64(_receivedBytes, &cancelledBytes);
+    }];
+}
+
+- (void) closeSpool
+{
+    [spool closeFile];
+    spool = nil;
+    if(spoolPath) {
+        [[NSFileManager defaultManager] removeItemAtPath:spoolPath error:NULL];
+        spoolPath = nil;
+    }
+}
+
+- (void) receivedResponse:(NSURLResponse*)response
+{
+    if(self.cancelled) {
+        return;
+    }
+    [self closeSpool];
+    _receivedBytes = 0;
+    _finalURL = response.URL;
+    storable = store && [response.MIMEType hasPrefix:@"image/"];
+    if(storable) {
+        spoolPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+        [[NSFileManager defaultManager] createFileAtPath:spoolPath contents:nil attributes:nil];
+        spool = [NSFileHandle fileHandleForWritingAtPath:spoolPath];
+        storable = spool != nil;
+        CC_MD5_Init(&digest);
+    }
+    [_delegate loader:self didReceiveResponse:response];
+}
+
+- (void) receivedData:(NSData*)data
+{
+    _receivedBytes += data.length;
+    if(self.cancelled) {
+        return;
+    }
+    if(storable) {
+        CC_MD5_Update(&digest, data.bytes, (CC_LONG)data.length);
+        @try {
+            [spool writeData:data];
+        }
+        @catch (NSException *exception) {
+            storable = NO;
+            [self closeSpool];
+        }
+    }
+    [_delegate loader:self didLoadData:data];
+}
+
+- (void) finishedLoading
+{
+    if(self.cancelled) {
+        return;
+    }
+    if(storable && _receivedBytes > 0) {
+        unsigned char result[CC_MD5_DIGEST_LENGTH];
+        CC_MD5_Final(result, &digest);
+        NSMutableString* hash = [NSMutableString stringWithCapacity:CC_MD5_DIGEST_LENGTH*2];
+        for(int i=0; i<CC_MD5_DIGEST_LENGTH; i++) {
+            [hash appendFormat:@"%02x", result[i]];
+        }
+        [spool closeFile];
+        spool = nil;
+        _storedKey = [store storeFileAtPath:spoolPath digest:hash type:_type];
+        spoolPath = nil;
+    }
+    [self closeSpool];
+    connection = nil;
+    task = nil;
+    [_delegate loaderDidFinishLoading:self];
+}
+
+- (void) failedWithError:(NSError*)error
+{
+    if(self.cancelled) {
+        return;
+    }
+    [self closeSpool];
+    connection = nil;
+    task = nil;
+    [_delegate loader:self didFailWithError:error];
+}
+
+#pragma mark NSURLConnectionDataDelegate
+
+- (NSURLRequest *)connection:(NSURLConnection *)aConnection willSendRequest:(NSURLRequest *)request redirectResponse:(NSURLResponse *)redirectResponse
+{
+    if(redirectResponse) {
+        _redirects++;
+    }
+    return request;
+}
+
+- (void)connection:(NSURLConnection *)aConnection didReceiveResponse:(NSURLResponse *)response
+{
+    [self receivedResponse:response];
+}
+
+- (void)connection:(NSURLConnection *)aConnection didReceiveData:(NSData *)data
+{
+    [self receivedData:data];
+}
+
+- (void)connectionDidFinishLoading:(NSURLConnection *)aConnection
+{
+    [self finishedLoading];
+}
+
+- (void)connection:(NSURLConnection *)aConnection didFailWithError:(NSError *)error
+{
+    [self failedWithError:error];
+}
+
+- (NSCachedURLResponse *)connection:(NSURLConnection *)aConnection willCacheResponse:(NSCachedURLResponse *)cachedResponse
+{
+    // The image store is the cache for replacement images.
+    return nil;
+}
+
+@end
@@ -0,0 +1,334 @@
+//
+//  CatResample.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/17/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatResample.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define kCatLanczosRadius 3
+
+// M_PI is not C99.
+static const double kCatPi = 3.14159265358979323846;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CAT_RESAMPLE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CAT_RESAMPLE_SSE2 1
+#endif
+
+// Source taps of every destination coordinate along one axis.
+typedef struct {
+    int* start;
+    int* count;
+    float* weights;     // maxTaps per destination coordinate
+    int maxTaps;
+} CatAxis;
+
+static void CatAxisFree(CatAxis* axis)
+{
+    free(axis->start);
+    free(axis->count);
+    free(axis->weights);
+}
+
+static double CatLanczos(double x)
+{
+    x = fabs(x);
+    if(x < 1e-8) {
+        return 1;
+    }
+    if(x >= kCatLanczosRadius) {
+        return 0;
+    }
+    double px = kCatPi * x;
+    return kCatLanczosRadius * sin(px) * sin(px / kCatLanczosRadius) / (px * px);
+}
+
+static int CatAxisAllocate(CatAxis* axis, int dstLength, int maxTaps)
+{
+    axis->maxTaps = maxTaps;
+    axis->start = malloc(sizeof(int) * dstLength);
+    axis->count = malloc(sizeof(int) * dstLength);
+    axis->weights = malloc(sizeof(float) * dstLength * maxTaps);
+    if(!axis->start || !axis->count || !axis->weights) {
+        CatAxisFree(axis);
+        return 0;
+    }
+    return 1;
+}
+
+static int CatAxisBuildBox(CatAxis* axis, int srcLength, int dstLength)
+{
+    double scale = (double)srcLength / dstLength;
+    if(!CatAxisAllocate(axis, dstLength, (int)ceil(scale) + 1)) {
+        return 0;
+    }
+    for(int i = 0; i < dstLength; i++) {
+        double lo = i * scale;
+        double hi = lo + scale;
+        int start = (int)floor(lo);
+        int end = (int)ceil(hi);
+        if(end > srcLength) {
+            end = srcLength;
+        }
+        float* weights = &axis->weights[i * axis->maxTaps];
+        double total = 0;
+        int count = 0;
+        for(int j = start; j < end && count < axis->maxTaps; j++) {
+            double covered = fmin(hi, j + 1) - fmax(lo, j);
+            if(covered <= 0) {
+                continue;
+            }
+            if(count == 0) {
+                start = j;
+            }
+            weights[count++] = (float)covered;
+            total += covered;
+        }
+        for(int t = 0; t < count; t++) {
+            weights[t] = (float)(weights[t] / total);
+        }
+        axis->start[i] = start;
+        axis->count[i] = count;
+    }
+    return 1;
+}
+
+// The kernel is stretched by the scale when shrinking, so it low-passes
+// what it drops. Taps past the edges are left out and the rest renormalized.
+static int CatAxisBuildLanczos(CatAxis* axis, int srcLength, int dstLength)
+{
+    double scale = (double)srcLength / dstLength;
+    double stretch = fmax(scale, 1);
+    double support = kCatLanczosRadius * stretch;
+    if(!CatAxisAllocate(axis, dstLength, (int)ceil(2 * support) + 1)) {
+        return 0;
+    }
+    for(int i = 0; i < dstLength; i++) {
+        double center = (i + 0.5) * scale;
+        int start = (int)floor(center - support);
+        int end = (int)ceil(center + support);
+        start = start < 0 ? 0 : start;
+        end = end > srcLength ? srcLength : end;
+        float* weights = &axis->weights[i * axis->maxTaps];
+        double total = 0;
+        int count = 0;
+        for(int j = start; j < end && count < axis->maxTaps; j++) {
+            double weight = CatLanczos((j + 0.5 - center) / stretch);
+            weights[count++] = (float)weight;
+            total += weight;
+        }
+        for(int t = 0; t < count; t++) {
+            weights[t] = (float)(weights[t] / total);
+        }
+        axis->start[i] = start;
+        axis->count[i] = count;
+    }
+    return 1;
+}
+
+static int CatAxisBuild(CatAxis* axis, int srcLength, int dstLength, CatResampleFilter filter)
+{
+    return filter == CatResampleFilterLanczos ? CatAxisBuildLanczos(axis, srcLength, dstLength) : CatAxisBuildBox(axis, srcLength, dstLength);
+}
+
+static void CatAccumulateRowScalar(float* acc, const uint8_t* row, size_t length, float weight, int first)
+{
+    if(first) {
+        for(size_t k = 0; k < length; k++) {
+            acc[k] = weight * row[k];
+        }
+    }
+    else {
+        for(size_t k = 0; k < length; k++) {
+            acc[k] += weight * row[k];
+        }
+    }
+}
+
+static void CatReduceRowScalar(const float* acc, const CatAxis* axis, uint8_t* dst, int dstWidth)
+{
+    for(int x = 0; x < dstWidth; x++) {
+        const float* weights = &axis->weights[x * axis->maxTaps];
+        const float* taps = &acc[axis->start[x] * 4];
+        float sum[4] = { 0, 0, 0, 0 };
+        for(int t = 0; t < axis->count[x]; t++) {
+            for(int c = 0; c < 4; c++) {
+                sum[c] += weights[t] * taps[t * 4 + c];
+            }
+        }
+        for(int c = 0; c < 4; c++) {
+            float value = sum[c] + 0.5f;
+            dst[x * 4 + c] = value <= 0 ? 0 : value >= 255 ? 255 : (uint8_t)value;
+        }
+    }
+}
+
+#if CAT_RESAMPLE_SSE2
+
+static void CatAccumulateRowSIMD(float* acc, const uint8_t* row, size_t length, float weight, int first)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 w = _mm_set1_ps(weight);
+    size_t k = 0;
+    for(; k + 16 <= length; k += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(row + k));
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128 f0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), w);
+        __m128 f1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), w);
+        __m128 f2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), w);
+        __m128 f3 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), w);
+        if(!first) {
+            f0 = _mm_add_ps(f0, _mm_loadu_ps(acc + k));
+            f1 = _mm_add_ps(f1, _mm_loadu_ps(acc + k + 4));
+            f2 = _mm_add_ps(f2, _mm_loadu_ps(acc + k + 8));
+            f3 = _mm_add_ps(f3, _mm_loadu_ps(acc + k + 12));
+        }
+        _mm_storeu_ps(acc + k, f0);
+        _mm_storeu_ps(acc + k + 4, f1);
+        _mm_storeu_ps(acc + k + 8, f2);
+        _mm_storeu_ps(acc + k + 12, f3);
+    }
+    CatAccumulateRowScalar(acc + k, row + k, length - k, weight, first);
+}
+
+static void CatReduceRowSIMD(const float* acc, const CatAxis* axis, uint8_t* dst, int dstWidth)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    for(int x = 0; x < dstWidth; x++) {
+        const float* weights = &axis->weights[x * axis->maxTaps];
+        const float* taps = &acc[axis->start[x] * 4];
+        __m128 sum = _mm_setzero_ps();
+        for(int t = 0; t < axis->count[x]; t++) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(taps + t * 4), _mm_set1_ps(weights[t])));
+        }
+        // Truncating conversion after adding one half rounds like the scalar path.
+        __m128i words = _mm_cvttps_epi32(_mm_add_ps(sum, half));
+        words = _mm_packs_epi32(words, words);
+        words = _mm_packus_epi16(words, words);
+        int pixel = _mm_cvtsi128_si32(words);
+        memcpy(dst + x * 4, &pixel, 4);
+    }
+}
+
+#elif CAT_RESAMPLE_NEON
+
+static void CatAccumulateRowSIMD(float* acc, const uint8_t* row, size_t length, float weight, int first)
+{
+    const float32x4_t w = vdupq_n_f32(weight);
+    size_t k = 0;
+    for(; k + 16 <= length; k += 16) {
+        uint8x16_t bytes = vld1q_u8(row + k);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+        float32x4_t f0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo)));
+        float32x4_t f1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo)));
+        float32x4_t f2 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi)));
+        float32x4_t f3 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi)));
+        if(first) {
+            vst1q_f32(acc + k, vmulq_f32(f0, w));
+            vst1q_f32(acc + k + 4, vmulq_f32(f1, w));
+            vst1q_f32(acc + k + 8, vmulq_f32(f2, w));
+            vst1q_f32(acc + k + 12, vmulq_f32(f3, w));
+        }
+        else {
+            vst1q_f32(acc + k, vmlaq_f32(vld1q_f32(acc + k), f0, w));
+            vst1q_f32(acc + k + 4, vmlaq_f32(vld1q_f32(acc + k + 4), f1, w));
+            vst1q_f32(acc + k + 8, vmlaq_f32(vld1q_f32(acc + k + 8), f2, w));
+            vst1q_f32(acc + k + 12, vmlaq_f32(vld1q_f32(acc + k + 12), f3, w));
+        }
+    }
+    CatAccumulateRowScalar(acc + k, row + k, length - k, weight, first);
+}
+
+static void CatReduceRowSIMD(const float* acc, const CatAxis* axis, uint8_t* dst, int dstWidth)
+{
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    for(int x = 0; x < dstWidth; x++) {
+        const float* weights = &axis->weights[x * axis->maxTaps];
+        const float* taps = &acc[axis->start[x] * 4];
+        float32x4_t sum = vdupq_n_f32(0);
+        for(int t = 0; t < axis->count[x]; t++) {
+            sum = vmlaq_n_f32(sum, vld1q_f32(taps + t * 4), weights[t]);
+        }
+        uint32x4_t words = vcvtq_u32_f32(vaddq_f32(sum, half));
+        uint8x8_t bytes = vqmovn_u16(vcombine_u16(vqmovn_u32(words), vqmovn_u32(words)));
+        vst1_lane_u32((uint32_t*)(dst + x * 4), vreinterpret_u32_u8(bytes), 0);
+    }
+}
+
+#endif
+
+int CatResampleHasSIMD(void)
+{
+#if CAT_RESAMPLE_SSE2 || CAT_RESAMPLE_NEON
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int CatResampleRGBA(const uint8_t* src, int srcWidth, int srcHeight, size_t srcStride,
+                    uint8_t* dst, int dstWidth, int dstHeight, size_t dstStride,
+                    CatResamplePath path)
+{
+    return CatResampleRGBAFiltered(src, srcWidth, srcHeight, srcStride, dst, dstWidth, dstHeight, dstStride, CatResampleFilterBox, path);
+}
+
+int CatResampleRGBAFiltered(const uint8_t* src, int srcWidth, int srcHeight, size_t srcStride,
+                            uint8_t* dst, int dstWidth, int dstHeight, size_t dstStride,
+                            CatResampleFilter filter, CatResamplePath path)
+{
+    if(!src || !dst || srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+        return -1;
+    }
+    void (*accumulate)(float*, const uint8_t*, size_t, float, int) = CatAccumulateRowScalar;
+    void (*reduce)(const float*, const CatAxis*, uint8_t*, int) = CatReduceRowScalar;
+#if CAT_RESAMPLE_SSE2 || CAT_RESAMPLE_NEON
+    if(path == CatResamplePathSIMD) {
+        accumulate = CatAccumulateRowSIMD;
+        reduce = CatReduceRowSIMD;
+    }
+#else
+    (void)path;
+#endif
+
+    CatAxis horizontal, vertical;
+    if(!CatAxisBuild(&horizontal, srcWidth, dstWidth, filter)) {
+        return -1;
+    }
+    if(!CatAxisBuild(&vertical, srcHeight, dstHeight, filter)) {
+        CatAxisFree(&horizontal);
+        return -1;
+    }
+    size_t rowLength = (size_t)srcWidth * 4;
+    float* acc = malloc(sizeof(float) * rowLength);
+    if(!acc) {
+        CatAxisFree(&horizontal);
+        CatAxisFree(&vertical);
+        return -1;
+    }
+
+    for(int y = 0; y < dstHeight; y++) {
+        const float* weights = &vertical.weights[y * vertical.maxTaps];
+        for(int t = 0; t < vertical.count[y]; t++) {
+            accumulate(acc, src + (size_t)(vertical.start[y] + t) * srcStride, rowLength, weights[t], t == 0);
+        }
+        reduce(acc, &horizontal, dst + (size_t)y * dstStride, dstWidth);
+    }
+
+    free(acc);
+    CatAxisFree(&horizontal);
+    CatAxisFree(&vertical);
+    return 0;
+}
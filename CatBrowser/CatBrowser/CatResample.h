@@ -0,0 +1,53 @@
+//
+//  CatResample.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/17/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Portable RGBA8 downscaler. Each destination pixel is the area weighted
+//  average of the source pixels it covers (box filter with fractional
+//  coverage). Rows are streamed: the vertical pass accumulates into a
+//  single float row, so scratch memory is one source row wide.
+//  The inner loops have NEON and SSE2 versions; the scalar path is the
+//  reference and the fallback on other targets.
+//  A Lanczos (a = 3) filter is there for thumbnails of pages, where a box
+//  leaves moire on text and fine patterns; it runs through the same loops
+//  with more taps per pixel.
+//
+
+#ifndef CatBrowser_CatResample_h
+#define CatBrowser_CatResample_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CatResamplePathScalar,
+    CatResamplePathSIMD,    // falls back to scalar when the target has no SIMD path
+} CatResamplePath;
+
+typedef enum {
+    CatResampleFilterBox,
+    CatResampleFilterLanczos,
+} CatResampleFilter;
+
+int CatResampleHasSIMD(void);
+
+// Returns 0 on success, -1 on invalid sizes or allocation failure.
+int CatResampleRGBA(const uint8_t* src, int srcWidth, int srcHeight, size_t srcStride,
+                    uint8_t* dst, int dstWidth, int dstHeight, size_t dstStride,
+                    CatResamplePath path);
+int CatResampleRGBAFiltered(const uint8_t* src, int srcWidth, int srcHeight, size_t srcStride,
+                            uint8_t* dst, int dstWidth, int dstHeight, size_t dstStride,
+                            CatResampleFilter filter, CatResamplePath path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
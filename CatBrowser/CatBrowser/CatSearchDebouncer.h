@@ -0,0 +1,34 @@
+//
+//  CatSearchDebouncer.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/27/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Search as you type without a page load per keystroke. Each query
+//  replaces the pending one and restarts the quiet period; only the query
+//  still pending when the user pauses is handed to the handler. Runs on
+//  the main run loop.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface CatSearchDebouncer : NSObject
+
+- (id) initWithQuietPeriod:(NSTimeInterval)quietPeriod handler:(void (^)(NSString* query))handler;
+
+- (void) submitQuery:(NSString*)query;
+// Hands the pending query over now, if any.
+- (void) flush;
+// Drops the pending query.
+- (void) cancel;
+
+@property NSTimeInterval quietPeriod;
+@property (readonly) NSString* pendingQuery;
+
+@property (readonly) NSUInteger submittedQueries;
+@property (readonly) NSUInteger loadedQueries;
+// Queries replaced or cancelled before they were loaded.
+@property (readonly) NSUInteger avoidedLoads;
+
+@end
@@ -0,0 +1,79 @@
+//
+//  CatSearchDebouncer.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/27/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatSearchDebouncer.h"
+#import "CatMetrics.h"
+
+@implementation CatSearchDebouncer
+{
+    void (^handler)(NSString* query);
+    NSTimer* quietTimer;
+}
+
+- (id) initWithQuietPeriod:(NSTimeInterval)quietPeriod handler:(void (^)(NSString* query))aHandler
+{
+    if(self = [super init]) {
+        _quietPeriod = quietPeriod;
+        handler = [aHandler copy];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [quietTimer invalidate];
+}
+
+- (void) submitQuery:(NSString*)query
+{
+    _submittedQueries++;
+    if(_pendingQuery) {
+        [self countAvoided];
+    }
+    _pendingQuery = [query copy];
+    [quietTimer invalidate];
+    // The timer retains us; it is invalidated as soon as it fires or is superseded.
+    quietTimer = [NSTimer scheduledTimerWithTimeInterval:_quietPeriod target:self selector:@selector(quietPeriodElapsed:) userInfo:nil repeats:NO];
+}
+
+- (void) quietPeriodElapsed:(NSTimer*)timer
+{
+    [self flush];
+}
+
+- (void) flush
+{
+    [quietTimer invalidate];
+    quietTimer = nil;
+    NSString* query = _pendingQuery;
+    if(!query) {
+        return;
+    }
+    _pendingQuery = nil;
+    _loadedQueries++;
+    CatMetricsCount(CatCounterSearchLoads);
+    handler(query);
+}
+
+- (void) cancel
+{
+    [quietTimer invalidate];
+    quietTimer = nil;
+    if(_pendingQuery) {
+        [self countAvoided];
+        _pendingQuery = nil;
+    }
+}
+
+- (void) countAvoided
+{
+    _avoidedLoads++;
+    CatMetricsCount(CatCounterSearchAvoided);
+}
+
+@end
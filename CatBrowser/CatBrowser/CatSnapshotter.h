@@ -0,0 +1,58 @@
+//
+//  CatSnapshotter.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/30/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Bookmark thumbnails of the page, captured on every tick of the bookmark
+//  screen's timer. The view is rendered into one bitmap kept across ticks
+//  and hashed in tiles; a new image is made and published only when some
+//  tile changed. Once a frame comes out the same as the last, ticks are
+//  skipped without rendering until setNeedsCapture says the page scrolled,
+//  loaded or otherwise moved.
+//  By default the view is rendered at twice the thumbnail size and brought
+//  down with CatResample's Lanczos filter: Core Animation's own scaling is
+//  fast but leaves text jagged and patterns in moire.
+//  Only the rendering happens on the main thread. Filtering, hashing and
+//  making the image go to a serial queue, and the image comes back on the
+//  main thread. Ticks arriving while a frame is still on the queue are
+//  dropped rather than queued behind it.
+//
+
+#import <UIKit/UIKit.h>
+
+typedef enum {
+    CatSnapshotDirect,          // rendered at thumbnail size
+    CatSnapshotBox,             // rendered at twice the size, box filtered down
+    CatSnapshotLanczos,         // rendered at twice the size, Lanczos filtered down
+} CatSnapshotQuality;
+
+@interface CatSnapshotter : NSObject
+
+// Size is the thumbnail in points, scale the screen scale. Lanczos quality.
+- (id) initWithThumbnailSize:(CGSize)size scale:(CGFloat)scale;
+- (id) initWithThumbnailSize:(CGSize)size scale:(CGFloat)scale quality:(CatSnapshotQuality)quality;
+
+// Main thread. Renders the view when due, and calls publish on the main
+// thread once the new image is made, if it changed.
+- (void) captureView:(UIView*)view offset:(CGFloat)offset publish:(void (^)(UIImage* image))publish;
+// The same, all done before returning. Returns YES when image changed.
+- (BOOL) captureView:(UIView*)view offset:(CGFloat)offset;
+// The next capture renders whatever happened since.
+- (void) setNeedsCapture;
+// Main thread. Frees the bitmaps and the image until the next capture.
+- (void) purge;
+@property (readonly) unsigned long long residentBytes;
+
+@property (readonly) UIImage* image;
+@property (readonly) CatSnapshotQuality quality;
+
+@property (readonly) NSUInteger renderedFrames;
+@property (readonly) NSUInteger publishedFrames;
+@property (readonly) NSUInteger unchangedFrames;    // rendered, no tile changed
+@property (readonly) NSUInteger skippedFrames;      // not rendered: idle or still processing
+@property (readonly) NSUInteger changedTiles;       // of the last rendered frame
+@property (readonly) NSUInteger tileCount;
+
+@end
@@ -0,0 +1,227 @@
+//
+//  CatSnapshotter.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/30/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatSnapshotter.h"
+#import "CatTileHash.h"
+#import "CatResample.h"
+#import "CatMetrics.h"
+#import <QuartzCore/QuartzCore.h>
+
+static const int kTileSize = 16;
+static const int kOversample = 2;
+
+@implementation CatSnapshotter
+{
+    CGFloat scale;
+    CGContextRef renderContext;
+    CGContextRef context;       // the thumbnail, renderContext when direct
+    size_t renderWidth;
+    size_t renderHeight;
+    size_t pixelWidth;
+    size_t pixelHeight;
+    uint64_t* previousHashes;
+    uint64_t* hashes;
+    BOOL hasFrame;
+    BOOL idle;                  // the last frame was unchanged, nothing since
+    BOOL needsCapture;          // setNeedsCapture since the last render
+    BOOL processing;            // a render is on the queue, its buffers are taken
+    dispatch_queue_t queue;
+}
+
+static CGContextRef createRGBAContext(size_t width, size_t height)
+{
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace,
+                                                 kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    return context;
+}
+
+- (id) initWithThumbnailSize:(CGSize)size scale:(CGFloat)screenScale
+{
+    return [self initWithThumbnailSize:size scale:screenScale quality:CatSnapshotLanczos];
+}
+
+- (id) initWithThumbnailSize:(CGSize)size scale:(CGFloat)screenScale quality:(CatSnapshotQuality)quality
+{
+    if(self = [super init]) {
+        scale = screenScale;
+        _quality = quality;
+        pixelWidth = (size_t)ceil(size.width * scale);
+        pixelHeight = (size_t)ceil(size.height * scale);
+        int oversample = quality == CatSnapshotDirect ? 1 : kOversample;
+        renderWidth = pixelWidth * oversample;
+        renderHeight = pixelHeight * oversample;
+        _tileCount = CatTileCount((int)pixelWidth, (int)pixelHeight, kTileSize, NULL, NULL);
+        previousHashes = calloc(_tileCount, sizeof(uint64_t));
+        hashes = calloc(_tileCount, sizeof(uint64_t));
+        if(![self prepareBuffers] || !previousHashes || !hashes) {
+            return nil;
+        }
+        queue = dispatch_queue_create("com.dobuki.CatBrowser.snapshot", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    [self releaseBuffers];
+    free(previousHashes);
+    free(hashes);
+}
+
+// The bitmaps go on purge and come back on the next render. The tile
+// hashes stay: a page that did not change is still not republished.
+- (BOOL) prepareBuffers
+{
+    if(!renderContext) {
+        renderContext = createRGBAContext(renderWidth, renderHeight);
+    }
+    if(!context) {
+        context = renderWidth == pixelWidth ? CGContextRetain(renderContext) : createRGBAContext(pixelWidth, pixelHeight);
+    }
+    return renderContext && context;
+}
+
+- (void) releaseBuffers
+{
+    CGContextRelease(renderContext);
+    CGContextRelease(context);
+    renderContext = NULL;
+    context = NULL;
+}
+
+- (void) purge
+{
+    if(!processing) {
+        [self releaseBuffers];
+        _image = nil;
+    }
+}
+
+- (unsigned long long) residentBytes
+{
+    unsigned long long bytes = 0;
+    if(renderContext) {
+        bytes += CGBitmapContextGetBytesPerRow(renderContext) * renderHeight;
+    }
+    if(context && context != renderContext) {
+        bytes += CGBitmapContextGetBytesPerRow(context) * pixelHeight;
+    }
+    if(_image) {
+        bytes += CGImageGetBytesPerRow(_image.CGImage) * CGImageGetHeight(_image.CGImage);
+    }
+    return bytes;
+}
+
+- (void) setNeedsCapture
+{
+    needsCapture = YES;
+    idle = NO;
+}
+
+// Main thread: whether this tick is skipped, idle or coalesced.
+- (BOOL) skipsTick
+{
+    if(processing || idle) {
+        _skippedFrames++;
+        CatMetricsCount(CatCounterSnapshotSkipped);
+        return YES;
+    }
+    return NO;
+}
+
+// Main thread: the only part that has to be, Core Animation rendering.
+- (void) renderView:(UIView*)view offset:(CGFloat)offset
+{
+    uint64_t start = CatMetricsNow();
+    needsCapture = NO;
+    // The view's width fills the thumbnail, as much of its top as fits.
+    CGFloat factor = renderWidth / view.bounds.size.width;
+    CGContextSaveGState(renderContext);
+    CGContextClearRect(renderContext, CGRectMake(0, 0, renderWidth, renderHeight));
+    CGContextTranslateCTM(renderContext, 0, renderHeight);
+    CGContextScaleCTM(renderContext, factor, -factor);
+    CGContextTranslateCTM(renderContext, 0, fmin(0, offset));
+    [view.layer renderInContext:renderContext];
+    CGContextRestoreGState(renderContext);
+    _renderedFrames++;
+    CatMetricsRecord(CatMetricSnapshot, CatMetricsNow() - start);
+}
+
+// Any thread, one at a time: the thumbnail when the render changed it, else nil.
+- (UIImage*) processFrame
+{
+    uint64_t start = CatMetricsNow();
+    if(renderContext != context) {
+        CatResampleRGBAFiltered(CGBitmapContextGetData(renderContext), (int)renderWidth, (int)renderHeight, CGBitmapContextGetBytesPerRow(renderContext),
+                                CGBitmapContextGetData(context), (int)pixelWidth, (int)pixelHeight, CGBitmapContextGetBytesPerRow(context),
+                                _quality == CatSnapshotBox ? CatResampleFilterBox : CatResampleFilterLanczos, CatResamplePathSIMD);
+    }
+    CatTileHashRGBA(CGBitmapContextGetData(context), (int)pixelWidth, (int)pixelHeight,
+                    CGBitmapContextGetBytesPerRow(context), kTileSize, hashes);
+    _changedTiles = CatTileDiff(previousHashes, hashes, (int)pixelWidth, (int)pixelHeight, kTileSize, NULL);
+    UIImage* image = nil;
+    if(_changedTiles || !hasFrame) {
+        CGImageRef cgImage = CGBitmapContextCreateImage(context);
+        image = [UIImage imageWithCGImage:cgImage scale:scale orientation:UIImageOrientationUp];
+        CGImageRelease(cgImage);
+        hasFrame = YES;
+    }
+    CatMetricsRecord(CatMetricSnapshotProcess, CatMetricsNow() - start);
+    return image;
+}
+
+// Main thread.
+- (void) noteFrame:(UIImage*)image
+{
+    if(image) {
+        _image = image;
+        _publishedFrames++;
+        CatMetricsCount(CatCounterSnapshotPublished);
+    }
+    else {
+        // The page sits still: no more renders until something says it
+        // moved, unless it already did while this frame was processed.
+        idle = !needsCapture;
+        _unchangedFrames++;
+        CatMetricsCount(CatCounterSnapshotUnchanged);
+    }
+}
+
+- (BOOL) captureView:(UIView*)view offset:(CGFloat)offset
+{
+    if([self skipsTick] || ![self prepareBuffers]) {
+        return NO;
+    }
+    [self renderView:view offset:offset];
+    UIImage* image = [self processFrame];
+    [self noteFrame:image];
+    return image != nil;
+}
+
+- (void) captureView:(UIView*)view offset:(CGFloat)offset publish:(void (^)(UIImage* image))publish
+{
+    if([self skipsTick] || ![self prepareBuffers]) {
+        return;
+    }
+    [self renderView:view offset:offset];
+    processing = YES;
+    dispatch_async(queue, ^{
+        UIImage* image = [self processFrame];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            processing = NO;
+            [self noteFrame:image];
+            if(image) {
+                publish(image);
+            }
+        });
+    });
+}
+
+@end
@@ -0,0 +1,54 @@
+//
+//  CatSuggestionEngine.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/28/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Address bar suggestions from bookmarks and visited pages, answered
+//  locally from a CatPrefixIndex. Each entry is keyed by its location
+//  (without scheme and www.) and by the words of its title, and ranked by
+//  frecency: every visit counts, a recent one more, and a bookmark counts
+//  as bookmarkWeight visits. Entries are added and rescored as pages are
+//  visited and bookmarks change; nothing is rebuilt.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface CatSuggestion : NSObject
+@property (readonly) NSString* title;
+@property (readonly) NSString* location;
+@property (readonly) NSUInteger visits;
+@property (readonly, getter=isBookmarked) BOOL bookmarked;
+@end
+
+@interface CatSuggestionEngine : NSObject
+
++ (CatSuggestionEngine*) sharedEngine;
+
+- (void) noteVisitToLocation:(NSString*)location title:(NSString*)title;
+- (void) noteVisitToLocation:(NSString*)location title:(NSString*)title date:(NSDate*)date;
+// Several visits at once, as if all made on the date: what history
+// remembers of a location, fed at startup.
+- (void) noteVisits:(NSUInteger)visits toLocation:(NSString*)location title:(NSString*)title date:(NSDate*)date;
+
+// Entries of bookmark.txt's favorites, @{title, location}. Bookmarks not
+// in the list any more lose their bonus, and are dropped unless visited.
+- (void) setBookmarks:(NSArray*)bookmarks;
+- (BOOL) loadBookmarksFromFile:(NSString*)path;
+// One bookmark made or changed, one removed: what setBookmarks: does for
+// it, without going through the others.
+- (void) setBookmark:(NSDictionary*)bookmark;
+- (void) removeBookmarkAtLocation:(NSString*)location;
+
+// Best matches first. Several words must all match: the first through the
+// index, the others as prefixes of title words or anywhere in the location.
+- (NSArray*) suggestionsForText:(NSString*)text limit:(NSUInteger)limit;
+
+@property (readonly) NSUInteger count;
+@property (readonly) size_t indexBytes;
+
+@property NSTimeInterval halfLife;      // default 7 days: a visit then weighs half a visit now
+@property double bookmarkWeight;        // default 10
+
+@end
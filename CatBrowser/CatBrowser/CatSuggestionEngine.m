@@ -0,0 +1,315 @@
+//
+//  CatSuggestionEngine.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/28/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatSuggestionEngine.h"
+#import "CatPrefixIndex.h"
+#include <math.h>
+
+static const NSUInteger kMaxTitleWords = 8;
+// Long locations are keyed by their start: nobody types the query string.
+static const NSUInteger kMaxKeyLength = 96;
+
+@interface CatSuggestion ()
+{
+@package
+    uint32_t identifier;
+    double visitScore;
+    double bookmarkScore;
+}
+@property (readwrite) NSString* title;
+@property (readwrite) NSString* location;
+@property (readwrite) NSUInteger visits;
+@property (readwrite, getter=isBookmarked) BOOL bookmarked;
+@end
+
+@implementation CatSuggestion
+@end
+
+@implementation CatSuggestionEngine
+{
+    CatPrefixIndex* index;
+    NSMutableArray* entries;            // identifier -> CatSuggestion, NSNull once removed
+    NSMutableDictionary* locations;     // location -> CatSuggestion
+    NSCharacterSet* separators;
+}
+
++ (CatSuggestionEngine*) sharedEngine
+{
+    static CatSuggestionEngine* sharedEngine = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedEngine = [[CatSuggestionEngine alloc] init];
+    });
+    return sharedEngine;
+}
+
+- (id) init
+{
+    if(self = [super init]) {
+        index = CatPrefixIndexCreate();
+        if(!index) {
+            return nil;
+        }
+        entries = [NSMutableArray array];
+        locations = [NSMutableDictionary dictionary];
+        separators = [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+        _halfLife = 7 * 24 * 3600;
+        _bookmarkWeight = 10;
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    CatPrefixIndexDestroy(index);
+}
+
+// Lowercase, without scheme and www., as typed in the address bar.
+static NSString* normalizedLocation(NSString* string)
+{
+    NSString* location = [string lowercaseString];
+    for(NSString* prefix in @[@"https://", @"http://", @"www."]) {
+        if([location hasPrefix:prefix]) {
+            location = [location substringFromIndex:prefix.length];
+        }
+    }
+    return location;
+}
+
+- (NSArray*) wordsOfString:(NSString*)string
+{
+    NSMutableArray* words = [NSMutableArray array];
+    for(NSString* word in [[string lowercaseString] componentsSeparatedByCharactersInSet:separators]) {
+        if(word.length >= 2 && ![words containsObject:word]) {
+            [words addObject:word];
+        }
+    }
+    return words;
+}
+
+- (void) insertKey:(NSString*)key forEntry:(CatSuggestion*)entry
+{
+    const char* bytes = key.UTF8String;
+    size_t length = MIN(strlen(bytes), kMaxKeyLength);
+    // Do not cut a UTF-8 sequence in half.
+    while(length && length < strlen(bytes) && (bytes[length] & 0xC0) == 0x80) {
+        length--;
+    }
+    CatPrefixIndexInsert(index, entry->identifier, bytes, length);
+}
+
+- (void) insertTitle:(NSString*)title forEntry:(CatSuggestion*)entry
+{
+    NSArray* words = [self wordsOfString:title];
+    for(NSUInteger i=0; i<MIN(words.count, kMaxTitleWords); i++) {
+        [self insertKey:words[i] forEntry:entry];
+    }
+}
+
+- (CatSuggestion*) entryForLocation:(NSString*)location title:(NSString*)title
+{
+    CatSuggestion* entry = locations[location];
+    if(!entry) {
+        entry = [[CatSuggestion alloc] init];
+        entry->identifier = (uint32_t)entries.count;
+        entry->visitScore = -INFINITY;
+        entry->bookmarkScore = -INFINITY;
+        entry.location = location;
+        [entries addObject:entry];
+        locations[location] = entry;
+        [self insertKey:normalizedLocation(location) forEntry:entry];
+    }
+    if(title.length && ![title isEqualToString:entry.title]) {
+        // Words of an older title stay: the page was known by them too.
+        entry.title = title;
+        [self insertTitle:title forEntry:entry];
+    }
+    return entry;
+}
+
+- (void) rescore:(CatSuggestion*)entry
+{
+    CatPrefixIndexSetScore(index, entry->identifier, CatFrecencyCombine(entry->visitScore, entry->bookmarkScore));
+}
+
+- (void) noteVisitToLocation:(NSString*)location title:(NSString*)title
+{
+    [self noteVisitToLocation:location title:title date:[NSDate date]];
+}
+
+- (void) noteVisitToLocation:(NSString*)location title:(NSString*)title date:(NSDate*)date
+{
+    [self noteVisits:1 toLocation:location title:title date:date];
+}
+
+- (void) noteVisits:(NSUInteger)visits toLocation:(NSString*)location title:(NSString*)title date:(NSDate*)date
+{
+    if(!location.length || !visits) {
+        return;
+    }
+    @synchronized(self) {
+        CatSuggestion* entry = [self entryForLocation:location title:title];
+        entry.visits += visits;
+        entry->visitScore = CatFrecencyAddVisit(entry->visitScore, [date timeIntervalSinceReferenceDate], _halfLife, visits);
+        [self rescore:entry];
+    }
+}
+
+// Location and title of a bookmark entry, NO when it is not one.
+static BOOL parseBookmark(NSDictionary* bookmark, NSString** location, NSString** title)
+{
+    *location = bookmark[@"location"];
+    *title = [bookmark[@"title"] isKindOfClass:[NSString class]] ? bookmark[@"title"] : nil;
+    return [*location isKindOfClass:[NSString class]] && [*location length] && !bookmark[@"not-favorite"];
+}
+
+// The bonus counts from when the bookmark is first seen.
+- (CatSuggestion*) bookmarkLocation:(NSString*)location title:(NSString*)title now:(NSTimeInterval)now
+{
+    CatSuggestion* entry = [self entryForLocation:location title:title];
+    if(!entry.bookmarked) {
+        entry.bookmarked = YES;
+        entry->bookmarkScore = CatFrecencyAddVisit(-INFINITY, now, _halfLife, _bookmarkWeight);
+        [self rescore:entry];
+    }
+    return entry;
+}
+
+- (void) unbookmark:(CatSuggestion*)entry
+{
+    entry.bookmarked = NO;
+    entry->bookmarkScore = -INFINITY;
+    if(entry.visits) {
+        [self rescore:entry];
+    }
+    else {
+        CatPrefixIndexRemove(index, entry->identifier);
+        [locations removeObjectForKey:entry.location];
+        entries[entry->identifier] = [NSNull null];
+    }
+}
+
+- (void) setBookmarks:(NSArray*)bookmarks
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    @synchronized(self) {
+        NSMutableSet* bookmarked = [NSMutableSet set];
+        for(NSDictionary* bookmark in bookmarks) {
+            NSString* location;
+            NSString* title;
+            if(parseBookmark(bookmark, &location, &title)) {
+                [bookmarked addObject:[self bookmarkLocation:location title:title now:now]];
+            }
+        }
+        for(NSUInteger i=0; i<entries.count; i++) {
+            CatSuggestion* entry = entries[i];
+            if(entry != (id)[NSNull null] && entry.bookmarked && ![bookmarked containsObject:entry]) {
+                [self unbookmark:entry];
+            }
+        }
+    }
+}
+
+- (void) setBookmark:(NSDictionary*)bookmark
+{
+    NSString* location;
+    NSString* title;
+    if(!parseBookmark(bookmark, &location, &title)) {
+        return;
+    }
+    @synchronized(self) {
+        [self bookmarkLocation:location title:title now:[NSDate timeIntervalSinceReferenceDate]];
+    }
+}
+
+- (void) removeBookmarkAtLocation:(NSString*)location
+{
+    @synchronized(self) {
+        CatSuggestion* entry = location ? locations[location] : nil;
+        if(entry.bookmarked) {
+            [self unbookmark:entry];
+        }
+    }
+}
+
+- (BOOL) loadBookmarksFromFile:(NSString*)path
+{
+    NSData* data = [NSData dataWithContentsOfFile:path];
+    NSDictionary* dico = data ? [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL] : nil;
+    NSArray* favorites = [dico isKindOfClass:[NSDictionary class]] ? dico[@"favorites"] : nil;
+    if(![favorites isKindOfClass:[NSArray class]]) {
+        return NO;
+    }
+    [self setBookmarks:favorites];
+    return YES;
+}
+
+- (BOOL) entry:(CatSuggestion*)entry matchesWords:(NSArray*)words
+{
+    NSArray* titleWords = nil;
+    NSString* location = normalizedLocation(entry.location);
+    for(NSString* word in words) {
+        if([location rangeOfString:word].location != NSNotFound) {
+            continue;
+        }
+        titleWords = titleWords ?: [self wordsOfString:entry.title];
+        BOOL found = NO;
+        for(NSString* titleWord in titleWords) {
+            if([titleWord hasPrefix:word]) {
+                found = YES;
+                break;
+            }
+        }
+        if(!found) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (NSArray*) suggestionsForText:(NSString*)text limit:(NSUInteger)limit
+{
+    NSString* query = normalizedLocation([text stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]);
+    NSMutableArray* words = [[query componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] mutableCopy];
+    [words removeObject:@""];
+    if(!words.count || !limit) {
+        return @[];
+    }
+    NSString* first = words.firstObject;
+    [words removeObjectAtIndex:0];
+    const char* bytes = first.UTF8String;
+
+    uint32_t found[kCatPrefixTopK];
+    NSMutableArray* suggestions = [NSMutableArray array];
+    @synchronized(self) {
+        size_t count = CatPrefixIndexQuery(index, bytes, strlen(bytes), found, kCatPrefixTopK);
+        for(size_t i=0; i<count && suggestions.count<limit; i++) {
+            CatSuggestion* entry = entries[found[i]];
+            if(!words.count || [self entry:entry matchesWords:words]) {
+                [suggestions addObject:entry];
+            }
+        }
+    }
+    return suggestions;
+}
+
+- (NSUInteger) count
+{
+    @synchronized(self) {
+        return locations.count;
+    }
+}
+
+- (size_t) indexBytes
+{
+    @synchronized(self) {
+        return CatPrefixIndexMemoryUsage(index);
+    }
+}
+
+@end
@@ -0,0 +1,99 @@
+//
+//  CatTileHash.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/30/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatTileHash.h"
+
+#include <string.h>
+
+#define kMultiplier 0x9e3779b97f4a7c15ULL
+
+size_t CatTileCount(int width, int height, int tileSize, int* columns, int* rows)
+{
+    int across = width > 0 ? (width + tileSize - 1) / tileSize : 0;
+    int down = height > 0 ? (height + tileSize - 1) / tileSize : 0;
+    if(columns) {
+        *columns = across;
+    }
+    if(rows) {
+        *rows = down;
+    }
+    return (size_t)across * down;
+}
+
+static inline uint64_t CatMix(uint64_t hash, uint64_t word)
+{
+    hash = (hash ^ word) * kMultiplier;
+    return hash ^ (hash >> 29);
+}
+
+void CatTileHashRGBA(const uint8_t* pixels, int width, int height, size_t stride, int tileSize, uint64_t* hashes)
+{
+    int columns, rows;
+    CatTileCount(width, height, tileSize, &columns, &rows);
+    for(int row=0; row<rows; row++) {
+        uint64_t* hashRow = hashes + (size_t)row * columns;
+        for(int column=0; column<columns; column++) {
+            hashRow[column] = kMultiplier;
+        }
+        int bottom = (row + 1) * tileSize < height ? (row + 1) * tileSize : height;
+        // Line by line across all the tiles of the row, in memory order.
+        for(int y=row*tileSize; y<bottom; y++) {
+            const uint8_t* line = pixels + (size_t)y * stride;
+            for(int column=0; column<columns; column++) {
+                int left = column * tileSize;
+                size_t length = (size_t)((left + tileSize < width ? tileSize : width - left) * 4);
+                const uint8_t* bytes = line + left * 4;
+                uint64_t hash = hashRow[column];
+                size_t i = 0;
+                for(; i + 8 <= length; i += 8) {
+                    uint64_t word;
+                    memcpy(&word, bytes + i, 8);
+                    hash = CatMix(hash, word);
+                }
+                for(; i < length; i += 4) {
+                    uint32_t word;
+                    memcpy(&word, bytes + i, 4);
+                    hash = CatMix(hash, word);
+                }
+                hashRow[column] = hash;
+            }
+        }
+    }
+}
+
+size_t CatTileDiff(uint64_t* previous, const uint64_t* current, int width, int height, int tileSize, CatTileRect* changed)
+{
+    int columns, rows;
+    CatTileCount(width, height, tileSize, &columns, &rows);
+    size_t count = 0;
+    int minColumn = columns, minRow = rows, maxColumn = -1, maxRow = -1;
+    for(int row=0; row<rows; row++) {
+        for(int column=0; column<columns; column++) {
+            size_t i = (size_t)row * columns + column;
+            if(previous[i] == current[i]) {
+                continue;
+            }
+            previous[i] = current[i];
+            count++;
+            minColumn = column < minColumn ? column : minColumn;
+            maxColumn = column > maxColumn ? column : maxColumn;
+            minRow = row < minRow ? row : minRow;
+            maxRow = row > maxRow ? row : maxRow;
+        }
+    }
+    if(changed) {
+        memset(changed, 0, sizeof(*changed));
+        if(count) {
+            changed->x = minColumn * tileSize;
+            changed->y = minRow * tileSize;
+            changed->width = ((maxColumn + 1) * tileSize < width ? (maxColumn + 1) * tileSize : width) - changed->x;
+            changed->height = ((maxRow + 1) * tileSize < height ? (maxRow + 1) * tileSize : height) - changed->y;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,42 @@
+//
+//  CatTileHash.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/30/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Change detection for a rendered RGBA buffer. The buffer is cut into
+//  square tiles, each hashed on its own, so comparing two frames is a
+//  compare of a few hundred words and the tiles that differ tell where
+//  the page changed. Plain C, no Apple dependency.
+//
+
+#ifndef CatBrowser_CatTileHash_h
+#define CatBrowser_CatTileHash_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int x, y, width, height;    // in pixels, empty when nothing changed
+} CatTileRect;
+
+// Tiles across and down. Edge tiles are cut short.
+size_t CatTileCount(int width, int height, int tileSize, int* columns, int* rows);
+
+// Writes one hash per tile, row major, into hashes.
+void CatTileHashRGBA(const uint8_t* pixels, int width, int height, size_t stride, int tileSize, uint64_t* hashes);
+
+// Number of tiles whose hash differs, and the pixel rect covering them.
+// previous is updated to current.
+size_t CatTileDiff(uint64_t* previous, const uint64_t* current, int width, int height, int tileSize, CatTileRect* changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,577 @@
+//
+//  CatURLMatcher.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/12/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#include "CatURLMatcher.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define kCatPackedKeyMax 8
+
+enum {
+    CatScanScheme,
+    CatScanSlash1,
+    CatScanSlash2,
+    CatScanAuthority,
+    CatScanPath,
+    CatScanRest,
+};
+
+typedef struct {
+    uint64_t key;
+    int rule;
+} CatPerfectSlot;
+
+// Collision free multiplicative hash over keys packed in a uint64_t.
+typedef struct {
+    CatPerfectSlot* slots;
+    uint64_t seed;
+    int shift;
+} CatPerfectSet;
+
+struct CatURLMatcher {
+    CatURLRule* rules;
+    size_t ruleCount;
+
+    CatPerfectSet extensions;
+    CatPerfectSet schemes;
+
+    // Aho-Corasick automaton over substring rules, flattened into a DFA
+    // over byte classes so a scan step is a single table load.
+    uint8_t classes[256];
+    int classCount;
+    int16_t* transitions;
+    int16_t* outputs;
+    int stateCount;
+
+    const char* exclusions[kCatURLMaxExclusions];
+    size_t exclusionLengths[kCatURLMaxExclusions];
+    int exclusionRules[kCatURLMaxExclusions];
+    int exclusionCount;
+
+    int* hostRules;
+    int hostRuleCount;
+    int allowRuleCount;
+};
+
+static inline uint8_t CatLower(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+
+static int CatPackKey(const char* pattern, uint64_t* key)
+{
+    size_t length = strlen(pattern);
+    if(length == 0 || length > kCatPackedKeyMax) {
+        return 0;
+    }
+    uint64_t packed = 0;
+    for(size_t i = 0; i < length; i++) {
+        packed = (packed << 8) | CatLower((uint8_t)pattern[i]);
+    }
+    *key = packed;
+    return 1;
+}
+
+static inline size_t CatPerfectIndex(const CatPerfectSet* set, uint64_t key)
+{
+    return (size_t)((key * set->seed) >> set->shift);
+}
+
+static inline int CatPerfectLookup(const CatPerfectSet* set, uint64_t key)
+{
+    const CatPerfectSlot* slot = &set->slots[CatPerfectIndex(set, key)];
+    return slot->key == key ? slot->rule : kCatURLNoRule;
+}
+
+static uint64_t CatNextSeed(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (z ^ (z >> 31)) | 1;
+}
+
+static int CatPerfectBuild(CatPerfectSet* set, const uint64_t* keys, const int* rules, size_t count)
+{
+    int bits = 3;
+    while(((size_t)1 << bits) < count * 2) {
+        bits++;
+    }
+    uint64_t seedState = 0;
+    for(;;) {
+        size_t size = (size_t)1 << bits;
+        set->slots = malloc(size * sizeof(CatPerfectSlot));
+        if(!set->slots) {
+            return 0;
+        }
+        set->shift = 64 - bits;
+        for(int attempt = 0; attempt < 256; attempt++) {
+            set->seed = CatNextSeed(&seedState);
+            for(size_t i = 0; i < size; i++) {
+                set->slots[i].key = 0;
+                set->slots[i].rule = kCatURLNoRule;
+            }
+            size_t i = 0;
+            for(; i < count; i++) {
+                CatPerfectSlot* slot = &set->slots[CatPerfectIndex(set, keys[i])];
+                if(slot->rule != kCatURLNoRule) {
+                    if(slot->key == keys[i]) {
+                        continue;   // duplicate pattern, first rule wins
+                    }
+                    break;
+                }
+                slot->key = keys[i];
+                slot->rule = rules[i];
+            }
+            if(i == count) {
+                return 1;
+            }
+        }
+        free(set->slots);
+        set->slots = NULL;
+        bits++;
+    }
+}
+
+static int CatBuildAutomaton(CatURLMatcher* matcher)
+{
+    size_t totalLength = 0;
+    for(size_t r = 0; r < matcher->ruleCount; r++) {
+        if(matcher->rules[r].kind == CatURLRuleSubstring) {
+            const char* pattern = matcher->rules[r].pattern;
+            totalLength += strlen(pattern);
+            for(const char* c = pattern; *c; c++) {
+                uint8_t lower = CatLower((uint8_t)*c);
+                if(!matcher->classes[lower]) {
+                    matcher->classes[lower] = (uint8_t)++matcher->classCount;
+                    if(lower >= 'a' && lower <= 'z') {
+                        matcher->classes[lower - ('a' - 'A')] = matcher->classes[lower];
+                    }
+                }
+            }
+        }
+    }
+    matcher->classCount++;  // class 0 is every byte that appears in no pattern
+    if(totalLength + 1 > INT16_MAX) {
+        return 0;
+    }
+
+    int classCount = matcher->classCount;
+    int maxStates = (int)totalLength + 1;
+    matcher->transitions = malloc(sizeof(int16_t) * maxStates * classCount);
+    matcher->outputs = malloc(sizeof(int16_t) * maxStates);
+    int16_t* fail = malloc(sizeof(int16_t) * maxStates);
+    int16_t* queue = malloc(sizeof(int16_t) * maxStates);
+    if(!matcher->transitions || !matcher->outputs || !fail || !queue) {
+        free(fail);
+        free(queue);
+        return 0;
+    }
+    for(int i = 0; i < maxStates * classCount; i++) {
+        matcher->transitions[i] = -1;
+    }
+    for(int i = 0; i < maxStates; i++) {
+        matcher->outputs[i] = kCatURLNoRule;
+    }
+    matcher->stateCount = 1;
+
+    for(size_t r = 0; r < matcher->ruleCount; r++) {
+        if(matcher->rules[r].kind != CatURLRuleSubstring) {
+            continue;
+        }
+        int state = 0;
+        for(const char* c = matcher->rules[r].pattern; *c; c++) {
+            int16_t* next = &matcher->transitions[state * classCount + matcher->classes[(uint8_t)*c]];
+            if(*next < 0) {
+                *next = (int16_t)matcher->stateCount++;
+            }
+            state = *next;
+        }
+        if(matcher->outputs[state] == kCatURLNoRule) {
+            matcher->outputs[state] = (int16_t)r;
+        }
+    }
+
+    // Breadth first: fill fail links and turn missing edges into DFA edges.
+    int head = 0, tail = 0;
+    for(int c = 0; c < classCount; c++) {
+        int16_t* next = &matcher->transitions[c];
+        if(*next < 0) {
+            *next = 0;
+        }
+        else {
+            fail[*next] = 0;
+            queue[tail++] = *next;
+        }
+    }
+    while(head < tail) {
+        int state = queue[head++];
+        int16_t fallback = fail[state];
+        int16_t inherited = matcher->outputs[fallback];
+        if(inherited != kCatURLNoRule && (matcher->outputs[state] == kCatURLNoRule || inherited < matcher->outputs[state])) {
+            matcher->outputs[state] = inherited;
+        }
+        for(int c = 0; c < classCount; c++) {
+            int16_t* next = &matcher->transitions[state * classCount + c];
+            if(*next < 0) {
+                *next = matcher->transitions[fallback * classCount + c];
+            }
+            else {
+                fail[*next] = matcher->transitions[fallback * classCount + c];
+                queue[tail++] = *next;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+    return 1;
+}
+
+static int CatBuildSet(CatURLMatcher* matcher, CatPerfectSet* set, CatURLRuleKind kind)
+{
+    uint64_t* keys = malloc(sizeof(uint64_t) * (matcher->ruleCount + 1));
+    int* rules = malloc(sizeof(int) * (matcher->ruleCount + 1));
+    size_t count = 0;
+    int ok = keys && rules;
+    for(size_t r = 0; ok && r < matcher->ruleCount; r++) {
+        if(matcher->rules[r].kind == kind) {
+            ok = CatPackKey(matcher->rules[r].pattern, &keys[count]);
+            rules[count++] = (int)r;
+        }
+    }
+    ok = ok && CatPerfectBuild(set, keys, rules, count);
+    free(keys);
+    free(rules);
+    return ok;
+}
+
+CatURLMatcher* CatURLMatcherCreate(const CatURLRule* rules, size_t count)
+{
+    if(count > INT16_MAX) {
+        return NULL;
+    }
+    CatURLMatcher* matcher = calloc(1, sizeof(CatURLMatcher));
+    if(!matcher) {
+        return NULL;
+    }
+    matcher->rules = calloc(count ? count : 1, sizeof(CatURLRule));
+    if(!matcher->rules) {
+        CatURLMatcherRelease(matcher);
+        return NULL;
+    }
+    for(size_t r = 0; r < count; r++) {
+        const char* pattern = rules[r].pattern ? rules[r].pattern : "";
+        char* copy = malloc(strlen(pattern) + 1);
+        if(!copy || (!*pattern && rules[r].kind != CatURLRuleExclude)) {
+            free(copy);
+            CatURLMatcherRelease(matcher);
+            return NULL;
+        }
+        strcpy(copy, pattern);
+        matcher->rules[r].kind = rules[r].kind;
+        matcher->rules[r].pattern = copy;
+        matcher->ruleCount = r + 1;
+
+        if(rules[r].kind == CatURLRuleExclude) {
+            if(matcher->exclusionCount == kCatURLMaxExclusions) {
+                CatURLMatcherRelease(matcher);
+                return NULL;
+            }
+            matcher->exclusions[matcher->exclusionCount] = copy;
+            matcher->exclusionLengths[matcher->exclusionCount] = strlen(copy);
+            matcher->exclusionRules[matcher->exclusionCount] = (int)r;
+            matcher->exclusionCount++;
+        }
+    }
+    matcher->hostRules = malloc(sizeof(int) * (count ? count : 1));
+    if(!matcher->hostRules) {
+        CatURLMatcherRelease(matcher);
+        return NULL;
+    }
+    for(size_t r = 0; r < count; r++) {
+        if(rules[r].kind == CatURLRuleDenyHost || rules[r].kind == CatURLRuleAllowHost) {
+            for(char* c = (char*)matcher->rules[r].pattern; *c; c++) {
+                *c = (char)CatLower((uint8_t)*c);
+            }
+            matcher->hostRules[matcher->hostRuleCount++] = (int)r;
+            if(rules[r].kind == CatURLRuleAllowHost) {
+                matcher->allowRuleCount++;
+            }
+        }
+    }
+    if(!CatBuildSet(matcher, &matcher->extensions, CatURLRuleExtension)
+       || !CatBuildSet(matcher, &matcher->schemes, CatURLRuleScheme)
+       || !CatBuildAutomaton(matcher)) {
+        CatURLMatcherRelease(matcher);
+        return NULL;
+    }
+    return matcher;
+}
+
+void CatURLMatcherRelease(CatURLMatcher* matcher)
+{
+    if(!matcher) {
+        return;
+    }
+    for(size_t r = 0; r < matcher->ruleCount; r++) {
+        free((char*)matcher->rules[r].pattern);
+    }
+    free(matcher->rules);
+    free(matcher->extensions.slots);
+    free(matcher->schemes.slots);
+    free(matcher->transitions);
+    free(matcher->outputs);
+    free(matcher->hostRules);
+    free(matcher);
+}
+
+size_t CatURLMatcherRuleCount(const CatURLMatcher* matcher)
+{
+    return matcher->ruleCount;
+}
+
+const CatURLRule* CatURLMatcherRuleAt(const CatURLMatcher* matcher, size_t index)
+{
+    return index < matcher->ruleCount ? &matcher->rules[index] : NULL;
+}
+
+void CatURLScanBegin(CatURLScan* scan, const CatURLMatcher* matcher)
+{
+    scan->matcher = matcher;
+    scan->consumed = 0;
+    scan->phase = CatScanScheme;
+    scan->state = 0;
+    scan->included = kCatURLNoRule;
+    scan->exclusions = matcher->exclusionCount == 64 ? ~0ULL : ((1ULL << matcher->exclusionCount) - 1);
+    scan->key = 0;
+    scan->keyLength = 0;
+    scan->hasDot = 0;
+    scan->hostDone = matcher->hostRuleCount == 0;
+    scan->hostBlocked = 0;
+    scan->hostRule = kCatURLNoRule;
+    scan->hostLength = 0;
+}
+
+static inline void CatScanInclude(CatURLScan* scan, int rule)
+{
+    if(rule != kCatURLNoRule && scan->included == kCatURLNoRule) {
+        scan->included = rule;
+    }
+}
+
+static inline void CatScanFinishExtension(CatURLScan* scan)
+{
+    if(scan->hasDot && scan->keyLength > 0 && scan->keyLength <= kCatPackedKeyMax) {
+        CatScanInclude(scan, CatPerfectLookup(&scan->matcher->extensions, scan->key));
+    }
+}
+
+// True when host is pattern or a subdomain of it.
+static int CatHostMatches(const char* host, size_t hostLength, const char* pattern)
+{
+    size_t length = strlen(pattern);
+    if(length > hostLength || memcmp(host + hostLength - length, pattern, length) != 0) {
+        return 0;
+    }
+    return length == hostLength || host[hostLength - length - 1] == '.';
+}
+
+static void CatScanFinishHost(CatURLScan* scan, int hasHost)
+{
+    const CatURLMatcher* matcher = scan->matcher;
+    scan->hostDone = 1;
+    if(!hasHost || !matcher->hostRuleCount || scan->hostLength > kCatURLMaxHostLength) {
+        return;
+    }
+    int allowed = matcher->allowRuleCount == 0;
+    for(int i = 0; i < matcher->hostRuleCount; i++) {
+        const CatURLRule* rule = &matcher->rules[matcher->hostRules[i]];
+        if(!CatHostMatches(scan->host, scan->hostLength, rule->pattern)) {
+            continue;
+        }
+        if(rule->kind == CatURLRuleDenyHost) {
+            scan->hostBlocked = 1;
+            scan->hostRule = matcher->hostRules[i];
+            return;
+        }
+        allowed = 1;
+    }
+    scan->hostBlocked = !allowed;
+}
+
+static inline void CatScanPushHost(CatURLScan* scan, uint8_t c)
+{
+    if(scan->hostLength < kCatURLMaxHostLength) {
+        scan->host[scan->hostLength] = (char)CatLower(c);
+    }
+    scan->hostLength++;
+}
+
+static inline void CatScanPushKey(CatURLScan* scan, uint8_t c)
+{
+    if(scan->keyLength < kCatPackedKeyMax) {
+        scan->key = (scan->key << 8) | CatLower(c);
+        scan->keyLength++;
+    }
+    else {
+        scan->keyLength = kCatPackedKeyMax + 1;
+    }
+}
+
+static inline int CatIsSchemeChar(uint8_t c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+        || c == '+' || c == '-' || c == '.';
+}
+
+int CatURLScanFeed(CatURLScan* scan, const char* bytes, size_t length)
+{
+    const CatURLMatcher* matcher = scan->matcher;
+    const int16_t* transitions = matcher->transitions;
+    const int16_t* outputs = matcher->outputs;
+    const int classCount = matcher->classCount;
+    int state = scan->state;
+
+    for(size_t i = 0; i < length; i++) {
+        uint8_t c = (uint8_t)bytes[i];
+
+        state = transitions[state * classCount + matcher->classes[c]];
+        if(outputs[state] != kCatURLNoRule) {
+            CatScanInclude(scan, outputs[state]);
+        }
+
+        if(scan->exclusions) {
+            uint64_t live = scan->exclusions;
+            while(live) {
+                int e = __builtin_ctzll(live);
+                live &= live - 1;
+                if(scan->consumed >= matcher->exclusionLengths[e] || (uint8_t)matcher->exclusions[e][scan->consumed] != c) {
+                    scan->exclusions &= ~(1ULL << e);
+                }
+            }
+        }
+        scan->consumed++;
+
+        switch(scan->phase) {
+            case CatScanScheme:
+                if(c == ':') {
+                    if(scan->keyLength > 0 && scan->keyLength <= kCatPackedKeyMax) {
+                        CatScanInclude(scan, CatPerfectLookup(&matcher->schemes, scan->key));
+                    }
+                    scan->phase = CatScanSlash1;
+                }
+                else if(CatIsSchemeChar(c)) {
+                    CatScanPushKey(scan, c);
+                }
+                else {
+                    scan->phase = CatScanRest;
+                    CatScanFinishHost(scan, 0);
+                }
+                break;
+            case CatScanSlash1:
+                scan->phase = c == '/' ? CatScanSlash2 : CatScanRest;
+                if(scan->phase == CatScanRest) {
+                    CatScanFinishHost(scan, 0);
+                }
+                break;
+            case CatScanSlash2:
+                scan->phase = c == '/' ? CatScanAuthority : CatScanRest;
+                if(scan->phase == CatScanRest) {
+                    CatScanFinishHost(scan, 0);
+                }
+                break;
+            case CatScanAuthority:
+                if(c == '/' || c == '?' || c == '#') {
+                    CatScanFinishHost(scan, 1);
+                    scan->phase = c == '/' ? CatScanPath : CatScanRest;
+                    scan->hasDot = 0;
+                    scan->keyLength = 0;
+                }
+                else if(c == '@') {
+                    scan->hostLength = 0;   // drop the user info
+                    scan->hasDot = 0;
+                }
+                else if(c == ':') {
+                    scan->hasDot = 1;       // port follows, stop collecting the host
+                }
+                else if(!scan->hasDot) {
+                    CatScanPushHost(scan, c);
+                }
+                break;
+            case CatScanPath:
+                if(c == '/') {
+                    scan->hasDot = 0;
+                    scan->keyLength = 0;
+                }
+                else if(c == '.') {
+                    scan->hasDot = 1;
+                    scan->key = 0;
+                    scan->keyLength = 0;
+                }
+                else if(c == '?' || c == '#') {
+                    CatScanFinishExtension(scan);
+                    scan->phase = CatScanRest;
+                }
+                else if(scan->hasDot) {
+                    CatScanPushKey(scan, c);
+                }
+                break;
+            default:
+                break;
+        }
+
+        if(scan->hostDone && (scan->hostBlocked || (scan->included != kCatURLNoRule && !scan->exclusions))) {
+            scan->state = state;
+            return 1;
+        }
+    }
+    scan->state = state;
+    return 0;
+}
+
+int CatURLScanEnd(CatURLScan* scan, int* rule)
+{
+    const CatURLMatcher* matcher = scan->matcher;
+    if(scan->phase == CatScanPath) {
+        CatScanFinishExtension(scan);
+        scan->phase = CatScanRest;
+    }
+    if(!scan->hostDone) {
+        CatScanFinishHost(scan, scan->phase == CatScanAuthority);
+    }
+    uint64_t live = scan->exclusions;
+    while(live) {
+        int e = __builtin_ctzll(live);
+        live &= live - 1;
+        if(matcher->exclusionLengths[e] == scan->consumed) {
+            if(rule) {
+                *rule = matcher->exclusionRules[e];
+            }
+            return 0;
+        }
+    }
+    if(scan->hostBlocked) {
+        if(rule) {
+            *rule = scan->hostRule;
+        }
+        return 0;
+    }
+    if(rule) {
+        *rule = scan->included;
+    }
+    return scan->included != kCatURLNoRule;
+}
+
+int CatURLMatcherMatch(const CatURLMatcher* matcher, const char* url, size_t length, int* rule)
+{
+    CatURLScan scan;
+    CatURLScanBegin(&scan, matcher);
+    CatURLScanFeed(&scan, url, length);
+    return CatURLScanEnd(&scan, rule);
+}
@@ -0,0 +1,85 @@
+//
+//  CatURLMatcher.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/12/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Plain C rule engine deciding which URLs get a cat. It is compiled once
+//  from a rule table and then scans the URL bytes a single time, without
+//  allocating, so it can be called from every WebKit loader thread.
+//  It has no Apple dependency and builds anywhere with a C99 compiler.
+//
+
+#ifndef CatBrowser_CatURLMatcher_h
+#define CatBrowser_CatURLMatcher_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CatURLRuleExtension,    // path extension, case insensitive, at most 8 bytes ("jpg")
+    CatURLRuleScheme,       // URL scheme, case insensitive, at most 8 bytes ("data")
+    CatURLRuleSubstring,    // substring anywhere in the URL, case insensitive ("googleusercontent.com")
+    CatURLRuleExclude,      // whole URL that never matches, even if another rule does
+    CatURLRuleDenyHost,     // host or any subdomain of it never matches ("example.com")
+    CatURLRuleAllowHost,    // when present, only URLs on these hosts or their subdomains can match
+} CatURLRuleKind;
+
+typedef struct {
+    CatURLRuleKind kind;
+    const char* pattern;
+} CatURLRule;
+
+#define kCatURLNoRule (-1)
+#define kCatURLMaxExclusions 64
+#define kCatURLMaxHostLength 255
+
+typedef struct CatURLMatcher CatURLMatcher;
+
+// Compiles the rule table. Patterns are copied. Returns NULL on invalid rules.
+CatURLMatcher* CatURLMatcherCreate(const CatURLRule* rules, size_t count);
+void CatURLMatcherRelease(CatURLMatcher* matcher);
+
+size_t CatURLMatcherRuleCount(const CatURLMatcher* matcher);
+const CatURLRule* CatURLMatcherRuleAt(const CatURLMatcher* matcher, size_t index);
+
+// Incremental scan, for callers that convert the URL to UTF-8 chunk by chunk.
+// The state lives on the caller's stack.
+typedef struct {
+    const CatURLMatcher* matcher;
+    size_t consumed;
+    int phase;
+    int state;
+    int included;
+    uint64_t exclusions;
+    uint64_t key;
+    int keyLength;
+    int hasDot;
+    int hostDone;
+    int hostBlocked;
+    int hostRule;
+    size_t hostLength;
+    char host[kCatURLMaxHostLength];
+} CatURLScan;
+
+void CatURLScanBegin(CatURLScan* scan, const CatURLMatcher* matcher);
+// Returns 1 once the decision can no longer change; the rest of the URL can then be skipped.
+int CatURLScanFeed(CatURLScan* scan, const char* bytes, size_t length);
+// Returns 1 if the URL should be intercepted. The deciding rule (include,
+// exclusion or denied host) is written to rule, or kCatURLNoRule when none
+// applied or the host is missing from the allow list.
+int CatURLScanEnd(CatURLScan* scan, int* rule);
+
+// One-shot helper over a complete UTF-8 URL.
+int CatURLMatcherMatch(const CatURLMatcher* matcher, const char* url, size_t length, int* rule);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,9 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "CatFormatPolicy.h"
+
+@class CatInterceptConfig;
 
 @interface CatURLProtocol : NSURLProtocol
 + (void) register;
@@ -14,4 +17,25 @@
 + (BOOL) cat;
 + (void) setCat:(BOOL)val;
 
+// Origin request for one replacement image, marked so that it is not intercepted itself.
++ (NSMutableURLRequest*) catRequestForType:(NSString*)type;
+
+// Interception settings in effect. Replacing them is atomic: a loader thread
+// sees either the old config or the new one, never a mix.
++ (CatInterceptConfig*) config;
++ (void) setConfig:(CatInterceptConfig*)config;
++ (BOOL) setConfigWithJSONData:(NSData*)data error:(NSError**)error;
+// Reloads the config whenever the JSON file at path is (atomically) rewritten.
++ (void) watchConfigAtPath:(NSString*)path;
+
+// Picks the type of every replacement. Defaults to a CatDecodeCostPolicy.
++ (id<CatFormatPolicy>) formatPolicy;
++ (void) setFormatPolicy:(id<CatFormatPolicy>)policy;
+
+// canInitWithRequest: remembers its decisions per URL and config version.
+// @{hits, misses, stores, hitRate}
++ (NSDictionary*) decisionCacheStats;
++ (void) clearDecisionCache;
++ (void) resetDecisionCacheStats;
+
 @end
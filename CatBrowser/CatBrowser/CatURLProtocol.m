@@ -7,45 +7,312 @@
 //
 
 #import "CatURLProtocol.h"
+#import "CatURLMatcher.h"
+#import "CatDecisionCache.h"
+#import "CatImageStore.h"
+#import "CatReplacementLoader.h"
+#import "CatImagePool.h"
+#import "CatImageResizer.h"
+#import "CatInterceptConfig.h"
+#import "CatMetrics.h"
+#import "CatRedirectCache.h"
+#import "CatDecodeCostPolicy.h"
+#import "CatGIFDowngrader.h"
+#import <libkern/OSAtomic.h>
+#include <fcntl.h>
+
+// How long a replaced config stays alive for loader threads that loaded it just before the swap.
+static const int64_t kConfigGracePeriod = 10 * NSEC_PER_SEC;
+// Marks our own replacement fetches so they are not intercepted again.
+static NSString* const kReplacementProperty = @"CatBrowserReplacement";
+// Longer URLs (data: mostly) are classified every time rather than hashed whole.
+static const CFIndex kMaxCachedURLLength = 2048;
+// The pool's worker gives up on an origin fetch after this.
+static const int64_t kPoolFetchTimeout = 60 * NSEC_PER_SEC;
+
+// One replacement fetched for the pool's worker, which wants it before it
+// goes on. Goes through CatReplacementLoader, and so through the shared
+// keep-alive origin client, and lands in the image store.
+@interface CatPoolFetch : NSObject <CatReplacementLoaderDelegate>
+@end
+
+@implementation CatPoolFetch
+{
+    dispatch_semaphore_t done;
+    BOOL imageResponse;
+    BOOL succeeded;
+}
+
+// Store key of the image fetched, or nil.
++ (NSString*) fetchRequest:(NSURLRequest*)request type:(NSString*)type store:(CatImageStore*)store
+{
+    CatPoolFetch* fetch = [[CatPoolFetch alloc] init];
+    fetch->done = dispatch_semaphore_create(0);
+    CatReplacementLoader* loader = [[CatReplacementLoader alloc] initWithRequest:request type:type store:store];
+    [loader setDelegate:fetch];
+    [loader start];
+    if(dispatch_semaphore_wait(fetch->done, dispatch_time(DISPATCH_TIME_NOW, kPoolFetchTimeout))) {
+        [loader cancel];
+        return nil;
+    }
+    return fetch->succeeded ? loader.storedKey : nil;
+}
+
+- (void) loader:(CatReplacementLoader*)loader didReceiveResponse:(NSURLResponse*)response
+{
+    imageResponse = [response.MIMEType hasPrefix:@"image/"];
+}
+
+- (void) loader:(CatReplacementLoader*)loader didLoadData:(NSData*)data
+{
+}
+
+- (void) loaderDidFinishLoading:(CatReplacementLoader*)loader
+{
+    succeeded = imageResponse;
+    dispatch_semaphore_signal(done);
+}
+
+- (void) loader:(CatReplacementLoader*)loader didFailWithError:(NSError*)error
+{
+    dispatch_semaphore_signal(done);
+}
+
+@end
+
+@interface CatURLProtocol () <CatReplacementLoaderDelegate>
+@end
 
 @implementation CatURLProtocol
 {
     NSMutableURLRequest* catRequest;
+    NSString* catType;
+    CatReplacementLoader* loader;
+    NSUInteger sizeClass;
+    uint64_t startTime;
+    long long deliveredBytes;
+    NSURL* learnedURL;          // fetching a redirect target from CatRedirectCache
+    NSUInteger learnedHops;
+    BOOL imageResponse;
+    NSURLResponse* heldResponse;    // a gif to downgrade is buffered whole first
+    NSMutableData* gifData;
+    NSThread* clientThread;
+    NSArray* clientModes;
+    BOOL stopped;               // on clientThread
 }
 
 
 + (void) register
 {
     [NSURLProtocol registerClass:[self class]];
+    // Created here, on the main thread, because it reads the screen scale.
+    [CatImageResizer sharedResizer];
+    // Created early so it hears about memory warnings before the first gif.
+    [CatGIFDowngrader sharedDowngrader];
+    
+    CatImagePool* pool = [CatImagePool sharedPool];
+    [pool setSource:^NSData*(NSString* type, NSString** key) {
+        // Nothing goes to the origin, or into memory, while cats are off.
+        if(![CatURLProtocol cat]) {
+            return nil;
+        }
+        CatImageStore* store = [CatImageStore sharedStore];
+        CatImageResizer* resizer = [CatImageResizer sharedResizer];
+        if(![store needsRefillForType:type]) {
+            NSData* data = [store randomDataOfType:type key:key];
+            if(data) {
+                // Resized here, off the loading thread, for slots without a size hint.
+                [resizer dataForImage:data key:*key type:type sizeClass:resizer.defaultSizeClass];
+                // Copy out of the file mapping so serving from the pool never touches the disk.
+                return [NSData dataWithBytes:data.bytes length:data.length];
+            }
+        }
+        NSString* fetched = [CatPoolFetch fetchRequest:[CatURLProtocol catRequestForType:type] type:type store:store];
+        NSData* data = fetched ? [store dataForKey:fetched] : nil;
+        if(!data) {
+            return nil;
+        }
+        *key = fetched;
+        [resizer dataForImage:data key:fetched type:type sizeClass:resizer.defaultSizeClass];
+        return [NSData dataWithBytes:data.bytes length:data.length];
+    }];
+    // Otherwise the first setCat:YES fills it.
+    if([self cat]) {
+        [pool scheduleRefill];
+    }
+    
+    NSString* documents = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES) firstObject];
+    [self watchConfigAtPath:[documents stringByAppendingPathComponent:@"intercept.json"]];
+}
+
++ (NSMutableURLRequest*) catRequestForType:(NSString*)type
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[[self config] originURLForType:type]];
+    [NSURLProtocol setProperty:@YES forKey:kReplacementProperty inRequest:request];
+    return request;
 }
 
 
+// Current CatInterceptConfig, retained. Readers load it without locking;
+// writers swap in a new one and release the old one after a grace period.
+static void* volatile currentConfig = NULL;
+
++ (void) initialize
+{
+    if(self == [CatURLProtocol class]) {
+        [self setConfig:[CatInterceptConfig defaultConfig]];
+    }
+}
+
++ (CatInterceptConfig*) config
+{
+    return (__bridge CatInterceptConfig*)currentConfig;
+}
+
++ (void) setConfig:(CatInterceptConfig*)config
+{
+    if(!config) {
+        return;
+    }
+    @synchronized(self) {
+        void* retired = currentConfig;
+        OSAtomicCompareAndSwapPtrBarrier(retired, (void*)CFBridgingRetain(config), &currentConfig);
+        if(retired) {
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, kConfigGracePeriod), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+                CFRelease(retired);
+            });
+        }
+    }
+}
+
++ (BOOL) setConfigWithJSONData:(NSData*)data error:(NSError**)error
+{
+    CatInterceptConfig* config = [CatInterceptConfig configWithJSONData:data error:error];
+    [self setConfig:config];
+    return config != nil;
+}
+
++ (void) watchConfigAtPath:(NSString*)path
+{
+    static dispatch_source_t source = nil;
+    @synchronized(self) {
+        if(source) {
+            dispatch_source_cancel(source);
+            source = nil;
+        }
+        NSString* directory = [path stringByDeletingLastPathComponent];
+        int descriptor = open(directory.fileSystemRepresentation, O_EVTONLY);
+        if(descriptor < 0) {
+            return;
+        }
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0);
+        source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, descriptor, DISPATCH_VNODE_WRITE, queue);
+        void (^reload)(void) = ^{
+            NSData* data = [NSData dataWithContentsOfFile:path];
+            NSError* error = nil;
+            if(data && ![self setConfigWithJSONData:data error:&error]) {
+                NSLog(@"Ignoring %@: %@", path.lastPathComponent, error.localizedDescription);
+            }
+        };
+        dispatch_source_set_event_handler(source, reload);
+        dispatch_source_set_cancel_handler(source, ^{
+            close(descriptor);
+        });
+        dispatch_resume(source);
+        dispatch_async(queue, reload);
+    }
+}
+
+// Feeds the URL to the matcher in small UTF-8 chunks converted on the stack,
+// so huge data: URLs are neither copied nor scanned past the decision point.
+static BOOL matchURLString(const CatURLMatcher* matcher, CFStringRef string, int* rule)
+{
+    CatURLScan scan;
+    CatURLScanBegin(&scan, matcher);
+    const char* utf8 = CFStringGetCStringPtr(string, kCFStringEncodingUTF8);
+    if(utf8) {
+        CatURLScanFeed(&scan, utf8, strlen(utf8));
+    }
+    else {
+        UInt8 buffer[256];
+        CFIndex length = CFStringGetLength(string);
+        CFIndex location = 0;
+        while(location < length) {
+            CFIndex used = 0;
+            CFIndex converted = CFStringGetBytes(string, CFRangeMake(location, length-location), kCFStringEncodingUTF8, '?', false, buffer, sizeof(buffer), &used);
+            if(converted == 0) {
+                break;
+            }
+            location += converted;
+            if(CatURLScanFeed(&scan, (const char*)buffer, used)) {
+                break;
+            }
+        }
+    }
+    return CatURLScanEnd(&scan, rule);
+}
+
+static CatDecisionCache decisionCache;
+
+// Hashes the same UTF-8 bytes the matcher would see. NO when the URL is too
+// long to be worth caching.
+static BOOL hashURLString(CFStringRef string, uint64_t* hash)
+{
+    CFIndex length = CFStringGetLength(string);
+    if(length > kMaxCachedURLLength) {
+        return NO;
+    }
+    *hash = kCatDecisionHashSeed;
+    const char* utf8 = CFStringGetCStringPtr(string, kCFStringEncodingUTF8);
+    if(utf8) {
+        *hash = CatDecisionHash(*hash, utf8, strlen(utf8));
+        return YES;
+    }
+    UInt8 buffer[256];
+    CFIndex location = 0;
+    while(location < length) {
+        CFIndex used = 0;
+        CFIndex converted = CFStringGetBytes(string, CFRangeMake(location, length-location), kCFStringEncodingUTF8, '?', false, buffer, sizeof(buffer), &used);
+        if(converted == 0) {
+            break;
+        }
+        location += converted;
+        *hash = CatDecisionHash(*hash, buffer, used);
+    }
+    return YES;
+}
+
 + (BOOL)canInitWithRequest:(NSURLRequest *)request {
     
-    if(!cat)
+    uint64_t start = CatMetricsNow();
+    // No retain: the grace period keeps a config alive well past this call.
+    __unsafe_unretained CatInterceptConfig* config = (__bridge CatInterceptConfig*)currentConfig;
+    BOOL intercept = NO;
+    if(!config.enabled)
     {
-        return NO;
+        CatMetricsCount(CatCounterDisabled);
     }
-    
-    NSString *fileExtension = request.URL.pathExtension.lowercaseString;
-    NSString *scheme = request.URL.scheme;
-    if([fileExtension isEqualToString:@"jpg"]
-       || [fileExtension isEqualToString:@"png"]
-       || [fileExtension isEqualToString:@"gif"]
-        || [fileExtension isEqualToString:@"jpeg"]
-        || [fileExtension isEqualToString:@"bmp"]
-            || [scheme isEqualToString:@"data"]
-            || [scheme isEqualToString:@"data:image/"]
-            || [request.URL.absoluteString rangeOfString:@"://encrypted-tbn"].location!=NSNotFound
-            || [request.URL.absoluteString rangeOfString:@"googleusercontent.com"].location!=NSNotFound
-            || [request.URL.absoluteString rangeOfString:@"maps-api-ssl.google.com/maps/api/staticmap"].location!=NSNotFound)
+    else if(![NSURLProtocol propertyForKey:kReplacementProperty inRequest:request])
     {
-        if([request.URL.absoluteString isEqualToString:@"data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D"])
-            return NO;
-        return ![[[request allHTTPHeaderFields] objectForKey:@"BANANA"] isEqualToString:@"APPLE"];
+        int rule = kCatURLNoRule;
+        CFStringRef urlString = (__bridge CFStringRef)request.URL.absoluteString;
+        uint64_t hash = 0;
+        BOOL cacheable = urlString && hashURLString(urlString, &hash);
+        int cached = 0;
+        // The config version is part of the key, so a new config or the cat toggle misses.
+        if(cacheable && CatDecisionCacheLookup(&decisionCache, hash, config.version, &cached, &rule)) {
+            intercept = cached;
+        }
+        else {
+            intercept = urlString && matchURLString(config.matcher, urlString, &rule);
+            if(cacheable) {
+                CatDecisionCacheStore(&decisionCache, hash, config.version, intercept, rule);
+            }
+        }
+        [config countDecision:intercept rule:rule];
     }
-//    NSLog(@"%@",request.URL.absoluteString);
-    return NO;
+    CatMetricsRecord(CatMetricClassification, CatMetricsNow() - start);
+    return intercept;
 }
 
 + (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
@@ -53,44 +320,255 @@
 }
 
 + (BOOL)requestIsCacheEquivalent:(NSURLRequest *)a toRequest:(NSURLRequest *)b {
-    // TODO Implement this here, or expose it through WebViewProxyResponse?
-    return NO;
+    return [a.URL isEqual:b.URL];
 }
 
 
 - (id)initWithRequest:(NSURLRequest *)request cachedResponse:(NSCachedURLResponse *)cachedResponse client:(id<NSURLProtocolClient>)client {
     
+    uint64_t start = CatMetricsNow();
     if (self = [super initWithRequest:request cachedResponse:cachedResponse client:client]) {
         catRequest = request.mutableCopy;
-        [catRequest setValue:@"APPLE" forHTTPHeaderField:@"BANANA"];
+        [NSURLProtocol setProperty:@YES forKey:kReplacementProperty inRequest:catRequest];
         
-        NSString* type = arc4random()%3==0?@"gif":arc4random()%2==0?@"jpg":@"png";
+        CatInterceptConfig* config = [CatURLProtocol config];
+        sizeClass = [[CatImageResizer sharedResizer] sizeClassForURL:request.URL];
+        NSString* type = [[CatURLProtocol formatPolicy] typeForURL:request.URL sizeClass:sizeClass config:config];
+        catType = type;
         
-        [catRequest setURL:[NSURL URLWithString:[@"http://thecatapi.com/api/images/get?format=src&type=" stringByAppendingString:type]]];
+        [catRequest setURL:[config originURLForType:type]];
 //        NSLog(@"%@ >> %@",request.URL.absoluteString,catRequest.URL.absoluteString);
     }
+    CatMetricsRecord(CatMetricSetup, CatMetricsNow() - start);
     return self;
 }
 
 - (void)startLoading {
-    [NSURLConnection sendAsynchronousRequest:catRequest queue:[NSOperationQueue mainQueue] completionHandler:^(NSURLResponse *netRes, NSData *data, NSError *netErr) {
+    startTime = CatMetricsNow();
+    clientThread = [NSThread currentThread];
+    NSString* mode = [[NSRunLoop currentRunLoop] currentMode];
+    clientModes = mode && ![mode isEqualToString:NSDefaultRunLoopMode] ? @[NSDefaultRunLoopMode, mode] : @[NSDefaultRunLoopMode];
+    NSString* key = nil;
+    NSData* pooled = [[CatImagePool sharedPool] takeImageOfType:catType key:&key];
+    if(pooled) {
+        CatMetricsCount(CatCounterPool);
+        [self deliverData:pooled key:key MIMEType:[CatImageStore MIMETypeForType:catType]];
+        return;
+    }
+    
+    CatImageStore* store = [CatImageStore sharedStore];
+    if(![store needsRefillForType:catType]) {
+        NSData* data = [store randomDataOfType:catType key:&key];
+        if(data) {
+            CatMetricsCount(CatCounterStore);
+            [self deliverData:data key:key MIMEType:[CatImageStore MIMETypeForType:catType]];
+            return;
+        }
+    }
+    
+    // A redirect target learned earlier skips the origin, and the network
+    // altogether when its body is still in the store.
+    CatRedirectCache* redirects = [CatRedirectCache sharedCache];
+    NSString* storeKey = nil;
+    learnedURL = [redirects URLForType:catType hops:&learnedHops storeKey:&storeKey];
+    if(learnedURL) {
+        NSData* data = storeKey ? [store dataForKey:storeKey] : nil;
+        if(data) {
+            [redirects countSavedRoundTrips:learnedHops + 1];
+            CatMetricsCount(CatCounterStore);
+            [self deliverData:data key:storeKey MIMEType:[CatImageStore MIMETypeForType:catType]];
+            return;
+        }
+        [catRequest setURL:learnedURL];
+    }
+    
+    CatMetricsCount(CatCounterNetwork);
+    loader = [[CatReplacementLoader alloc] initWithRequest:catRequest type:catType store:store];
+    [loader setDelegate:self];
+    [loader start];
+}
+
+- (void) loader:(CatReplacementLoader*)aLoader didReceiveResponse:(NSURLResponse*)response
+{
+    imageResponse = [response.MIMEType hasPrefix:@"image/"];
+    if(imageResponse && [catType isEqualToString:@"gif"] && [CatGIFDowngrader sharedDowngrader].activeMode != CatGIFDowngradeNone) {
+        heldResponse = response;
+        gifData = [NSMutableData data];
+        return;
+    }
+    [self onClientThread:^{
+        [[self client] URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    }];
+}
+
+- (void) loader:(CatReplacementLoader*)aLoader didLoadData:(NSData*)data
+{
+    if(gifData) {
+        [gifData appendData:data];
+        return;
+    }
+    if(!deliveredBytes && data.length) {
+        CatMetricsRecord(CatMetricFirstByte, CatMetricsNow() - startTime);
+    }
+    deliveredBytes += data.length;
+    [self onClientThread:^{
+        [[self client] URLProtocol:self didLoadData:data];
+    }];
+}
+
+- (void) loaderDidFinishLoading:(CatReplacementLoader*)aLoader
+{
+    CatRedirectCache* redirects = [CatRedirectCache sharedCache];
+    if(!imageResponse) {
+        [redirects forgetURL:learnedURL];
+    }
+    else if(learnedURL) {
+        [redirects countSavedRoundTrips:learnedHops];
+    }
+    else {
+        [redirects learnURL:aLoader.finalURL type:catType hops:aLoader.redirects storeKey:aLoader.storedKey];
+    }
+    NSData* downgraded = nil;
+    NSURLResponse* response = nil;
+    if(gifData) {
+        downgraded = [[CatGIFDowngrader sharedDowngrader] dataForGIF:gifData key:aLoader.storedKey sizeClass:sizeClass];
+        gifData = nil;
+        response = [[NSURLResponse alloc] initWithURL:heldResponse.URL MIMEType:heldResponse.MIMEType expectedContentLength:downgraded.length textEncodingName:nil];
+        CatMetricsRecord(CatMetricFirstByte, CatMetricsNow() - startTime);
+        deliveredBytes = downgraded.length;
+    }
+    id<CatFormatPolicy> policy = [CatURLProtocol formatPolicy];
+    if((downgraded || aLoader.storedKey) && [policy respondsToSelector:@selector(didDeliverData:type:sizeClass:)]) {
+        [policy didDeliverData:downgraded ?: [[CatImageStore sharedStore] dataForKey:aLoader.storedKey] type:catType sizeClass:sizeClass];
+    }
+    [self recordFinish];
+    [self onClientThread:^{
         id<NSURLProtocolClient> client = [self client];
-        [client URLProtocol:self didReceiveResponse:netRes cacheStoragePolicy:[catRequest cachePolicy]];
-        [client URLProtocol:self didLoadData:data];
+        if(response) {
+            [client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+            [client URLProtocol:self didLoadData:downgraded];
+        }
         [client URLProtocolDidFinishLoading:self];
     }];
 }
 
+- (void) loader:(CatReplacementLoader*)aLoader didFailWithError:(NSError*)error
+{
+    CatMetricsCount(CatCounterFailed);
+    if(learnedURL) {
+        [[CatRedirectCache sharedCache] forgetURL:learnedURL];
+    }
+    [self onClientThread:^{
+        [[self client] URLProtocol:self didFailWithError:error];
+    }];
+}
+
+// The loader calls back on its network queue, but the client belongs to
+// the thread that started loading. Calls go there in order, and are
+// dropped once stopLoading has run on it.
+- (void) onClientThread:(dispatch_block_t)block
+{
+    [self performSelector:@selector(runOnClientThread:) onThread:clientThread withObject:[block copy] waitUntilDone:NO modes:clientModes];
+}
+
+- (void) runOnClientThread:(dispatch_block_t)block
+{
+    if(!stopped) {
+        block();
+    }
+}
+
+- (void) recordFinish
+{
+    CatMetricsRecord(CatMetricFetch, CatMetricsNow() - startTime);
+    CatMetricsRecord(CatMetricBytes, deliveredBytes);
+}
+
+// Key is the image's store key. A missing variant is made in the background
+// for next time; this request gets the original rather than wait for it.
+- (void)deliverData:(NSData*)data key:(NSString*)key MIMEType:(NSString*)MIMEType
+{
+    CatImageResizer* resizer = [CatImageResizer sharedResizer];
+    NSData* variant = [resizer variantForKey:key type:catType sizeClass:sizeClass];
+    if(variant) {
+        data = variant;
+    }
+    else {
+        [resizer prepareVariantOfData:data key:key type:catType sizeClass:sizeClass];
+    }
+    if([catType isEqualToString:@"gif"]) {
+        data = [[CatGIFDowngrader sharedDowngrader] dataForGIF:data key:key sizeClass:sizeClass];
+    }
+    id<CatFormatPolicy> policy = [CatURLProtocol formatPolicy];
+    if([policy respondsToSelector:@selector(didDeliverData:type:sizeClass:)]) {
+        [policy didDeliverData:data type:catType sizeClass:sizeClass];
+    }
+    NSURLResponse* response = [[NSURLResponse alloc] initWithURL:self.request.URL MIMEType:MIMEType expectedContentLength:data.length textEncodingName:nil];
+    id<NSURLProtocolClient> client = [self client];
+    [client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    CatMetricsRecord(CatMetricFirstByte, CatMetricsNow() - startTime);
+    deliveredBytes = data.length;
+    [client URLProtocol:self didLoadData:data];
+    [self recordFinish];
+    [client URLProtocolDidFinishLoading:self];
+}
 
 - (void)stopLoading {
+    stopped = YES;
+    [loader cancel];
+    loader = nil;
 }
 
-static BOOL cat = YES;
+static id<CatFormatPolicy> formatPolicy = nil;
+
++ (id<CatFormatPolicy>) formatPolicy
+{
+    @synchronized(self) {
+        if(!formatPolicy) {
+            formatPolicy = [[CatDecodeCostPolicy alloc] init];
+        }
+        return formatPolicy;
+    }
+}
+
++ (void) setFormatPolicy:(id<CatFormatPolicy>)policy
+{
+    @synchronized(self) {
+        formatPolicy = policy;
+    }
+}
+
++ (NSDictionary*) decisionCacheStats
+{
+    uint64_t hits, misses, stores;
+    CatDecisionCacheStats(&decisionCache, &hits, &misses, &stores);
+    return @{
+        @"hits": @(hits),
+        @"misses": @(misses),
+        @"stores": @(stores),
+        @"hitRate": @(hits + misses ? (double)hits / (hits + misses) : 0),
+    };
+}
+
++ (void) clearDecisionCache
+{
+    CatDecisionCacheClear(&decisionCache);
+}
+
++ (void) resetDecisionCacheStats
+{
+    CatDecisionCacheResetStats(&decisionCache);
+}
 
 + (BOOL) cat
-{ @synchronized(self) { return cat; } }
+{ return [self config].enabled; }
 + (void) setCat:(BOOL)val
-{ @synchronized(self) { cat = val; } }
+{
+    @synchronized(self) { [self setConfig:[[self config] configWithEnabled:val]]; }
+    if(val) {
+        [[CatImagePool sharedPool] scheduleRefill];
+    }
+}
 
 
 @end
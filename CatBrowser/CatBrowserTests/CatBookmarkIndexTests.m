@@ -0,0 +1,124 @@
+//
+//  CatBookmarkIndexTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/4/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Writing and reading back, damaged files, then the time to open and
+//  search indexes of 10k and 100k bookmarks.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatBookmarkIndex.h"
+#import "CatMetrics.h"
+
+@interface CatBookmarkIndexTests : XCTestCase
+@end
+
+@implementation CatBookmarkIndexTests
+{
+    NSString* path;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+    [super tearDown];
+}
+
+// Locations like http://site7.example.com/cats/1234, no thumbnail on even ones.
+- (void)writeBookmarks:(NSUInteger)count
+{
+    CatBookmark* bookmarks = calloc(count, sizeof(CatBookmark));
+    char (*locations)[64] = malloc(count * 64);
+    for(NSUInteger i=0; i<count; i++) {
+        int length = snprintf(locations[i], 64, "http://site%lu.example.com/cats/%lu", (unsigned long)(i % 977), (unsigned long)i);
+        bookmarks[i] = (CatBookmark){ locations[i], length, "Cats", 4, i % 2 ? "cats.jpg" : "", i % 2 ? 8 : 0 };
+    }
+    XCTAssertEqual(CatBookmarkIndexWrite(path.fileSystemRepresentation, 7, bookmarks, count), 0);
+    free(bookmarks);
+    free(locations);
+}
+
+- (long)find:(NSString*)location in:(CatBookmarkIndex*)index
+{
+    return CatBookmarkIndexFind(index, location.UTF8String, strlen(location.UTF8String));
+}
+
+- (void)testWritesAndReads
+{
+    [self writeBookmarks:1000];
+    CatBookmarkIndex* index = CatBookmarkIndexOpen(path.fileSystemRepresentation);
+    XCTAssertTrue(index != NULL);
+    XCTAssertEqual(CatBookmarkIndexCount(index), (size_t)1000);
+    XCTAssertEqual(CatBookmarkIndexGeneration(index), 7ULL);
+    XCTAssertEqual([self find:@"http://site5.example.com/cats/5" in:index], 5L);
+    XCTAssertEqual([self find:@"http://site5.example.com/cats/6" in:index], -1L);
+
+    CatBookmark bookmark;
+    XCTAssertEqual(CatBookmarkIndexGet(index, 999, &bookmark), 1);
+    XCTAssertEqualObjects([[NSString alloc] initWithBytes:bookmark.location length:bookmark.locationLength encoding:NSUTF8StringEncoding],
+                          @"http://site22.example.com/cats/999");
+    XCTAssertEqual(bookmark.thumbnailLength, (size_t)8);
+    XCTAssertEqual(CatBookmarkIndexGet(index, 1000, &bookmark), 0);
+    CatBookmarkIndexClose(index);
+
+    XCTAssertEqual(CatBookmarkIndexWrite(path.fileSystemRepresentation, 8, NULL, 0), 0);
+    index = CatBookmarkIndexOpen(path.fileSystemRepresentation);
+    XCTAssertEqual(CatBookmarkIndexCount(index), (size_t)0);
+    XCTAssertEqual([self find:@"http://site5.example.com/cats/5" in:index], -1L);
+    CatBookmarkIndexClose(index);
+}
+
+- (void)testRejectsDamagedFiles
+{
+    [@"{\"favorites\":[]}" writeToFile:path atomically:NO encoding:NSUTF8StringEncoding error:NULL];
+    XCTAssertTrue(CatBookmarkIndexOpen(path.fileSystemRepresentation) == NULL);
+    XCTAssertEqual(errno, EILSEQ);
+
+    [self writeBookmarks:100];
+    NSFileHandle* file = [NSFileHandle fileHandleForWritingAtPath:path];
+    [file truncateFileAtOffset:[file seekToEndOfFile] - 1];
+    [file closeFile];
+    XCTAssertTrue(CatBookmarkIndexOpen(path.fileSystemRepresentation) == NULL);
+    XCTAssertEqual(errno, EILSEQ);
+}
+
+- (void)benchmark:(NSUInteger)count
+{
+    [self writeBookmarks:count];
+    const int opens = 1000;
+    uint64_t start = CatMetricsNow();
+    for(int i=0; i<opens; i++) {
+        CatBookmarkIndexClose(CatBookmarkIndexOpen(path.fileSystemRepresentation));
+    }
+    double openMicroseconds = (CatMetricsNow() - start) / opens / 1e3;
+
+    CatBookmarkIndex* index = CatBookmarkIndexOpen(path.fileSystemRepresentation);
+    char location[64];
+    start = CatMetricsNow();
+    for(NSUInteger i=0; i<count; i++) {
+        int length = snprintf(location, sizeof(location), "http://site%lu.example.com/cats/%lu", (unsigned long)(i % 977), (unsigned long)i);
+        XCTAssertEqual(CatBookmarkIndexFind(index, location, length), (long)i);
+    }
+    double findNanoseconds = (CatMetricsNow() - start) / (double)count;
+    CatBookmarkIndexClose(index);
+    NSLog(@"%lu bookmarks: open %.1fus, find %.0fns", (unsigned long)count, openMicroseconds, findNanoseconds);
+    // Opening does not read the bookmarks.
+    XCTAssertTrue(openMicroseconds < 1000);
+}
+
+- (void)testBenchmarkOpen
+{
+    [self benchmark:10000];
+    [self benchmark:100000];
+}
+
+@end
@@ -0,0 +1,248 @@
+//
+//  CatBookmarkStoreTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/3/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Reading an old bookmark.txt, journaling and reopening, recovery from a
+//  torn line and from a compaction cut short, lists over a snapshot and
+//  changes, feeding the suggestion engine, then a thousand toggles over a
+//  thousand bookmarks.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatBookmarkStore.h"
+#import "CatMetrics.h"
+#import "CatSuggestionEngine.h"
+
+@interface CatBookmarkStoreTests : XCTestCase
+@end
+
+@implementation CatBookmarkStoreTests
+{
+    NSString* directory;
+    CatBookmarkStore* store;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
+}
+
+- (void)tearDown
+{
+    [store waitUntilWritten];
+    store = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+    [super tearDown];
+}
+
+// The store opens in the background; lists are empty until it has.
+- (void)reopen
+{
+    [store waitUntilWritten];
+    store = [[CatBookmarkStore alloc] initWithDirectory:directory];
+    [store waitUntilWritten];
+}
+
+- (NSArray*)locations
+{
+    return [[store favorites] valueForKey:@"location"];
+}
+
+- (NSDictionary*)entry:(int)i
+{
+    return @{@"title": [NSString stringWithFormat:@"Cats %d", i], @"location": [NSString stringWithFormat:@"http://example.com/%d", i]};
+}
+
+- (void)writeLegacyFile
+{
+    NSDictionary* dico = @{@"favorites": @[@{@"title": @"Kittens", @"location": @"http://kittens.com/", @"thumbnail": @"kittens.jpg"},
+                                           @{@"title": @"Cats", @"location": @"http://cats.com/"}]};
+    NSData* data = [NSJSONSerialization dataWithJSONObject:dico options:NSJSONWritingPrettyPrinted error:NULL];
+    [data writeToFile:[directory stringByAppendingPathComponent:@"bookmark.txt"] atomically:YES];
+}
+
+- (void)testReadsLegacyFileAndJournals
+{
+    [self writeLegacyFile];
+    [self reopen];
+    NSArray* expected = @[@"http://kittens.com/", @"http://cats.com/"];
+    XCTAssertEqualObjects([self locations], expected);
+    XCTAssertEqual(store.generation, 0ULL);
+
+    NSData* before = [NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:@"bookmark.txt"]];
+    [store setBookmark:@{@"title": @"Tigers", @"location": @"http://tigers.com/", @"thumbnail": @"tigers.jpg"}
+             thumbnail:[@"jpeg" dataUsingEncoding:NSUTF8StringEncoding]];
+    [store setBookmark:@{@"title": @"Big cats", @"location": @"http://cats.com/"} thumbnail:nil];
+    [store removeBookmarkAtLocation:@"http://kittens.com/"];
+    [store waitUntilWritten];
+    // The snapshot is left alone; the thumbnail is written.
+    XCTAssertEqualObjects([NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:@"bookmark.txt"]], before);
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[directory stringByAppendingPathComponent:@"tigers.jpg"]]);
+    XCTAssertEqual(store.journalRecords, (NSUInteger)3);
+
+    [self reopen];
+    expected = @[@"http://tigers.com/", @"http://cats.com/"];
+    XCTAssertEqualObjects([self locations], expected);
+    XCTAssertEqualObjects([store favorites][1][@"title"], @"Big cats");
+    XCTAssertEqual(store.journalRecords, (NSUInteger)3);
+}
+
+- (void)testTornLine
+{
+    [self reopen];
+    [store setBookmark:[self entry:1] thumbnail:nil];
+    [store waitUntilWritten];
+    store = nil;
+
+    NSString* journalPath = [directory stringByAppendingPathComponent:@"bookmark.journal"];
+    NSFileHandle* file = [NSFileHandle fileHandleForWritingAtPath:journalPath];
+    [file seekToEndOfFile];
+    [file writeData:[@"{\"set\":{\"location\":\"http://exa" dataUsingEncoding:NSUTF8StringEncoding]];
+    [file closeFile];
+
+    [self reopen];
+    NSArray* expected = @[@"http://example.com/1"];
+    XCTAssertEqualObjects([self locations], expected);
+    [store setBookmark:[self entry:2] thumbnail:nil];
+    [self reopen];
+    expected = @[@"http://example.com/2", @"http://example.com/1"];
+    XCTAssertEqualObjects([self locations], expected);
+}
+
+- (void)testCompactionCutShort
+{
+    [self reopen];
+    for(int i=0; i<5; i++) {
+        [store setBookmark:[self entry:i] thumbnail:nil];
+    }
+    [store waitUntilWritten];
+    NSString* journalPath = [directory stringByAppendingPathComponent:@"bookmark.journal"];
+    NSData* journal = [NSData dataWithContentsOfFile:journalPath];
+    XCTAssertTrue([store compact]);
+    XCTAssertEqual(store.generation, 1ULL);
+    XCTAssertEqual(store.journalRecords, (NSUInteger)0);
+    store = nil;
+
+    // A crash between the snapshot and the new journal: the old journal
+    // is already in the snapshot.
+    [journal writeToFile:journalPath atomically:NO];
+    [self reopen];
+    XCTAssertEqual([store favorites].count, (NSUInteger)5);
+    XCTAssertEqual(store.journalRecords, (NSUInteger)0);
+    [store removeBookmarkAtLocation:@"http://example.com/3"];
+    [self reopen];
+    XCTAssertEqual([store favorites].count, (NSUInteger)4);
+}
+
+- (void)testListOverSnapshot
+{
+    [self reopen];
+    for(int i=0; i<10; i++) {
+        [store setBookmark:[self entry:i] thumbnail:nil];
+    }
+    XCTAssertTrue([store compact]);
+    CatBookmarkList* before = [store list];
+
+    [store setBookmark:[self entry:10] thumbnail:nil];
+    [store setBookmark:@{@"title": @"Five", @"location": @"http://example.com/5"} thumbnail:nil];
+    [store removeBookmarkAtLocation:@"http://example.com/7"];
+    [store removeBookmarkAtLocation:@"http://example.com/3"];
+    [store setBookmark:[self entry:3] thumbnail:nil];
+    [store removeBookmarkAtLocation:@"http://example.com/0"];
+    CatBookmarkList* list = [store list];
+
+    NSArray* expected = @[@3, @10, @9, @8, @6, @5, @4, @2, @1];
+    NSMutableArray* locations = [NSMutableArray array];
+    XCTAssertEqual(list.count, expected.count);
+    for(NSUInteger i=0; i<expected.count; i++) {
+        NSString* location = [NSString stringWithFormat:@"http://example.com/%@", expected[i]];
+        XCTAssertEqualObjects([list bookmarkAtIndex:i][@"location"], location);
+        XCTAssertEqual([list indexOfLocation:location], i);
+        [locations addObject:location];
+    }
+    XCTAssertEqualObjects([list bookmarkForLocation:@"http://example.com/5"][@"title"], @"Five");
+    XCTAssertEqual([list indexOfLocation:@"http://example.com/7"], (NSUInteger)NSNotFound);
+    XCTAssertNil([list bookmarkAtIndex:expected.count]);
+    XCTAssertEqualObjects([[list allBookmarks] valueForKey:@"location"], locations);
+    // Taken before the changes.
+    XCTAssertEqual(before.count, (NSUInteger)10);
+    XCTAssertEqualObjects([before bookmarkAtIndex:0][@"location"], @"http://example.com/9");
+
+    // Through a snapshot, then through the JSON alone.
+    NSArray* favorites = [store favorites];
+    XCTAssertTrue([store compact]);
+    XCTAssertEqualObjects([store favorites], favorites);
+    NSString* exported = [directory stringByAppendingPathComponent:@"exported.txt"];
+    XCTAssertTrue([store exportToFile:exported]);
+    [store waitUntilWritten];
+    store = nil;
+    NSFileManager* fileManager = [NSFileManager defaultManager];
+    for(NSString* name in @[@"bookmark.idx", @"bookmark.journal", @"bookmark.txt"]) {
+        [fileManager removeItemAtPath:[directory stringByAppendingPathComponent:name] error:NULL];
+    }
+    [fileManager moveItemAtPath:exported toPath:[directory stringByAppendingPathComponent:@"bookmark.txt"] error:NULL];
+    [self reopen];
+    XCTAssertEqualObjects([store favorites], favorites);
+    XCTAssertEqual(store.generation, 2ULL);
+}
+
+- (void)testFeedsSuggestionEngine
+{
+    [self reopen];
+    for(int i=0; i<3; i++) {
+        [store setBookmark:[self entry:i] thumbnail:nil];
+    }
+    CatSuggestionEngine* engine = [[CatSuggestionEngine alloc] init];
+    [store feedSuggestionEngine:engine];
+    [store waitUntilWritten];
+    XCTAssertEqual([engine suggestionsForText:@"example.com" limit:10].count, (NSUInteger)3);
+
+    // Changes follow without feeding the whole list again.
+    [store setBookmark:@{@"title": @"Tigers", @"location": @"http://tigers.com/"} thumbnail:nil];
+    [store removeBookmarkAtLocation:@"http://example.com/1"];
+    // Published at once, before the queue gets to them.
+    XCTAssertEqualObjects([[store list] bookmarkAtIndex:0][@"location"], @"http://tigers.com/");
+    XCTAssertEqual([store list].count, (NSUInteger)3);
+    [store waitUntilWritten];
+    CatSuggestion* tigers = [engine suggestionsForText:@"tig" limit:10].firstObject;
+    XCTAssertEqualObjects(tigers.title, @"Tigers");
+    XCTAssertTrue(tigers.bookmarked);
+    NSArray* expected = @[@"http://example.com/2", @"http://example.com/0"];
+    XCTAssertEqualObjects([[engine suggestionsForText:@"example.com" limit:10] valueForKey:@"location"], expected);
+}
+
+- (void)testTogglesAreJournaled
+{
+    [self reopen];
+    for(int i=0; i<1000; i++) {
+        [store setBookmark:[self entry:i] thumbnail:nil];
+    }
+    XCTAssertTrue([store compact]);
+
+    uint64_t start = CatMetricsNow();
+    for(int i=0; i<1000; i++) {
+        if(i % 2) {
+            [store setBookmark:[self entry:i] thumbnail:nil];
+        }
+        else {
+            [store removeBookmarkAtLocation:[self entry:i][@"location"]];
+        }
+    }
+    double callMicroseconds = (CatMetricsNow() - start) / 1000 / 1e3;
+    [store waitUntilWritten];
+    NSUInteger commits = store.commits;
+    NSLog(@"1000 toggles: %.1fus per call, %lu writes, %lu compactions", callMicroseconds, (unsigned long)commits, (unsigned long)store.compactions);
+    // Toggles that came in together were synced together.
+    XCTAssertTrue(commits < 1000);
+
+    [self reopen];
+    XCTAssertEqual([store favorites].count, (NSUInteger)500);
+    XCTAssertEqualObjects([store favorites][0][@"location"], @"http://example.com/999");
+}
+
+@end
@@ -0,0 +1,177 @@
+//
+//  CatClassificationBenchmarkTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/20/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Replays url-corpus.txt through the interception decision: subresource
+//  URLs labelled 1 when the resource is an image that should become a
+//  cat. The corpus is generated by make-url-corpus.py, not recorded, so
+//  accuracy is against the shapes of URL it knows. Reports ns/URL,
+//  allocations/URL and accuracy, and fails when a rule change makes
+//  classification slower than the budgets below. CatCoreBench runs the
+//  bare matcher part on Linux with the same budgets.
+//
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+#import <pthread.h>
+#import "CatURLMatcher.h"
+#import "CatURLProtocol.h"
+#import "CatInterceptConfig.h"
+#import "CatMetrics.h"
+
+static const NSUInteger kPasses = 200;
+static const double kMaxMatcherNanosecondsPerURL = 2000;
+static const double kMaxClassificationNanosecondsPerURL = 20000;
+static const double kMinAccuracy = .95;
+
+// libmalloc calls this hook on every allocation when it is set; it is how
+// malloc stack logging works. Only allocations made by the benchmark
+// thread are counted.
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t skip);
+extern malloc_logger_t* malloc_logger;
+
+static pthread_t countedThread;
+static volatile int64_t allocations;
+
+static void countAllocation(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t skip)
+{
+    if((type & 2) && pthread_equal(pthread_self(), countedThread)) {
+        OSAtomicIncrement64(&allocations);
+    }
+}
+
+@interface CatClassificationBenchmarkTests : XCTestCase
+{
+    NSMutableArray* urls;
+    NSMutableArray* requests;
+    NSMutableData* labels;
+}
+@end
+
+@implementation CatClassificationBenchmarkTests
+
+- (void)setUp
+{
+    [super setUp];
+    NSString* path = [[NSBundle bundleForClass:[self class]] pathForResource:@"url-corpus" ofType:@"txt"];
+    NSString* corpus = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:NULL];
+    XCTAssertNotNil(corpus);
+
+    urls = [NSMutableArray array];
+    requests = [NSMutableArray array];
+    labels = [NSMutableData data];
+    for(NSString* line in [corpus componentsSeparatedByString:@"\n"]) {
+        NSRange tab = [line rangeOfString:@"\t"];
+        if(tab.location == NSNotFound) {
+            continue;
+        }
+        NSString* url = [line substringFromIndex:tab.location+1];
+        BOOL label = [[line substringToIndex:tab.location] boolValue];
+        [urls addObject:url];
+        [requests addObject:[NSURLRequest requestWithURL:[NSURL URLWithString:url]]];
+        [labels appendBytes:&label length:sizeof(label)];
+    }
+    XCTAssertTrue(urls.count > 400);
+}
+
+- (void)beginCounting
+{
+    countedThread = pthread_self();
+    allocations = 0;
+    malloc_logger = countAllocation;
+}
+
+- (int64_t)endCounting
+{
+    malloc_logger = NULL;
+    return allocations;
+}
+
+- (void)report:(NSString*)name nanoseconds:(uint64_t)ns allocations:(int64_t)count correct:(NSUInteger)correct
+{
+    double perURL = (double)ns / (kPasses * urls.count);
+    NSLog(@"%@: %.0f ns/URL, %.2f allocations/URL, accuracy %.1f%% (%lu/%lu)", name, perURL,
+          (double)count / (kPasses * urls.count), 100. * correct / urls.count, (unsigned long)correct, (unsigned long)urls.count);
+}
+
+- (void)testMatcherThroughput
+{
+    CatInterceptConfig* config = [CatInterceptConfig defaultConfig];
+    NSMutableArray* utf8 = [NSMutableArray array];
+    for(NSString* url in urls) {
+        [utf8 addObject:[url dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    const BOOL* expected = labels.bytes;
+
+    NSUInteger correct = 0;
+    for(NSUInteger i=0; i<utf8.count; i++) {
+        NSData* url = utf8[i];
+        correct += CatURLMatcherMatch(config.matcher, url.bytes, url.length, NULL) == expected[i];
+    }
+
+    // Pointers are taken up front so the timed loop does no Objective-C work.
+    NSUInteger count = utf8.count;
+    const char** bytes = malloc(sizeof(char*) * count);
+    size_t* lengths = malloc(sizeof(size_t) * count);
+    for(NSUInteger i=0; i<count; i++) {
+        bytes[i] = [utf8[i] bytes];
+        lengths[i] = [utf8[i] length];
+    }
+    const CatURLMatcher* matcher = config.matcher;
+    volatile int sink = 0;
+    [self beginCounting];
+    uint64_t start = CatMetricsNow();
+    for(NSUInteger pass=0; pass<kPasses; pass++) {
+        for(NSUInteger i=0; i<count; i++) {
+            sink += CatURLMatcherMatch(matcher, bytes[i], lengths[i], NULL);
+        }
+    }
+    uint64_t elapsed = CatMetricsNow() - start;
+    int64_t allocated = [self endCounting];
+    free(bytes);
+    free(lengths);
+
+    [self report:@"matcher" nanoseconds:elapsed allocations:allocated correct:correct];
+    XCTAssertEqual(allocated, 0LL, @"the matcher must not allocate");
+    XCTAssertTrue((double)correct / count >= kMinAccuracy);
+    XCTAssertTrue((double)elapsed / (kPasses * count) <= kMaxMatcherNanosecondsPerURL);
+}
+
+- (void)testCanInitWithRequestThroughput
+{
+    CatInterceptConfig* previous = [CatURLProtocol config];
+    [CatURLProtocol setConfig:[CatInterceptConfig defaultConfig]];
+    const BOOL* expected = labels.bytes;
+
+    NSUInteger correct = 0;
+    for(NSUInteger i=0; i<requests.count; i++) {
+        correct += [CatURLProtocol canInitWithRequest:requests[i]] == expected[i];
+    }
+
+    // Later passes are what WebKit's repeated checks look like: decision cache hits.
+    [CatURLProtocol resetDecisionCacheStats];
+    [self beginCounting];
+    uint64_t start = CatMetricsNow();
+    for(NSUInteger pass=0; pass<kPasses; pass++) {
+        @autoreleasepool {
+            for(NSURLRequest* request in requests) {
+                [CatURLProtocol canInitWithRequest:request];
+            }
+        }
+    }
+    uint64_t elapsed = CatMetricsNow() - start;
+    int64_t allocated = [self endCounting];
+    [CatURLProtocol setConfig:previous];
+
+    [self report:@"canInitWithRequest" nanoseconds:elapsed allocations:allocated correct:correct];
+    NSDictionary* decisions = [CatURLProtocol decisionCacheStats];
+    NSLog(@"decision cache: %@", decisions);
+    XCTAssertTrue([decisions[@"hitRate"] doubleValue] > .9);
+    XCTAssertTrue((double)correct / requests.count >= kMinAccuracy);
+    XCTAssertTrue((double)elapsed / (kPasses * requests.count) <= kMaxClassificationNanosecondsPerURL);
+}
+
+@end
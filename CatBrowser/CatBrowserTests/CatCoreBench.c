@@ -0,0 +1,405 @@
+//
+//  CatCoreBench.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/5/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Timings of the plain C cores, to compare a change against numbers
+//  anyone can reproduce:
+//    CatCoreBench [corpus] [name...]
+//  corpus is url-corpus.txt, for the URL matcher. The matcher has the
+//  same budgets as CatClassificationBenchmarkTests and the program exits
+//  nonzero when it misses one; ctest runs it that way. The other
+//  numbers are printed only.
+//
+
+// clock_gettime, mkdtemp, nftw, random and strdup under -std=c99.
+#define _XOPEN_SOURCE 700
+
+#include "CatBookmarkIndex.h"
+#include "CatDecisionCache.h"
+#include "CatHistoryLog.h"
+#include "CatPrefixIndex.h"
+#include "CatResample.h"
+#include "CatURLMatcher.h"
+
+#include <ftw.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const double kMaxMatcherNanosecondsPerURL = 2000;
+static const double kMinAccuracy = .95;
+
+static const char* corpusPath = NULL;
+static int failures = 0;
+
+#ifdef CAT_COUNT_ALLOCATIONS
+// Linked with --wrap for malloc, calloc and realloc (see CMakeLists.txt),
+// so every allocation in the program comes through here first.
+static int countingAllocations = 0;
+static uint64_t allocations = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    allocations += countingAllocations;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    allocations += countingAllocations;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    allocations += countingAllocations;
+    return __real_realloc(pointer, size);
+}
+#endif
+
+static uint64_t now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+}
+
+static int removeEntry(const char* path, const struct stat* status, int flag, struct FTW* ftw)
+{
+    return remove(path);
+}
+
+static void removeDirectory(const char* directory)
+{
+    nftw(directory, removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+}
+
+// MARK: URL matcher
+
+static const CatURLRule kDefaultRules[] = {
+    { CatURLRuleExtension, "jpg" }, { CatURLRuleExtension, "png" }, { CatURLRuleExtension, "gif" },
+    { CatURLRuleExtension, "jpeg" }, { CatURLRuleExtension, "bmp" },
+    { CatURLRuleScheme, "data" },
+    { CatURLRuleSubstring, "://encrypted-tbn" }, { CatURLRuleSubstring, "googleusercontent.com" },
+    { CatURLRuleSubstring, "maps-api-ssl.google.com/maps/api/staticmap" },
+    { CatURLRuleExclude, "data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D" },
+};
+
+// The corpus is one "label<tab>url" per line.
+static void benchURLMatcher(void)
+{
+    FILE* file = corpusPath ? fopen(corpusPath, "r") : NULL;
+    if(!file) {
+        printf("URLMatcher: no corpus, pass url-corpus.txt\n");
+        failures++;
+        return;
+    }
+    size_t count = 0, capacity = 512;
+    char** urls = malloc(sizeof(char*) * capacity);
+    int* labels = malloc(sizeof(int) * capacity);
+    char line[4096];
+    while(fgets(line, sizeof(line), file)) {
+        char* tab = strchr(line, '\t');
+        if(!tab) {
+            continue;
+        }
+        tab[1 + strcspn(tab + 1, "\r\n")] = 0;
+        if(count == capacity) {
+            capacity *= 2;
+            urls = realloc(urls, sizeof(char*) * capacity);
+            labels = realloc(labels, sizeof(int) * capacity);
+        }
+        labels[count] = atoi(line);
+        urls[count++] = strdup(tab + 1);
+    }
+    fclose(file);
+
+    CatURLMatcher* matcher = CatURLMatcherCreate(kDefaultRules, sizeof(kDefaultRules) / sizeof(*kDefaultRules));
+    size_t* lengths = malloc(sizeof(size_t) * count);
+    size_t correct = 0;
+    for(size_t i=0; i<count; i++) {
+        lengths[i] = strlen(urls[i]);
+        correct += CatURLMatcherMatch(matcher, urls[i], lengths[i], NULL) == labels[i];
+    }
+    const int passes = 2000;
+    int matches = 0;
+#ifdef CAT_COUNT_ALLOCATIONS
+    allocations = 0;
+    countingAllocations = 1;
+#endif
+    uint64_t start = now();
+    for(int pass=0; pass<passes; pass++) {
+        for(size_t i=0; i<count; i++) {
+            matches += CatURLMatcherMatch(matcher, urls[i], lengths[i], NULL);
+        }
+    }
+    double perURL = (double)(now() - start) / ((double)passes * count);
+#ifdef CAT_COUNT_ALLOCATIONS
+    countingAllocations = 0;
+    double allocationsPerURL = (double)allocations / ((double)passes * count);
+    char allocated[64];
+    snprintf(allocated, sizeof(allocated), "%.2f allocations/URL", allocationsPerURL);
+#else
+    double allocationsPerURL = 0;
+    const char* allocated = "allocations not counted";
+#endif
+    double accuracy = (double)correct / count;
+    printf("URLMatcher: %lu URLs, %.0f ns/URL, %s, accuracy %.1f%%, %d matches\n", (unsigned long)count, perURL,
+           allocated, 100. * accuracy, matches / passes);
+    if(perURL > kMaxMatcherNanosecondsPerURL || accuracy < kMinAccuracy || allocationsPerURL > 0) {
+        printf("URLMatcher: over budget (%.0f ns/URL, %.0f%% accuracy, no allocation)\n",
+               kMaxMatcherNanosecondsPerURL, 100. * kMinAccuracy);
+        failures++;
+    }
+    CatURLMatcherRelease(matcher);
+    for(size_t i=0; i<count; i++) {
+        free(urls[i]);
+    }
+    free(urls);
+    free(labels);
+    free(lengths);
+}
+
+// MARK: Resampling
+
+// A retina iPad page rendered at twice the thumbnail size, brought down
+// to the thumbnail.
+static void benchResample(void)
+{
+    int srcWidth = 760, srcHeight = 688, dstWidth = 380, dstHeight = 344;
+    uint8_t* src = malloc(srcWidth * srcHeight * 4);
+    uint8_t* dst = malloc(dstWidth * dstHeight * 4);
+    for(int i=0; i<srcWidth*srcHeight*4; i++) {
+        src[i] = (uint8_t)(i * 7 + i / 4013);
+    }
+    const char* filterNames[] = { "box", "lanczos" };
+    const int rounds = 50;
+    for(CatResampleFilter filter = CatResampleFilterBox; filter <= CatResampleFilterLanczos; filter++) {
+        double milliseconds[2];
+        for(CatResamplePath path = CatResamplePathScalar; path <= CatResamplePathSIMD; path++) {
+            uint64_t start = now();
+            for(int round=0; round<rounds; round++) {
+                CatResampleRGBAFiltered(src, srcWidth, srcHeight, srcWidth * 4, dst, dstWidth, dstHeight, dstWidth * 4, filter, path);
+            }
+            milliseconds[path] = (now() - start) / rounds / 1e6;
+        }
+        printf("Resample: %s %dx%d to %dx%d, scalar %.2fms, SIMD %.2fms%s\n", filterNames[filter], srcWidth, srcHeight,
+               dstWidth, dstHeight, milliseconds[0], milliseconds[1], CatResampleHasSIMD() ? "" : " (no SIMD path)");
+    }
+    free(src);
+    free(dst);
+}
+
+// MARK: Prefix index
+
+// 100k entries, bookmarks and history alike, keyed by location and a
+// title word; the queries of someone typing a location, a visit to every
+// entry, then removing every other one.
+static void benchPrefixIndex(void)
+{
+    const int entries = 100000;
+    CatPrefixIndex* index = CatPrefixIndexCreate();
+    char key[96];
+    srandom(7);
+    uint64_t start = now();
+    for(int i=0; i<entries; i++) {
+        int length = snprintf(key, sizeof(key), "site%ld.example.com/cats/%d", random() % 2000, i);
+        CatPrefixIndexInsert(index, i, key, length);
+        length = snprintf(key, sizeof(key), "cats%ld", random() % 500);
+        CatPrefixIndexInsert(index, i, key, length);
+        CatPrefixIndexSetScore(index, i, CatFrecencyAddVisit(-INFINITY, random() % 100000, 86400 * 7, 1));
+    }
+    double buildMilliseconds = (now() - start) / 1e6;
+    size_t nodes = CatPrefixIndexNodeCount(index);
+    size_t memory = CatPrefixIndexMemoryUsage(index);
+
+    const char* typed = "site1234.example.com/cats/";
+    uint32_t found[kCatPrefixTopK];
+    size_t total = 0;
+    const int rounds = 10000;
+    start = now();
+    for(int round=0; round<rounds; round++) {
+        for(size_t length=1; length<=strlen(typed); length++) {
+            total += CatPrefixIndexQuery(index, typed, length, found, kCatPrefixTopK);
+        }
+    }
+    double queryNanoseconds = (double)(now() - start) / (rounds * strlen(typed));
+
+    start = now();
+    for(int i=0; i<entries; i++) {
+        CatPrefixIndexSetScore(index, i, CatFrecencyAddVisit(CatPrefixIndexScore(index, i), 100000 + i, 86400 * 7, 1));
+    }
+    double visitNanoseconds = (double)(now() - start) / entries;
+
+    start = now();
+    for(int i=0; i<entries; i+=2) {
+        CatPrefixIndexRemove(index, i);
+    }
+    double removeNanoseconds = (double)(now() - start) / (entries / 2);
+    printf("PrefixIndex: %d entries in %.0fms, %lu nodes, %.1fMB, query %.0fns, visit %.0fns, removal %.0fns (%lu found)\n",
+           entries, buildMilliseconds, (unsigned long)nodes, memory / 1048576., queryNanoseconds, visitNanoseconds,
+           removeNanoseconds, (unsigned long)total);
+    CatPrefixIndexDestroy(index);
+}
+
+// MARK: History log
+
+// Two million visits over 100k locations.
+static void benchHistoryLog(void)
+{
+    const int visits = 2000000, locations = 100000;
+    char directory[] = "/tmp/CatCoreBench.XXXXXX";
+    if(!mkdtemp(directory)) {
+        return;
+    }
+    CatHistoryLog* log = CatHistoryLogOpen(directory);
+    char url[128];
+    srandom(11);
+    uint64_t start = now();
+    for(int i=0; i<visits; i++) {
+        int length = snprintf(url, sizeof(url), "http://site%ld.example.com/page/%ld", random() % 1000, random() % (locations / 1000));
+        CatHistoryLogAppend(log, url, length, "A page title", 12, i);
+    }
+    double insertSeconds = (now() - start) / 1e9;
+
+    CatHistoryVisit visit;
+    int hits = 0;
+    start = now();
+    for(int i=0; i<100000; i++) {
+        int length = snprintf(url, sizeof(url), "http://site%ld.example.com/page/%ld", random() % 1000, random() % (locations / 1000));
+        hits += CatHistoryLogLookup(log, url, length, &visit) == 1;
+    }
+    double lookupNanoseconds = (now() - start) / 100000.;
+
+    CatHistoryLogClose(log);
+    start = now();
+    log = CatHistoryLogOpen(directory);
+    double openMilliseconds = (now() - start) / 1e6;
+    start = now();
+    CatHistoryLogCompact(log, 0);
+    double compactMilliseconds = (now() - start) / 1e6;
+    printf("HistoryLog: %d visits, %llu locations: %.0f inserts/s, lookup %.0fns (%d hits), open %.2fms, compaction %.0fms to %.1fMB\n",
+           visits, (unsigned long long)CatHistoryLogURLCount(log), visits / insertSeconds, lookupNanoseconds, hits,
+           openMilliseconds, compactMilliseconds, CatHistoryLogBytes(log) / 1048576.);
+    CatHistoryLogClose(log);
+    removeDirectory(directory);
+}
+
+// MARK: Bookmark index
+
+static void benchBookmarkIndex(void)
+{
+    char directory[] = "/tmp/CatCoreBench.XXXXXX";
+    if(!mkdtemp(directory)) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "%s/bookmark.idx", directory);
+    for(size_t count=10000; count<=100000; count*=10) {
+        CatBookmark* bookmarks = calloc(count, sizeof(CatBookmark));
+        char (*locations)[64] = malloc(count * 64);
+        for(size_t i=0; i<count; i++) {
+            int length = snprintf(locations[i], 64, "http://site%lu.example.com/cats/%lu", (unsigned long)(i % 977), (unsigned long)i);
+            bookmarks[i] = (CatBookmark){ locations[i], length, "A page about cats", 17, i % 2 ? "cats.jpg" : "", i % 2 ? 8 : 0 };
+        }
+        uint64_t start = now();
+        CatBookmarkIndexWrite(path, 1, bookmarks, count);
+        double writeMilliseconds = (now() - start) / 1e6;
+
+        const int opens = 1000;
+        start = now();
+        for(int i=0; i<opens; i++) {
+            CatBookmarkIndexClose(CatBookmarkIndexOpen(path));
+        }
+        double openMicroseconds = (now() - start) / opens / 1e3;
+
+        CatBookmarkIndex* index = CatBookmarkIndexOpen(path);
+        size_t found = 0;
+        start = now();
+        for(size_t i=0; i<count; i++) {
+            found += CatBookmarkIndexFind(index, locations[i], bookmarks[i].locationLength) == (long)i;
+        }
+        double findNanoseconds = (double)(now() - start) / count;
+        CatBookmarkIndexClose(index);
+        printf("BookmarkIndex: %lu bookmarks, write %.1fms, open %.1fus, find %.0fns (%lu found)\n", (unsigned long)count,
+               writeMilliseconds, openMicroseconds, findNanoseconds, (unsigned long)found);
+        free(bookmarks);
+        free(locations);
+    }
+    removeDirectory(directory);
+}
+
+// MARK: Decision cache
+
+// Hits over a working set that fits, and the hash of a typical URL.
+static void benchDecisionCache(void)
+{
+    static CatDecisionCache cache;
+    enum { kURLs = 1000 };
+    static uint64_t hashes[kURLs];
+    char url[96];
+    for(int i=0; i<kURLs; i++) {
+        int length = snprintf(url, sizeof(url), "http://images.example.com/cats/%d.jpg", i);
+        hashes[i] = CatDecisionHash(kCatDecisionHashSeed, url, length);
+        CatDecisionCacheStore(&cache, hashes[i], 1, i % 2, 0);
+    }
+    const int rounds = 10000;
+    int intercept, rule, hits = 0;
+    uint64_t start = now();
+    for(int round=0; round<rounds; round++) {
+        for(int i=0; i<kURLs; i++) {
+            hits += CatDecisionCacheLookup(&cache, hashes[i], 1, &intercept, &rule);
+        }
+    }
+    double lookupNanoseconds = (double)(now() - start) / ((double)rounds * kURLs);
+
+    int length = snprintf(url, sizeof(url), "http://images.example.com/cats/%d.jpg", 123);
+    uint64_t hash = 0;
+    start = now();
+    for(int round=0; round<1000000; round++) {
+        hash += CatDecisionHash(kCatDecisionHashSeed, url, length);
+    }
+    double hashNanoseconds = (now() - start) / 1e6;
+    printf("DecisionCache: lookup %.1fns (%d%% hits), hash of %d bytes %.1fns (%llx)\n", lookupNanoseconds,
+           (int)(100. * hits / ((double)rounds * kURLs)), length, hashNanoseconds, (unsigned long long)(hash & 0xff));
+}
+
+static const struct {
+    const char* name;
+    void (*run)(void);
+} benchmarks[] = {
+    { "URLMatcher", benchURLMatcher },
+    { "Resample", benchResample },
+    { "PrefixIndex", benchPrefixIndex },
+    { "HistoryLog", benchHistoryLog },
+    { "BookmarkIndex", benchBookmarkIndex },
+    { "DecisionCache", benchDecisionCache },
+};
+
+int main(int argc, char** argv)
+{
+    int first = 1;
+    if(argc > 1 && strchr(argv[1], '.')) {
+        corpusPath = argv[1];
+        first = 2;
+    }
+    for(size_t i=0; i<sizeof(benchmarks)/sizeof(*benchmarks); i++) {
+        int selected = argc <= first;
+        for(int a=first; a<argc; a++) {
+            selected |= !strcmp(argv[a], benchmarks[i].name);
+        }
+        if(selected) {
+            benchmarks[i].run();
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,723 @@
+//
+//  CatCoreTests.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/5/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  The plain C cores, tested without Xcode: CMakeLists.txt runs one
+//  ctest per core, by name. The same ground as the XCTest cases, minus
+//  what needs Foundation.
+//
+
+// mkdtemp, nftw, random and truncate under -std=c99.
+#define _XOPEN_SOURCE 700
+
+#include "CatBookmarkIndex.h"
+#include "CatDecisionCache.h"
+#include "CatGIF.h"
+#include "CatHTTPParser.h"
+#include "CatHistoryLog.h"
+#include "CatPrefixIndex.h"
+#include "CatResample.h"
+#include "CatURLMatcher.h"
+
+#include <errno.h>
+#include <ftw.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if(!(condition)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while(0)
+
+static int removeEntry(const char* path, const struct stat* status, int flag, struct FTW* ftw)
+{
+    return remove(path);
+}
+
+static char* makeDirectory(void)
+{
+    char* directory = strdup("/tmp/CatCoreTests.XXXXXX");
+    return mkdtemp(directory);
+}
+
+static void removeDirectory(char* directory)
+{
+    nftw(directory, removeEntry, 8, FTW_DEPTH | FTW_PHYS);
+    free(directory);
+}
+
+// MARK: URL matcher
+
+static const CatURLRule kDefaultRules[] = {
+    { CatURLRuleExtension, "jpg" }, { CatURLRuleExtension, "png" }, { CatURLRuleExtension, "gif" },
+    { CatURLRuleExtension, "jpeg" }, { CatURLRuleExtension, "bmp" },
+    { CatURLRuleScheme, "data" },
+    { CatURLRuleSubstring, "://encrypted-tbn" }, { CatURLRuleSubstring, "googleusercontent.com" },
+    { CatURLRuleSubstring, "maps-api-ssl.google.com/maps/api/staticmap" },
+    { CatURLRuleExclude, "data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D" },
+};
+
+// Matches url in one go and byte by byte, which must agree.
+static int match(const CatURLMatcher* matcher, const char* url, int* rule)
+{
+    int whole = CatURLMatcherMatch(matcher, url, strlen(url), rule);
+    CatURLScan scan;
+    CatURLScanBegin(&scan, matcher);
+    for(size_t i=0; url[i]; i++) {
+        if(CatURLScanFeed(&scan, url + i, 1)) {
+            break;
+        }
+    }
+    int scannedRule;
+    CHECK(CatURLScanEnd(&scan, &scannedRule) == whole);
+    CHECK(scannedRule == *rule);
+    return whole;
+}
+
+static void testURLMatcher(void)
+{
+    CatURLMatcher* matcher = CatURLMatcherCreate(kDefaultRules, sizeof(kDefaultRules) / sizeof(*kDefaultRules));
+    CHECK(matcher != NULL);
+    int rule;
+    CHECK(match(matcher, "http://a.com/x/y.JPG", &rule) && rule == 0);
+    CHECK(match(matcher, "http://a.com/x/y.jpeg?x=1", &rule) && rule == 3);
+    CHECK(!match(matcher, "http://a.com/x/y.jpgx", &rule));
+    CHECK(!match(matcher, "http://a.jpg/", &rule));
+    CHECK(!match(matcher, "http://a.com/a.jpg/b", &rule));
+    CHECK(match(matcher, "DATA:image/png;base64,xx", &rule) && rule == 5);
+    CHECK(!match(matcher, "data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D", &rule) && rule == 9);
+    CHECK(match(matcher, "https://lh3.GoogleUserContent.com/abc=s72", &rule) && rule == 7);
+    CHECK(!match(matcher, "http://maps-api-ssl.google.com/maps/api/static", &rule));
+    CHECK(!match(matcher, "", &rule) && rule == kCatURLNoRule);
+    CatURLMatcherRelease(matcher);
+
+    const CatURLRule hostRules[] = {
+        { CatURLRuleExtension, "jpg" }, { CatURLRuleSubstring, "googleusercontent.com" },
+        { CatURLRuleDenyHost, "Example.com" }, { CatURLRuleAllowHost, "cats.org" },
+        { CatURLRuleAllowHost, "googleusercontent.com" },
+    };
+    matcher = CatURLMatcherCreate(hostRules, 5);
+    CHECK(match(matcher, "http://www.CATS.org:8080/a.jpg", &rule) && rule == 0);
+    CHECK(!match(matcher, "http://notcats.org/a.jpg", &rule) && rule == kCatURLNoRule);
+    CHECK(!match(matcher, "http://user@img.example.com/a.jpg", &rule) && rule == 2);
+    CHECK(!match(matcher, "http://cats.org.evil.com/a.jpg", &rule) && rule == kCatURLNoRule);
+    CHECK(match(matcher, "https://lh3.googleusercontent.com/x", &rule) && rule == 1);
+    CatURLMatcherRelease(matcher);
+
+    const CatURLRule invalid[] = { { CatURLRuleExtension, "waytoolong" } };
+    CHECK(CatURLMatcherCreate(invalid, 1) == NULL);
+}
+
+// MARK: Resampling
+
+static void testResample(void)
+{
+    int srcWidth = 640, srcHeight = 480, dstWidth = 190, dstHeight = 143;
+    uint8_t* src = malloc(srcWidth * srcHeight * 4);
+    uint8_t* scalar = malloc(dstWidth * dstHeight * 4);
+    uint8_t* simd = malloc(dstWidth * dstHeight * 4);
+    for(CatResampleFilter filter = CatResampleFilterBox; filter <= CatResampleFilterLanczos; filter++) {
+        // A flat image stays flat, on every path.
+        memset(src, 200, srcWidth * srcHeight * 4);
+        CHECK(CatResampleRGBAFiltered(src, srcWidth, srcHeight, srcWidth * 4, simd, dstWidth, dstHeight, dstWidth * 4, filter, CatResamplePathSIMD) == 0);
+        int flat = 1;
+        for(int i=0; i<dstWidth*dstHeight*4; i++) {
+            flat &= simd[i] == 200;
+        }
+        CHECK(flat);
+
+        // SIMD and scalar are the same filter, off by a rounding at most.
+        for(int i=0; i<srcWidth*srcHeight*4; i++) {
+            src[i] = (uint8_t)(i * 7 + i / 4013);
+        }
+        CHECK(CatResampleRGBAFiltered(src, srcWidth, srcHeight, srcWidth * 4, scalar, dstWidth, dstHeight, dstWidth * 4, filter, CatResamplePathScalar) == 0);
+        CHECK(CatResampleRGBAFiltered(src, srcWidth, srcHeight, srcWidth * 4, simd, dstWidth, dstHeight, dstWidth * 4, filter, CatResamplePathSIMD) == 0);
+        int close = 1;
+        for(int i=0; i<dstWidth*dstHeight*4; i++) {
+            close &= abs(scalar[i] - simd[i]) <= 1;
+        }
+        CHECK(close);
+    }
+    CHECK(CatResampleRGBA(src, srcWidth, srcHeight, srcWidth * 4, simd, 0, dstHeight, dstWidth * 4, CatResamplePathScalar) == -1);
+    free(src);
+    free(scalar);
+    free(simd);
+}
+
+// MARK: Prefix index
+
+enum { kPrefixEntries = 40, kPrefixKeys = 4 };
+
+// Random inserts, scores and removals over few short keys, so entries
+// share most of their ancestors, each round checked against a scan.
+static void testPrefixIndex(void)
+{
+    static char keys[kPrefixEntries][kPrefixKeys][8];
+    int keyCount[kPrefixEntries] = { 0 };
+    double scores[kPrefixEntries];
+    const char* prefixes[] = { "", "a", "b", "ab", "ba", "aa", "bb", "abb" };
+    CatPrefixIndex* index = CatPrefixIndexCreate();
+    for(int i=0; i<kPrefixEntries; i++) {
+        scores[i] = -INFINITY;
+    }
+    srandom(5);
+    int mismatches = 0;
+    for(int round=0; round<20000 && !mismatches; round++) {
+        int entry = (int)(random() % kPrefixEntries);
+        long operation = random() % 10;
+        if(operation < 4 && keyCount[entry] < kPrefixKeys) {
+            char key[8];
+            int length = 1 + (int)(random() % 4);
+            for(int i=0; i<length; i++) {
+                key[i] = "ab"[random() % 2];
+            }
+            key[length] = 0;
+            CHECK(CatPrefixIndexInsert(index, entry, key, length) == 0);
+            int known = 0;
+            for(int k=0; k<keyCount[entry]; k++) {
+                known |= !strcmp(keys[entry][k], key);
+            }
+            if(!known) {
+                strcpy(keys[entry][keyCount[entry]++], key);
+            }
+        }
+        else if(operation < 8 && keyCount[entry]) {
+            scores[entry] = random() % 10;
+            CatPrefixIndexSetScore(index, entry, scores[entry]);
+        }
+        else if(operation >= 8 && keyCount[entry]) {
+            CatPrefixIndexRemove(index, entry);
+            keyCount[entry] = 0;
+            scores[entry] = -INFINITY;
+        }
+
+        for(size_t p=0; p<sizeof(prefixes)/sizeof(*prefixes); p++) {
+            size_t length = strlen(prefixes[p]);
+            int expected[kPrefixEntries], count = 0;
+            for(int i=0; i<kPrefixEntries; i++) {
+                for(int k=0; k<keyCount[i]; k++) {
+                    if(!strncmp(keys[i][k], prefixes[p], length)) {
+                        expected[count++] = i;
+                        break;
+                    }
+                }
+            }
+            // Highest score first, lower id first on a tie.
+            for(int i=1; i<count; i++) {
+                int value = expected[i], j = i;
+                while(j > 0 && (scores[value] > scores[expected[j-1]] || (scores[value] == scores[expected[j-1]] && value < expected[j-1]))) {
+                    expected[j] = expected[j-1];
+                    j--;
+                }
+                expected[j] = value;
+            }
+            count = count < kCatPrefixTopK ? count : kCatPrefixTopK;
+            uint32_t found[kCatPrefixTopK];
+            size_t foundCount = CatPrefixIndexQuery(index, prefixes[p], length, found, kCatPrefixTopK);
+            int same = (int)foundCount == count;
+            for(int i=0; same && i<count; i++) {
+                same = (int)found[i] == expected[i];
+            }
+            if(!same) {
+                fprintf(stderr, "round %d, prefix \"%s\": not the best entries\n", round, prefixes[p]);
+                mismatches++;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    CatPrefixIndexDestroy(index);
+
+    double score = CatFrecencyAddVisit(-INFINITY, 0, 10, 1);
+    CHECK(score == 0);
+    CHECK(fabs(CatFrecencyAddVisit(score, 10, 10, 1) - log2(3)) < 1e-9);
+}
+
+// MARK: History log
+
+static int countVisit(const CatHistoryVisit* visit, void* context)
+{
+    (*(size_t*)context)++;
+    return 1;
+}
+
+static void appendVisits(CatHistoryLog* log)
+{
+    char url[64], title[64];
+    for(int i=0; i<5000; i++) {
+        int urlLength = snprintf(url, sizeof(url), "http://example.com/%d", i % 700);
+        int titleLength = snprintf(title, sizeof(title), "Page %d", i);
+        CHECK(CatHistoryLogAppend(log, url, urlLength, title, titleLength, i) == 0);
+    }
+}
+
+static uint32_t visitsTo(CatHistoryLog* log, const char* url)
+{
+    CatHistoryVisit visit = { 0 };
+    CatHistoryLogLookup(log, url, strlen(url), &visit);
+    return visit.visits;
+}
+
+static void testHistoryLog(void)
+{
+    char* directory = makeDirectory();
+    CHECK(directory != NULL);
+    CatHistoryLog* log = CatHistoryLogOpen(directory);
+    CHECK(log != NULL);
+    appendVisits(log);
+    CHECK(CatHistoryLogRecordCount(log) == 5000);
+    CHECK(CatHistoryLogURLCount(log) == 700);
+    CatHistoryVisit visit;
+    CHECK(CatHistoryLogLookup(log, "http://example.com/5", 20, &visit) == 1);
+    CHECK(visit.visits == 8 && visit.time == 4905);
+    CHECK(visit.titleLength == 9 && !memcmp(visit.title, "Page 4905", 9));
+    CHECK(CatHistoryLogLookup(log, "http://example.com/5000", 23, &visit) == 0);
+    size_t count = 0;
+    CHECK(CatHistoryLogEnumerateSince(log, 4990, countVisit, &count) == 10);
+
+    // An append cut short by a crash is dropped on open.
+    uint64_t bytes = CatHistoryLogBytes(log);
+    CatHistoryLogClose(log);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/history.log", directory);
+    FILE* file = fopen(path, "a");
+    fputs("CatRtorn", file);
+    fclose(file);
+    log = CatHistoryLogOpen(directory);
+    CHECK(CatHistoryLogBytes(log) == bytes);
+    CHECK(CatHistoryLogRecordCount(log) == 5000);
+
+    // A missing table is rebuilt from the log.
+    CatHistoryLogClose(log);
+    snprintf(path, sizeof(path), "%s/history.idx", directory);
+    unlink(path);
+    log = CatHistoryLogOpen(directory);
+    CHECK(CatHistoryLogURLCount(log) == 700);
+    CHECK(visitsTo(log, "http://example.com/5") == 8);
+
+    // Locations last visited before 4400 are dropped.
+    CHECK(CatHistoryLogNeedsCompaction(log));
+    CHECK(CatHistoryLogCompact(log, 4400) == 0);
+    CHECK(CatHistoryLogURLCount(log) == 600);
+    CHECK(CatHistoryLogRecordCount(log) == 600);
+    CHECK(CatHistoryLogBytes(log) < bytes / 5);
+    CHECK(visitsTo(log, "http://example.com/150") == 0);
+    CHECK(CatHistoryLogAppend(log, "http://example.com/5", 20, "Again", 5, 7000) == 0);
+    CatHistoryLogClose(log);
+    log = CatHistoryLogOpen(directory);
+    CHECK(visitsTo(log, "http://example.com/5") == 9);
+    CatHistoryLogClose(log);
+    removeDirectory(directory);
+}
+
+// MARK: Bookmark index
+
+static void writeBookmarks(const char* path, size_t count)
+{
+    CatBookmark* bookmarks = calloc(count, sizeof(CatBookmark));
+    char (*locations)[64] = malloc(count * 64);
+    for(size_t i=0; i<count; i++) {
+        int length = snprintf(locations[i], 64, "http://site%lu.example.com/cats/%lu", (unsigned long)(i % 977), (unsigned long)i);
+        bookmarks[i] = (CatBookmark){ locations[i], length, "Cats", 4, i % 2 ? "cats.jpg" : "", i % 2 ? 8 : 0 };
+    }
+    CHECK(CatBookmarkIndexWrite(path, 7, bookmarks, count) == 0);
+    free(bookmarks);
+    free(locations);
+}
+
+static void testBookmarkIndex(void)
+{
+    char* directory = makeDirectory();
+    char path[256];
+    snprintf(path, sizeof(path), "%s/bookmark.idx", directory);
+    writeBookmarks(path, 1000);
+    CatBookmarkIndex* index = CatBookmarkIndexOpen(path);
+    CHECK(index != NULL);
+    CHECK(CatBookmarkIndexCount(index) == 1000);
+    CHECK(CatBookmarkIndexGeneration(index) == 7);
+    CHECK(CatBookmarkIndexFind(index, "http://site5.example.com/cats/5", 31) == 5);
+    CHECK(CatBookmarkIndexFind(index, "http://site5.example.com/cats/6", 31) == -1);
+    CatBookmark bookmark;
+    CHECK(CatBookmarkIndexGet(index, 999, &bookmark) == 1);
+    CHECK(bookmark.locationLength == 34 && !memcmp(bookmark.location, "http://site22.example.com/cats/999", 34));
+    CHECK(bookmark.thumbnailLength == 8);
+    CHECK(CatBookmarkIndexGet(index, 1000, &bookmark) == 0);
+    CatBookmarkIndexClose(index);
+
+    CHECK(CatBookmarkIndexWrite(path, 8, NULL, 0) == 0);
+    index = CatBookmarkIndexOpen(path);
+    CHECK(index != NULL && CatBookmarkIndexCount(index) == 0);
+    CatBookmarkIndexClose(index);
+
+    // Not an index, a truncated one, none at all.
+    FILE* file = fopen(path, "w");
+    fputs("{\"favorites\":[]}", file);
+    fclose(file);
+    CHECK(CatBookmarkIndexOpen(path) == NULL && errno == EILSEQ);
+    writeBookmarks(path, 100);
+    CHECK(truncate(path, 1000) == 0);
+    CHECK(CatBookmarkIndexOpen(path) == NULL && errno == EILSEQ);
+    unlink(path);
+    CHECK(CatBookmarkIndexOpen(path) == NULL && errno == ENOENT);
+    removeDirectory(directory);
+}
+
+// MARK: Decision cache
+
+static CatDecisionCache sharedCache;
+
+// Each thread stores and looks up the same 3000 URLs; a hit must be the
+// decision that was stored for it.
+static void* decide(void* context)
+{
+    long thread = (long)context;
+    long wrong = 0;
+    char url[64];
+    for(int round=0; round<100000; round++) {
+        int n = (int)((round * 7 + thread) % 3000);
+        int length = snprintf(url, sizeof(url), "http://x/%d.jpg", n);
+        uint64_t hash = CatDecisionHash(kCatDecisionHashSeed, url, length);
+        int intercept, rule, expected = n % 3 == 0;
+        if(CatDecisionCacheLookup(&sharedCache, hash, 5, &intercept, &rule)) {
+            wrong += intercept != expected || rule != (expected ? 2 : -1);
+        }
+        else {
+            CatDecisionCacheStore(&sharedCache, hash, 5, expected, expected ? 2 : -1);
+        }
+    }
+    return (void*)wrong;
+}
+
+static void testDecisionCache(void)
+{
+    static CatDecisionCache cache;
+    uint64_t hash = CatDecisionHash(kCatDecisionHashSeed, "abc", 3);
+    int intercept, rule;
+    CHECK(!CatDecisionCacheLookup(&cache, hash, 1, &intercept, &rule));
+    CatDecisionCacheStore(&cache, hash, 1, 1, -1);
+    CHECK(CatDecisionCacheLookup(&cache, hash, 1, &intercept, &rule) && intercept == 1 && rule == -1);
+    // Another config version, or another hash in the same slot, misses.
+    CHECK(!CatDecisionCacheLookup(&cache, hash, 2, &intercept, &rule));
+    CHECK(!CatDecisionCacheLookup(&cache, hash ^ (1ULL << 20), 1, &intercept, &rule));
+    CatDecisionCacheStore(&cache, hash, 2, 0, 7);
+    CHECK(CatDecisionCacheLookup(&cache, hash, 2, &intercept, &rule) && intercept == 0 && rule == 7);
+    uint64_t hits, misses, stores;
+    CatDecisionCacheStats(&cache, &hits, &misses, &stores);
+    CHECK(hits == 2 && misses == 3 && stores == 2);
+    CatDecisionCacheClear(&cache);
+    CHECK(!CatDecisionCacheLookup(&cache, hash, 2, &intercept, &rule));
+
+    pthread_t threads[8];
+    for(long i=0; i<8; i++) {
+        pthread_create(&threads[i], NULL, decide, (void*)i);
+    }
+    for(int i=0; i<8; i++) {
+        void* wrong;
+        pthread_join(threads[i], &wrong);
+        CHECK(wrong == NULL);
+    }
+    CatDecisionCacheStats(&sharedCache, &hits, &misses, &stores);
+    CHECK(hits + misses == 800000);
+}
+
+// MARK: GIF
+
+typedef struct {
+    uint8_t* bytes;
+    size_t length;
+    size_t capacity;
+} GIFBuffer;
+
+static void gifAppend(GIFBuffer* buffer, const void* bytes, size_t length)
+{
+    if(buffer->length + length > buffer->capacity) {
+        buffer->capacity = (buffer->length + length) * 2;
+        buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+    }
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void gifAppend16(GIFBuffer* buffer, uint16_t value)
+{
+    uint8_t bytes[2] = { value & 0xFF, value >> 8 };
+    gifAppend(buffer, bytes, 2);
+}
+
+// A looping animation of stripes, 4 colors, every frame covering the canvas.
+static GIFBuffer makeGIF(uint16_t width, uint16_t height, int frames, int interlaced)
+{
+    GIFBuffer gif = { NULL, 0, 0 };
+    gifAppend(&gif, "GIF89a", 6);
+    gifAppend16(&gif, width);
+    gifAppend16(&gif, height);
+    const uint8_t screen[] = { 0xF1, 0, 0, 0,0,0, 255,0,0, 0,255,0, 0,0,255 };
+    gifAppend(&gif, screen, sizeof(screen));
+    gifAppend(&gif, "\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00", 19);
+    uint8_t* pixels = malloc((size_t)width * height);
+    for(int f=0; f<frames; f++) {
+        gifAppend(&gif, "\x21\xF9\x04\x04\x0A\x00\x00\x00", 8);
+        gifAppend(&gif, "\x2C", 1);
+        gifAppend16(&gif, 0);
+        gifAppend16(&gif, 0);
+        gifAppend16(&gif, width);
+        gifAppend16(&gif, height);
+        const uint8_t flags[] = { interlaced ? 0x40 : 0, 2 };
+        gifAppend(&gif, flags, 2);
+        for(int i=0; i<width * height; i++) {
+            pixels[i] = ((i % width) / 7 + (i / width) / 5 + f) & 3;
+        }
+        size_t length = 0;
+        uint8_t* codes = CatGIFEncodeLZW(pixels, (size_t)width * height, 2, &length);
+        for(size_t offset=0; offset<length; offset+=255) {
+            uint8_t chunk = (uint8_t)(length - offset < 255 ? length - offset : 255);
+            gifAppend(&gif, &chunk, 1);
+            gifAppend(&gif, codes + offset, chunk);
+        }
+        free(codes);
+        gifAppend(&gif, "\0", 1);
+    }
+    gifAppend(&gif, "\x3B", 1);
+    free(pixels);
+    return gif;
+}
+
+static void testGIF(void)
+{
+    // LZW round trip, noise and runs, enough to fill the table and reset it.
+    size_t count = 100000;
+    uint8_t* pixels = malloc(count);
+    uint8_t* decoded = malloc(count);
+    srandom(3);
+    for(int minCodeSize=2; minCodeSize<=8; minCodeSize++) {
+        for(size_t i=0; i<count; i++) {
+            pixels[i] = (i % 3 ? (uint8_t)random() : pixels[i ? i-1 : 0]) & ((1 << minCodeSize) - 1);
+        }
+        size_t length = 0;
+        uint8_t* codes = CatGIFEncodeLZW(pixels, count, minCodeSize, &length);
+        CHECK(codes != NULL);
+        CHECK(CatGIFDecodeLZW(codes, length, minCodeSize, decoded, count) == count);
+        CHECK(!memcmp(decoded, pixels, count));
+        free(codes);
+    }
+    free(pixels);
+    free(decoded);
+
+    GIFBuffer gif = makeGIF(400, 300, 5, 0);
+    CatGIFInfo before, after, check;
+    CHECK(CatGIFInspect(gif.bytes, gif.length, &check) == 0);
+    CHECK(check.width == 400 && check.height == 300 && check.frames == 5);
+    CHECK(check.decodedBytes == 400ull * 300 * 4 * 5);
+    CHECK(CatGIFInspect((const uint8_t*)"\x89PNG\r\n\x1a\n....", 12, &check) == -1);
+
+    // First frame only.
+    uint8_t* output = NULL;
+    size_t length = 0;
+    CatGIFLimits firstFrame = { 1, 0 };
+    CHECK(CatGIFTranscode(gif.bytes, gif.length, firstFrame, &output, &length, &before, &after) == 1);
+    CHECK(CatGIFInspect(output, length, &check) == 0 && check.frames == 1);
+    CHECK(after.decodedBytes * 5 == before.decodedBytes);
+    CHECK(length < gif.length);
+    free(output);
+    free(gif.bytes);
+
+    // Resolution cap over interlaced frames.
+    gif = makeGIF(400, 300, 3, 1);
+    CatGIFLimits capped = { 2, 100 };
+    CHECK(CatGIFTranscode(gif.bytes, gif.length, capped, &output, &length, NULL, NULL) == 1);
+    CHECK(CatGIFInspect(output, length, &check) == 0);
+    CHECK(check.width == 100 && check.height == 75 && check.frames == 2);
+    free(output);
+    free(gif.bytes);
+
+    // Within limits: left alone.
+    gif = makeGIF(64, 64, 2, 0);
+    CatGIFLimits loose = { 4, 128 };
+    output = NULL;
+    CHECK(CatGIFTranscode(gif.bytes, gif.length, loose, &output, &length, NULL, NULL) == 0);
+    CHECK(output == NULL);
+    free(gif.bytes);
+
+    // Cut at every length, then bit flips: no crash, no read out of bounds.
+    gif = makeGIF(64, 64, 3, 0);
+    CatGIFLimits tight = { 1, 20 };
+    for(size_t cut=0; cut<gif.length; cut++) {
+        if(CatGIFTranscode(gif.bytes, cut, tight, &output, &length, NULL, NULL) == 1) {
+            free(output);
+        }
+    }
+    for(int i=0; i<2000; i++) {
+        size_t position = (size_t)random() % gif.length;
+        uint8_t bit = 1 << (random() % 8);
+        gif.bytes[position] ^= bit;
+        if(CatGIFTranscode(gif.bytes, gif.length, tight, &output, &length, NULL, NULL) == 1) {
+            free(output);
+        }
+        gif.bytes[position] ^= bit;
+    }
+    free(gif.bytes);
+}
+
+// MARK: HTTP parser
+
+typedef struct {
+    int heads;
+    int completes;
+    int keepAlive;
+    int complete;
+    char body[1024];
+    size_t bodyLength;
+} ParseResult;
+
+static CatHTTPParser parser;
+
+static void onHead(void* context, int status, const char* head, size_t length)
+{
+    ((ParseResult*)context)->heads++;
+}
+
+static void onBody(void* context, const char* bytes, size_t length)
+{
+    ParseResult* result = context;
+    memcpy(result->body + result->bodyLength, bytes, length);
+    result->bodyLength += length;
+}
+
+static void onComplete(void* context)
+{
+    ParseResult* result = context;
+    result->completes++;
+    result->complete = 1;
+    result->keepAlive = parser.keepAlive;
+}
+
+static void startParsing(ParseResult* result)
+{
+    memset(result, 0, sizeof(*result));
+    CatHTTPCallbacks callbacks = { onHead, onBody, onComplete };
+    CatHTTPParserInit(&parser, callbacks, result);
+}
+
+// Feeds the bytes step at a time, the way a socket would hand them over.
+static int feed(const char* bytes, size_t step, ParseResult* result)
+{
+    size_t length = strlen(bytes), offset = 0;
+    while(offset < length) {
+        long used = CatHTTPParserFeed(&parser, bytes + offset, step < length - offset ? step : length - offset);
+        if(used < 0) {
+            return 0;
+        }
+        offset += used;
+        if(result->complete) {
+            result->complete = 0;
+            CatHTTPParserReset(&parser);
+        }
+    }
+    return 1;
+}
+
+static void testHTTPParser(void)
+{
+    const char* responses =
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nContent-Type: image/jpeg\r\n\r\nhello"
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 302 Found\r\nLocation: /x\r\nContent-Length: 0\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3;x=y\r\nabc\r\n1A\r\nabcdefghijklmnopqrstuvwxyz\r\n0\r\nX-T: 1\r\n\r\n";
+    ParseResult result;
+    for(size_t step=1; step<=strlen(responses); step++) {
+        startParsing(&result);
+        CHECK(feed(responses, step, &result));
+        CHECK(result.heads == 3 && result.completes == 3);
+        CHECK(result.keepAlive);
+        CHECK(result.bodyLength == 34);
+        CHECK(!memcmp(result.body, "helloabcabcdefghijklmnopqrstuvwxyz", 34));
+    }
+
+    // Until close.
+    startParsing(&result);
+    const char* response = "HTTP/1.0 200 OK\r\nContent-Type: image/gif\r\n\r\nstream until close";
+    CHECK(CatHTTPParserFeed(&parser, response, strlen(response)) == (long)strlen(response));
+    CHECK(!parser.keepAlive);
+    CHECK(CatHTTPParserFinish(&parser) == 0);
+    CHECK(result.completes == 1 && result.bodyLength == 18);
+
+    // Cut short, garbage, and lengths that would misframe the next response.
+    startParsing(&result);
+    response = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc";
+    CatHTTPParserFeed(&parser, response, strlen(response));
+    CHECK(CatHTTPParserFinish(&parser) == -1);
+    const char* malformed[] = {
+        "garbage\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 18446744073709551615\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 12abc\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 12, 13\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: \r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 3\r\nContent-Length: 5\r\n\r\n",
+    };
+    for(size_t i=0; i<sizeof(malformed) / sizeof(*malformed); i++) {
+        startParsing(&result);
+        CHECK(CatHTTPParserFeed(&parser, malformed[i], strlen(malformed[i])) == -1);
+        CHECK(result.heads == 0);
+    }
+    startParsing(&result);
+    response = "HTTP/1.1 200 OK\r\nContent-Length: 3 \r\nContent-Length: 3\r\n\r\nabc";
+    CHECK(CatHTTPParserFeed(&parser, response, strlen(response)) == (long)strlen(response));
+    CHECK(result.completes == 1 && result.bodyLength == 3);
+
+    startParsing(&result);
+    response = "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n";
+    CHECK(CatHTTPParserFeed(&parser, response, strlen(response)) == (long)strlen(response));
+    CHECK(result.completes == 1 && !result.keepAlive);
+}
+
+static const struct {
+    const char* name;
+    void (*run)(void);
+} tests[] = {
+    { "URLMatcher", testURLMatcher },
+    { "Resample", testResample },
+    { "PrefixIndex", testPrefixIndex },
+    { "HistoryLog", testHistoryLog },
+    { "BookmarkIndex", testBookmarkIndex },
+    { "DecisionCache", testDecisionCache },
+    { "GIF", testGIF },
+    { "HTTPParser", testHTTPParser },
+};
+
+// Runs the tests named on the command line, or all of them.
+int main(int argc, char** argv)
+{
+    size_t count = sizeof(tests) / sizeof(*tests);
+    for(int a=1; a<argc; a++) {
+        size_t i = 0;
+        while(i < count && strcmp(argv[a], tests[i].name)) {
+            i++;
+        }
+        if(i == count) {
+            fprintf(stderr, "no test named %s\n", argv[a]);
+            failures++;
+        }
+    }
+    for(size_t i=0; i<count; i++) {
+        int selected = argc < 2;
+        for(int a=1; a<argc; a++) {
+            selected |= !strcmp(argv[a], tests[i].name);
+        }
+        if(selected) {
+            int before = failures;
+            tests[i].run();
+            printf("%s: %s\n", tests[i].name, failures == before ? "passed" : "FAILED");
+        }
+    }
+    return failures ? 1 : 0;
+}
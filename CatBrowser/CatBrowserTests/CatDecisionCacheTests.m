@@ -0,0 +1,130 @@
+//
+//  CatDecisionCacheTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/24/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatDecisionCache.h"
+#import "CatURLProtocol.h"
+#import "CatInterceptConfig.h"
+
+static CatDecisionCache cache;
+
+@interface CatDecisionCacheTests : XCTestCase
+@end
+
+@implementation CatDecisionCacheTests
+
+- (void)setUp
+{
+    [super setUp];
+    CatDecisionCacheClear(&cache);
+    CatDecisionCacheResetStats(&cache);
+}
+
+- (uint64_t)hash:(const char*)url
+{
+    return CatDecisionHash(kCatDecisionHashSeed, url, strlen(url));
+}
+
+- (void)testStoresDecisionAndRulePerVersion
+{
+    uint64_t hash = [self hash:"http://example.com/tabby.jpg"];
+    int intercept = 0, rule = 0;
+    XCTAssertFalse(CatDecisionCacheLookup(&cache, hash, 1, &intercept, &rule));
+    CatDecisionCacheStore(&cache, hash, 1, 1, -1);
+    XCTAssertTrue(CatDecisionCacheLookup(&cache, hash, 1, &intercept, &rule));
+    XCTAssertEqual(intercept, 1);
+    XCTAssertEqual(rule, -1);
+
+    // Another config version never sees it.
+    XCTAssertFalse(CatDecisionCacheLookup(&cache, hash, 2, &intercept, &rule));
+    CatDecisionCacheStore(&cache, hash, 2, 0, 7);
+    XCTAssertTrue(CatDecisionCacheLookup(&cache, hash, 2, &intercept, &rule));
+    XCTAssertEqual(intercept, 0);
+    XCTAssertEqual(rule, 7);
+
+    uint64_t hits, misses, stores;
+    CatDecisionCacheStats(&cache, &hits, &misses, &stores);
+    XCTAssertEqual(hits, 2ULL);
+    XCTAssertEqual(misses, 2ULL);
+    XCTAssertEqual(stores, 2ULL);
+}
+
+- (void)testWholeHashIsCompared
+{
+    // Same shard, same pair of slots, same high half: only a middle bit differs.
+    uint64_t hash = [self hash:"http://example.com/tabby.jpg"];
+    uint64_t other = hash ^ (1ULL << 20);
+    int intercept = 0, rule = 0;
+    CatDecisionCacheStore(&cache, hash, 1, 1, 4);
+    XCTAssertFalse(CatDecisionCacheLookup(&cache, other, 1, &intercept, &rule));
+    CatDecisionCacheStore(&cache, other, 1, 0, -1);
+    XCTAssertTrue(CatDecisionCacheLookup(&cache, hash, 1, &intercept, &rule));
+    XCTAssertEqual(rule, 4);
+    XCTAssertTrue(CatDecisionCacheLookup(&cache, other, 1, &intercept, &rule));
+    XCTAssertEqual(rule, -1);
+}
+
+- (void)testHashChains
+{
+    XCTAssertEqual([self hash:"http://example.com/a.gif"],
+                   CatDecisionHash(CatDecisionHash(kCatDecisionHashSeed, "http://example", 14), ".com/a.gif", 10));
+}
+
+- (void)testConcurrentReadersSeeWholeEntries
+{
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        for(int i=0; i<50000; i++) {
+            int n = (int)((i * 7 + worker) % 3000);
+            char url[64];
+            snprintf(url, sizeof(url), "http://example.com/%d.jpg", n);
+            uint64_t hash = CatDecisionHash(kCatDecisionHashSeed, url, strlen(url));
+            int expected = n % 3 == 0, intercept, rule;
+            if(CatDecisionCacheLookup(&cache, hash, 5, &intercept, &rule)) {
+                XCTAssertEqual(intercept, expected);
+                XCTAssertEqual(rule, expected ? 2 : -1);
+            }
+            else {
+                CatDecisionCacheStore(&cache, hash, 5, expected, expected ? 2 : -1);
+            }
+        }
+    });
+    uint64_t hits, misses;
+    CatDecisionCacheStats(&cache, &hits, &misses, NULL);
+    XCTAssertTrue(hits > misses);
+}
+
+- (void)testProtocolCachesAndFollowsTheToggle
+{
+    CatInterceptConfig* previous = [CatURLProtocol config];
+    [CatURLProtocol setConfig:[CatInterceptConfig defaultConfig]];
+    [CatURLProtocol resetDecisionCacheStats];
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/decision.jpg"]];
+
+    XCTAssertTrue([CatURLProtocol canInitWithRequest:request]);
+    XCTAssertTrue([CatURLProtocol canInitWithRequest:request]);
+    XCTAssertTrue([CatURLProtocol canInitWithRequest:request]);
+    NSDictionary* stats = [CatURLProtocol decisionCacheStats];
+    XCTAssertEqualObjects(stats[@"hits"], @2);
+    XCTAssertEqualObjects(stats[@"misses"], @1);
+
+    [CatURLProtocol setCat:NO];
+    XCTAssertFalse([CatURLProtocol canInitWithRequest:request]);
+    [CatURLProtocol setCat:YES];
+    XCTAssertTrue([CatURLProtocol canInitWithRequest:request]);
+    // The toggle made a new config, so the first check after it was a miss.
+    XCTAssertEqualObjects([CatURLProtocol decisionCacheStats][@"misses"], @2);
+
+    // Our own replacement fetches carry a marker and are left alone.
+    NSMutableURLRequest* marked = [CatURLProtocol catRequestForType:@"jpg"];
+    marked.URL = request.URL;
+    XCTAssertFalse([CatURLProtocol canInitWithRequest:marked]);
+
+    [CatURLProtocol setConfig:previous];
+}
+
+@end
@@ -0,0 +1,138 @@
+//
+//  CatFormatPolicyTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/25/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Offline comparison of format policies: a synthetic browsing trace is
+//  replayed against decode costs seeded from typical measurements, and the
+//  decoded memory per page is compared.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatDecodeCostPolicy.h"
+#import "CatInterceptConfig.h"
+#import "CatImageResizer.h"
+
+static const NSUInteger kPages = 200;
+static const NSUInteger kImagesPerPage = 30;
+static const uint64_t kGifFrames = 12;
+
+@interface CatFormatPolicyTests : XCTestCase
+@end
+
+@implementation CatFormatPolicyTests
+
+// Decoded size of one image: 4 bytes per pixel, every frame for gifs.
+static uint64_t decodedBytes(NSString* type, NSUInteger sizeClass)
+{
+    uint64_t side = CatImageSizeClasses[sizeClass];
+    return side * side * 4 * ([type isEqualToString:@"gif"] ? kGifFrames : 1);
+}
+
+- (CatDecodeCostPolicy*)seededPolicy
+{
+    CatDecodeCostPolicy* policy = [[CatDecodeCostPolicy alloc] init];
+    for(NSString* type in @[@"gif", @"jpg", @"png"]) {
+        for(NSUInteger sizeClass=0; sizeClass<CatImageSizeClassCount; sizeClass++) {
+            uint64_t bytes = decodedBytes(type, sizeClass);
+            [policy recordDecodeOfType:type sizeClass:sizeClass nanoseconds:bytes / 4 bytes:bytes];
+        }
+    }
+    return policy;
+}
+
+// Replays the trace; returns decoded bytes per page and fills the other averages.
+- (double)replay:(id<CatFormatPolicy>)policy gifsPerPage:(double*)gifsPerPage maxGifs:(NSUInteger*)maxGifs originalMatches:(double*)originalMatches
+{
+    CatInterceptConfig* config = [CatInterceptConfig defaultConfig];
+    NSArray* extensions = @[@"jpg", @"png", @"gif", @"jpeg"];
+    srandom(42);
+    uint64_t bytes = 0;
+    NSUInteger gifs = 0, matches = 0;
+    *maxGifs = 0;
+    for(NSUInteger page=0; page<kPages; page++) {
+        if([policy respondsToSelector:@selector(resetPage)]) {
+            [policy resetPage];
+        }
+        NSUInteger pageGifs = 0;
+        for(NSUInteger i=0; i<kImagesPerPage; i++) {
+            // Mostly thumbnails, a few large images per page.
+            NSUInteger sizeClass = random() % 8 == 0 ? CatImageSizeClassCount - 1 - random() % 2 : random() % 4;
+            NSString* extension = extensions[random() % extensions.count];
+            NSURL* url = [NSURL URLWithString:[NSString stringWithFormat:@"http://example.com/%lu/%lu.%@", (unsigned long)page, (unsigned long)i, extension]];
+            NSString* type = [policy typeForURL:url sizeClass:sizeClass config:config];
+            bytes += decodedBytes(type, sizeClass);
+            pageGifs += [type isEqualToString:@"gif"];
+            matches += [type isEqualToString:CatFormatTypeForExtension(extension)];
+        }
+        gifs += pageGifs;
+        *maxGifs = MAX(*maxGifs, pageGifs);
+    }
+    *gifsPerPage = (double)gifs / kPages;
+    *originalMatches = (double)matches / (kPages * kImagesPerPage);
+    return (double)bytes / kPages;
+}
+
+- (void)testDecodeCostPolicyAgainstWeightedDraw
+{
+    double weightedGifs, costGifs, weightedMatches, costMatches;
+    NSUInteger weightedMax, costMax;
+    double weightedBytes = [self replay:[[CatWeightedFormatPolicy alloc] init] gifsPerPage:&weightedGifs maxGifs:&weightedMax originalMatches:&weightedMatches];
+    CatDecodeCostPolicy* policy = [self seededPolicy];
+    double costBytes = [self replay:policy gifsPerPage:&costGifs maxGifs:&costMax originalMatches:&costMatches];
+
+    NSLog(@"decoded per page: weighted %.1fMB (%.1f gifs, %.0f%% original format), decode cost %.1fMB (%.1f gifs, %.0f%% original format, %lu gifs avoided)",
+          weightedBytes / 1048576, weightedGifs, weightedMatches * 100,
+          costBytes / 1048576, costGifs, costMatches * 100, (unsigned long)policy.avoidedAnimations);
+
+    NSUInteger animationsPerPage = [[CatInterceptConfig defaultConfig].formatBudget[@"animationsPerPage"] unsignedIntegerValue];
+    XCTAssertTrue(costMax <= animationsPerPage);
+    XCTAssertTrue(costBytes < weightedBytes / 2);
+    XCTAssertTrue(costMatches > weightedMatches);
+}
+
+- (void)testNoGifsUnderMemoryPressure
+{
+    CatDecodeCostPolicy* policy = [[CatDecodeCostPolicy alloc] init];
+    CatInterceptConfig* config = [CatInterceptConfig configWithDictionary:@{ CatInterceptFormatBudgetKey: @{ @"preferOriginal": @100 } }];
+    NSURL* url = [NSURL URLWithString:@"http://example.com/dancing.gif"];
+    NSUInteger gifs = 0;
+    for(int i=0; i<50; i++) {
+        gifs += [[policy typeForURL:url sizeClass:2 config:config] isEqualToString:@"gif"];
+    }
+    XCTAssertTrue(gifs > 40);
+
+    [policy noteMemoryWarning];
+    XCTAssertTrue(policy.underMemoryPressure);
+    for(int i=0; i<50; i++) {
+        XCTAssertNotEqualObjects([policy typeForURL:url sizeClass:2 config:config], @"gif");
+    }
+    policy.pressureInterval = 0;
+    [policy noteMemoryWarning];
+    XCTAssertFalse(policy.underMemoryPressure);
+}
+
+- (void)testMeasuresDeliveredImages
+{
+    CatDecodeCostPolicy* policy = [[CatDecodeCostPolicy alloc] init];
+    NSData* data = [NSData dataWithContentsOfFile:[[NSBundle mainBundle] pathForResource:@"home.png" ofType:nil]];
+    XCTAssertNotNil(data);
+    [policy didDeliverData:data type:@"png" sizeClass:1];
+    NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while(![policy expectedBytesForType:@"png" sizeClass:1] && [deadline timeIntervalSinceNow] > 0) {
+        [NSThread sleepForTimeInterval:.01];
+    }
+    XCTAssertTrue([policy expectedBytesForType:@"png" sizeClass:1] > 0);
+    XCTAssertEqual([policy costs].count, (NSUInteger)1);
+}
+
+- (void)testBudgetIsPartOfTheConfig
+{
+    CatInterceptConfig* config = [CatInterceptConfig configWithDictionary:@{ CatInterceptFormatBudgetKey: @{ @"animationsPerPage": @1 } }];
+    XCTAssertEqualObjects([config dictionaryRepresentation][CatInterceptFormatBudgetKey], @{ @"animationsPerPage": @1 });
+    XCTAssertNil([CatInterceptConfig configWithDictionary:@{ CatInterceptFormatBudgetKey: @"lots" }]);
+}
+
+@end
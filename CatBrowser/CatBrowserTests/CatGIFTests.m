@@ -0,0 +1,110 @@
+//
+//  CatGIFTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/26/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  ImageIO reading a transcoded gif, and the downgrader under memory
+//  pressure. The transcoder itself is tested in CatCoreTests.c.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatGIF.h"
+#import "CatGIFDowngrader.h"
+#import <ImageIO/ImageIO.h>
+
+@interface CatGIFTests : XCTestCase
+@end
+
+@implementation CatGIFTests
+
+static void append16(NSMutableData* data, uint16_t value)
+{
+    uint8_t bytes[2] = { value & 0xFF, value >> 8 };
+    [data appendBytes:bytes length:2];
+}
+
+// A looping animation of stripes, 4 colors, every frame covering the canvas.
+static NSData* makeGIF(uint16_t width, uint16_t height, int frames, BOOL interlaced)
+{
+    NSMutableData* gif = [NSMutableData dataWithBytes:"GIF89a" length:6];
+    append16(gif, width);
+    append16(gif, height);
+    uint8_t screen[] = { 0xF1, 0, 0, 0,0,0, 255,0,0, 0,255,0, 0,0,255 };
+    [gif appendBytes:screen length:sizeof(screen)];
+    [gif appendBytes:"\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00" length:19];
+    NSMutableData* pixels = [NSMutableData dataWithLength:width * height];
+    for(int f=0; f<frames; f++) {
+        [gif appendBytes:"\x21\xF9\x04\x04\x0A\x00\x00\x00" length:8];
+        [gif appendBytes:"\x2C" length:1];
+        append16(gif, 0);
+        append16(gif, 0);
+        append16(gif, width);
+        append16(gif, height);
+        uint8_t flags[] = { interlaced ? 0x40 : 0, 2 };
+        [gif appendBytes:flags length:2];
+        uint8_t* p = pixels.mutableBytes;
+        for(int i=0; i<width * height; i++) {
+            p[i] = ((i % width) / 7 + (i / width) / 5 + f) & 3;
+        }
+        size_t length = 0;
+        uint8_t* codes = CatGIFEncodeLZW(p, pixels.length, 2, &length);
+        for(size_t offset=0; offset<length; offset+=255) {
+            uint8_t chunk = (uint8_t)MIN(255, length - offset);
+            [gif appendBytes:&chunk length:1];
+            [gif appendBytes:codes + offset length:chunk];
+        }
+        free(codes);
+        [gif appendBytes:"\0" length:1];
+    }
+    [gif appendBytes:"\x3B" length:1];
+    return gif;
+}
+
+- (void)testImageIOReadsTranscodedGIF
+{
+    NSData* gif = makeGIF(400, 300, 3, YES);
+    uint8_t* output = NULL;
+    size_t length = 0;
+    CatGIFLimits limits = { 2, 100 };
+    XCTAssertEqual(CatGIFTranscode(gif.bytes, gif.length, limits, &output, &length, NULL, NULL), 1);
+    CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef)[NSData dataWithBytesNoCopy:output length:length], NULL);
+    XCTAssertEqual(CGImageSourceGetCount(source), (size_t)2);
+    CGImageRef image = CGImageSourceCreateImageAtIndex(source, 1, NULL);
+    XCTAssertEqual(CGImageGetWidth(image), (size_t)100);
+    XCTAssertEqual(CGImageGetHeight(image), (size_t)75);
+    CGImageRelease(image);
+    CFRelease(source);
+}
+
+- (void)testDowngradesUnderMemoryPressure
+{
+    CatGIFDowngrader* downgrader = [[CatGIFDowngrader alloc] init];
+    NSData* gif = makeGIF(200, 200, 6, NO);
+    XCTAssertEqual(downgrader.activeMode, CatGIFDowngradeNone);
+    XCTAssertEqualObjects([downgrader dataForGIF:gif key:@"test.gif" sizeClass:0], gif);
+
+    [downgrader noteMemoryWarning];
+    XCTAssertEqual(downgrader.activeMode, CatGIFDowngradeFirstFrame);
+    NSData* downgraded = [downgrader dataForGIF:gif key:@"test.gif" sizeClass:0];
+    CatGIFInfo info;
+    XCTAssertEqual(CatGIFInspect(downgraded.bytes, downgraded.length, &info), 0);
+    XCTAssertEqual(info.frames, 1u);
+    XCTAssertEqual(downgrader.bytesSaved, 200ull * 200 * 4 * 5);
+    // The second time comes from the cache and counts too.
+    XCTAssertEqualObjects([downgrader dataForGIF:gif key:@"test.gif" sizeClass:0], downgraded);
+    XCTAssertEqual(downgrader.transcodedImages, (NSUInteger)2);
+
+    downgrader.pressureMode = CatGIFDowngradeResolutionCap;
+    downgraded = [downgrader dataForGIF:gif key:@"test.gif" sizeClass:64];
+    XCTAssertEqual(CatGIFInspect(downgraded.bytes, downgraded.length, &info), 0);
+    XCTAssertEqual(info.width, 64u);
+    XCTAssertEqual(info.frames, 6u);
+
+    downgrader.pressureInterval = 0;
+    [downgrader noteMemoryWarning];
+    XCTAssertEqual(downgrader.activeMode, CatGIFDowngradeNone);
+}
+
+@end
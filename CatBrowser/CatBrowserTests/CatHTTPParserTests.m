@@ -0,0 +1,164 @@
+//
+//  CatHTTPParserTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/22/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatHTTPParser.h"
+
+typedef struct {
+    int heads;
+    int completes;
+    int lastStatus;
+    int keepAlive;
+    BOOL complete;
+    char body[1024];
+    size_t bodyLength;
+} ParseResult;
+
+static CatHTTPParser parser;
+
+static void onHead(void* context, int status, const char* head, size_t length)
+{
+    ParseResult* result = context;
+    result->heads++;
+    result->lastStatus = status;
+}
+
+static void onBody(void* context, const char* bytes, size_t length)
+{
+    ParseResult* result = context;
+    memcpy(result->body + result->bodyLength, bytes, length);
+    result->bodyLength += length;
+}
+
+static void onComplete(void* context)
+{
+    ParseResult* result = context;
+    result->completes++;
+    result->complete = YES;
+    result->keepAlive = parser.keepAlive;
+}
+
+@interface CatHTTPParserTests : XCTestCase
+@end
+
+@implementation CatHTTPParserTests
+
+- (void)startParsing:(ParseResult*)result
+{
+    memset(result, 0, sizeof(*result));
+    CatHTTPCallbacks callbacks = { onHead, onBody, onComplete };
+    CatHTTPParserInit(&parser, callbacks, result);
+}
+
+// Feeds the bytes step at a time, the way a socket would hand them over.
+- (BOOL)feed:(const char*)bytes step:(size_t)step result:(ParseResult*)result
+{
+    size_t length = strlen(bytes), offset = 0;
+    while(offset < length) {
+        long used = CatHTTPParserFeed(&parser, bytes + offset, MIN(step, length - offset));
+        if(used < 0) {
+            return NO;
+        }
+        offset += used;
+        if(result->complete) {
+            result->complete = NO;
+            CatHTTPParserReset(&parser);
+        }
+    }
+    return YES;
+}
+
+- (void)testPipelinedResponsesAtEverySplit
+{
+    const char* responses =
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nContent-Type: image/jpeg\r\n\r\nhello"
+        "HTTP/1.1 100 Continue\r\n\r\n"
+        "HTTP/1.1 302 Found\r\nLocation: /x\r\nContent-Length: 0\r\n\r\n"
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3;x=y\r\nabc\r\n1A\r\nabcdefghijklmnopqrstuvwxyz\r\n0\r\nX-T: 1\r\n\r\n";
+    for(size_t step=1; step<40; step++) {
+        ParseResult result;
+        [self startParsing:&result];
+        XCTAssertTrue([self feed:responses step:step result:&result]);
+        XCTAssertEqual(result.heads, 3, @"step %zu", step);
+        XCTAssertEqual(result.completes, 3, @"step %zu", step);
+        XCTAssertTrue(result.keepAlive);
+        XCTAssertEqual(result.bodyLength, (size_t)34);
+        XCTAssertTrue(memcmp(result.body, "helloabcabcdefghijklmnopqrstuvwxyz", 34) == 0);
+    }
+}
+
+- (void)testBodyUntilClose
+{
+    ParseResult result;
+    [self startParsing:&result];
+    const char* response = "HTTP/1.0 200 OK\r\nContent-Type: image/gif\r\n\r\nstream until close";
+    XCTAssertEqual(CatHTTPParserFeed(&parser, response, strlen(response)), (long)strlen(response));
+    XCTAssertFalse(parser.keepAlive);
+    XCTAssertEqual(CatHTTPParserFinish(&parser), 0);
+    XCTAssertEqual(result.completes, 1);
+    XCTAssertEqual(result.bodyLength, (size_t)18);
+}
+
+- (void)testTruncatedAndMalformed
+{
+    ParseResult result;
+    [self startParsing:&result];
+    const char* truncated = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc";
+    CatHTTPParserFeed(&parser, truncated, strlen(truncated));
+    XCTAssertEqual(CatHTTPParserFinish(&parser), -1);
+
+    [self startParsing:&result];
+    XCTAssertEqual(CatHTTPParserFeed(&parser, "garbage\r\n\r\n", 11), -1L);
+}
+
+- (void)testOversizedContentLength
+{
+    ParseResult result;
+    [self startParsing:&result];
+    const char* response = "HTTP/1.1 200 OK\r\nContent-Length: 18446744073709551615\r\n\r\nabc";
+    XCTAssertEqual(CatHTTPParserFeed(&parser, response, strlen(response)), -1L);
+    XCTAssertEqual(result.heads, 0);
+    XCTAssertEqual(result.bodyLength, (size_t)0);
+
+    [self startParsing:&result];
+    response = "HTTP/1.1 200 OK\r\nContent-Length: 99999999999999999999\r\n\r\n";
+    XCTAssertEqual(CatHTTPParserFeed(&parser, response, strlen(response)), -1L);
+}
+
+- (void)testAmbiguousContentLength
+{
+    const char* malformed[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 12abc\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 12, 13\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 3\r\nContent-Length: 5\r\n\r\n",
+    };
+    ParseResult result;
+    for(int i=0; i<3; i++) {
+        [self startParsing:&result];
+        XCTAssertEqual(CatHTTPParserFeed(&parser, malformed[i], strlen(malformed[i])), -1L, @"%s", malformed[i]);
+        XCTAssertEqual(result.heads, 0);
+    }
+
+    [self startParsing:&result];
+    const char* repeated = "HTTP/1.1 200 OK\r\nContent-Length: 3 \r\nContent-Length: 3\r\n\r\nabc";
+    XCTAssertEqual(CatHTTPParserFeed(&parser, repeated, strlen(repeated)), (long)strlen(repeated));
+    XCTAssertEqual(result.completes, 1);
+    XCTAssertEqual(result.bodyLength, (size_t)3);
+}
+
+- (void)testConnectionClose
+{
+    ParseResult result;
+    [self startParsing:&result];
+    const char* response = "HTTP/1.1 204 No Content\r\nConnection: close\r\n\r\n";
+    XCTAssertEqual(CatHTTPParserFeed(&parser, response, strlen(response)), (long)strlen(response));
+    XCTAssertEqual(result.completes, 1);
+    XCTAssertFalse(result.keepAlive);
+}
+
+@end
@@ -0,0 +1,222 @@
+//
+//  CatHistoryLogTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/29/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Appends, lookups and reopening, recovery from a torn append and from a
+//  stale or missing table, compaction, then a benchmark of two million
+//  visits over 100k locations.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatHistoryLog.h"
+#import "CatHistoryStore.h"
+#import "CatMetrics.h"
+
+static const int kBenchmarkVisits = 2000000;
+static const int kBenchmarkLocations = 100000;
+
+@interface CatHistoryLogTests : XCTestCase
+@end
+
+@implementation CatHistoryLogTests
+{
+    NSString* directory;
+    CatHistoryLog* log;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:NULL];
+    log = CatHistoryLogOpen(directory.fileSystemRepresentation);
+    XCTAssertTrue(log != NULL);
+}
+
+- (void)tearDown
+{
+    CatHistoryLogClose(log);
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+    [super tearDown];
+}
+
+- (void)reopen
+{
+    CatHistoryLogClose(log);
+    log = CatHistoryLogOpen(directory.fileSystemRepresentation);
+    XCTAssertTrue(log != NULL);
+}
+
+- (void)append:(NSString*)url title:(NSString*)title time:(double)time
+{
+    XCTAssertEqual(CatHistoryLogAppend(log, url.UTF8String, strlen(url.UTF8String), title.UTF8String, strlen(title.UTF8String), time), 0);
+}
+
+- (CatHistoryVisit)lookup:(NSString*)url
+{
+    CatHistoryVisit visit = { 0 };
+    CatHistoryLogLookup(log, url.UTF8String, strlen(url.UTF8String), &visit);
+    return visit;
+}
+
+- (NSString*)titleOf:(NSString*)url
+{
+    CatHistoryVisit visit = [self lookup:url];
+    return visit.title ? [[NSString alloc] initWithBytes:visit.title length:visit.titleLength encoding:NSUTF8StringEncoding] : nil;
+}
+
+- (void)appendVisits
+{
+    for(int i=0; i<5000; i++) {
+        [self append:[NSString stringWithFormat:@"http://example.com/%d", i % 700] title:[NSString stringWithFormat:@"Page %d", i] time:i];
+    }
+}
+
+static int countVisit(const CatHistoryVisit* visit, void* context)
+{
+    double* last = context;
+    if(visit->time > last[0]) {
+        last[1] = -1;
+        return 0;
+    }
+    last[0] = visit->time;
+    last[1]++;
+    return 1;
+}
+
+- (void)testAppendAndLookup
+{
+    [self appendVisits];
+    XCTAssertEqual(CatHistoryLogRecordCount(log), (uint64_t)5000);
+    XCTAssertEqual(CatHistoryLogURLCount(log), (uint64_t)700);
+    CatHistoryVisit visit = [self lookup:@"http://example.com/5"];
+    XCTAssertEqual(visit.visits, (uint32_t)8);
+    XCTAssertEqual(visit.time, 4905.);
+    XCTAssertEqualObjects([self titleOf:@"http://example.com/5"], @"Page 4905");
+    XCTAssertEqual(CatHistoryLogLookup(log, "http://example.com/5000", 23, &visit), 0);
+
+    double last[2] = { INFINITY, 0 };
+    XCTAssertEqual(CatHistoryLogEnumerateSince(log, 4990, countVisit, last), (size_t)10);
+    XCTAssertEqual(last[1], 10.);
+
+    [self reopen];
+    XCTAssertEqual(CatHistoryLogRecordCount(log), (uint64_t)5000);
+    XCTAssertEqual([self lookup:@"http://example.com/5"].visits, (uint32_t)8);
+}
+
+- (void)testRecovery
+{
+    [self appendVisits];
+    uint64_t bytes = CatHistoryLogBytes(log);
+    [self reopen];
+    // An append cut short by a crash.
+    NSString* logPath = [directory stringByAppendingPathComponent:@"history.log"];
+    NSFileHandle* file = [NSFileHandle fileHandleForWritingAtPath:logPath];
+    [file seekToEndOfFile];
+    [file writeData:[@"CatRtorn" dataUsingEncoding:NSUTF8StringEncoding]];
+    [file closeFile];
+    [self reopen];
+    XCTAssertEqual(CatHistoryLogBytes(log), bytes);
+    XCTAssertEqual(CatHistoryLogRecordCount(log), (uint64_t)5000);
+
+    // A table behind the log catches up; a missing one is rebuilt.
+    NSString* indexPath = [directory stringByAppendingPathComponent:@"history.idx"];
+    NSData* stale = [NSData dataWithContentsOfFile:indexPath];
+    [self append:@"http://example.com/new" title:@"New" time:6000];
+    CatHistoryLogClose(log);
+    [stale writeToFile:indexPath atomically:NO];
+    log = CatHistoryLogOpen(directory.fileSystemRepresentation);
+    XCTAssertEqual(CatHistoryLogURLCount(log), (uint64_t)701);
+    XCTAssertEqualObjects([self titleOf:@"http://example.com/new"], @"New");
+
+    CatHistoryLogClose(log);
+    [[NSFileManager defaultManager] removeItemAtPath:indexPath error:NULL];
+    log = CatHistoryLogOpen(directory.fileSystemRepresentation);
+    XCTAssertEqual(CatHistoryLogRecordCount(log), (uint64_t)5001);
+    XCTAssertEqual([self lookup:@"http://example.com/5"].visits, (uint32_t)8);
+}
+
+- (void)testCompaction
+{
+    [self appendVisits];
+    XCTAssertTrue(CatHistoryLogNeedsCompaction(log));
+    uint64_t bytes = CatHistoryLogBytes(log);
+    // Locations last visited before 4400 are dropped.
+    XCTAssertEqual(CatHistoryLogCompact(log, 4400), 0);
+    XCTAssertEqual(CatHistoryLogURLCount(log), (uint64_t)600);
+    XCTAssertEqual(CatHistoryLogRecordCount(log), (uint64_t)600);
+    XCTAssertTrue(CatHistoryLogBytes(log) < bytes / 5);
+    XCTAssertEqual([self lookup:@"http://example.com/5"].visits, (uint32_t)8);
+    XCTAssertEqual([self lookup:@"http://example.com/150"].visits, (uint32_t)0);
+
+    double last[2] = { INFINITY, 0 };
+    CatHistoryLogEnumerateSince(log, 0, countVisit, last);
+    XCTAssertEqual(last[1], 600.);
+
+    [self append:@"http://example.com/5" title:@"Again" time:7000];
+    [self reopen];
+    CatHistoryVisit visit = [self lookup:@"http://example.com/5"];
+    XCTAssertEqual(visit.visits, (uint32_t)9);
+    XCTAssertEqual(visit.time, 7000.);
+}
+
+- (void)testStore
+{
+    CatHistoryStore* store = [[CatHistoryStore alloc] initWithDirectory:[directory stringByAppendingPathComponent:@"store"]];
+    [store addVisitToLocation:@"http://cats.example.com/" title:@"Chats élégants"];
+    [store addVisitToLocation:@"http://cats.example.com/" title:@"Cats"];
+    [store waitUntilWritten];
+    XCTAssertEqual(store.locationCount, 1ULL);
+
+    __block CatHistoryEntry* found = nil;
+    [store entryForLocation:@"http://cats.example.com/" completion:^(CatHistoryEntry* entry) {
+        found = entry;
+    }];
+    NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    while(!found && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:.01]];
+    }
+    XCTAssertEqualObjects(found.title, @"Cats");
+    XCTAssertEqual(found.visits, (NSUInteger)2);
+}
+
+- (void)testBenchmarkMillionsOfVisits
+{
+    char url[128];
+    srandom(11);
+    uint64_t start = CatMetricsNow();
+    for(int i=0; i<kBenchmarkVisits; i++) {
+        int length = snprintf(url, sizeof(url), "http://site%ld.example.com/page/%ld", random() % 1000, random() % (kBenchmarkLocations / 1000));
+        CatHistoryLogAppend(log, url, length, "A page title", 12, i);
+    }
+    double insertSeconds = (CatMetricsNow() - start) / 1e9;
+
+    CatHistoryVisit visit;
+    int hits = 0;
+    start = CatMetricsNow();
+    for(int i=0; i<100000; i++) {
+        int length = snprintf(url, sizeof(url), "http://site%ld.example.com/page/%ld", random() % 1000, random() % (kBenchmarkLocations / 1000));
+        hits += CatHistoryLogLookup(log, url, length, &visit) == 1;
+    }
+    double lookupNanoseconds = (CatMetricsNow() - start) / 100000.;
+
+    start = CatMetricsNow();
+    [self reopen];
+    double openMilliseconds = (CatMetricsNow() - start) / 1e6;
+    start = CatMetricsNow();
+    XCTAssertEqual(CatHistoryLogCompact(log, 0), 0);
+    double compactMilliseconds = (CatMetricsNow() - start) / 1e6;
+
+    NSLog(@"%d visits, %llu locations: %.0f inserts/s, lookup %.0fns, open %.2fms, compaction %.0fms to %.1fMB",
+          kBenchmarkVisits, CatHistoryLogURLCount(log), kBenchmarkVisits / insertSeconds, lookupNanoseconds,
+          openMilliseconds, compactMilliseconds, CatHistoryLogBytes(log) / 1048576.);
+    XCTAssertEqual(hits, 100000);
+    XCTAssertEqual(CatHistoryLogURLCount(log), (uint64_t)kBenchmarkLocations);
+    // Opening does not parse the log.
+    XCTAssertTrue(openMilliseconds < 50);
+}
+
+@end
@@ -0,0 +1,144 @@
+//
+//  CatImagePoolTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/16/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatImagePool.h"
+
+@interface CatImagePoolTests : XCTestCase
+@end
+
+@implementation CatImagePoolTests
+{
+    CatImagePool* pool;
+    NSMutableArray* requested;      // type of every call to the source
+    NSUInteger available;           // images the stub origin still has
+}
+
+- (void)setUp
+{
+    [super setUp];
+    pool = [[CatImagePool alloc] initWithTypes:@[@"gif", @"jpg"] capacity:8];
+    requested = [NSMutableArray array];
+    available = NSUIntegerMax;
+}
+
+- (void)useStubSource
+{
+    __weak CatImagePoolTests* weakSelf = self;
+    pool.source = ^NSData*(NSString* type, NSString** key) {
+        CatImagePoolTests* tests = weakSelf;
+        @synchronized(tests) {
+            if(!tests || !tests->available) {
+                return nil;
+            }
+            tests->available--;
+            [tests->requested addObject:type];
+            *key = [NSString stringWithFormat:@"%lu.%@", (unsigned long)tests->requested.count, type];
+            return [NSMutableData dataWithLength:100];
+        }
+    };
+}
+
+- (BOOL)waitFor:(BOOL(^)(void))condition timeout:(NSTimeInterval)timeout
+{
+    NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:timeout];
+    while(!condition() && [deadline timeIntervalSinceNow] > 0) {
+        [NSThread sleepForTimeInterval:.01];
+    }
+    return condition();
+}
+
+- (void)testRingKeepsOrderAndKeys
+{
+    XCTAssertEqual(pool.lowWatermark, (NSUInteger)3);
+    XCTAssertEqual(pool.highWatermark, (NSUInteger)8);
+    XCTAssertEqual(pool.refillBatch, (NSUInteger)4);
+    for(NSUInteger i=0; i<8; i++) {
+        XCTAssertTrue([pool addImage:[NSMutableData dataWithLength:i+1] key:[NSString stringWithFormat:@"%lu.jpg", (unsigned long)i] type:@"jpg"]);
+    }
+    XCTAssertFalse([pool addImage:[NSMutableData dataWithLength:1] key:nil type:@"jpg"]);
+    XCTAssertFalse([pool addImage:[NSMutableData dataWithLength:1] key:nil type:@"png"]);
+    XCTAssertFalse([pool addImage:[NSData data] key:nil type:@"gif"]);
+    XCTAssertEqual(pool.residentBytes, 36ULL);
+
+    NSString* key = nil;
+    XCTAssertEqual([pool takeImageOfType:@"jpg" key:&key].length, (NSUInteger)1);
+    XCTAssertEqualObjects(key, @"0.jpg");
+    XCTAssertTrue([pool addImage:[NSMutableData dataWithLength:9] key:nil type:@"jpg"]);
+    for(NSUInteger i=1; i<8; i++) {
+        XCTAssertEqual([pool takeImageOfType:@"jpg" key:NULL].length, i+1);
+    }
+    XCTAssertEqual([pool takeImageOfType:@"jpg" key:&key].length, (NSUInteger)9);
+    XCTAssertNil(key);
+    XCTAssertEqual(pool.residentBytes, 0ULL);
+}
+
+- (void)testDryTakes
+{
+    XCTAssertNil([pool takeImageOfType:@"jpg" key:NULL]);
+    XCTAssertNil([pool takeImageOfType:@"png" key:NULL]);
+    [pool addImage:[NSMutableData dataWithLength:10] key:nil type:@"gif"];
+    XCTAssertNotNil([pool takeImageOfType:@"gif" key:NULL]);
+    XCTAssertEqual(pool.takes, (NSUInteger)3);
+    XCTAssertEqual(pool.dryTakes, (NSUInteger)2);
+    // Without a source nothing is refilled.
+    XCTAssertEqual(pool.refills, (NSUInteger)0);
+}
+
+- (void)testRefillsEveryLowRingToHighWatermark
+{
+    [self useStubSource];
+    [pool scheduleRefill];
+    XCTAssertTrue([self waitFor:^BOOL{ return pool.refilledImages == 16; } timeout:5]);
+    XCTAssertEqual(pool.refills, (NSUInteger)2);
+    XCTAssertEqual([pool depthForType:@"gif"], (NSUInteger)8);
+    XCTAssertEqual([pool depthForType:@"jpg"], (NSUInteger)8);
+    XCTAssertEqual(requested.count, (NSUInteger)16);
+
+    // Down to the low watermark is fine; under it schedules a refill.
+    NSString* key = nil;
+    for(NSUInteger i=0; i<5; i++) {
+        [pool takeImageOfType:@"jpg" key:&key];
+    }
+    XCTAssertTrue([key hasSuffix:@".jpg"]);
+    [NSThread sleepForTimeInterval:.1];
+    XCTAssertEqual(pool.refills, (NSUInteger)2);
+    [pool takeImageOfType:@"jpg" key:NULL];
+    // A batch of 4, then 2 more to the high watermark, and nothing fetched past it.
+    XCTAssertTrue([self waitFor:^BOOL{ return pool.refilledImages == 22; } timeout:5]);
+    XCTAssertEqual(pool.refills, (NSUInteger)3);
+    XCTAssertEqual([pool depthForType:@"jpg"], (NSUInteger)8);
+    XCTAssertEqual(requested.count, (NSUInteger)22);
+}
+
+- (void)testDryOriginEndsTheBatch
+{
+    [self useStubSource];
+    available = 3;
+    [pool scheduleRefill];
+    XCTAssertTrue([self waitFor:^BOOL{ return pool.refills == 2; } timeout:5]);
+    [NSThread sleepForTimeInterval:.1];
+    XCTAssertEqual(pool.refilledImages, (NSUInteger)3);
+    XCTAssertEqual(requested.count, (NSUInteger)3);
+    XCTAssertEqual([pool depthForType:@"gif"] + [pool depthForType:@"jpg"], (NSUInteger)3);
+}
+
+- (void)testDrain
+{
+    [self useStubSource];
+    [pool scheduleRefill];
+    XCTAssertTrue([self waitFor:^BOOL{ return pool.refilledImages == 16; } timeout:5]);
+    XCTAssertEqual(pool.residentBytes, 1600ULL);
+    [pool drain];
+    XCTAssertEqual([pool depthForType:@"jpg"], (NSUInteger)0);
+    XCTAssertEqual(pool.residentBytes, 0ULL);
+    XCTAssertNil([pool takeImageOfType:@"gif" key:NULL]);
+    XCTAssertEqualObjects([pool metrics][@"dryTakes"], @1);
+}
+
+@end
@@ -0,0 +1,63 @@
+//
+//  CatImageResizerTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/17/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatImageResizer.h"
+#import "CatImageStore.h"
+
+@interface CatImageResizerTests : XCTestCase
+@end
+
+@implementation CatImageResizerTests
+
+- (NSUInteger)hint:(NSString*)url
+{
+    return [CatImageResizer pixelHintForURL:[NSURL URLWithString:url]];
+}
+
+- (void)testPixelHints
+{
+    XCTAssertEqual([self hint:@"http://example.com/avatar.png?width=48&v=2"], (NSUInteger)48);
+    XCTAssertEqual([self hint:@"https://www.google.com/images?q=tbn:x&sz=90"], (NSUInteger)90);
+    XCTAssertEqual([self hint:@"https://lh3.googleusercontent.com/-abc/AAAA/s72-c/photo.jpg"], (NSUInteger)72);
+    XCTAssertEqual([self hint:@"https://lh3.googleusercontent.com/abc=w120-h90"], (NSUInteger)120);
+    XCTAssertEqual([self hint:@"http://cdn.example.com/thumbs/cat_160x120.jpg"], (NSUInteger)160);
+    XCTAssertEqual([self hint:@"http://cdn.example.com/cats/tabby.jpg"], (NSUInteger)0);
+}
+
+- (void)testSizeClasses
+{
+    NSString* directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    CatImageResizer* resizer = [[CatImageResizer alloc] initWithStore:[[CatImageStore alloc] initWithDirectory:directory budget:1024*1024]];
+    resizer.screenScale = 2;
+    resizer.defaultSizeClass = 512;
+    XCTAssertEqual([resizer sizeClassForURL:[NSURL URLWithString:@"http://example.com/a.png?w=32"]], (NSUInteger)64);
+    XCTAssertEqual([resizer sizeClassForURL:[NSURL URLWithString:@"http://example.com/a.png?w=900"]], (NSUInteger)0);
+    XCTAssertEqual([resizer sizeClassForURL:[NSURL URLWithString:@"http://example.com/a.png"]], (NSUInteger)512);
+
+    NSData* original = [NSData dataWithContentsOfFile:[[NSBundle mainBundle] pathForResource:@"yawning_cat" ofType:@"jpg"]];
+    XCTAssertNil([resizer variantForKey:@"yawning.jpg" type:@"jpg" sizeClass:64]);
+    NSData* resized = [resizer dataForImage:original key:@"yawning.jpg" type:@"jpg" sizeClass:64];
+    UIImage* image = [UIImage imageWithData:resized];
+    XCTAssertTrue(MAX(image.size.width, image.size.height) * image.scale <= 64);
+    XCTAssertEqualObjects([resizer dataForImage:original key:@"yawning.jpg" type:@"jpg" sizeClass:64], resized);
+    XCTAssertEqualObjects([resizer variantForKey:@"yawning.jpg" type:@"jpg" sizeClass:64], resized);
+    XCTAssertEqual(resizer.reusedImages, (NSUInteger)2);
+    XCTAssertEqual(resizer.resizedImages, (NSUInteger)1);
+
+    // Made in the background, then found by key.
+    [resizer prepareVariantOfData:original key:@"yawning.jpg" type:@"jpg" sizeClass:128];
+    NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+    while(resizer.resizedImages < 2 && [deadline timeIntervalSinceNow] > 0) {
+        [NSThread sleepForTimeInterval:.01];
+    }
+    XCTAssertNotNil([resizer variantForKey:@"yawning.jpg" type:@"jpg" sizeClass:128]);
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+@end
@@ -0,0 +1,102 @@
+//
+//  CatImageStoreTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/13/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatImageStore.h"
+
+@interface CatImageStoreTests : XCTestCase
+{
+    NSString* root;
+    NSString* samples;
+}
+@end
+
+@implementation CatImageStoreTests
+
+- (void)setUp
+{
+    [super setUp];
+    root = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    samples = [root stringByAppendingPathComponent:@"samples"];
+    NSFileManager* fileManager = [NSFileManager defaultManager];
+    [fileManager createDirectoryAtPath:samples withIntermediateDirectories:YES attributes:nil error:NULL];
+    for(NSString* name in @[@"yawning_cat.jpg", @"home.png", @"silhouette.png", @"liftarn_Cat_silhouette.png", @"blankstar.png"]) {
+        NSString* source = [[NSBundle mainBundle] pathForResource:name ofType:nil];
+        [fileManager copyItemAtPath:source toPath:[samples stringByAppendingPathComponent:name] error:NULL];
+    }
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:root error:NULL];
+    [super tearDown];
+}
+
+- (CatImageStore*)storeWithBudget:(unsigned long long)budget
+{
+    return [[CatImageStore alloc] initWithDirectory:[root stringByAppendingPathComponent:@"store"] budget:budget];
+}
+
+- (void)testImportAndServeOffline
+{
+    CatImageStore* store = [self storeWithBudget:64 * 1024 * 1024];
+    XCTAssertEqual([store importDirectory:samples], (NSUInteger)5);
+    XCTAssertEqual([store countForType:@"png"], (NSUInteger)4);
+    XCTAssertEqual([store countForType:@"jpeg"], (NSUInteger)1);
+
+    NSString* key = nil;
+    XCTAssertNotNil([store randomDataOfType:@"png" key:&key]);
+    XCTAssertTrue([key hasSuffix:@".png"]);
+    XCTAssertNil([store randomDataOfType:@"gif" key:&key]);
+    XCTAssertNil(key);
+    XCTAssertEqual(store.hits, (NSUInteger)1);
+    XCTAssertEqual(store.misses, (NSUInteger)1);
+}
+
+- (void)testSameBodyIsStoredOnce
+{
+    CatImageStore* store = [self storeWithBudget:64 * 1024 * 1024];
+    NSData* data = [NSData dataWithContentsOfFile:[samples stringByAppendingPathComponent:@"home.png"]];
+    NSString* first = [store storeData:data type:@"png"];
+    NSString* second = [store storeData:data type:@"png"];
+    XCTAssertEqualObjects(first, second);
+    XCTAssertEqual([store countForType:@"png"], (NSUInteger)1);
+    XCTAssertEqual(store.size, (unsigned long long)data.length);
+}
+
+- (void)testEvictsLeastRecentlyServed
+{
+    NSData* a = [NSData dataWithContentsOfFile:[samples stringByAppendingPathComponent:@"home.png"]];
+    NSData* b = [NSData dataWithContentsOfFile:[samples stringByAppendingPathComponent:@"silhouette.png"]];
+    NSData* c = [NSData dataWithContentsOfFile:[samples stringByAppendingPathComponent:@"blankstar.png"]];
+    CatImageStore* store = [self storeWithBudget:a.length + b.length + c.length - 1];
+
+    NSString* keyA = [store storeData:a type:@"png"];
+    NSString* keyB = [store storeData:b type:@"png"];
+    XCTAssertNotNil([store dataForKey:keyA]);
+    NSString* keyC = [store storeData:c type:@"png"];
+
+    XCTAssertTrue([store containsKey:keyA]);
+    XCTAssertFalse([store containsKey:keyB]);
+    XCTAssertTrue([store containsKey:keyC]);
+    XCTAssertEqual(store.evictions, (NSUInteger)1);
+    XCTAssertTrue(store.size <= store.budget);
+}
+
+- (void)testIndexSurvivesRelaunch
+{
+    CatImageStore* store = [self storeWithBudget:64 * 1024 * 1024];
+    [store importDirectory:samples];
+    unsigned long long size = store.size;
+
+    CatImageStore* reopened = [self storeWithBudget:64 * 1024 * 1024];
+    XCTAssertEqual(reopened.size, size);
+    XCTAssertEqual([reopened countForType:@"png"], (NSUInteger)4);
+}
+
+@end
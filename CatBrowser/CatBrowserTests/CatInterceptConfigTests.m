@@ -0,0 +1,101 @@
+//
+//  CatInterceptConfigTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/18/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatInterceptConfig.h"
+#import "CatURLProtocol.h"
+
+@interface CatInterceptConfigTests : XCTestCase
+@end
+
+@implementation CatInterceptConfigTests
+
+- (BOOL)config:(CatInterceptConfig*)config matches:(const char*)url
+{
+    return CatURLMatcherMatch(config.matcher, url, strlen(url), NULL);
+}
+
+- (void)testDefaultRules
+{
+    CatInterceptConfig* config = [CatInterceptConfig defaultConfig];
+    XCTAssertTrue(config.enabled);
+    XCTAssertTrue([self config:config matches:"http://example.com/tabby.jpg"]);
+    XCTAssertTrue([self config:config matches:"https://lh4.googleusercontent.com/photo=s64"]);
+    XCTAssertFalse([self config:config matches:"http://example.com/index.html"]);
+}
+
+- (void)testToggleKeepsRulesAndBumpsVersion
+{
+    CatInterceptConfig* config = [CatInterceptConfig defaultConfig];
+    CatInterceptConfig* off = [config configWithEnabled:NO];
+    XCTAssertFalse(off.enabled);
+    XCTAssertTrue(off.version > config.version);
+    XCTAssertEqualObjects(off.typeWeights, config.typeWeights);
+    XCTAssertTrue([self config:off matches:"http://example.com/tabby.jpg"]);
+}
+
+- (void)testJSON
+{
+    NSData* json = [@"{\"denyHosts\":[\"example.com\"],\"typeWeights\":{\"png\":1,\"gif\":0}}" dataUsingEncoding:NSUTF8StringEncoding];
+    NSError* error = nil;
+    CatInterceptConfig* config = [CatInterceptConfig configWithJSONData:json error:&error];
+    XCTAssertNotNil(config, @"%@", error);
+    XCTAssertFalse([self config:config matches:"http://img.example.com/tabby.jpg"]);
+    XCTAssertTrue([self config:config matches:"http://example.org/tabby.jpg"]);
+    for(int i=0; i<50; i++) {
+        XCTAssertEqualObjects([config randomType], @"png");
+    }
+
+    CatInterceptConfig* roundTrip = [CatInterceptConfig configWithDictionary:[config dictionaryRepresentation]];
+    XCTAssertEqualObjects([roundTrip dictionaryRepresentation], [config dictionaryRepresentation]);
+
+    XCTAssertNil([CatInterceptConfig configWithJSONData:[@"{\"extensions\":\"jpg\"}" dataUsingEncoding:NSUTF8StringEncoding] error:&error]);
+    XCTAssertNotNil(error);
+    XCTAssertNil([CatInterceptConfig configWithDictionary:@{CatInterceptTypeWeightsKey: @{@"gif": @0}}]);
+}
+
+- (void)testRejectsMistypedValues
+{
+    NSArray* files = @[@"{\"enabled\":[true]}",
+                       @"{\"enabled\":\"yes\"}",
+                       @"{\"typeWeights\":{\"png\":[1]}}",
+                       @"{\"typeWeights\":{\"png\":\"1\"}}",
+                       @"{\"typeWeights\":[\"png\"]}",
+                       @"{\"formatBudget\":{\"decodedBytes\":{}}}",
+                       @"{\"formatBudget\":7}",
+                       @"{\"origin\":42}",
+                       @"{\"extensions\":[\"jpg\",1]}",
+                       @"[\"jpg\"]"];
+    CatInterceptConfig* previous = [CatURLProtocol config];
+    for(NSString* file in files) {
+        NSError* error = nil;
+        XCTAssertFalse([CatURLProtocol setConfigWithJSONData:[file dataUsingEncoding:NSUTF8StringEncoding] error:&error], @"%@", file);
+        XCTAssertNotNil(error, @"%@", file);
+        XCTAssertEqual([CatURLProtocol config], previous, @"%@", file);
+    }
+}
+
+- (void)testPublish
+{
+    CatInterceptConfig* previous = [CatURLProtocol config];
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/tabby.jpg"]];
+
+    [CatURLProtocol setCat:NO];
+    XCTAssertFalse([CatURLProtocol cat]);
+    XCTAssertFalse([CatURLProtocol canInitWithRequest:request]);
+
+    [CatURLProtocol setCat:YES];
+    XCTAssertTrue([CatURLProtocol canInitWithRequest:request]);
+
+    XCTAssertTrue([CatURLProtocol setConfigWithJSONData:[@"{\"denyHosts\":[\"example.com\"]}" dataUsingEncoding:NSUTF8StringEncoding] error:NULL]);
+    XCTAssertFalse([CatURLProtocol canInitWithRequest:request]);
+
+    [CatURLProtocol setConfig:previous];
+}
+
+@end
@@ -0,0 +1,109 @@
+//
+//  CatMemoryManagerTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/2/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatMemoryManager.h"
+
+@interface CatMemoryManagerTests : XCTestCase
+@end
+
+@implementation CatMemoryManagerTests
+{
+    CatMemoryManager* manager;
+    NSMutableArray* purged;
+    NSMutableDictionary* sizes;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    manager = [[CatMemoryManager alloc] init];
+    manager.targetBytes = 1000;
+    purged = [NSMutableArray array];
+    sizes = [NSMutableDictionary dictionary];
+}
+
+- (id)registerCache:(NSString*)name tier:(CatMemoryTier)tier bytes:(unsigned long long)bytes
+{
+    sizes[name] = @(bytes);
+    NSMutableDictionary* cacheSizes = sizes;
+    NSMutableArray* order = purged;
+    return [manager registerCacheNamed:name tier:tier cost:^unsigned long long{
+        return [cacheSizes[name] unsignedLongLongValue];
+    } purge:^{
+        [order addObject:name];
+        cacheSizes[name] = @0;
+    }];
+}
+
+- (void)testCheapestTiersFirst
+{
+    [self registerCache:@"working" tier:CatMemoryTierWorkingSet bytes:500];
+    [self registerCache:@"decoded" tier:CatMemoryTierCache bytes:3000];
+    [self registerCache:@"thumbnails" tier:CatMemoryTierDisposable bytes:2000];
+    XCTAssertEqual(manager.totalResidentBytes, 5500ULL);
+    XCTAssertEqualObjects([manager residentBytes][@"decoded"], @3000);
+
+    // Disposable then cache, which brings the total under the target.
+    XCTAssertEqual([manager handleMemoryPressure], 5000ULL);
+    NSArray* expected = @[@"thumbnails", @"decoded"];
+    XCTAssertEqualObjects(purged, expected);
+    XCTAssertEqual(manager.totalResidentBytes, 500ULL);
+    XCTAssertEqual(manager.pressureEvents, (NSUInteger)1);
+    XCTAssertEqual(manager.bytesFreed, 5000ULL);
+}
+
+- (void)testDisposableAlwaysGoes
+{
+    [self registerCache:@"thumbnails" tier:CatMemoryTierDisposable bytes:100];
+    [self registerCache:@"decoded" tier:CatMemoryTierCache bytes:100];
+    XCTAssertEqual([manager handleMemoryPressure], 100ULL);
+    NSArray* expected = @[@"thumbnails"];
+    XCTAssertEqualObjects(purged, expected);
+
+    [manager purgeThroughTier:CatMemoryTierCache];
+    expected = @[@"thumbnails", @"thumbnails", @"decoded"];
+    XCTAssertEqualObjects(purged, expected);
+}
+
+- (void)testReportOnlyAndUnregister
+{
+    __block unsigned long long indexBytes = 4000;
+    [manager registerCacheNamed:@"index" tier:CatMemoryTierDisposable cost:^unsigned long long{
+        return indexBytes;
+    } purge:nil];
+    id token = [self registerCache:@"thumbnails" tier:CatMemoryTierDisposable bytes:2000];
+    XCTAssertEqual([manager purgeThroughTier:CatMemoryTierWorkingSet], 2000ULL);
+    XCTAssertEqual(manager.totalResidentBytes, 4000ULL);
+
+    [manager unregisterCache:token];
+    sizes[@"thumbnails"] = @2000;
+    XCTAssertEqual(manager.totalResidentBytes, 4000ULL);
+    XCTAssertNil([manager residentBytes][@"thumbnails"]);
+    [manager handleMemoryPressure];
+    XCTAssertEqual(purged.count, (NSUInteger)1);
+}
+
+- (void)testReportOnlyDoesNotCountAgainstTarget
+{
+    // Over the target on its own, but nothing can be purged from it.
+    [manager registerCacheNamed:@"index" tier:CatMemoryTierWorkingSet cost:^unsigned long long{
+        return 5000;
+    } purge:nil];
+    [self registerCache:@"thumbnails" tier:CatMemoryTierDisposable bytes:2000];
+    [self registerCache:@"decoded" tier:CatMemoryTierCache bytes:800];
+    [self registerCache:@"working" tier:CatMemoryTierWorkingSet bytes:100];
+
+    // Past the first tier, what is purgeable is under the target: the rest stays.
+    XCTAssertEqual([manager handleMemoryPressure], 2000ULL);
+    NSArray* expected = @[@"thumbnails"];
+    XCTAssertEqualObjects(purged, expected);
+    XCTAssertEqual(manager.totalResidentBytes, 5900ULL);
+}
+
+@end
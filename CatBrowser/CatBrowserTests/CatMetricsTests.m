@@ -0,0 +1,75 @@
+//
+//  CatMetricsTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/19/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatHistogram.h"
+#import "CatMetrics.h"
+#import "CatURLProtocol.h"
+#import "CatInterceptConfig.h"
+
+@interface CatMetricsTests : XCTestCase
+@end
+
+@implementation CatMetricsTests
+
+- (void)testHistogramBuckets
+{
+    CatHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    XCTAssertEqual(CatHistogramPercentile(&histogram, .5), 0ULL);
+
+    for(uint64_t value=1; value<=1000; value++) {
+        CatHistogramRecord(&histogram, value);
+    }
+    XCTAssertEqual(histogram.count, 1000ULL);
+    XCTAssertEqual(histogram.max, 1000ULL);
+    XCTAssertEqual(CatHistogramMean(&histogram), 500ULL);
+    // 500 falls in [256, 512), reported as its upper bound.
+    XCTAssertEqual(CatHistogramPercentile(&histogram, .5), 511ULL);
+    XCTAssertEqual(CatHistogramPercentile(&histogram, 1), 1000ULL);
+
+    CatHistogramReset(&histogram);
+    XCTAssertEqual(histogram.count, 0ULL);
+    CatHistogramRecord(&histogram, 0);
+    XCTAssertEqual(CatHistogramPercentile(&histogram, 1), 0ULL);
+}
+
+- (void)testConcurrentRecording
+{
+    static CatHistogram histogram;
+    CatHistogramReset(&histogram);
+    dispatch_apply(8, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        for(uint64_t value=1; value<=10000; value++) {
+            CatHistogramRecord(&histogram, value);
+        }
+    });
+    XCTAssertEqual(histogram.count, 80000ULL);
+    XCTAssertEqual(histogram.max, 10000ULL);
+}
+
+- (void)testClassificationIsCounted
+{
+    CatInterceptConfig* previous = [CatURLProtocol config];
+    [CatURLProtocol setConfig:[CatInterceptConfig defaultConfig]];
+    [CatMetrics reset];
+
+    [CatURLProtocol canInitWithRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/tabby.jpg"]]];
+    [CatURLProtocol canInitWithRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/tabby.png"]]];
+    [CatURLProtocol canInitWithRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/index.html"]]];
+
+    NSDictionary* snapshot = [CatMetrics snapshot];
+    XCTAssertEqualObjects(snapshot[@"classification"][@"count"], @3);
+    XCTAssertEqualObjects(snapshot[@"rules"][@"extension:jpg"][@"intercepted"], @1);
+    XCTAssertEqualObjects(snapshot[@"rules"][@"extension:png"][@"intercepted"], @1);
+    XCTAssertEqualObjects(snapshot[@"rules"][@"none"][@"passed"], @1);
+    XCTAssertTrue([CatMetrics summary].length > 0);
+
+    [CatURLProtocol setConfig:previous];
+}
+
+@end
@@ -0,0 +1,212 @@
+//
+//  CatOriginClientTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/22/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Behaviour of the pooled origin client against a keep-alive stand-in,
+//  and a throughput comparison: a connection per request, pooled
+//  connections, and pooled connections with pipelining.
+//
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+#import "CatOriginClient.h"
+#import "CatStandInServer.h"
+#import "CatMetrics.h"
+
+static const NSUInteger kBenchmarkRequests = 400;
+
+@interface CatOriginClientTests : XCTestCase
+{
+    CatStandInServer* server;
+}
+@end
+
+@implementation CatOriginClientTests
+
+- (void)setUp
+{
+    [super setUp];
+    server = [[CatStandInServer alloc] init];
+    server.body = [NSMutableData dataWithLength:16 * 1024];
+    server.keepAlive = YES;
+    XCTAssertTrue([server start]);
+}
+
+- (void)tearDown
+{
+    [server stop];
+    [super tearDown];
+}
+
+- (NSURLRequest*)requestFor:(NSString*)path
+{
+    return [NSURLRequest requestWithURL:[NSURL URLWithString:path relativeToURL:server.baseURL]];
+}
+
+// Runs count fetches and returns how many completed without error, or -1 on timeout.
+- (NSInteger)fetch:(NSUInteger)count with:(CatOriginClient*)client path:(NSString*)path
+{
+    dispatch_group_t group = dispatch_group_create();
+    __block volatile int32_t succeeded = 0;
+    NSUInteger expected = server.body.length;
+    for(NSUInteger i=0; i<count; i++) {
+        dispatch_group_enter(group);
+        __block NSUInteger received = 0;
+        __block NSInteger status = 0;
+        [client fetchRequest:[self requestFor:path] response:^(NSHTTPURLResponse* response) {
+            status = response.statusCode;
+        } data:^(NSData* data) {
+            received += data.length;
+        } completion:^(NSError* error) {
+            if(!error && status == 200 && received == expected) {
+                OSAtomicIncrement32(&succeeded);
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    if(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 60 * NSEC_PER_SEC))) {
+        return -1;
+    }
+    return succeeded;
+}
+
+- (void)testReusesConnections
+{
+    CatOriginClient* client = [[CatOriginClient alloc] init];
+    client.maxConnectionsPerHost = 2;
+    XCTAssertEqual([self fetch:20 with:client path:@"/images/1.jpg"], (NSInteger)20);
+    XCTAssertTrue(server.connections <= 2);
+    XCTAssertEqual(client.requestsSent, (NSUInteger)20);
+    XCTAssertTrue(client.reusedRequests >= 18);
+    XCTAssertTrue([client connectionStats].count <= 2);
+}
+
+- (void)testFollowsRedirects
+{
+    server.redirects = 2;
+    CatOriginClient* client = [[CatOriginClient alloc] init];
+    XCTAssertEqual([self fetch:5 with:client path:@"/api/images/get?type=jpg"], (NSInteger)5);
+    XCTAssertEqual(server.redirectsSent, (NSUInteger)10);
+    XCTAssertEqual(server.requests, (NSUInteger)15);
+}
+
+- (void)testHandsBackHTTPSRedirects
+{
+    server.redirects = 1;
+    server.redirectLocation = [NSString stringWithFormat:@"https://127.0.0.1:%d/images/1.jpg", server.port];
+    CatOriginClient* client = [[CatOriginClient alloc] init];
+    __block NSError* failure = nil;
+    __block BOOL responded = NO;
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    CatOriginTask* task = [client fetchRequest:[self requestFor:@"/api/images/get?type=jpg"] response:^(NSHTTPURLResponse* response) {
+        responded = YES;
+    } data:nil completion:^(NSError* error) {
+        failure = error;
+        dispatch_semaphore_signal(done);
+    }];
+    XCTAssertEqual(dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0L);
+    XCTAssertFalse(responded);
+    XCTAssertEqual(failure.code, (NSInteger)NSURLErrorUnsupportedURL);
+    XCTAssertEqualObjects(task.URL.absoluteString, server.redirectLocation);
+    XCTAssertEqual(task.redirects, (NSUInteger)1);
+    XCTAssertEqual(server.requests, (NSUInteger)1);
+}
+
+- (void)testRecoversWhenServerDropsIdleConnection
+{
+    server.idleTimeout = .2;
+    CatOriginClient* client = [[CatOriginClient alloc] init];
+    client.maxConnectionsPerHost = 1;
+    XCTAssertEqual([self fetch:1 with:client path:@"/images/1.jpg"], (NSInteger)1);
+    [NSThread sleepForTimeInterval:.5];
+    XCTAssertEqual([self fetch:1 with:client path:@"/images/2.jpg"], (NSInteger)1);
+}
+
+- (void)testErrorsReachTheCompletion
+{
+    server.errorRate = 1;
+    CatOriginClient* client = [[CatOriginClient alloc] init];
+    XCTAssertEqual([self fetch:4 with:client path:@"/images/1.jpg"], (NSInteger)0);
+    XCTAssertEqual(server.errorsSent, (NSUInteger)4);
+
+    [server stop];
+    __block NSError* failure = nil;
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    CatOriginClient* unreachable = [[CatOriginClient alloc] init];
+    [unreachable fetchRequest:[self requestFor:@"/images/1.jpg"] response:nil data:nil completion:^(NSError* error) {
+        failure = error;
+        dispatch_semaphore_signal(done);
+    }];
+    XCTAssertEqual(dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)), 0L);
+    XCTAssertNotNil(failure);
+}
+
+- (void)testCancelStopsCallbacks
+{
+    server.bytesPerSecond = 32 * 1024;
+    CatOriginClient* client = [[CatOriginClient alloc] init];
+    __block volatile int32_t calls = 0;
+    __block CatOriginTask* task = nil;
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    task = [client fetchRequest:[self requestFor:@"/images/1.jpg"] response:^(NSHTTPURLResponse* response) {
+        dispatch_semaphore_signal(started);
+    } data:^(NSData* data) {
+        OSAtomicIncrement32(&calls);
+    } completion:^(NSError* error) {
+        OSAtomicAdd32(1000, &calls);
+    }];
+    XCTAssertEqual(dispatch_semaphore_wait(started, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)), 0L);
+    [client.delegateQueue addOperationWithBlock:^{
+        [task cancel];
+    }];
+    [client.delegateQueue waitUntilAllOperationsAreFinished];
+    int32_t seen = calls;
+    [NSThread sleepForTimeInterval:.5];
+    XCTAssertEqual(calls, seen);
+    XCTAssertTrue(calls < 1000);
+    XCTAssertTrue(task.cancelled);
+
+    // The connection was dropped mid-body; the next request gets a fresh one.
+    server.bytesPerSecond = 0;
+    XCTAssertEqual([self fetch:1 with:client path:@"/images/2.jpg"], (NSInteger)1);
+}
+
+- (double)requestsPerSecond:(CatOriginClient*)client
+{
+    [self fetch:4 with:client path:@"/images/0.jpg"];
+    uint64_t start = CatMetricsNow();
+    XCTAssertEqual([self fetch:kBenchmarkRequests with:client path:@"/images/1.jpg"], (NSInteger)kBenchmarkRequests);
+    return kBenchmarkRequests / ((CatMetricsNow() - start) / 1e9);
+}
+
+- (void)testThroughputWithAndWithoutPooling
+{
+    server.latency = .002;
+
+    CatOriginClient* unpooled = [[CatOriginClient alloc] init];
+    unpooled.reuseConnections = NO;
+    double unpooledRate = [self requestsPerSecond:unpooled];
+    NSUInteger unpooledConnections = unpooled.connectionsOpened;
+
+    CatOriginClient* pooled = [[CatOriginClient alloc] init];
+    double pooledRate = [self requestsPerSecond:pooled];
+
+    CatOriginClient* pipelined = [[CatOriginClient alloc] init];
+    pipelined.pipelineDepth = 4;
+    double pipelinedRate = [self requestsPerSecond:pipelined];
+
+    NSLog(@"%lu requests: %.0f req/s with a connection each (%lu opened), %.0f req/s pooled (%lu opened), "
+          @"%.0f req/s pipelined x4 (%lu opened, %lu retried)",
+          (unsigned long)kBenchmarkRequests, unpooledRate, (unsigned long)unpooledConnections,
+          pooledRate, (unsigned long)pooled.connectionsOpened,
+          pipelinedRate, (unsigned long)pipelined.connectionsOpened, (unsigned long)pipelined.retriedRequests);
+
+    XCTAssertTrue(unpooledConnections >= kBenchmarkRequests + 4);
+    XCTAssertTrue(pooled.connectionsOpened <= pooled.maxConnectionsPerHost);
+    XCTAssertTrue(pooledRate > unpooledRate);
+}
+
+@end
@@ -0,0 +1,64 @@
+//
+//  CatPageBridgeTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/1/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatPageBridge.h"
+
+@interface CatPageBridgeTests : XCTestCase
+@end
+
+@implementation CatPageBridgeTests
+
+- (void)testParsesRecords
+{
+    CatPageState* state = [CatPageState stateWithRecord:@"{\"t\":\"Cats\",\"h\":\"http://example.com/\",\"y\":120,\"s\":2400,\"v\":480,\"i\":12}"];
+    XCTAssertEqualObjects(state.title, @"Cats");
+    XCTAssertEqualObjects(state.location, @"http://example.com/");
+    XCTAssertEqual(state.scrollY, (CGFloat)120);
+    XCTAssertEqual(state.scrollHeight, (CGFloat)2400);
+    XCTAssertEqual(state.viewportHeight, (CGFloat)480);
+    XCTAssertEqual(state.imageCount, (NSUInteger)12);
+
+    // What a page without JavaScript, or a blank one, gives back.
+    for(NSString* record in @[@"", @"null", @"{\"t\":null,\"i\":\"3\"}"]) {
+        state = [CatPageState stateWithRecord:record];
+        XCTAssertEqualObjects(state.title, @"");
+        XCTAssertEqualObjects(state.location, @"");
+        XCTAssertEqual(state.imageCount, (NSUInteger)0);
+    }
+}
+
+- (void)testOneEvaluationPerLoad
+{
+    UIWebView* webView = [[UIWebView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)];
+    [webView loadHTMLString:@"<html><head><title>Kittens</title></head><body><img><img></body></html>"
+                    baseURL:[NSURL URLWithString:@"http://example.com/kittens"]];
+    NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    while(![[webView stringByEvaluatingJavaScriptFromString:@"document.readyState"] isEqualToString:@"complete"] && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:.01]];
+    }
+
+    CatPageBridge* bridge = [[CatPageBridge alloc] initWithWebView:webView];
+    XCTAssertEqualObjects([bridge state].title, @"Kittens");
+    XCTAssertEqualObjects([bridge state].location, @"http://example.com/kittens");
+    XCTAssertEqual([bridge state].imageCount, (NSUInteger)2);
+    XCTAssertEqual(bridge.evaluations, (NSUInteger)1);
+    XCTAssertEqual(bridge.avoidedCalls, (NSUInteger)2);
+
+    [webView stringByEvaluatingJavaScriptFromString:@"document.title = 'Cats'"];
+    XCTAssertEqualObjects([bridge state].title, @"Kittens");
+    [bridge invalidate];
+    XCTAssertEqualObjects([bridge state].title, @"Cats");
+    XCTAssertEqual(bridge.evaluations, (NSUInteger)2);
+
+    [bridge beginPage];
+    XCTAssertEqual(bridge.pageAvoidedCalls, (NSUInteger)0);
+    XCTAssertEqual(bridge.avoidedCalls, (NSUInteger)3);
+}
+
+@end
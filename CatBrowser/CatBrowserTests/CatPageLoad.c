@@ -0,0 +1,270 @@
+//
+//  CatPageLoad.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 5/6/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  CatPageLoadTests for a Linux box: the same pages of concurrent image
+//  requests against the same stand-in origin (CatStandIn.c), redirecting,
+//  throttling and failing at the same rates. NSURLProtocol isn't there,
+//  so each image is fetched the way the loader does it, with redirects
+//  followed and responses framed by CatHTTPParser. Reports throughput,
+//  p50/p99 page complete time and peak resident memory, and exits
+//  nonzero when an origin error doesn't surface as exactly one failed
+//  image. ctest runs it.
+//
+
+// getrusage, strncasecmp and nanosleep under -std=c99.
+#define _XOPEN_SOURCE 700
+
+#include "CatHTTPParser.h"
+#include "CatHistogram.h"
+#include "CatStandIn.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const int kPages = 20;
+static const int kImagesPerPage = 24;
+static const int kMaxRedirects = 8;
+static const int kPageTimeout = 30;
+
+static unsigned short port;
+
+typedef struct {
+    const char* type;
+    size_t expectedLength;
+    int loaded;
+} ImageLoad;
+
+typedef struct {
+    int status;
+    int complete;
+    char location[1024];
+    char contentType[64];
+    size_t bodyLength;
+} Response;
+
+static uint64_t now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+}
+
+static void headerValue(const char* head, size_t length, const char* name, char* value, size_t capacity)
+{
+    size_t nameLength = strlen(name);
+    const char* line = head;
+    const char* end = head + length;
+    value[0] = 0;
+    while(line < end) {
+        const char* lineEnd = memchr(line, '\n', end - line);
+        if(!lineEnd) {
+            lineEnd = end;
+        }
+        if((size_t)(lineEnd - line) > nameLength && !strncasecmp(line, name, nameLength) && line[nameLength] == ':') {
+            const char* start = line + nameLength + 1;
+            while(start < lineEnd && *start == ' ') {
+                start++;
+            }
+            size_t count = lineEnd - start;
+            if(count && start[count - 1] == '\r') {
+                count--;
+            }
+            if(count >= capacity) {
+                count = capacity - 1;
+            }
+            memcpy(value, start, count);
+            value[count] = 0;
+            return;
+        }
+        line = lineEnd + 1;
+    }
+}
+
+static void onHead(void* context, int status, const char* head, size_t length)
+{
+    Response* response = context;
+    response->status = status;
+    headerValue(head, length, "Location", response->location, sizeof(response->location));
+    headerValue(head, length, "Content-Type", response->contentType, sizeof(response->contentType));
+}
+
+static void onBody(void* context, const char* bytes, size_t length)
+{
+    ((Response*)context)->bodyLength += length;
+}
+
+static void onComplete(void* context)
+{
+    ((Response*)context)->complete = 1;
+}
+
+// One request on its own connection. Returns 0 when the response didn't arrive whole.
+static int request(const char* target, Response* response)
+{
+    memset(response, 0, sizeof(*response));
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    if(client < 0) {
+        return 0;
+    }
+    struct timeval timeout = { kPageTimeout, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    char message[1200];
+    int length = snprintf(message, sizeof(message), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n", target);
+    if(connect(client, (struct sockaddr*)&address, sizeof(address)) < 0
+       || send(client, message, length, MSG_NOSIGNAL) != length) {
+        close(client);
+        return 0;
+    }
+
+    CatHTTPParser* parser = malloc(sizeof(*parser));
+    CatHTTPCallbacks callbacks = { onHead, onBody, onComplete };
+    CatHTTPParserInit(parser, callbacks, response);
+    char buffer[16384];
+    ssize_t count;
+    while(!response->complete && (count = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+        if(CatHTTPParserFeed(parser, buffer, count) < 0) {
+            break;
+        }
+    }
+    if(!response->complete && CatHTTPParserFinish(parser) < 0) {
+        response->complete = 0;
+    }
+    free(parser);
+    close(client);
+    return response->complete;
+}
+
+static void* loadImage(void* argument)
+{
+    ImageLoad* load = argument;
+    char target[1024];
+    snprintf(target, sizeof(target), "/api/images/get?format=src&type=%s", load->type);
+    for(int hop=0; hop<=kMaxRedirects; hop++) {
+        Response response;
+        if(!request(target, &response)) {
+            return NULL;
+        }
+        if(response.status == 302 && response.location[0]) {
+            snprintf(target, sizeof(target), "%s", response.location);
+            continue;
+        }
+        load->loaded = response.status == 200 && !strncmp(response.contentType, "image/", 6)
+            && response.bodyLength == load->expectedLength;
+        return NULL;
+    }
+    return NULL;
+}
+
+// Page complete time in ns. Adds the images that didn't load to failures.
+static uint64_t loadPage(size_t jpgLength, size_t pngLength, int* failures)
+{
+    pthread_t threads[kImagesPerPage];
+    ImageLoad loads[kImagesPerPage];
+    uint64_t start = now();
+    for(int i=0; i<kImagesPerPage; i++) {
+        loads[i].type = i % 2 ? "png" : "jpg";
+        loads[i].expectedLength = i % 2 ? pngLength : jpgLength;
+        loads[i].loaded = 0;
+        pthread_create(&threads[i], NULL, loadImage, &loads[i]);
+    }
+    for(int i=0; i<kImagesPerPage; i++) {
+        pthread_join(threads[i], NULL);
+        *failures += !loads[i].loaded;
+    }
+    return now() - start;
+}
+
+static double peakResidentMegabytes(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1048576.;
+#else
+    return usage.ru_maxrss / 1024.;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    // Stand-ins for yawning_cat.jpg and home.png: only the sizes matter here.
+    size_t jpgLength = 48 * 1024, pngLength = 12 * 1024;
+    char* jpg = malloc(jpgLength);
+    char* png = malloc(pngLength);
+    for(size_t i=0; i<jpgLength; i++) {
+        jpg[i] = (char)(i * 31);
+    }
+    for(size_t i=0; i<pngLength; i++) {
+        png[i] = (char)(i * 17);
+    }
+
+    CatStandIn* server = CatStandInCreate();
+    CatStandInSetBody(server, "jpg", "image/jpeg", jpg, jpgLength);
+    CatStandInSetBody(server, "png", "image/png", png, pngLength);
+    CatStandInSettings settings;
+    CatStandInGetSettings(server, &settings);
+    settings.latency = .02;
+    settings.bytesPerSecond = 2 * 1024 * 1024;
+    settings.redirects = 1;
+    settings.errorRate = .05;
+    CatStandInSetSettings(server, &settings);
+    int started = CatStandInStart(server);
+    if(started < 0) {
+        fprintf(stderr, "the stand-in origin didn't start\n");
+        return 1;
+    }
+    port = (unsigned short)started;
+
+    CatHistogram pageTimes;
+    memset(&pageTimes, 0, sizeof(pageTimes));
+    int failures = 0;
+    uint64_t start = now();
+    for(int page=0; page<kPages; page++) {
+        CatHistogramRecord(&pageTimes, loadPage(jpgLength, pngLength, &failures));
+    }
+    double seconds = (now() - start) / 1e9;
+    CatStandInCounters counters;
+    CatStandInGetCounters(server, &counters);
+    CatStandInDestroy(server);
+    free(jpg);
+    free(png);
+
+    int images = kPages * kImagesPerPage;
+    printf("%d pages x %d images: %.1f images/s, page complete p50 %.1fms p99 %.1fms, "
+           "%d failed (%llu errors, %llu redirects served), peak resident %.1fMB\n",
+           kPages, kImagesPerPage, images / seconds,
+           CatHistogramPercentile(&pageTimes, .5) / 1e6, CatHistogramPercentile(&pageTimes, .99) / 1e6,
+           failures, (unsigned long long)counters.errorsSent, (unsigned long long)counters.redirectsSent,
+           peakResidentMegabytes());
+
+    // Every origin error surfaces as exactly one failed image, nothing else fails,
+    // and every image went through a redirect.
+    int passed = (uint64_t)failures == counters.errorsSent
+        && counters.redirectsSent >= (uint64_t)images - counters.errorsSent;
+    if(!passed) {
+        fprintf(stderr, "failures don't match the errors the origin sent\n");
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+//
+//  CatPageLoadTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/21/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Load generator for the substitution path. Each simulated page issues
+//  a burst of concurrent image requests through CatURLProtocol, with the
+//  origin pointed at a local CatStandInServer that redirects, throttles
+//  and fails like the real one. Pool and store are kept out of the way
+//  so every image goes to the origin or to a redirect target learned from
+//  it. Reports throughput, p50/p99 page complete time, round trips saved
+//  per page and peak resident memory.
+//
+
+#import <XCTest/XCTest.h>
+#import <libkern/OSAtomic.h>
+#include <mach/mach.h>
+#import "CatStandInServer.h"
+#import "CatURLProtocol.h"
+#import "CatInterceptConfig.h"
+#import "CatImageStore.h"
+#import "CatImagePool.h"
+#import "CatHistogram.h"
+#import "CatMetrics.h"
+#import "CatRedirectCache.h"
+
+static const NSUInteger kPages = 20;
+static const NSUInteger kImagesPerPage = 24;
+static const NSTimeInterval kPageTimeout = 30;
+
+static uint64_t residentBytes(void)
+{
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+}
+
+@interface CatPageLoadTests : XCTestCase
+{
+    CatStandInServer* server;
+    CatInterceptConfig* previousConfig;
+    NSUInteger previousThreshold;
+    CatImagePoolSource previousSource;
+    NSOperationQueue* pageQueue;
+}
+@end
+
+@implementation CatPageLoadTests
+
+- (void)setUp
+{
+    [super setUp];
+    server = [[CatStandInServer alloc] init];
+    NSMutableDictionary* bodies = [NSMutableDictionary dictionary];
+    for(NSString* name in @[@"yawning_cat.jpg", @"home.png"]) {
+        NSData* data = [NSData dataWithContentsOfFile:[[NSBundle mainBundle] pathForResource:name ofType:nil]];
+        XCTAssertNotNil(data);
+        bodies[name.pathExtension] = @{ @"body": data, @"contentType": [CatImageStore MIMETypeForType:name.pathExtension] };
+    }
+    server.bodiesByType = bodies;
+    server.latency = .02;
+    server.bytesPerSecond = 2 * 1024 * 1024;
+    server.redirects = 1;
+    server.errorRate = .05;
+    XCTAssertTrue([server start]);
+
+    previousConfig = [CatURLProtocol config];
+    [CatURLProtocol setConfig:[CatInterceptConfig configWithDictionary:@{
+        CatInterceptOriginKey: server.baseURL.absoluteString,
+        CatInterceptTypeWeightsKey: @{ @"jpg": @1, @"png": @1 },
+    }]];
+    [NSURLProtocol registerClass:[CatURLProtocol class]];
+
+    previousThreshold = [CatImageStore sharedStore].refillThreshold;
+    [CatImageStore sharedStore].refillThreshold = NSUIntegerMax;
+    // Without a source the pool stays empty and sends nothing to the origin.
+    previousSource = [CatImagePool sharedPool].source;
+    [CatImagePool sharedPool].source = nil;
+    [[CatImagePool sharedPool] drain];
+    [[CatRedirectCache sharedCache] removeAllURLs];
+
+    pageQueue = [[NSOperationQueue alloc] init];
+    pageQueue.maxConcurrentOperationCount = NSOperationQueueDefaultMaxConcurrentOperationCount;
+}
+
+- (void)tearDown
+{
+    [CatImageStore sharedStore].refillThreshold = previousThreshold;
+    [CatImagePool sharedPool].source = previousSource;
+    [CatURLProtocol setConfig:previousConfig];
+    [server stop];
+    [super tearDown];
+}
+
+// Page complete time in ns, or 0 on timeout.
+- (uint64_t)loadPage:(NSUInteger)page failures:(volatile int32_t*)failures
+{
+    dispatch_group_t group = dispatch_group_create();
+    uint64_t start = CatMetricsNow();
+    for(NSUInteger i=0; i<kImagesPerPage; i++) {
+        NSString* url = [NSString stringWithFormat:@"http://page%lu.example.com/images/%lu.jpg", (unsigned long)page, (unsigned long)i];
+        dispatch_group_enter(group);
+        [NSURLConnection sendAsynchronousRequest:[NSURLRequest requestWithURL:[NSURL URLWithString:url]] queue:pageQueue
+                               completionHandler:^(NSURLResponse* response, NSData* data, NSError* error) {
+            if(error || ![response.MIMEType hasPrefix:@"image/"] || !data.length) {
+                OSAtomicIncrement32(failures);
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    if(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kPageTimeout * NSEC_PER_SEC)))) {
+        return 0;
+    }
+    return CatMetricsNow() - start;
+}
+
+- (void)testConcurrentPageLoads
+{
+    __block volatile uint64_t peak = residentBytes();
+    uint64_t baseline = peak;
+    dispatch_source_t sampler = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0));
+    dispatch_source_set_timer(sampler, DISPATCH_TIME_NOW, 10 * NSEC_PER_MSEC, 5 * NSEC_PER_MSEC);
+    dispatch_source_set_event_handler(sampler, ^{
+        uint64_t resident = residentBytes();
+        if(resident > peak) {
+            peak = resident;
+        }
+    });
+    dispatch_resume(sampler);
+
+    CatHistogram pageTimes;
+    memset(&pageTimes, 0, sizeof(pageTimes));
+    volatile int32_t failures = 0;
+    CatRedirectCache* redirects = [CatRedirectCache sharedCache];
+    NSUInteger hits = redirects.hits;
+    NSUInteger saved = redirects.roundTripsSaved;
+    NSMutableArray* savedPerPage = [NSMutableArray array];
+    uint64_t start = CatMetricsNow();
+    for(NSUInteger page=0; page<kPages; page++) {
+        [redirects beginPage];
+        uint64_t elapsed = [self loadPage:page failures:&failures];
+        XCTAssertTrue(elapsed > 0, @"page %lu timed out", (unsigned long)page);
+        CatHistogramRecord(&pageTimes, elapsed);
+        [savedPerPage addObject:@(redirects.pageRoundTripsSaved)];
+    }
+    hits = redirects.hits - hits;
+    saved = redirects.roundTripsSaved - saved;
+    double seconds = (CatMetricsNow() - start) / 1e9;
+    dispatch_source_cancel(sampler);
+
+    NSUInteger images = kPages * kImagesPerPage;
+    NSLog(@"%lu pages x %lu images: %.1f images/s, page complete p50 %.1fms p99 %.1fms, "
+          @"%d failed (%lu errors, %lu redirects served), peak resident +%.1fMB",
+          (unsigned long)kPages, (unsigned long)kImagesPerPage, images / seconds,
+          CatHistogramPercentile(&pageTimes, .5) / 1e6, CatHistogramPercentile(&pageTimes, .99) / 1e6,
+          failures, (unsigned long)server.errorsSent, (unsigned long)server.redirectsSent, (peak - baseline) / 1048576.);
+    NSLog(@"round trips saved by learned redirects: %lu (%.1f per page: %@)",
+          (unsigned long)saved, (double)saved / kPages, [savedPerPage componentsJoinedByString:@" "]);
+
+    // Every origin error surfaces as exactly one failed image, nothing else fails.
+    XCTAssertEqual((NSUInteger)failures, server.errorsSent);
+    // Every image went through a redirect or skipped it with a learned target.
+    XCTAssertTrue(server.redirectsSent + hits >= images - server.errorsSent);
+    XCTAssertTrue(saved > 0);
+}
+
+@end
@@ -0,0 +1,233 @@
+//
+//  CatPrefixIndexTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/28/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Checks the per-node best lists against a brute force scan through
+//  random inserts, rescoring and removals, sparse and then dense with
+//  keys sharing ancestors, then times queries over 100k
+//  entries shaped like history: a location and a few title words each.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatPrefixIndex.h"
+#import "CatMetrics.h"
+#include <math.h>
+
+static const NSUInteger kEntries = 100000;
+static const double kMaxQueryNanoseconds = 20000;
+
+@interface CatPrefixIndexTests : XCTestCase
+@end
+
+@implementation CatPrefixIndexTests
+{
+    CatPrefixIndex* index;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    index = CatPrefixIndexCreate();
+}
+
+- (void)tearDown
+{
+    CatPrefixIndexDestroy(index);
+    [super tearDown];
+}
+
+- (NSArray*)query:(NSString*)prefix
+{
+    uint32_t found[kCatPrefixTopK];
+    size_t count = CatPrefixIndexQuery(index, prefix.UTF8String, strlen(prefix.UTF8String), found, kCatPrefixTopK);
+    NSMutableArray* result = [NSMutableArray array];
+    for(size_t i=0; i<count; i++) {
+        [result addObject:@(found[i])];
+    }
+    return result;
+}
+
+- (void)insert:(NSString*)key entry:(uint32_t)entry
+{
+    XCTAssertEqual(CatPrefixIndexInsert(index, entry, key.UTF8String, strlen(key.UTF8String)), 0);
+}
+
+- (void)testRanksByScore
+{
+    [self insert:@"catalog" entry:1];
+    [self insert:@"cats" entry:2];
+    [self insert:@"category" entry:3];
+    [self insert:@"dogs" entry:4];
+    CatPrefixIndexSetScore(index, 1, 1);
+    CatPrefixIndexSetScore(index, 2, 3);
+    CatPrefixIndexSetScore(index, 3, 2);
+    XCTAssertEqualObjects([self query:@"cat"], (@[@2, @3, @1]));
+    XCTAssertEqualObjects([self query:@"cate"], (@[@3]));
+    XCTAssertEqualObjects([self query:@"catz"], (@[]));
+    XCTAssertEqualObjects([self query:@""], (@[@2, @3, @1, @4]));
+
+    CatPrefixIndexSetScore(index, 2, 0);
+    XCTAssertEqualObjects([self query:@"cat"], (@[@3, @1, @2]));
+    CatPrefixIndexRemove(index, 3);
+    XCTAssertEqualObjects([self query:@"cat"], (@[@1, @2]));
+    XCTAssertEqualObjects([self query:@"cate"], (@[]));
+}
+
+- (void)testSeveralKeysPerEntry
+{
+    [self insert:@"example.com/kittens" entry:7];
+    [self insert:@"fluffy" entry:7];
+    [self insert:@"kittens" entry:7];
+    [self insert:@"kittens" entry:7];
+    XCTAssertEqualObjects([self query:@"k"], (@[@7]));
+    XCTAssertEqualObjects([self query:@"exa"], (@[@7]));
+    XCTAssertEqualObjects([self query:@"fl"], (@[@7]));
+    CatPrefixIndexRemove(index, 7);
+    XCTAssertEqualObjects([self query:@""], (@[]));
+}
+
+// Random inserts of keys over letters, rescoring to [0, maxScore) and
+// removals, comparing every prefix against a scan after each check round.
+- (void)matchBruteForce:(int)entries keys:(NSUInteger)maxKeys length:(long)maxLength letters:(const char*)letters
+               maxScore:(long)maxScore rounds:(int)rounds checkEvery:(int)every prefixes:(NSArray*)prefixes
+{
+    NSMutableArray* keys = [NSMutableArray array];
+    double* scores = calloc(entries, sizeof(double));
+    BOOL* alive = calloc(entries, sizeof(BOOL));
+    for(int i=0; i<entries; i++) {
+        [keys addObject:[NSMutableSet set]];
+        scores[i] = -INFINITY;
+    }
+    size_t letterCount = strlen(letters);
+    for(int round=0; round<rounds; round++) {
+        uint32_t entry = random() % entries;
+        long operation = random() % 10;
+        if(operation < 4 && [keys[entry] count] < maxKeys) {
+            NSMutableString* key = [NSMutableString string];
+            for(long i=0, length=1+random()%maxLength; i<length; i++) {
+                [key appendFormat:@"%c", letters[random() % letterCount]];
+            }
+            [self insert:key entry:entry];
+            [keys[entry] addObject:key];
+            alive[entry] = YES;
+        }
+        else if(operation < 8 && alive[entry]) {
+            scores[entry] = random() % maxScore;
+            CatPrefixIndexSetScore(index, entry, scores[entry]);
+        }
+        else if(operation == 8 && alive[entry]) {
+            CatPrefixIndexRemove(index, entry);
+            [keys[entry] removeAllObjects];
+            scores[entry] = -INFINITY;
+            alive[entry] = NO;
+        }
+        if(round % every) {
+            continue;
+        }
+        for(NSString* prefix in prefixes) {
+            NSMutableArray* expected = [NSMutableArray array];
+            for(int i=0; i<entries; i++) {
+                for(NSString* key in keys[i]) {
+                    if([key hasPrefix:prefix]) {
+                        [expected addObject:@(i)];
+                        break;
+                    }
+                }
+            }
+            [expected sortUsingComparator:^NSComparisonResult(NSNumber* a, NSNumber* b) {
+                double scoreA = scores[a.intValue], scoreB = scores[b.intValue];
+                return scoreA > scoreB ? NSOrderedAscending : scoreA < scoreB ? NSOrderedDescending : [a compare:b];
+            }];
+            NSArray* best = [expected subarrayWithRange:NSMakeRange(0, MIN(expected.count, (NSUInteger)kCatPrefixTopK))];
+            XCTAssertEqualObjects([self query:prefix], best, @"prefix '%@' round %d", prefix, round);
+        }
+    }
+    free(scores);
+    free(alive);
+}
+
+- (void)testMatchesBruteForce
+{
+    srandom(3);
+    [self matchBruteForce:2000 keys:3 length:6 letters:"abc" maxScore:50 rounds:20000 checkEvery:100
+                 prefixes:@[@"", @"a", @"b", @"ab", @"ba", @"abc", @"cab", @"aa", @"bbb", @"acba"]];
+}
+
+// Few entries with many short keys over two letters: most lists share
+// ancestors across an entry's keys and ties in score are common, so every
+// change is checked.
+- (void)testSharedAncestorsMatchBruteForce
+{
+    srandom(5);
+    [self matchBruteForce:40 keys:4 length:4 letters:"ab" maxScore:10 rounds:20000 checkEvery:1
+                 prefixes:@[@"", @"a", @"b", @"ab", @"ba", @"aa", @"bb", @"abb"]];
+}
+
+- (void)testFrecency
+{
+    double halfLife = 100;
+    double once = CatFrecencyAddVisit(-INFINITY, 1000, halfLife, 1);
+    double twice = CatFrecencyAddVisit(once, 1000, halfLife, 1);
+    XCTAssertEqualWithAccuracy(twice - once, 1, 1e-9);
+    // Two visits a half life ago weigh as much as one now.
+    double old = CatFrecencyAddVisit(CatFrecencyAddVisit(-INFINITY, 900, halfLife, 1), 900, halfLife, 1);
+    XCTAssertEqualWithAccuracy(old, once, 1e-9);
+    XCTAssertEqualWithAccuracy(CatFrecencyAddVisit(-INFINITY, 1000, halfLife, 4), once + 2, 1e-9);
+}
+
+- (void)testBenchmark100kEntries
+{
+    NSArray* words = @[@"cat", @"cats", @"kitten", @"news", @"video", @"search", @"google", @"apple", @"map", @"music",
+                       @"store", @"photo", @"weather", @"recipe", @"travel", @"sport", @"game", @"blog", @"wiki", @"shop"];
+    srandom(7);
+    char key[128];
+    uint64_t start = CatMetricsNow();
+    for(uint32_t entry=0; entry<kEntries; entry++) {
+        int length = snprintf(key, sizeof(key), "%s%ld.example.com/%s/%ld", [words[random() % words.count] UTF8String], random() % 5000,
+                              [words[random() % words.count] UTF8String], random());
+        CatPrefixIndexInsert(index, entry, key, length);
+        for(int i=0; i<4; i++) {
+            const char* word = [words[random() % words.count] UTF8String];
+            CatPrefixIndexInsert(index, entry, word, strlen(word));
+        }
+        CatPrefixIndexSetScore(index, entry, CatFrecencyAddVisit(-INFINITY, entry, 1000, 1 + random() % 5));
+    }
+    double buildMilliseconds = (CatMetricsNow() - start) / 1e6;
+
+    // What typing a few queries looks like, one prefix per keystroke.
+    NSMutableArray* prefixes = [NSMutableArray array];
+    for(NSString* typed in @[@"cat123.example.com", @"news", @"google", @"wiki9", @"xyz", @"store42"]) {
+        for(NSUInteger i=1; i<=typed.length; i++) {
+            [prefixes addObject:[typed substringToIndex:i]];
+        }
+    }
+    uint32_t found[kCatPrefixTopK];
+    size_t results = 0;
+    NSUInteger queries = 0;
+    start = CatMetricsNow();
+    for(int pass=0; pass<1000; pass++) {
+        for(NSString* prefix in prefixes) {
+            results += CatPrefixIndexQuery(index, prefix.UTF8String, prefix.length, found, kCatPrefixTopK);
+            queries++;
+        }
+    }
+    double queryNanoseconds = (double)(CatMetricsNow() - start) / queries;
+
+    start = CatMetricsNow();
+    for(int i=0; i<10000; i++) {
+        uint32_t entry = random() % kEntries;
+        CatPrefixIndexSetScore(index, entry, CatFrecencyAddVisit(CatPrefixIndexScore(index, entry), kEntries + i, 1000, 1));
+    }
+    double visitNanoseconds = (CatMetricsNow() - start) / 10000.;
+
+    NSLog(@"%lu entries: built in %.0fms, %lu nodes, %.1fMB; query %.0fns, visit %.0fns (%lu results)",
+          (unsigned long)kEntries, buildMilliseconds, CatPrefixIndexNodeCount(index), CatPrefixIndexMemoryUsage(index) / 1048576.,
+          queryNanoseconds, visitNanoseconds, results);
+    XCTAssertTrue(results > 0);
+    XCTAssertTrue(queryNanoseconds < kMaxQueryNanoseconds);
+}
+
+@end
@@ -0,0 +1,83 @@
+//
+//  CatRedirectCacheTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/23/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatRedirectCache.h"
+
+@interface CatRedirectCacheTests : XCTestCase
+@end
+
+@implementation CatRedirectCacheTests
+
+- (NSURL*)imageURL:(NSUInteger)n
+{
+    return [NSURL URLWithString:[NSString stringWithFormat:@"http://images.example.com/%lu.jpg", (unsigned long)n]];
+}
+
+- (void)testServesLearnedURLByType
+{
+    CatRedirectCache* cache = [[CatRedirectCache alloc] initWithCapacity:8 ttl:60];
+    XCTAssertNil([cache URLForType:@"jpg" hops:NULL storeKey:NULL]);
+    [cache learnURL:[self imageURL:1] type:@"jpg" hops:2 storeKey:@"abc.jpg"];
+    XCTAssertNil([cache URLForType:@"gif" hops:NULL storeKey:NULL]);
+
+    NSUInteger hops = 0;
+    NSString* key = nil;
+    XCTAssertEqualObjects([cache URLForType:@"jpg" hops:&hops storeKey:&key], [self imageURL:1]);
+    XCTAssertEqual(hops, (NSUInteger)2);
+    XCTAssertEqualObjects(key, @"abc.jpg");
+    XCTAssertEqual(cache.hits, (NSUInteger)1);
+    XCTAssertEqual(cache.misses, (NSUInteger)2);
+}
+
+- (void)testRetiresAfterMaxUsesAndRotates
+{
+    CatRedirectCache* cache = [[CatRedirectCache alloc] initWithCapacity:8 ttl:60];
+    cache.maxUses = 2;
+    [cache learnURL:[self imageURL:1] type:@"jpg" hops:1 storeKey:nil];
+    [cache learnURL:[self imageURL:2] type:@"jpg" hops:1 storeKey:nil];
+    NSURL* first = [cache URLForType:@"jpg" hops:NULL storeKey:NULL];
+    NSURL* second = [cache URLForType:@"jpg" hops:NULL storeKey:NULL];
+    XCTAssertNotEqualObjects(first, second);
+    [cache URLForType:@"jpg" hops:NULL storeKey:NULL];
+    [cache URLForType:@"jpg" hops:NULL storeKey:NULL];
+    XCTAssertEqual(cache.count, (NSUInteger)0);
+    XCTAssertNil([cache URLForType:@"jpg" hops:NULL storeKey:NULL]);
+}
+
+- (void)testBoundedAndExpiring
+{
+    CatRedirectCache* cache = [[CatRedirectCache alloc] initWithCapacity:4 ttl:.1];
+    for(NSUInteger i=0; i<10; i++) {
+        [cache learnURL:[self imageURL:i] type:@"jpg" hops:1 storeKey:nil];
+    }
+    XCTAssertEqual(cache.count, (NSUInteger)4);
+    // Redirect-free fetches teach nothing.
+    [cache learnURL:[self imageURL:99] type:@"jpg" hops:0 storeKey:nil];
+    XCTAssertEqual(cache.count, (NSUInteger)4);
+
+    [NSThread sleepForTimeInterval:.2];
+    XCTAssertNil([cache URLForType:@"jpg" hops:NULL storeKey:NULL]);
+    XCTAssertEqual(cache.expirations, (NSUInteger)4);
+}
+
+- (void)testForgetAndPageTally
+{
+    CatRedirectCache* cache = [[CatRedirectCache alloc] initWithCapacity:4 ttl:60];
+    [cache learnURL:[self imageURL:1] type:@"png" hops:1 storeKey:nil];
+    [cache forgetURL:[self imageURL:1]];
+    XCTAssertEqual(cache.count, (NSUInteger)0);
+
+    [cache countSavedRoundTrips:3];
+    [cache beginPage];
+    [cache countSavedRoundTrips:2];
+    XCTAssertEqual(cache.pageRoundTripsSaved, (NSUInteger)2);
+    XCTAssertEqual(cache.roundTripsSaved, (NSUInteger)5);
+}
+
+@end
@@ -0,0 +1,128 @@
+//
+//  CatReplacementLoaderTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/15/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatReplacementLoader.h"
+#import "CatStandInServer.h"
+
+@interface CatReplacementLoaderTests : XCTestCase <CatReplacementLoaderDelegate>
+{
+    CatStandInServer* server;
+    BOOL receivedResponse;
+    BOOL finished;
+    NSError* failure;
+    long long delivered;
+}
+@end
+
+@implementation CatReplacementLoaderTests
+
+- (void)setUp
+{
+    [super setUp];
+    server = [[CatStandInServer alloc] init];
+    NSMutableData* body = [NSMutableData dataWithLength:256 * 1024];
+    server.body = body;
+    XCTAssertTrue([server start]);
+}
+
+- (void)tearDown
+{
+    [server stop];
+    [super tearDown];
+}
+
+- (BOOL)waitFor:(BOOL(^)(void))condition timeout:(NSTimeInterval)timeout
+{
+    NSDate* deadline = [NSDate dateWithTimeIntervalSinceNow:timeout];
+    while(!condition() && [deadline timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:.01]];
+    }
+    return condition();
+}
+
+- (CatReplacementLoader*)startLoader
+{
+    return [self startLoader:@"cat.jpg"];
+}
+
+- (CatReplacementLoader*)startLoader:(NSString*)path
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:path relativeToURL:server.baseURL]];
+    CatReplacementLoader* loader = [[CatReplacementLoader alloc] initWithRequest:request type:@"jpg" store:nil];
+    [loader setDelegate:self];
+    [loader start];
+    return loader;
+}
+
+- (void)testStreamsWholeBody
+{
+    CatReplacementLoader* loader = [self startLoader];
+    XCTAssertTrue([self waitFor:^BOOL{ return finished || failure; } timeout:10]);
+    XCTAssertTrue(receivedResponse);
+    XCTAssertNil(failure);
+    XCTAssertEqual(delivered, (long long)server.body.length);
+    XCTAssertEqual(loader.receivedBytes, (long long)server.body.length);
+}
+
+- (void)testHTTPSRedirectGoesOnOverNSURLConnection
+{
+    // The stand-in does not speak TLS: the handshake reaching it is what shows.
+    server.idleTimeout = .5;
+    server.redirects = 1;
+    server.redirectLocation = [NSString stringWithFormat:@"https://127.0.0.1:%d/images/1.jpg", server.port];
+    CatReplacementLoader* loader = [self startLoader:@"/api/images/get?type=jpg"];
+    XCTAssertTrue([self waitFor:^BOOL{ return finished || failure; } timeout:10]);
+    XCTAssertNotEqual(failure.code, (NSInteger)NSURLErrorUnsupportedURL);
+    XCTAssertEqual(loader.redirects, (NSUInteger)1);
+    XCTAssertEqual(server.redirectsSent, (NSUInteger)1);
+    XCTAssertEqual(server.connections, (NSUInteger)2);
+}
+
+- (void)testCancelAbortsSlowTransfer
+{
+    server.bytesPerSecond = 32 * 1024;
+    int64_t cancelledRequests = [CatReplacementLoader cancelledRequests];
+    int64_t cancelledBytes = [CatReplacementLoader cancelledBytes];
+
+    CatReplacementLoader* loader = [self startLoader];
+    XCTAssertTrue([self waitFor:^BOOL{ return delivered > 0; } timeout:5]);
+    [loader cancel];
+
+    XCTAssertTrue([self waitFor:^BOOL{ return [CatReplacementLoader cancelledRequests] == cancelledRequests + 1; } timeout:2]);
+    XCTAssertTrue([CatReplacementLoader cancelledBytes] - cancelledBytes >= delivered);
+
+    // The origin notices the hang-up long before the 8 seconds the full body would take.
+    XCTAssertTrue([self waitFor:^BOOL{ return server.abortedResponses == 1; } timeout:3]);
+    XCTAssertTrue(server.bytesSent < server.body.length);
+    XCTAssertFalse(finished);
+    XCTAssertNil(failure);
+}
+
+- (void) loader:(CatReplacementLoader*)loader didReceiveResponse:(NSURLResponse*)response
+{
+    dispatch_async(dispatch_get_main_queue(), ^{ receivedResponse = YES; });
+}
+
+- (void) loader:(CatReplacementLoader*)loader didLoadData:(NSData*)data
+{
+    long long length = data.length;
+    dispatch_async(dispatch_get_main_queue(), ^{ delivered += length; });
+}
+
+- (void) loaderDidFinishLoading:(CatReplacementLoader*)loader
+{
+    dispatch_async(dispatch_get_main_queue(), ^{ finished = YES; });
+}
+
+- (void) loader:(CatReplacementLoader*)loader didFailWithError:(NSError*)error
+{
+    dispatch_async(dispatch_get_main_queue(), ^{ failure = error; });
+}
+
+@end
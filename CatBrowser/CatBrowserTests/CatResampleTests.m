@@ -0,0 +1,146 @@
+//
+//  CatResampleTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/17/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatResample.h"
+#import "CatMetrics.h"
+
+@interface CatResampleTests : XCTestCase
+@end
+
+@implementation CatResampleTests
+
+static void fillPattern(uint8_t* pixels, size_t length)
+{
+    for(size_t i = 0; i < length; i++) {
+        pixels[i] = (uint8_t)((i * 7 + i / 4013) & 255);
+    }
+}
+
+- (void)testUniformColorIsPreserved
+{
+    int width = 301, height = 157;
+    NSMutableData* source = [NSMutableData dataWithLength:width * height * 4];
+    memset(source.mutableBytes, 200, source.length);
+    uint8_t destination[64 * 33 * 4];
+    XCTAssertEqual(CatResampleRGBA(source.bytes, width, height, width * 4, destination, 64, 33, 64 * 4, CatResamplePathSIMD), 0);
+    for(size_t i = 0; i < sizeof(destination); i++) {
+        XCTAssertEqual(destination[i], (uint8_t)200);
+    }
+}
+
+- (void)testBoxAverageOfTwoByTwo
+{
+    const uint8_t source[16] = { 0, 0, 0, 255,  100, 0, 0, 255,
+                                 0, 40, 0, 255,  100, 40, 8, 255 };
+    uint8_t destination[4];
+    XCTAssertEqual(CatResampleRGBA(source, 2, 2, 8, destination, 1, 1, 4, CatResamplePathScalar), 0);
+    XCTAssertEqual(destination[0], (uint8_t)50);
+    XCTAssertEqual(destination[1], (uint8_t)20);
+    XCTAssertEqual(destination[2], (uint8_t)2);
+    XCTAssertEqual(destination[3], (uint8_t)255);
+}
+
+- (void)testSIMDMatchesScalar
+{
+    int width = 1937, height = 1291, scaledWidth = 190, scaledHeight = 127;
+    NSMutableData* source = [NSMutableData dataWithLength:width * height * 4];
+    fillPattern(source.mutableBytes, source.length);
+    NSMutableData* scalar = [NSMutableData dataWithLength:scaledWidth * scaledHeight * 4];
+    NSMutableData* simd = [NSMutableData dataWithLength:scaledWidth * scaledHeight * 4];
+
+    CatResampleRGBA(source.bytes, width, height, width * 4, scalar.mutableBytes, scaledWidth, scaledHeight, scaledWidth * 4, CatResamplePathScalar);
+    CatResampleRGBA(source.bytes, width, height, width * 4, simd.mutableBytes, scaledWidth, scaledHeight, scaledWidth * 4, CatResamplePathSIMD);
+    const uint8_t* a = scalar.bytes;
+    const uint8_t* b = simd.bytes;
+    for(NSUInteger i = 0; i < scalar.length; i++) {
+        XCTAssertTrue(abs(a[i] - b[i]) <= 1);
+    }
+}
+
+- (void)testLanczos
+{
+    int width = 480, height = 368, scaledWidth = 240, scaledHeight = 184;
+    NSMutableData* source = [NSMutableData dataWithLength:width * height * 4];
+    memset(source.mutableBytes, 90, source.length);
+    NSMutableData* scalar = [NSMutableData dataWithLength:scaledWidth * scaledHeight * 4];
+    NSMutableData* simd = [NSMutableData dataWithLength:scaledWidth * scaledHeight * 4];
+    CatResampleRGBAFiltered(source.bytes, width, height, width * 4, simd.mutableBytes, scaledWidth, scaledHeight, scaledWidth * 4,
+                            CatResampleFilterLanczos, CatResamplePathSIMD);
+    const uint8_t* b = simd.bytes;
+    for(NSUInteger i = 0; i < simd.length; i++) {
+        XCTAssertEqual(b[i], (uint8_t)90);
+    }
+
+    fillPattern(source.mutableBytes, source.length);
+    CatResampleRGBAFiltered(source.bytes, width, height, width * 4, scalar.mutableBytes, scaledWidth, scaledHeight, scaledWidth * 4,
+                            CatResampleFilterLanczos, CatResamplePathScalar);
+    CatResampleRGBAFiltered(source.bytes, width, height, width * 4, simd.mutableBytes, scaledWidth, scaledHeight, scaledWidth * 4,
+                            CatResampleFilterLanczos, CatResamplePathSIMD);
+    const uint8_t* a = scalar.bytes;
+    for(NSUInteger i = 0; i < scalar.length; i++) {
+        XCTAssertTrue(abs(a[i] - b[i]) <= 1);
+    }
+}
+
+- (void)testLanczosAvoidsMoire
+{
+    // One lit column in four, shrunk by 3.2: a box beats against the
+    // stripes, Lanczos settles on their average.
+    int width = 256, height = 2, scaledWidth = 80;
+    uint8_t source[256 * 2 * 4];
+    for(int i = 0; i < width * height; i++) {
+        memset(source + i * 4, (i % width) % 4 ? 0 : 255, 4);
+    }
+    uint8_t box[80 * 4], lanczos[80 * 4];
+    CatResampleRGBAFiltered(source, width, height, width * 4, box, scaledWidth, 1, scaledWidth * 4, CatResampleFilterBox, CatResamplePathScalar);
+    CatResampleRGBAFiltered(source, width, height, width * 4, lanczos, scaledWidth, 1, scaledWidth * 4, CatResampleFilterLanczos, CatResamplePathScalar);
+    int boxMin = 255, boxMax = 0, lanczosMin = 255, lanczosMax = 0;
+    for(int x = 4; x < scaledWidth - 4; x++) {
+        boxMin = MIN(boxMin, box[x * 4]);
+        boxMax = MAX(boxMax, box[x * 4]);
+        lanczosMin = MIN(lanczosMin, lanczos[x * 4]);
+        lanczosMax = MAX(lanczosMax, lanczos[x * 4]);
+    }
+    XCTAssertTrue(boxMax - boxMin > 32);
+    XCTAssertTrue(lanczosMax - lanczosMin < 8);
+}
+
+- (void)testBenchmarkThumbnailPaths
+{
+    // A snapshot rendered at twice the thumbnail size, iPhone and iPad cells at 2x.
+    int sizes[2][2] = { { 240, 184 }, { 380, 344 } };
+    for(int s = 0; s < 2; s++) {
+        int width = sizes[s][0] * 2, height = sizes[s][1] * 2;
+        NSMutableData* source = [NSMutableData dataWithLength:width * height * 4];
+        fillPattern(source.mutableBytes, source.length);
+        NSMutableData* destination = [NSMutableData dataWithLength:sizes[s][0] * sizes[s][1] * 4];
+        for(int filter = CatResampleFilterBox; filter <= CatResampleFilterLanczos; filter++) {
+            double milliseconds[2];
+            for(int path = CatResamplePathScalar; path <= CatResamplePathSIMD; path++) {
+                uint64_t start = CatMetricsNow();
+                for(int i = 0; i < 20; i++) {
+                    CatResampleRGBAFiltered(source.bytes, width, height, width * 4, destination.mutableBytes, sizes[s][0], sizes[s][1], sizes[s][0] * 4,
+                                            filter, path);
+                }
+                milliseconds[path] = (CatMetricsNow() - start) / 20e6;
+            }
+            NSLog(@"%@ %dx%d -> %dx%d: scalar %.2fms, SIMD %.2fms", filter == CatResampleFilterBox ? @"box" : @"lanczos",
+                  width, height, sizes[s][0], sizes[s][1], milliseconds[0], milliseconds[1]);
+        }
+    }
+}
+
+- (void)testRejectsEmptySizes
+{
+    uint8_t pixel[4] = { 0 };
+    XCTAssertEqual(CatResampleRGBA(pixel, 0, 1, 4, pixel, 1, 1, 4, CatResamplePathScalar), -1);
+    XCTAssertEqual(CatResampleRGBA(pixel, 1, 1, 4, pixel, 1, 0, 4, CatResamplePathScalar), -1);
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+//  CatSearchDebouncerTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/27/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatSearchDebouncer.h"
+
+@interface CatSearchDebouncerTests : XCTestCase
+@end
+
+@implementation CatSearchDebouncerTests
+{
+    NSMutableArray* loaded;
+    CatSearchDebouncer* debouncer;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    loaded = [NSMutableArray array];
+    NSMutableArray* queries = loaded;
+    debouncer = [[CatSearchDebouncer alloc] initWithQuietPeriod:.1 handler:^(NSString* query) {
+        [queries addObject:query];
+    }];
+}
+
+- (void)spin:(NSTimeInterval)interval
+{
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:interval]];
+}
+
+- (void)testOnlyTheLastQueryOfABurstLoads
+{
+    NSString* query = @"fluffy kittens in boxes";
+    for(NSUInteger i=1; i<=query.length; i++) {
+        [debouncer submitQuery:[query substringToIndex:i]];
+        [self spin:.01];
+    }
+    XCTAssertEqual(loaded.count, (NSUInteger)0);
+    [self spin:.3];
+    XCTAssertEqualObjects(loaded, @[query]);
+    XCTAssertEqual(debouncer.submittedQueries, query.length);
+    XCTAssertEqual(debouncer.loadedQueries, (NSUInteger)1);
+    XCTAssertEqual(debouncer.avoidedLoads, query.length - 1);
+}
+
+- (void)testPausesLoadEachQuery
+{
+    [debouncer submitQuery:@"cat"];
+    [self spin:.3];
+    [debouncer submitQuery:@"cats"];
+    [self spin:.3];
+    XCTAssertEqualObjects(loaded, (@[@"cat", @"cats"]));
+    XCTAssertEqual(debouncer.avoidedLoads, (NSUInteger)0);
+}
+
+- (void)testFlushAndCancel
+{
+    [debouncer submitQuery:@"tabby"];
+    [debouncer flush];
+    XCTAssertEqualObjects(loaded, @[@"tabby"]);
+    XCTAssertNil(debouncer.pendingQuery);
+
+    [debouncer submitQuery:@"calico"];
+    [debouncer cancel];
+    [self spin:.3];
+    XCTAssertEqualObjects(loaded, @[@"tabby"]);
+    XCTAssertEqual(debouncer.avoidedLoads, (NSUInteger)1);
+    [debouncer flush];
+    XCTAssertEqual(loaded.count, (NSUInteger)1);
+}
+
+@end
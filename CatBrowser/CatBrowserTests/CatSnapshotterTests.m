@@ -0,0 +1,138 @@
+//
+//  CatSnapshotterTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/30/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatSnapshotter.h"
+#import "CatTileHash.h"
+#import "CatMetrics.h"
+
+@interface CatSnapshotterTests : XCTestCase
+@end
+
+@implementation CatSnapshotterTests
+
+- (void)testTilesPinpointChanges
+{
+    int width = 100, height = 70, tileSize = 16, columns, rows;
+    size_t count = CatTileCount(width, height, tileSize, &columns, &rows);
+    XCTAssertEqual(columns, 7);
+    XCTAssertEqual(rows, 5);
+    uint8_t* pixels = calloc(width * height, 4);
+    uint64_t* previous = calloc(count, sizeof(uint64_t));
+    uint64_t* current = calloc(count, sizeof(uint64_t));
+    CatTileRect changed;
+
+    CatTileHashRGBA(pixels, width, height, width * 4, tileSize, current);
+    CatTileDiff(previous, current, width, height, tileSize, NULL);
+    CatTileHashRGBA(pixels, width, height, width * 4, tileSize, current);
+    XCTAssertEqual(CatTileDiff(previous, current, width, height, tileSize, &changed), (size_t)0);
+    XCTAssertEqual(changed.width, 0);
+
+    // One pixel in the cut short corner tile, one in the middle.
+    pixels[(69 * width + 99) * 4 + 2] = 1;
+    pixels[(20 * width + 40) * 4] = 255;
+    CatTileHashRGBA(pixels, width, height, width * 4, tileSize, current);
+    XCTAssertEqual(CatTileDiff(previous, current, width, height, tileSize, &changed), (size_t)2);
+    XCTAssertEqual(changed.x, 32);
+    XCTAssertEqual(changed.y, 16);
+    XCTAssertEqual(changed.width, 68);
+    XCTAssertEqual(changed.height, 54);
+    XCTAssertEqual(CatTileDiff(previous, current, width, height, tileSize, NULL), (size_t)0);
+    free(pixels);
+    free(previous);
+    free(current);
+}
+
+- (void)testPublishesOnlyChanges
+{
+    UIView* view = [[UIView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)];
+    view.backgroundColor = [UIColor whiteColor];
+    CatSnapshotter* snapshotter = [[CatSnapshotter alloc] initWithThumbnailSize:CGSizeMake(120, 92) scale:2];
+    XCTAssertTrue([snapshotter captureView:view offset:0]);
+    XCTAssertEqual(snapshotter.image.size.width, (CGFloat)120);
+    XCTAssertEqual(snapshotter.changedTiles, snapshotter.tileCount);
+
+    // An idle page: rendered once more to find it unchanged, then not until told.
+    for(int tick=0; tick<20; tick++) {
+        XCTAssertFalse([snapshotter captureView:view offset:0]);
+    }
+    XCTAssertEqual(snapshotter.publishedFrames, (NSUInteger)1);
+    XCTAssertEqual(snapshotter.renderedFrames, (NSUInteger)2);
+    XCTAssertEqual(snapshotter.skippedFrames, (NSUInteger)19);
+
+    UIView* box = [[UIView alloc] initWithFrame:CGRectMake(10, 10, 20, 20)];
+    box.backgroundColor = [UIColor redColor];
+    [view addSubview:box];
+    [snapshotter setNeedsCapture];
+    XCTAssertTrue([snapshotter captureView:view offset:0]);
+    XCTAssertTrue(snapshotter.changedTiles > 0 && snapshotter.changedTiles < snapshotter.tileCount / 4);
+    XCTAssertEqual(snapshotter.publishedFrames, (NSUInteger)2);
+}
+
+- (void)testPublishesFromTheQueueAndCoalesces
+{
+    UIView* view = [[UIView alloc] initWithFrame:CGRectMake(0, 0, 320, 480)];
+    view.backgroundColor = [UIColor greenColor];
+    CatSnapshotter* snapshotter = [[CatSnapshotter alloc] initWithThumbnailSize:CGSizeMake(120, 92) scale:2];
+    __block NSUInteger published = 0;
+    void (^publish)(UIImage*) = ^(UIImage* image) {
+        XCTAssertTrue([NSThread isMainThread]);
+        XCTAssertEqual(image.size.width, (CGFloat)120);
+        published++;
+    };
+    [snapshotter captureView:view offset:0 publish:publish];
+    // Still processing the first frame: dropped, not queued.
+    [snapshotter captureView:view offset:0 publish:publish];
+    XCTAssertEqual(snapshotter.renderedFrames, (NSUInteger)1);
+    XCTAssertEqual(snapshotter.skippedFrames, (NSUInteger)1);
+
+    NSDate* timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    while(!published && [timeout timeIntervalSinceNow] > 0) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:.01]];
+    }
+    XCTAssertEqual(published, (NSUInteger)1);
+    XCTAssertNotNil(snapshotter.image);
+}
+
+- (void)testQualities
+{
+    UIView* view = [[UIView alloc] initWithFrame:CGRectMake(0, 0, 768, 1024)];
+    view.backgroundColor = [UIColor blueColor];
+    for(CatSnapshotQuality quality = CatSnapshotDirect; quality <= CatSnapshotLanczos; quality++) {
+        CatSnapshotter* snapshotter = [[CatSnapshotter alloc] initWithThumbnailSize:CGSizeMake(190, 172) scale:2 quality:quality];
+        uint64_t start = CatMetricsNow();
+        XCTAssertTrue([snapshotter captureView:view offset:0]);
+        NSLog(@"quality %d: captured in %.2fms", quality, (CatMetricsNow() - start) / 1e6);
+        XCTAssertEqual(snapshotter.image.size.width, (CGFloat)190);
+        XCTAssertEqual(snapshotter.image.scale, (CGFloat)2);
+    }
+}
+
+- (void)testBenchmarkHashing
+{
+    int width = 380, height = 344;
+    uint8_t* pixels = malloc(width * height * 4);
+    for(int i=0; i<width*height*4; i++) {
+        pixels[i] = (uint8_t)random();
+    }
+    size_t count = CatTileCount(width, height, 16, NULL, NULL);
+    uint64_t* previous = calloc(count, sizeof(uint64_t));
+    uint64_t* current = calloc(count, sizeof(uint64_t));
+    uint64_t start = CatMetricsNow();
+    for(int i=0; i<1000; i++) {
+        CatTileHashRGBA(pixels, width, height, width * 4, 16, current);
+        CatTileDiff(previous, current, width, height, 16, NULL);
+    }
+    double microseconds = (CatMetricsNow() - start) / 1000. / 1000.;
+    NSLog(@"%dx%d thumbnail: hashed and compared in %.1fus", width, height, microseconds);
+    free(pixels);
+    free(previous);
+    free(current);
+}
+
+@end
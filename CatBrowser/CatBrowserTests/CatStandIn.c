@@ -0,0 +1,507 @@
+//
+//  CatStandIn.c
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/15/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+// Sockets, threads and nanosleep under -std=c99. Darwin keeps sin_len
+// and SO_NOSIGPIPE visible with _DARWIN_C_SOURCE.
+#define _XOPEN_SOURCE 700
+#define _DARWIN_C_SOURCE
+
+#include "CatStandIn.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+// Linux has no SO_NOSIGPIPE, Darwin no MSG_NOSIGNAL: whichever exists
+// keeps a client hanging up from killing the test with SIGPIPE.
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct CatStandInBody {
+    struct CatStandInBody* next;
+    int references;
+    char* type;                 // NULL for the default body
+    char* contentType;
+    size_t length;
+    char bytes[];
+} CatStandInBody;
+
+struct CatStandIn {
+    pthread_mutex_t lock;
+    int references;             // the owner, plus one per connection being served
+    CatStandInSettings settings;
+    CatStandInCounters counters;
+    CatStandInBody* bodies;
+    char* redirectLocation;
+    uint64_t seed;
+    int listener;
+    int wake[2];
+    pthread_t acceptThread;
+    int running;
+};
+
+typedef struct {
+    CatStandIn* server;
+    int client;
+} CatStandInConnection;
+
+static char* CatStandInCopy(const char* string)
+{
+    if(!string) {
+        return NULL;
+    }
+    size_t length = strlen(string) + 1;
+    return memcpy(malloc(length), string, length);
+}
+
+static void CatStandInSleep(double seconds)
+{
+    struct timespec time = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&time, NULL);
+}
+
+static void CatStandInReleaseBody(CatStandInBody* body)
+{
+    if(--body->references == 0) {
+        free(body->type);
+        free(body->contentType);
+        free(body);
+    }
+}
+
+// Called with the lock held, or by the last owner.
+static void CatStandInRemoveAllBodies(CatStandIn* server)
+{
+    while(server->bodies) {
+        CatStandInBody* body = server->bodies;
+        server->bodies = body->next;
+        CatStandInReleaseBody(body);
+    }
+}
+
+static void CatStandInRelease(CatStandIn* server)
+{
+    pthread_mutex_lock(&server->lock);
+    int references = --server->references;
+    pthread_mutex_unlock(&server->lock);
+    if(references) {
+        return;
+    }
+    CatStandInRemoveAllBodies(server);
+    free(server->redirectLocation);
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+}
+
+CatStandIn* CatStandInCreate(void)
+{
+    CatStandIn* server = calloc(1, sizeof(*server));
+    pthread_mutex_init(&server->lock, NULL);
+    server->references = 1;
+    server->settings.idleTimeout = 5;
+    server->listener = -1;
+    struct timeval time;
+    gettimeofday(&time, NULL);
+    server->seed = (uint64_t)time.tv_sec * 1000000 + time.tv_usec;
+    CatStandInSetBody(server, NULL, "image/jpeg", NULL, 0);
+    return server;
+}
+
+void CatStandInDestroy(CatStandIn* server)
+{
+    if(server) {
+        CatStandInStop(server);
+        CatStandInRelease(server);
+    }
+}
+
+void CatStandInGetSettings(CatStandIn* server, CatStandInSettings* settings)
+{
+    pthread_mutex_lock(&server->lock);
+    *settings = server->settings;
+    pthread_mutex_unlock(&server->lock);
+}
+
+void CatStandInSetSettings(CatStandIn* server, const CatStandInSettings* settings)
+{
+    pthread_mutex_lock(&server->lock);
+    server->settings = *settings;
+    pthread_mutex_unlock(&server->lock);
+}
+
+void CatStandInGetCounters(CatStandIn* server, CatStandInCounters* counters)
+{
+    pthread_mutex_lock(&server->lock);
+    *counters = server->counters;
+    pthread_mutex_unlock(&server->lock);
+}
+
+void CatStandInSetBody(CatStandIn* server, const char* type, const char* contentType, const void* bytes, size_t length)
+{
+    CatStandInBody* body = malloc(sizeof(*body) + length);
+    body->references = 1;
+    body->type = CatStandInCopy(type);
+    body->contentType = CatStandInCopy(contentType ? contentType : "application/octet-stream");
+    body->length = length;
+    if(length) {
+        memcpy(body->bytes, bytes, length);
+    }
+    pthread_mutex_lock(&server->lock);
+    CatStandInBody** link = &server->bodies;
+    while(*link && !((*link)->type == NULL ? type == NULL : type && !strcmp((*link)->type, type))) {
+        link = &(*link)->next;
+    }
+    if(*link) {
+        CatStandInBody* replaced = *link;
+        body->next = replaced->next;
+        CatStandInReleaseBody(replaced);
+    }
+    else {
+        body->next = NULL;
+    }
+    *link = body;
+    pthread_mutex_unlock(&server->lock);
+}
+
+void CatStandInRemoveBodies(CatStandIn* server)
+{
+    pthread_mutex_lock(&server->lock);
+    CatStandInRemoveAllBodies(server);
+    pthread_mutex_unlock(&server->lock);
+}
+
+void CatStandInSetRedirectLocation(CatStandIn* server, const char* location)
+{
+    char* copy = CatStandInCopy(location);
+    pthread_mutex_lock(&server->lock);
+    free(server->redirectLocation);
+    server->redirectLocation = copy;
+    pthread_mutex_unlock(&server->lock);
+}
+
+// MARK: Serving
+
+// The body for a type, falling back to the default one. Retained for the caller.
+static CatStandInBody* CatStandInBodyForType(CatStandIn* server, const char* type)
+{
+    pthread_mutex_lock(&server->lock);
+    CatStandInBody* found = NULL;
+    for(CatStandInBody* body = server->bodies; body; body = body->next) {
+        if(type && body->type && !strcmp(body->type, type)) {
+            found = body;
+            break;
+        }
+        if(!body->type && !found) {
+            found = body;
+        }
+    }
+    if(found) {
+        found->references++;
+    }
+    pthread_mutex_unlock(&server->lock);
+    return found;
+}
+
+static void CatStandInReleaseBodyLocked(CatStandIn* server, CatStandInBody* body)
+{
+    pthread_mutex_lock(&server->lock);
+    CatStandInReleaseBody(body);
+    pthread_mutex_unlock(&server->lock);
+}
+
+// The type= parameter, or else the extension of the last path component.
+static int CatStandInTypeInTarget(const char* target, char* type, size_t capacity)
+{
+    const char* start = strstr(target, "type=");
+    size_t length;
+    if(start) {
+        start += 5;
+        length = strcspn(start, "&");
+    }
+    else {
+        const char* component = strrchr(target, '/');
+        start = strrchr(component ? component : target, '.');
+        if(!start || !start[1]) {
+            return 0;
+        }
+        start++;
+        length = strlen(start);
+    }
+    if(length >= capacity) {
+        length = capacity - 1;
+    }
+    memcpy(type, start, length);
+    type[length] = 0;
+    return 1;
+}
+
+// Reads the target of the next request, 0 when the client hung up.
+// Bytes past the request stay in pending for the next call.
+static int CatStandInReadRequest(int client, char* pending, size_t capacity, size_t* pendingLength, char* target, size_t targetCapacity)
+{
+    size_t scanned = 0;
+    while(1) {
+        for(size_t i = scanned + 3; i < *pendingLength; i++) {
+            if(memcmp(pending + i - 3, "\r\n\r\n", 4) == 0) {
+                const char* lineEnd = memchr(pending, '\r', i);
+                const char* space = memchr(pending, ' ', lineEnd - pending);
+                const char* start = space ? space + 1 : "/";
+                const char* end = space ? memchr(start, ' ', lineEnd - start) : start + 1;
+                size_t length = (size_t)((end ? end : lineEnd) - start);
+                if(length >= targetCapacity) {
+                    length = targetCapacity - 1;
+                }
+                memcpy(target, start, length);
+                target[length] = 0;
+                *pendingLength -= i + 1;
+                memmove(pending, pending + i + 1, *pendingLength);
+                return 1;
+            }
+        }
+        scanned = *pendingLength > 3 ? *pendingLength - 3 : 0;
+        if(*pendingLength == capacity) {
+            return 0;
+        }
+        ssize_t count = recv(client, pending + *pendingLength, capacity - *pendingLength, 0);
+        if(count <= 0) {
+            return 0;
+        }
+        *pendingLength += count;
+    }
+}
+
+static int CatStandInSend(CatStandIn* server, int client, const void* bytes, size_t length)
+{
+    while(length > 0) {
+        ssize_t count = send(client, bytes, length, MSG_NOSIGNAL);
+        if(count <= 0) {
+            return 0;
+        }
+        pthread_mutex_lock(&server->lock);
+        server->counters.bytesSent += count;
+        pthread_mutex_unlock(&server->lock);
+        bytes = (const char*)bytes + count;
+        length -= count;
+    }
+    return 1;
+}
+
+static const char* CatStandInStatusLine(const CatStandInSettings* settings, char* line, size_t capacity, const char* status)
+{
+    snprintf(line, capacity, settings->keepAlive ? "HTTP/1.1 %s\r\n" : "HTTP/1.0 %s\r\nConnection: close\r\n", status);
+    return line;
+}
+
+static int CatStandInRespond(CatStandIn* server, int client, const CatStandInSettings* settings, const char* status, const char* headers)
+{
+    char line[64], response[2048];
+    int length = snprintf(response, sizeof(response), "%s%sContent-Length: 0\r\n\r\n",
+                          CatStandInStatusLine(settings, line, sizeof(line), status), headers);
+    return CatStandInSend(server, client, response, (size_t)length < sizeof(response) ? (size_t)length : sizeof(response) - 1);
+}
+
+// Returns 0 when the connection can't carry another response.
+static int CatStandInAnswer(CatStandIn* server, int client, const char* target)
+{
+    CatStandInSettings settings;
+    pthread_mutex_lock(&server->lock);
+    settings = server->settings;
+    uint64_t serial = ++server->counters.requests;
+    server->seed = server->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint32_t draw = (uint32_t)(server->seed >> 32);
+    pthread_mutex_unlock(&server->lock);
+    if(settings.latency > 0) {
+        CatStandInSleep(settings.latency);
+    }
+
+    if(settings.errorRate > 0 && draw < settings.errorRate * UINT32_MAX) {
+        pthread_mutex_lock(&server->lock);
+        server->counters.errorsSent++;
+        pthread_mutex_unlock(&server->lock);
+        return CatStandInRespond(server, client, &settings, "503 Service Unavailable", "");
+    }
+
+    char type[64];
+    int hasType = CatStandInTypeInTarget(target, type, sizeof(type));
+    if(strncmp(target, "/images/", 8) != 0 && settings.redirects > 0) {
+        // /hop/1?type=gif -> /hop/2?type=gif -> ... -> /images/17.gif
+        unsigned long hop = strncmp(target, "/hop/", 5) == 0 ? strtoul(target + 5, NULL, 10) : 0;
+        char location[1024];
+        pthread_mutex_lock(&server->lock);
+        if(hop + 1 < settings.redirects) {
+            snprintf(location, sizeof(location), "/hop/%lu?type=%s", hop + 1, hasType ? type : "");
+        }
+        else if(server->redirectLocation) {
+            snprintf(location, sizeof(location), "%s", server->redirectLocation);
+        }
+        else {
+            snprintf(location, sizeof(location), "/images/%llu.%s", (unsigned long long)serial, hasType ? type : "jpg");
+        }
+        server->counters.redirectsSent++;
+        pthread_mutex_unlock(&server->lock);
+        char headers[1040];
+        snprintf(headers, sizeof(headers), "Location: %s\r\n", location);
+        return CatStandInRespond(server, client, &settings, "302 Found", headers);
+    }
+
+    CatStandInBody* body = CatStandInBodyForType(server, hasType ? type : NULL);
+    const char* contentType = body ? body->contentType : "application/octet-stream";
+    size_t length = body ? body->length : 0;
+    char line[64], header[512];
+    int headerLength = snprintf(header, sizeof(header), "%sContent-Type: %s\r\nContent-Length: %lu\r\n\r\n",
+                                CatStandInStatusLine(&settings, line, sizeof(line), "200 OK"), contentType, (unsigned long)length);
+    int complete = CatStandInSend(server, client, header, (size_t)headerLength < sizeof(header) ? (size_t)headerLength : sizeof(header) - 1);
+
+    size_t slice = settings.bytesPerSecond ? (settings.bytesPerSecond / 20 ? (size_t)(settings.bytesPerSecond / 20) : 1) : length;
+    for(size_t offset = 0; complete && offset < length; offset += slice) {
+        size_t count = slice < length - offset ? slice : length - offset;
+        complete = CatStandInSend(server, client, body->bytes + offset, count);
+        if(complete && settings.bytesPerSecond && offset + count < length) {
+            CatStandInSleep(.05);
+        }
+    }
+    if(body) {
+        CatStandInReleaseBodyLocked(server, body);
+    }
+    if(!complete) {
+        pthread_mutex_lock(&server->lock);
+        server->counters.abortedResponses++;
+        pthread_mutex_unlock(&server->lock);
+    }
+    return complete;
+}
+
+static void* CatStandInServe(void* argument)
+{
+    CatStandInConnection connection = *(CatStandInConnection*)argument;
+    free(argument);
+    CatStandIn* server = connection.server;
+    int client = connection.client;
+#ifdef SO_NOSIGPIPE
+    int yes = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+    pthread_mutex_lock(&server->lock);
+    double idleTimeout = server->settings.idleTimeout;
+    server->counters.connections++;
+    pthread_mutex_unlock(&server->lock);
+    struct timeval idle = { (time_t)idleTimeout, (suseconds_t)((idleTimeout - (time_t)idleTimeout) * 1000000) };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+
+    char* pending = malloc(65536);
+    size_t pendingLength = 0;
+    char target[4096];
+    while(CatStandInReadRequest(client, pending, 65536, &pendingLength, target, sizeof(target))
+          && CatStandInAnswer(server, client, target)) {
+        CatStandInSettings settings;
+        CatStandInGetSettings(server, &settings);
+        if(!settings.keepAlive) {
+            break;
+        }
+    }
+    free(pending);
+    close(client);
+    CatStandInRelease(server);
+    return NULL;
+}
+
+static void* CatStandInAccept(void* argument)
+{
+    CatStandIn* server = argument;
+    struct pollfd descriptors[2] = { { server->listener, POLLIN, 0 }, { server->wake[0], POLLIN, 0 } };
+    while(poll(descriptors, 2, -1) >= 0 && !descriptors[1].revents) {
+        if(!descriptors[0].revents) {
+            continue;
+        }
+        int client = accept(server->listener, NULL, NULL);
+        if(client < 0) {
+            continue;
+        }
+        CatStandInConnection* connection = malloc(sizeof(*connection));
+        connection->server = server;
+        connection->client = client;
+        pthread_mutex_lock(&server->lock);
+        server->references++;
+        pthread_mutex_unlock(&server->lock);
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, CatStandInServe, connection) != 0) {
+            close(client);
+            free(connection);
+            CatStandInRelease(server);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+// MARK: Lifetime
+
+int CatStandInStart(CatStandIn* server)
+{
+    if(server->running) {
+        return -1;
+    }
+    server->listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(server->listener < 0) {
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(server->listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+#ifdef __APPLE__
+    address.sin_len = sizeof(address);
+#endif
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if(bind(server->listener, (struct sockaddr*)&address, sizeof(address)) < 0
+       || listen(server->listener, 64) < 0
+       || getsockname(server->listener, (struct sockaddr*)&address, &length) < 0
+       || pipe(server->wake) < 0) {
+        close(server->listener);
+        server->listener = -1;
+        return -1;
+    }
+    if(pthread_create(&server->acceptThread, NULL, CatStandInAccept, server) != 0) {
+        close(server->wake[0]);
+        close(server->wake[1]);
+        close(server->listener);
+        server->listener = -1;
+        return -1;
+    }
+    server->running = 1;
+    return ntohs(address.sin_port);
+}
+
+void CatStandInStop(CatStandIn* server)
+{
+    if(!server->running) {
+        return;
+    }
+    ssize_t written = write(server->wake[1], "", 1);
+    (void)written;
+    pthread_join(server->acceptThread, NULL);
+    close(server->wake[0]);
+    close(server->wake[1]);
+    close(server->listener);
+    server->listener = -1;
+    server->running = 0;
+}
@@ -0,0 +1,68 @@
+//
+//  CatStandIn.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/15/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  The stand-in cat origin behind CatStandInServer, in plain C so the
+//  same server runs under XCTest and under ctest on Linux. One thread
+//  accepts on the loopback interface, one thread serves each connection.
+//  Settings and bodies can change while it runs; each answer uses the
+//  ones current when the request arrived.
+//
+
+#ifndef CatBrowser_CatStandIn_h
+#define CatBrowser_CatStandIn_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CatStandIn CatStandIn;
+
+typedef struct {
+    double latency;             // seconds before each answer
+    uint64_t bytesPerSecond;    // 0 means unthrottled
+    double errorRate;           // fraction of requests answered 503
+    unsigned redirects;         // 302 hops before the image is served
+    int keepAlive;              // HTTP/1.1 persistent connections, pipelined requests answered in order
+    double idleTimeout;         // keep-alive connections are closed after this, default 5s
+} CatStandInSettings;
+
+typedef struct {
+    uint64_t connections;
+    uint64_t requests;
+    uint64_t abortedResponses;  // client hung up before the body was sent
+    uint64_t bytesSent;
+    uint64_t errorsSent;
+    uint64_t redirectsSent;
+} CatStandInCounters;
+
+CatStandIn* CatStandInCreate(void);
+// Stops accepting. Connections still being served finish on their own.
+void CatStandInDestroy(CatStandIn* server);
+
+// Returns the port, or -1 when the socket can't be set up.
+int CatStandInStart(CatStandIn* server);
+void CatStandInStop(CatStandIn* server);
+
+void CatStandInGetSettings(CatStandIn* server, CatStandInSettings* settings);
+void CatStandInSetSettings(CatStandIn* server, const CatStandInSettings* settings);
+void CatStandInGetCounters(CatStandIn* server, CatStandInCounters* counters);
+
+// The body for a type= parameter or path extension, or with a NULL type
+// the one every other request gets. The bytes are copied.
+void CatStandInSetBody(CatStandIn* server, const char* type, const char* contentType, const void* bytes, size_t length);
+void CatStandInRemoveBodies(CatStandIn* server);
+// Where the last redirect hop points instead of /images/<n>.<type>, NULL to reset.
+void CatStandInSetRedirectLocation(CatStandIn* server, const char* location);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
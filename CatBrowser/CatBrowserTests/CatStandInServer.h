@@ -0,0 +1,47 @@
+//
+//  CatStandInServer.h
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/15/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+//  Minimal HTTP/1.0 server on the loopback interface standing in for the
+//  cat origin in tests. Requests are answered after a fixed latency and
+//  throttled to a given bandwidth. Like thecatapi, it can redirect to the
+//  image, pick the body from the type= parameter and fail at random.
+//  With keepAlive it speaks HTTP/1.1 persistent connections and answers
+//  pipelined requests in order. The server itself is CatStandIn.c, which
+//  the Linux page load driver (CatPageLoad.c) runs as well.
+//
+
+#import <Foundation/Foundation.h>
+
+@interface CatStandInServer : NSObject
+
+- (BOOL) start;
+- (void) stop;
+
+@property (readonly) unsigned short port;
+@property (readonly) NSURL* baseURL;
+
+@property NSData* body;
+@property NSString* contentType;
+@property NSTimeInterval latency;
+@property NSUInteger bytesPerSecond;    // 0 means unthrottled
+// type -> @{@"body": NSData, @"contentType": NSString}, chosen by the type=
+// parameter or the path extension. Other requests get body and contentType.
+@property NSDictionary* bodiesByType;
+@property double errorRate;             // fraction of requests answered 503
+@property NSUInteger redirects;         // 302 hops before the image is served
+@property NSString* redirectLocation;   // where the last hop points instead, if set
+@property BOOL keepAlive;
+@property NSTimeInterval idleTimeout;   // keep-alive connections are closed after this, default 5s
+
+@property (readonly) NSUInteger connections;
+@property (readonly) NSUInteger requests;
+@property (readonly) NSUInteger abortedResponses;   // client hung up before the body was sent
+@property (readonly) unsigned long long bytesSent;
+@property (readonly) NSUInteger errorsSent;
+@property (readonly) NSUInteger redirectsSent;
+
+@end
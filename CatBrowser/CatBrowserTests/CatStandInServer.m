@@ -0,0 +1,242 @@
+//
+//  CatStandInServer.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/15/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import "CatStandInServer.h"
+#include "CatStandIn.h"
+
+@implementation CatStandInServer
+{
+    CatStandIn* standIn;
+}
+
+@synthesize body = _body, contentType = _contentType, bodiesByType = _bodiesByType, redirectLocation = _redirectLocation;
+
+- (id) init
+{
+    if(self = [super init]) {
+        standIn = CatStandInCreate();
+        _contentType = @"image/jpeg";
+        _body = [NSData data];
+    }
+    return self;
+}
+
+- (void) dealloc
+{
+    CatStandInDestroy(standIn);
+}
+
+- (BOOL) start
+{
+    int port = CatStandInStart(standIn);
+    if(port < 0) {
+        return NO;
+    }
+    _port = (unsigned short)port;
+    _baseURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%d/", _port]];
+    return YES;
+}
+
+- (void) stop
+{
+    CatStandInStop(standIn);
+}
+
+#pragma mark Bodies
+
+- (void) updateBodies
+{
+    @synchronized(self) {
+        CatStandInRemoveBodies(standIn);
+        CatStandInSetBody(standIn, NULL, _contentType.UTF8String, _body.bytes, _body.length);
+        for(NSString* type in _bodiesByType) {
+            NSDictionary* typed = _bodiesByType[type];
+            NSData* body = typed[@"body"];
+            CatStandInSetBody(standIn, type.UTF8String, [typed[@"contentType"] UTF8String], body.bytes, body.length);
+        }
+    }
+}
+
+- (NSData*) body
+{
+    @synchronized(self) {
+        return _body;
+    }
+}
+
+- (void) setBody:(NSData*)body
+{
+    @synchronized(self) {
+        _body = [body copy];
+    }
+    [self updateBodies];
+}
+
+- (NSString*) contentType
+{
+    @synchronized(self) {
+        return _contentType;
+    }
+}
+
+- (void) setContentType:(NSString*)contentType
+{
+    @synchronized(self) {
+        _contentType = [contentType copy];
+    }
+    [self updateBodies];
+}
+
+- (NSDictionary*) bodiesByType
+{
+    @synchronized(self) {
+        return _bodiesByType;
+    }
+}
+
+- (void) setBodiesByType:(NSDictionary*)bodiesByType
+{
+    @synchronized(self) {
+        _bodiesByType = [bodiesByType copy];
+    }
+    [self updateBodies];
+}
+
+- (NSString*) redirectLocation
+{
+    @synchronized(self) {
+        return _redirectLocation;
+    }
+}
+
+- (void) setRedirectLocation:(NSString*)redirectLocation
+{
+    @synchronized(self) {
+        _redirectLocation = [redirectLocation copy];
+    }
+    CatStandInSetRedirectLocation(standIn, redirectLocation.UTF8String);
+}
+
+#pragma mark Settings
+
+- (CatStandInSettings) settings
+{
+    CatStandInSettings settings;
+    CatStandInGetSettings(standIn, &settings);
+    return settings;
+}
+
+- (void) updateSettings:(void (^)(CatStandInSettings* settings))change
+{
+    @synchronized(self) {
+        CatStandInSettings settings = self.settings;
+        change(&settings);
+        CatStandInSetSettings(standIn, &settings);
+    }
+}
+
+- (NSTimeInterval) latency
+{
+    return self.settings.latency;
+}
+
+- (void) setLatency:(NSTimeInterval)latency
+{
+    [self updateSettings:^(CatStandInSettings* settings) { settings->latency = latency; }];
+}
+
+- (NSUInteger) bytesPerSecond
+{
+    return (NSUInteger)self.settings.bytesPerSecond;
+}
+
+- (void) setBytesPerSecond:(NSUInteger)bytesPerSecond
+{
+    [self updateSettings:^(CatStandInSettings* settings) { settings->bytesPerSecond = bytesPerSecond; }];
+}
+
+- (double) errorRate
+{
+    return self.settings.errorRate;
+}
+
+- (void) setErrorRate:(double)errorRate
+{
+    [self updateSettings:^(CatStandInSettings* settings) { settings->errorRate = errorRate; }];
+}
+
+- (NSUInteger) redirects
+{
+    return self.settings.redirects;
+}
+
+- (void) setRedirects:(NSUInteger)redirects
+{
+    [self updateSettings:^(CatStandInSettings* settings) { settings->redirects = (unsigned)redirects; }];
+}
+
+- (BOOL) keepAlive
+{
+    return self.settings.keepAlive != 0;
+}
+
+- (void) setKeepAlive:(BOOL)keepAlive
+{
+    [self updateSettings:^(CatStandInSettings* settings) { settings->keepAlive = keepAlive; }];
+}
+
+- (NSTimeInterval) idleTimeout
+{
+    return self.settings.idleTimeout;
+}
+
+- (void) setIdleTimeout:(NSTimeInterval)idleTimeout
+{
+    [self updateSettings:^(CatStandInSettings* settings) { settings->idleTimeout = idleTimeout; }];
+}
+
+#pragma mark Counters
+
+- (CatStandInCounters) counters
+{
+    CatStandInCounters counters;
+    CatStandInGetCounters(standIn, &counters);
+    return counters;
+}
+
+- (NSUInteger) connections
+{
+    return (NSUInteger)self.counters.connections;
+}
+
+- (NSUInteger) requests
+{
+    return (NSUInteger)self.counters.requests;
+}
+
+- (NSUInteger) abortedResponses
+{
+    return (NSUInteger)self.counters.abortedResponses;
+}
+
+- (unsigned long long) bytesSent
+{
+    return self.counters.bytesSent;
+}
+
+- (NSUInteger) errorsSent
+{
+    return (NSUInteger)self.counters.errorsSent;
+}
+
+- (NSUInteger) redirectsSent
+{
+    return (NSUInteger)self.counters.redirectsSent;
+}
+
+@end
@@ -0,0 +1,86 @@
+//
+//  CatSuggestionEngineTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/28/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatSuggestionEngine.h"
+
+@interface CatSuggestionEngineTests : XCTestCase
+@end
+
+@implementation CatSuggestionEngineTests
+{
+    CatSuggestionEngine* engine;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    engine = [[CatSuggestionEngine alloc] init];
+}
+
+- (NSArray*)locationsFor:(NSString*)text
+{
+    return [[engine suggestionsForText:text limit:10] valueForKey:@"location"];
+}
+
+- (void)testMatchesLocationsAndTitleWords
+{
+    [engine noteVisitToLocation:@"https://www.apple.com/iphone/" title:@"Apple - iPhone"];
+    [engine noteVisitToLocation:@"http://en.wikipedia.org/wiki/Cat" title:@"Cat - Wikipedia, the free encyclopedia"];
+    XCTAssertEqualObjects([self locationsFor:@"app"], @[@"https://www.apple.com/iphone/"]);
+    XCTAssertEqualObjects([self locationsFor:@"www.apple.com/i"], @[@"https://www.apple.com/iphone/"]);
+    XCTAssertEqualObjects([self locationsFor:@"IPHO"], @[@"https://www.apple.com/iphone/"]);
+    XCTAssertEqualObjects([self locationsFor:@"encyc"], @[@"http://en.wikipedia.org/wiki/Cat"]);
+    XCTAssertEqualObjects([self locationsFor:@"cat free"], @[@"http://en.wikipedia.org/wiki/Cat"]);
+    XCTAssertEqualObjects([self locationsFor:@"cat dog"], @[]);
+    XCTAssertEqualObjects([self locationsFor:@"zebra"], @[]);
+    XCTAssertEqualObjects([self locationsFor:@"  "], @[]);
+}
+
+- (void)testRanksByFrecency
+{
+    NSDate* now = [NSDate date];
+    NSDate* monthAgo = [now dateByAddingTimeInterval:-30 * 24 * 3600];
+    for(int i=0; i<5; i++) {
+        [engine noteVisitToLocation:@"http://news.example.com/old" title:@"News" date:monthAgo];
+    }
+    [engine noteVisitToLocation:@"http://news.example.com/recent" title:@"News" date:now];
+    [engine noteVisitToLocation:@"http://news.example.com/once" title:@"News" date:[now dateByAddingTimeInterval:-3600]];
+    // Five visits a month ago are worth less than one today.
+    XCTAssertEqualObjects([self locationsFor:@"news"], (@[@"http://news.example.com/recent", @"http://news.example.com/once", @"http://news.example.com/old"]));
+    [engine noteVisitToLocation:@"http://news.example.com/once" title:@"News" date:now];
+    XCTAssertEqualObjects([self locationsFor:@"news"].firstObject, @"http://news.example.com/once");
+}
+
+- (void)testBookmarks
+{
+    [engine noteVisitToLocation:@"http://cats.example.com/daily" title:@"Daily cats"];
+    [engine setBookmarks:@[
+        @{ @"title": @"Cat videos", @"location": @"http://cats.example.com/videos" },
+        @{ @"title": @"Not kept", @"location": @"http://cats.example.com/skip", @"not-favorite": @YES },
+    ]];
+    XCTAssertEqual(engine.count, (NSUInteger)2);
+    CatSuggestion* first = [engine suggestionsForText:@"cats" limit:1].firstObject;
+    XCTAssertEqualObjects(first.location, @"http://cats.example.com/videos");
+    XCTAssertTrue(first.bookmarked);
+
+    [engine setBookmarks:@[]];
+    XCTAssertEqual(engine.count, (NSUInteger)1);
+    XCTAssertEqualObjects([self locationsFor:@"cat"], @[@"http://cats.example.com/daily"]);
+}
+
+- (void)testLimit
+{
+    for(int i=0; i<20; i++) {
+        [engine noteVisitToLocation:[NSString stringWithFormat:@"http://example.com/%d", i] title:nil];
+    }
+    XCTAssertEqual([engine suggestionsForText:@"example" limit:3].count, (NSUInteger)3);
+    XCTAssertEqual([engine suggestionsForText:@"example" limit:50].count, (NSUInteger)8);
+}
+
+@end
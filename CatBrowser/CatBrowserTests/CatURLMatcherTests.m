@@ -0,0 +1,123 @@
+//
+//  CatURLMatcherTests.m
+//  CatBrowser
+//
+//  Created by Vincent Le Quang on 4/12/14.
+//  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "CatURLMatcher.h"
+
+static const CatURLRule testRules[] = {
+    { CatURLRuleExtension, "jpg" },
+    { CatURLRuleExtension, "jpeg" },
+    { CatURLRuleScheme, "data" },
+    { CatURLRuleSubstring, "://encrypted-tbn" },
+    { CatURLRuleSubstring, "googleusercontent.com" },
+    { CatURLRuleExclude, "data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D" },
+};
+
+@interface CatURLMatcherTests : XCTestCase
+{
+    CatURLMatcher* matcher;
+}
+@end
+
+@implementation CatURLMatcherTests
+
+- (void)setUp
+{
+    [super setUp];
+    matcher = CatURLMatcherCreate(testRules, sizeof(testRules)/sizeof(testRules[0]));
+    XCTAssert(matcher != NULL);
+}
+
+- (void)tearDown
+{
+    CatURLMatcherRelease(matcher);
+    [super tearDown];
+}
+
+- (int)match:(const char*)url
+{
+    int rule = kCatURLNoRule;
+    CatURLMatcherMatch(matcher, url, strlen(url), &rule);
+    return rule;
+}
+
+- (void)testExtensions
+{
+    XCTAssertEqual([self match:"http://example.com/cats/tabby.jpg"], 0);
+    XCTAssertEqual([self match:"http://example.com/cats/tabby.JPEG?size=2"], 1);
+    XCTAssertEqual([self match:"http://example.com/cats/tabby.jpgx"], kCatURLNoRule);
+    XCTAssertEqual([self match:"http://example.com/tabby.jpg/index.html"], kCatURLNoRule);
+    XCTAssertEqual([self match:"http://tabby.jpg/"], kCatURLNoRule);
+}
+
+- (void)testSchemesAndSubstrings
+{
+    XCTAssertEqual([self match:"data:image/png;base64,iVBORw0KGgo="], 2);
+    XCTAssertEqual([self match:"https://encrypted-tbn1.gstatic.com/images?q=tbn:abc"], 3);
+    XCTAssertEqual([self match:"https://lh4.GoogleUserContent.com/photo=s64"], 4);
+    XCTAssertEqual([self match:"https://www.google.com/#q=cats"], kCatURLNoRule);
+}
+
+- (void)testExclusionIsExact
+{
+    const char* pixel = testRules[5].pattern;
+    XCTAssertEqual([self match:pixel], 5);
+    XCTAssertFalse(CatURLMatcherMatch(matcher, pixel, strlen(pixel), NULL));
+
+    char longer[128];
+    snprintf(longer, sizeof(longer), "%sA", pixel);
+    XCTAssertTrue(CatURLMatcherMatch(matcher, longer, strlen(longer), NULL));
+}
+
+- (void)testIncrementalScanMatchesOneShot
+{
+    const char* url = "https://lh4.googleusercontent.com/photo.jpg";
+    CatURLScan scan;
+    CatURLScanBegin(&scan, matcher);
+    for(size_t i = 0; url[i]; i++) {
+        if(CatURLScanFeed(&scan, url + i, 1)) {
+            break;
+        }
+    }
+    int rule = kCatURLNoRule;
+    XCTAssertTrue(CatURLScanEnd(&scan, &rule));
+    XCTAssertEqual(rule, 4);
+}
+
+- (void)testHostRules
+{
+    static const CatURLRule hostRules[] = {
+        { CatURLRuleExtension, "jpg" },
+        { CatURLRuleSubstring, "googleusercontent.com" },
+        { CatURLRuleDenyHost, "Ads.Example.com" },
+        { CatURLRuleAllowHost, "example.com" },
+        { CatURLRuleAllowHost, "googleusercontent.com" },
+    };
+    CatURLMatcher* hosts = CatURLMatcherCreate(hostRules, sizeof(hostRules)/sizeof(hostRules[0]));
+    XCTAssert(hosts != NULL);
+
+    const char* urls[] = {
+        "http://example.com/tabby.jpg",
+        "http://www.EXAMPLE.com:8080/tabby.jpg",
+        "https://lh4.googleusercontent.com/photo=s64",
+        "http://ads.example.com/tabby.jpg",
+        "http://user@cdn.ads.example.com/tabby.jpg",
+        "http://notexample.com/tabby.jpg",
+        "http://example.com.evil.org/tabby.jpg",
+    };
+    const int expected[] = { 0, 0, 1, 2, 2, kCatURLNoRule, kCatURLNoRule };
+    const int intercepted[] = { 1, 1, 1, 0, 0, 0, 0 };
+    for(size_t i = 0; i < sizeof(urls)/sizeof(urls[0]); i++) {
+        int rule = kCatURLNoRule;
+        XCTAssertEqual(CatURLMatcherMatch(hosts, urls[i], strlen(urls[i]), &rule), intercepted[i], @"%s", urls[i]);
+        XCTAssertEqual(rule, expected[i], @"%s", urls[i]);
+    }
+    CatURLMatcherRelease(hosts);
+}
+
+@end
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+#
+#  make-url-corpus.py
+#  CatBrowser
+#
+#  Created by Vincent Le Quang on 4/20/14.
+#  Copyright (c) 2014 Dobuki Studio. All rights reserved.
+#
+#  Writes url-corpus.txt: "label<tab>url" per line, 1 for an image that
+#  should become a cat. The URLs are generated, not recorded: the hosts,
+#  path shapes and data URIs of the pages the browser is used on, mixed
+#  with scripts, styles and pages that must pass, and a few images the
+#  rules are known to miss. The seed is fixed, so the file comes out the
+#  same every time.
+#
+
+import base64, os, random
+
+random.seed(7)
+lines=[]
+def add(label,url): lines.append(f"{label}\t{url}")
+hosts=["upload.wikimedia.org","i.imgur.com","pbs.twimg.com","images.nytimes.com","cdn.cnn.com","static01.nyt.com","media.giphy.com","s.yimg.com","fbcdn-sphotos-a-a.akamaihd.net","farm4.staticflickr.com"]
+words=["cat","kitten","tabby","siamese","sunset","profile","hero","banner","thumb","photo","IMG_2041","DSC0043","logo","avatar"]
+for i in range(120):
+    h=random.choice(hosts); w=random.choice(words); ext=random.choice(["jpg","JPG","png","gif","jpeg","bmp"])
+    path="/".join(random.choice(["images","2014","04","wikipedia/commons/thumb/a/a3","media","static","u","photos"]) for _ in range(random.randint(1,4)))
+    q=random.choice(["","?w=640","?v=3&size=large","#frag",""])
+    add(1,f"http{random.choice(['','s'])}://{h}/{path}/{w}_{random.randint(1,9999)}.{ext}{q}")
+for i in range(50):
+    add(1,f"https://encrypted-tbn{random.randint(0,3)}.gstatic.com/images?q=tbn:ANd9GcR{''.join(random.choice('abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-') for _ in range(60))}")
+for i in range(40):
+    add(1,f"https://lh{random.randint(3,6)}.googleusercontent.com/-{''.join(random.choice('abcdefghijkABCDEFG0123456789') for _ in range(11))}/AAAAAAAAAAI/AAAAAAAAAAA/{''.join(random.choice('abcdefgXYZ0123') for _ in range(11))}/s{random.choice([32,48,64,96,128])}-c/photo{random.choice(['','.jpg'])}")
+for i in range(20):
+    add(1,f"https://maps-api-ssl.google.com/maps/api/staticmap?center={random.uniform(-80,80):.5f},{random.uniform(-170,170):.5f}&zoom={random.randint(3,16)}&size=200x200&sensor=false")
+for i in range(30):
+    raw=bytes(random.getrandbits(8) for _ in range(random.randint(60,900)))
+    mime=random.choice(["png","jpeg","gif"])
+    add(1,f"data:image/{mime};base64,{base64.b64encode(raw).decode()}")
+for i in range(15):
+    add(0,"data:image/gif;base64,R0lGODlhAQABAID/AMDAwAAAACH5BAEAAAAALAAAAAABAAEAAAICRAEAOw%3D%3D")
+# non images
+for i in range(160):
+    h=random.choice(hosts+["www.google.com","ssl.gstatic.com","www.google-analytics.com","ajax.googleapis.com","fonts.googleapis.com","en.wikipedia.org"])
+    ext=random.choice(["js","css","html","json","woff","php","","aspx","svgz"])
+    path="/".join(random.choice(["js","css","static","api","v2","search","wiki","xjs","_","ui"]) for _ in range(random.randint(1,4)))
+    q=random.choice(["","?q=cats&hl=en","?callback=jsonp123&_=1397","#q=cat+pictures",""])
+    tail=f"{random.choice(words)}.{ext}" if ext else random.choice(words)
+    add(0,f"http{random.choice(['','s'])}://{h}/{path}/{tail}{q}")
+for i in range(15):
+    add(0,f"https://www.google.com/search?q={random.choice(words)}.jpg+{random.choice(words)}&tbm=isch")
+# real images the rules miss
+for i in range(10):
+    add(1,f"https://{random.choice(hosts)}/image?id={random.randint(1,99999)}&format=webp")
+for i in range(5):
+    add(1,f"https://{random.choice(hosts)}/icons/{random.choice(words)}.svg")
+random.shuffle(lines)
+path=os.path.join(os.path.dirname(os.path.abspath(__file__)),"url-corpus.txt")
+open(path,"w").write("\n".join(lines)+"\n")
+print(len(lines), "URLs written to", path)